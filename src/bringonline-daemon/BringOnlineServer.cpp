@@ -42,6 +42,7 @@ static void heartBeat(void)
 {
     unsigned myIndex=0, count=0;
     unsigned hashStart=0, hashEnd=0;
+    std::vector<std::pair<unsigned, unsigned>> hashRanges, lastHashRanges;
     const std::string service_name = "fts_bringonline";
     int heartBeatInterval;
     try {
@@ -70,6 +71,13 @@ static void heartBeat(void)
                 << std::dec
                 << commit;
 
+            db::DBSingleton::instance().getDBObjectInstance()->getHashSegment(&hashRanges);
+            if (hashRanges != lastHashRanges) {
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Hash ranges changed: " << hashRanges.size()
+                    << " ranges owned" << commit;
+                lastHashRanges = hashRanges;
+            }
+
             boost::this_thread::sleep(boost::posix_time::seconds(heartBeatInterval));
         }
         catch (const std::exception& ex) {
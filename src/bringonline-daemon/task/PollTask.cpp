@@ -32,7 +32,7 @@ void PollTask::run(const boost::any&)
     // handle cancelled jobs/files
     handle_canceled();
 
-    int maxPollRetries = fts3::config::ServerConfig::instance().get<int>("StagingPollRetries");
+    int maxPollRetries = fts3::config::ServerConfig::instance().values().stagingPollRetries;
     bool forcePoll = false;
 
     std::set<std::string> urlSet = ctx.getUrls();
@@ -64,12 +64,45 @@ std::string ConcurrentQueue::pop(int wait)
 }
 
 
-void ConcurrentQueue::push(const std::string &val)
+size_t ConcurrentQueue::popBatch(std::vector<std::string> &values, size_t max, int wait)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+
+    if (theQueue.empty() && wait > 0) {
+        cv.timed_wait(lock, boost::posix_time::seconds(wait));
+    }
+
+    size_t count = 0;
+    while (!theQueue.empty() && count < max) {
+        values.emplace_back(std::move(theQueue.front()));
+        theQueue.pop();
+        ++count;
+    }
+    return count;
+}
+
+
+bool ConcurrentQueue::push(const std::string &val)
 {
     boost::lock_guard<boost::mutex> lock(mutex);
-    if (theQueue.size() < ConcurrentQueue::MaxElements)
-        theQueue.push(val);
+    if (theQueue.size() >= ConcurrentQueue::MaxElements) {
+        return false;
+    }
+    theQueue.push(val);
+    cv.notify_one();
+    return true;
+}
+
+
+bool ConcurrentQueue::push(std::string &&val)
+{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    if (theQueue.size() >= ConcurrentQueue::MaxElements) {
+        return false;
+    }
+    theQueue.push(std::move(val));
     cv.notify_one();
+    return true;
 }
 
 
@@ -22,6 +22,8 @@
 #define CONCURRENT_QUEUE_H
 
 #include <queue>
+#include <string>
+#include <vector>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
@@ -51,7 +53,12 @@ public:
     size_t size();
 
     /// Push a new element into the queue
-    void push(const std::string &value);
+    /// Return false if the queue is full, and value has been left out
+    bool push(const std::string &value);
+
+    /// Push a new element into the queue, moving it in
+    /// Return false if the queue is full, and value has been left untouched
+    bool push(std::string &&value);
 
     /// Pop an element off the queue
     /// If wait is 0, return null if the queue is empty, otherwise wait until an item is placed in the queue
@@ -60,6 +67,10 @@ public:
     ///  wait = 0  => don't block, return null if the queue is empty
     /// wait > 0  => block for <block> seconds
     std::string pop(const int wait = -1);
+
+    /// Move up to max elements into values, waiting up to wait seconds if the queue is empty
+    /// Return how many were moved
+    size_t popBatch(std::vector<std::string> &values, size_t max, const int wait);
 };
 
 
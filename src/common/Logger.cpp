@@ -24,14 +24,225 @@
 #include "Exceptions.h"
 
 #include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
 #include <fstream>
+#include <memory>
+#include <vector>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
 
 
 namespace fts3 {
 namespace common {
 
 
+/// Maximum number of lines written in one go by the asynchronous writer
+static const size_t WRITE_BATCH_SIZE = IOV_MAX;
+/// How long the writer sleeps when there is nothing to do, unless woken up
+static const int WRITE_IDLE_WAIT_MS = 50;
+
+
+/// Output of a thread redirected with Logger::redirectThread
+class ThreadOutput
+{
+public:
+    int fd;
+
+    ThreadOutput(): fd(-1)
+    {
+    }
+
+    ~ThreadOutput()
+    {
+        reset(-1);
+    }
+
+    void reset(int newFd)
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = newFd;
+    }
+};
+
+static thread_local ThreadOutput threadOutput;
+
+
+/// Lines queued by one thread, for the asynchronous writer.
+/// There is a single producer, the owning thread, and a single consumer, whoever holds Logger::outMutex
+class LineQueue
+{
+public:
+    explicit LineQueue(unsigned capacity): slots(std::max(1u, capacity)), head(0), tail(0), closed(false)
+    {
+    }
+
+    /// On success, line is consumed
+    bool push(std::string &line)
+    {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= slots.size()) {
+            return false;
+        }
+        slots[h % slots.size()].swap(line);
+        // Sequentially consistent, so the writer either sees the line or is woken up
+        head.store(h + 1);
+        return true;
+    }
+
+    /// Move up to max lines into batch
+    size_t pop(std::vector<std::string> &batch, size_t max)
+    {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        // Sequentially consistent, paired with push, see Logger::flush
+        const size_t n = std::min<uint64_t>(head.load() - t, max);
+        for (size_t i = 0; i < n; ++i) {
+            batch.emplace_back();
+            batch.back().swap(slots[(t + i) % slots.size()]);
+        }
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    bool empty() const
+    {
+        return head.load() == tail.load();
+    }
+
+    std::vector<std::string> slots;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    /// The owning thread is gone
+    std::atomic<bool> closed;
+};
+
+
+struct Logger::AsyncWriter
+{
+    AsyncWriter(): queueSize(1024), dropOnFull(false), stop(false), sleeping(false), dropped(0)
+    {
+    }
+
+    std::atomic<unsigned> queueSize;
+    std::atomic<bool> dropOnFull;
+
+    // Protects enabling and disabling
+    boost::mutex stateMutex;
+    boost::thread thread;
+    std::atomic<bool> stop;
+
+    boost::mutex wakeMutex;
+    boost::condition_variable wakeCond;
+    std::atomic<bool> sleeping;
+
+    boost::mutex queuesMutex;
+    std::vector<std::shared_ptr<LineQueue>> queues;
+
+    std::atomic<uint64_t> dropped;
+
+    /// Queue of the calling thread, created on first use
+    LineQueue &getQueue()
+    {
+        struct Holder {
+            std::shared_ptr<LineQueue> queue;
+            ~Holder() {
+                if (queue) {
+                    queue->closed = true;
+                }
+            }
+        };
+        static thread_local Holder holder;
+
+        if (!holder.queue) {
+            holder.queue = std::make_shared<LineQueue>(queueSize);
+            boost::mutex::scoped_lock lock(queuesMutex);
+            queues.push_back(holder.queue);
+        }
+        return *holder.queue;
+    }
+
+    /// Queues of all threads. Those of finished threads are forgotten once empty.
+    void getQueues(std::vector<std::shared_ptr<LineQueue>> &snapshot)
+    {
+        boost::mutex::scoped_lock lock(queuesMutex);
+        queues.erase(std::remove_if(queues.begin(), queues.end(),
+            [](const std::shared_ptr<LineQueue> &q) { return q->closed && q->empty(); }),
+            queues.end());
+        snapshot = queues;
+    }
+
+    void wakeUp()
+    {
+        if (sleeping) {
+            boost::mutex::scoped_lock lock(wakeMutex);
+            wakeCond.notify_one();
+        }
+    }
+
+    bool pending()
+    {
+        boost::mutex::scoped_lock lock(queuesMutex);
+        for (auto i = queues.begin(); i != queues.end(); ++i) {
+            if (!(*i)->empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+
+/// Write all the lines, and clear batch
+/// As with the stream, errors (i.e. disk full) are ignored, and the lines lost
+static void writeLines(int fd, std::vector<std::string> &batch)
+{
+    struct iovec iov[WRITE_BATCH_SIZE];
+    size_t offset = 0;
+
+    while (offset < batch.size()) {
+        size_t count = std::min(batch.size() - offset, WRITE_BATCH_SIZE);
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<char*>(batch[offset + i].data());
+            iov[i].iov_len = batch[offset + i].size();
+        }
+        offset += count;
+
+        struct iovec *current = iov;
+        while (count > 0) {
+            ssize_t written = writev(fd, current, static_cast<int>(count));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            // Partial write, skip what is done
+            while (count > 0 && static_cast<size_t>(written) >= current->iov_len) {
+                written -= current->iov_len;
+                ++current;
+                --count;
+            }
+            if (count > 0) {
+                current->iov_base = static_cast<char*>(current->iov_base) + written;
+                current->iov_len -= written;
+            }
+        }
+    }
+    batch.clear();
+}
+
+
+/// Flush the asynchronous writer at exit
+static void stopAsyncLogger()
+{
+    theLogger().setAsync(false);
+}
+
+
 Logger& theLogger()
 {
     static Logger *logger = new Logger();
@@ -87,7 +298,8 @@ Logger::LogLevel Logger::getLogLevel(const std::string& repr)
 }
 
 
-Logger::Logger(): _logLevel(DEBUG), _profiling(false), _separator("; "), _nCommits(0)
+Logger::Logger(): _logLevel(DEBUG), _profiling(false), _separator("; "),
+    outFd(STDOUT_FILENO), asyncEnabled(false), asyncWriter(new AsyncWriter), _nCommits(0)
 {
     ostream = &std::cout;
     newLog(TRACE, __FILE__, __FUNCTION__, __LINE__) << "Logger created" << commit;
@@ -97,6 +309,8 @@ Logger::Logger(): _logLevel(DEBUG), _profiling(false), _separator("; "), _nCommi
 Logger::~Logger ()
 {
     newLog(TRACE, __FILE__, __FUNCTION__, __LINE__) << "Logger about to be destroyed" << commit;
+    setAsync(false);
+    delete asyncWriter;
 }
 
 
@@ -119,8 +333,144 @@ Logger & Logger::setProfiling(bool value)
 }
 
 
-void Logger::flush(const std::string &line)
+Logger & Logger::setAsync(bool enable, unsigned queueSize, bool dropOnFull)
+{
+    boost::mutex::scoped_lock stateLock(asyncWriter->stateMutex);
+    asyncWriter->queueSize = queueSize;
+    asyncWriter->dropOnFull = dropOnFull;
+
+    if (enable && !asyncEnabled) {
+        static bool exitHandler = false;
+        if (!exitHandler) {
+            exitHandler = true;
+            atexit(stopAsyncLogger);
+        }
+        asyncWriter->stop = false;
+        asyncWriter->thread = boost::thread(&Logger::asyncRun, this);
+        asyncEnabled = true;
+    }
+    else if (!enable && asyncEnabled) {
+        asyncEnabled = false;
+        asyncWriter->stop = true;
+        {
+            boost::mutex::scoped_lock lock(asyncWriter->wakeMutex);
+            asyncWriter->wakeCond.notify_one();
+        }
+        asyncWriter->thread.join();
+        // Lines queued right before disabling
+        boost::mutex::scoped_lock lock(outMutex);
+        drainQueues();
+    }
+    else {
+        return *this;
+    }
+
+    // Logged once the change is done, so when disabling it is written right away
+    newLog(INFO, __FILE__, __FUNCTION__, __LINE__)
+        << "Setting asynchronous logging to " << enable
+        << " (queue size " << queueSize << ", drop on full " << dropOnFull << ")"
+        << commit;
+    return *this;
+}
+
+
+void Logger::asyncRun()
 {
+    while (!asyncWriter->stop) {
+        size_t written;
+        {
+            boost::mutex::scoped_lock lock(outMutex);
+            written = drainQueues();
+        }
+
+        if (written == 0) {
+            boost::mutex::scoped_lock lock(asyncWriter->wakeMutex);
+            asyncWriter->sleeping = true;
+            if (!asyncWriter->stop && !asyncWriter->pending()) {
+                asyncWriter->wakeCond.timed_wait(lock,
+                    boost::posix_time::milliseconds(WRITE_IDLE_WAIT_MS));
+            }
+            asyncWriter->sleeping = false;
+        }
+    }
+
+    boost::mutex::scoped_lock lock(outMutex);
+    drainQueues();
+}
+
+
+size_t Logger::drainQueues()
+{
+    std::vector<std::shared_ptr<LineQueue>> queues;
+    asyncWriter->getQueues(queues);
+
+    std::vector<std::string> batch;
+    batch.reserve(WRITE_BATCH_SIZE);
+
+    size_t total = 0;
+    for (auto i = queues.begin(); i != queues.end(); ++i) {
+        while ((*i)->pop(batch, WRITE_BATCH_SIZE - batch.size()) > 0) {
+            if (batch.size() >= WRITE_BATCH_SIZE) {
+                total += batch.size();
+                writeLines(outFd, batch);
+            }
+        }
+    }
+
+    uint64_t dropped = asyncWriter->dropped.exchange(0);
+    if (dropped > 0) {
+        std::ostringstream msg;
+        msg << logLevelStringRepresentation(WARNING) << timestamp() << _separator
+            << dropped << " log lines were dropped because the log queue was full\n";
+        batch.push_back(msg.str());
+    }
+
+    total += batch.size();
+    writeLines(outFd, batch);
+    return total;
+}
+
+
+void Logger::flush(std::string &line)
+{
+    // One write per line, so threads appending to the same file do not mix their lines
+    if (threadOutput.fd >= 0) {
+        line.push_back('\n');
+        if (write(threadOutput.fd, line.data(), line.size()) < 0) {
+            // Nowhere else to report it
+        }
+        return;
+    }
+
+    if (asyncEnabled) {
+        LineQueue &queue = asyncWriter->getQueue();
+        line.push_back('\n');
+        bool queued;
+        while (!(queued = queue.push(line))) {
+            if (asyncWriter->dropOnFull) {
+                ++asyncWriter->dropped;
+                asyncWriter->wakeUp();
+                return;
+            }
+            asyncWriter->wakeUp();
+            // Disabled meanwhile, write it from here
+            if (!asyncEnabled) {
+                line.pop_back();
+                break;
+            }
+            boost::this_thread::sleep(boost::posix_time::microseconds(100));
+        }
+        if (queued) {
+            asyncWriter->wakeUp();
+            // Disabled between the check and the push, so the writer may have done its last pass already
+            if (!asyncEnabled) {
+                boost::mutex::scoped_lock lock(outMutex);
+                drainQueues();
+            }
+            return;
+        }
+    }
+
     boost::mutex::scoped_lock lock(outMutex);
     _nCommits++;
     if (_nCommits >= NB_COMMITS_BEFORE_CHECK) {
@@ -174,11 +524,27 @@ static int createAndReopen(const std::string& path, FILE* stream)
 
 int Logger::redirect(const std::string& outPath, const std::string& errPath) throw()
 {
+    boost::mutex::scoped_lock lock(outMutex);
+
+    // Whatever is queued belongs to the previous file
+    if (asyncEnabled) {
+        drainQueues();
+    }
+
     if (ostream != &std::cout) {
         delete ostream;
     }
     ostream = new std::ofstream(outPath, std::ios_base::app);
 
+    if (outFd != STDOUT_FILENO) {
+        close(outFd);
+    }
+    outFd = ::open(outPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (outFd < 0) {
+        outFd = STDOUT_FILENO;
+        return -1;
+    }
+
     if (!errPath.empty()) {
         if (createAndReopen(errPath, stderr) < 0)
             return -1;
@@ -187,6 +553,20 @@ int Logger::redirect(const std::string& outPath, const std::string& errPath) thr
 }
 
 
+int Logger::redirectThread(const std::string& path) throw()
+{
+    if (path.empty()) {
+        threadOutput.reset(-1);
+        return 0;
+    }
+
+    // On failure, the shared output is used
+    int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    threadOutput.reset(fd);
+    return fd < 0 ? -1 : 0;
+}
+
+
 void Logger::checkFd(void)
 {
     if (ostream->fail()) {
@@ -197,14 +577,20 @@ void Logger::checkFd(void)
 
 std::string Logger::timestamp()
 {
-    char timebuf[128] = "";
+    // Most lines are logged within the same second as the previous one from the same thread,
+    // so keep the formatted string around
+    static thread_local time_t cachedTime = 0;
+    static thread_local char timebuf[128] = "";
     // Get Current Time
     time_t current;
     time(&current);
-    struct tm local_tm;
-    localtime_r(&current, &local_tm);
-    // asctime format
-    strftime(timebuf, sizeof(timebuf), "%a, %d %b %Y %H:%M:%S %z", &local_tm);
+    if (current != cachedTime) {
+        struct tm local_tm;
+        localtime_r(&current, &local_tm);
+        // asctime format
+        strftime(timebuf, sizeof(timebuf), "%a, %d %b %Y %H:%M:%S %z", &local_tm);
+        cachedTime = current;
+    }
     return timebuf;
 }
 
@@ -24,6 +24,7 @@
 #ifndef LOGGER_H_
 #define LOGGER_H_
 
+#include <atomic>
 #include <iostream>
 #include <boost/thread/mutex.hpp>
 
@@ -104,6 +105,15 @@ public:
     /// Set Profiling Logs On/Off
     Logger& setProfiling(bool value);
 
+    /// Write the log lines from a background thread instead of the calling one.
+    /// Each thread queues its lines into its own buffer of queueSize lines, without locking,
+    /// and a single writer thread drains all of them in batches.
+    /// When a buffer is full, the calling thread waits for the writer, unless dropOnFull is set,
+    /// in which case the line is discarded and the number of discarded lines is logged later.
+    /// queueSize only applies to threads that have not logged yet.
+    /// Disabling it writes whatever is pending before returning.
+    Logger& setAsync(bool enable, unsigned queueSize = 1024, bool dropOnFull = false);
+
     /// Start a new log message. But this is not the recommended way,
     /// use FTS3_COMMON_LOGGER_NEWLOG. It calls this method, but adds
     /// proper debug information. The integer LOGLEVEL template parameter
@@ -117,8 +127,15 @@ public:
     /// Return 0 on success
     int redirect(const std::string& stdout, const std::string& stderr) throw();
 
+    /// Write the lines logged by the calling thread into path, instead of the shared output,
+    /// so threads working on different things can log into different files.
+    /// An empty path sends them back to the shared output. The file is closed when the thread exits.
+    /// Return 0 on success
+    int redirectThread(const std::string& path) throw();
+
 private:
     friend class LoggerEntry;
+    struct AsyncWriter;
 
     /// Log level
     LogLevel _logLevel;
@@ -130,14 +147,28 @@ private:
     std::string _separator;
 
     // Where to write
+    // The asynchronous writer uses outFd, the synchronous path ostream
     boost::mutex outMutex;
     std::ostream *ostream;
+    int outFd;
+
+    // Asynchronous mode
+    std::atomic<bool> asyncEnabled;
+    AsyncWriter *asyncWriter;
 
     /// Check file descriptor every X iterations
     static const unsigned NB_COMMITS_BEFORE_CHECK = 1000;
     unsigned _nCommits;
 
-    void flush(const std::string &line);
+    /// Write, or queue, line. It may be consumed.
+    void flush(std::string &line);
+
+    /// Body of the asynchronous writer thread
+    void asyncRun();
+
+    /// Write everything queued by the threads. outMutex must be held.
+    /// @return How many lines were written
+    size_t drainQueues();
 
     /// String representation of the timestamp
     static std::string timestamp();
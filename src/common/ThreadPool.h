@@ -21,11 +21,19 @@
 #ifndef THREADPOOL_H_
 #define THREADPOOL_H_
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
 #include <boost/thread.hpp>
-#include <boost/ptr_container/ptr_deque.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/bind.hpp>
 #include <boost/any.hpp>
+#include <boost/core/demangle.hpp>
 #include <boost/optional.hpp>
 
 namespace fts3
@@ -33,8 +41,86 @@ namespace fts3
 namespace common
 {
 
+/**
+ * Counts the tasks of a batch that are still to be run, so the caller can wait
+ * for them without joining (and so destroying) the thread pool
+ */
+class CompletionCounter
+{
+public:
+    CompletionCounter() : pending(0) {}
+
+    /// block until all the tasks of the batch have run
+    void wait()
+    {
+        boost::mutex::scoped_lock lock(mx);
+        while (pending > 0) {
+            cvar.wait(lock);
+        }
+    }
+
+    /// @return number of tasks not run yet
+    size_t size()
+    {
+        return pending;
+    }
+
+    void add()
+    {
+        ++pending;
+    }
+
+    void done()
+    {
+        // the lock is only taken to wake up the waiters
+        if (--pending == 0) {
+            boost::mutex::scoped_lock lock(mx);
+            cvar.notify_all();
+        }
+    }
+
+private:
+    boost::mutex mx;
+    boost::condition_variable cvar;
+    std::atomic<size_t> pending;
+};
+
+
+/**
+ * Statistics of the tasks of a given type run by a thread pool
+ */
+struct ThreadPoolMetrics
+{
+    ThreadPoolMetrics() : executed(0), stolen(0), queueTime(0), runTime(0) {}
+
+    /// number of tasks run
+    uint64_t executed;
+    /// how many of them were taken from another worker's queue
+    uint64_t stolen;
+    /// total time spent in the queue, in seconds
+    double queueTime;
+    /// total time spent running, in seconds
+    double runTime;
+
+    ThreadPoolMetrics & operator += (const ThreadPoolMetrics &other)
+    {
+        executed += other.executed;
+        stolen += other.stolen;
+        queueTime += other.queueTime;
+        runTime += other.runTime;
+        return *this;
+    }
+};
+
+
 /**
  * A generic thread-pool class
+ *
+ * Every worker has its own queue. Tasks started from outside the pool are spread
+ * over the queues, tasks started by a task go to the queue of its worker.
+ * A worker runs the tasks of its own queue first, oldest first, and when it runs out
+ * takes (steals) the newest task of another worker's queue.
+ * Only one sleeping worker is woken up per task started.
  */
 template <typename TASK, typename INIT_FUNC = void (*)(boost::any&)>
 class ThreadPool
@@ -42,8 +128,18 @@ class ThreadPool
     /// optional initialisation function (a typedef for convenience)
     typedef boost::optional<INIT_FUNC> init_func;
 
+    typedef std::chrono::steady_clock clock;
+
+    /// A queued task
+    struct Item
+    {
+        TASK *task;
+        CompletionCounter *counter;
+        clock::time_point queued;
+    };
+
     /**
-     * A helper class that retrieves subsequent tasks from the queue
+     * A helper class that retrieves subsequent tasks from the queues
      * and then executes them
      */
     struct ThreadPoolWorker
@@ -51,7 +147,7 @@ class ThreadPool
     public:
 
         /// constructor
-        ThreadPoolWorker(ThreadPool & pool, init_func init_context) : t_pool(pool)
+        ThreadPoolWorker(ThreadPool & pool, size_t index, init_func init_context) : t_pool(pool), index(index)
         {
             if (init_context.is_initialized()) {
                 (*init_context)(thread_context);
@@ -59,13 +155,14 @@ class ThreadPool
         }
 
         /// the run routine that retrieves subsequent tasks
-        /// from the queue and then executes them
+        /// from the queues and then executes them
         void run()
         {
-            while (!t_pool.interrupt_flag) {
-                std::unique_ptr<TASK> task(t_pool.next());
-                if (!task.get()) break;
-                task->run(thread_context);
+            currentWorker() = this;
+            Item item;
+            bool stolen;
+            while (!t_pool.interrupt_flag && t_pool.next(*this, item, stolen)) {
+                execute(item, stolen);
             }
         }
 
@@ -73,8 +170,59 @@ class ThreadPool
         boost::any thread_context;
         /// reference to the thread pool object
         ThreadPool & t_pool;
+        /// position within the pool
+        size_t index;
+
+        /// own queue, protected by mx
+        boost::mutex mx;
+        std::deque<Item> queue;
+
+        /// statistics per task type, protected by metricsMx
+        boost::mutex metricsMx;
+        std::map<std::type_index, ThreadPoolMetrics> metrics;
+
+    private:
+        /// marks the task as done even if it is interrupted
+        struct Completion
+        {
+            Completion(ThreadPool &pool, CompletionCounter *counter) : pool(pool), counter(counter) {}
+            ~Completion()
+            {
+                if (counter) {
+                    counter->done();
+                }
+                pool.all.done();
+            }
+            ThreadPool &pool;
+            CompletionCounter *counter;
+        };
+
+        void execute(Item &item, bool stolen)
+        {
+            std::unique_ptr<TASK> task(item.task);
+            Completion completion(t_pool, item.counter);
+            const std::type_index type(typeid(*task));
+
+            clock::time_point start = clock::now();
+            task->run(thread_context);
+            clock::time_point end = clock::now();
+
+            boost::mutex::scoped_lock lock(metricsMx);
+            ThreadPoolMetrics &m = metrics[type];
+            ++m.executed;
+            m.stolen += stolen;
+            m.queueTime += std::chrono::duration<double>(start - item.queued).count();
+            m.runTime += std::chrono::duration<double>(end - start).count();
+        }
     };
 
+    /// worker run by the calling thread, if any
+    static ThreadPoolWorker *& currentWorker()
+    {
+        static thread_local ThreadPoolWorker *worker = NULL;
+        return worker;
+    }
+
 public:
 
     /**
@@ -82,15 +230,17 @@ public:
      *
      * @param size : size of the thread pool
      */
-    ThreadPool(int size, init_func init_context = init_func()) : workers(size), interrupt_flag(false), join_flag(false)
+    ThreadPool(int size, init_func init_context = init_func()) : workers(size), interrupt_flag(false), join_flag(false),
+        queued(0), idle(0), nextQueue(0)
     {
         for (int i = 0; i < size; ++i) {
-            // create new worker
-            ThreadPoolWorker *worker = new ThreadPoolWorker(*this, init_context);
             // take ownership of the memory
-            workers.push_back(worker);
+            workers.push_back(new ThreadPoolWorker(*this, i, init_context));
+        }
+        // only start once all the queues exist, since they can be stolen from
+        for (int i = 0; i < size; ++i) {
             // create new thread belonging to the right group
-            group.create_thread(boost::bind(&ThreadPoolWorker::run, worker));
+            group.create_thread(boost::bind(&ThreadPoolWorker::run, &workers[i]));
         }
     }
 
@@ -99,6 +249,16 @@ public:
     {
         interrupt();
         join();
+        // tasks never run, still released from whoever waits for them
+        for (auto it = workers.begin(); it != workers.end(); ++it) {
+            for (auto item = it->queue.begin(); item != it->queue.end(); ++item) {
+                if (item->counter) {
+                    item->counter->done();
+                }
+                all.done();
+                delete item->task;
+            }
+        }
     }
 
     /**
@@ -107,16 +267,33 @@ public:
      * Please note that the thread-pool takes ownership of the pointer!
      *
      * @param t : task that will be executed
+     * @param counter : if given, it will be decremented once the task has run
      */
-    void start(TASK *t)
+    void start(TASK *t, CompletionCounter *counter = NULL)
     {
+        if (counter) {
+            counter->add();
+        }
+        all.add();
+
+        Item item = {t, counter, clock::now()};
+
+        // from one of our own workers, keep it local
+        ThreadPoolWorker *worker = currentWorker();
+        if (worker == NULL || &worker->t_pool != this) {
+            worker = &workers[nextQueue++ % workers.size()];
+        }
+        ++queued;
         {
-            // lock the queue
+            boost::mutex::scoped_lock lock(worker->mx);
+            worker->queue.push_back(item);
+        }
+
+        // wake up only one worker, if any is sleeping
+        if (idle > 0) {
             boost::mutex::scoped_lock lock(mx);
-            tasks.push_back(t);
+            cvar.notify_one();
         }
-        // notify waiting threads
-        cvar.notify_all();
     }
 
     /// interrupt all the threads belonging to this thread pool
@@ -140,12 +317,38 @@ public:
         group.join_all();
     }
 
+    /// block until all the tasks started so far have run, keeping the threads alive
+    /// not to be called from within a task
+    void wait()
+    {
+        all.wait();
+    }
+
     /// @return size of the thread pool
     size_t size()
     {
         return group.size();
     }
 
+    /// @return number of tasks started but not run yet
+    size_t pending()
+    {
+        return all.size();
+    }
+
+    /// @return statistics of the tasks run, per task type
+    std::map<std::string, ThreadPoolMetrics> getMetrics()
+    {
+        std::map<std::string, ThreadPoolMetrics> result;
+        for (auto it = workers.begin(); it != workers.end(); ++it) {
+            boost::mutex::scoped_lock lock(it->metricsMx);
+            for (auto m = it->metrics.begin(); m != it->metrics.end(); ++m) {
+                result[boost::core::demangle(m->first.name())] += m->second;
+            }
+        }
+        return result;
+    }
+
     /**
      * Executes a reduce operation on all thread contexts
      *
@@ -172,44 +375,101 @@ public:
 
 private:
 
+    /// take the oldest task of the worker's own queue
+    bool popOwn(ThreadPoolWorker &worker, Item &item)
+    {
+        boost::mutex::scoped_lock lock(worker.mx);
+        if (worker.queue.empty()) {
+            return false;
+        }
+        item = worker.queue.front();
+        worker.queue.pop_front();
+        --queued;
+        return true;
+    }
+
+    /// take the newest task of somebody else's queue
+    bool steal(ThreadPoolWorker &thief, Item &item)
+    {
+        for (size_t i = 1; i < workers.size(); ++i) {
+            ThreadPoolWorker &victim = workers[(thief.index + i) % workers.size()];
+            boost::mutex::scoped_lock lock(victim.mx, boost::try_to_lock);
+            if (!lock.owns_lock() || victim.queue.empty()) {
+                continue;
+            }
+            item = victim.queue.back();
+            victim.queue.pop_back();
+            --queued;
+            return true;
+        }
+        return false;
+    }
+
     /**
-     * Returns the next task in the queue
+     * Gets the next task for the worker, waiting if there is none
      *
-     * @return next task in the queue
+     * @return false if the pool is being joined and there is nothing left
      */
-    TASK* next()
+    bool next(ThreadPoolWorker &worker, Item &item, bool &stolen)
     {
-        // lock the queue
-        boost::mutex::scoped_lock lock(mx);
-        // if the queue is empty wait until someone puts something inside
-        // (unless the join flag is raised)
-        while (tasks.empty() && !join_flag) {
-            cvar.wait(lock);
-        }
-        // take the first element from the queue
-        typename boost::ptr_deque<TASK>::iterator it = tasks.begin();
-        // if the queue is empty return null
-        if (it == tasks.end()) {
-            return 0;
+        while (true) {
+            if (popOwn(worker, item)) {
+                stolen = false;
+                return true;
+            }
+            // there may be tasks queued elsewhere, even if a try lock failed
+            while (queued > 0) {
+                if (steal(worker, item)) {
+                    stolen = true;
+                    return true;
+                }
+                if (popOwn(worker, item)) {
+                    stolen = false;
+                    return true;
+                }
+                boost::this_thread::yield();
+            }
+
+            boost::mutex::scoped_lock lock(mx);
+            if (join_flag) {
+                return false;
+            }
+            // announce we are going to sleep before checking one last time,
+            // so start either sees us idle, or we see its task
+            ++idle;
+            if (queued == 0) {
+                try {
+                    cvar.wait(lock);
+                }
+                catch (...) {
+                    --idle;
+                    throw;
+                }
+            }
+            --idle;
         }
-        // otherwise give up ownership of the object and return it
-        return tasks.release(it).release();
     }
 
     /// group with worker threads
     boost::thread_group group;
-    /// the mutex preventing access
+    /// the mutex used to sleep and wake up the workers
     boost::mutex mx;
-    /// conditional variable preventing concurrent browsing and reconnecting
+    /// conditional variable the idle workers wait on
     boost::condition_variable cvar;
-    /// the queue itself
-    boost::ptr_deque<TASK> tasks;
-    /// pool of worker objects
+    /// pool of worker objects, with their queues
     boost::ptr_vector<ThreadPoolWorker> workers;
     /// a flag indicating whether all threads should be stopped
-    bool interrupt_flag;
+    std::atomic<bool> interrupt_flag;
     /// a flag indicating whether someone is joining us
     bool join_flag;
+    /// number of tasks in the queues
+    std::atomic<size_t> queued;
+    /// number of workers sleeping, or about to
+    std::atomic<size_t> idle;
+    /// queue for the next task started from outside the pool
+    std::atomic<size_t> nextQueue;
+    /// every task started and not run yet
+    CompletionCounter all;
 };
 
 } /* namespace common */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef TIMERQUEUE_H_
+#define TIMERQUEUE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+namespace fts3
+{
+namespace common
+{
+
+/**
+ * Items ordered by the time they are due (a binary min-heap)
+ *
+ * Adding an item and taking the earliest one are O(log n), so handing over the
+ * expired items costs O(expired log n) regardless of how many are still waiting.
+ * Items due at the same time come out in the order they were added.
+ *
+ * The queue takes ownership of the pointers, and it is not thread safe.
+ */
+template <typename T>
+class TimerQueue
+{
+public:
+    TimerQueue(): counter(0) {}
+
+    ~TimerQueue()
+    {
+        clear();
+    }
+
+    /// Queue item until due
+    void push(time_t due, T *item)
+    {
+        Entry entry = {due, counter++, item};
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), Later());
+    }
+
+    /**
+     * Take the earliest item, if it is due by now
+     *
+     * @param now : current time
+     * @param due : if given, set to the time the item was due
+     * @return the item, owned by the caller, or NULL if none is due
+     */
+    T* pop(time_t now, time_t *due = NULL)
+    {
+        if (heap.empty() || heap.front().due > now) {
+            return NULL;
+        }
+        std::pop_heap(heap.begin(), heap.end(), Later());
+        Entry entry = heap.back();
+        heap.pop_back();
+        if (due) {
+            *due = entry.due;
+        }
+        return entry.item;
+    }
+
+    /// Time the earliest item is due. Only meaningful if not empty.
+    time_t next() const
+    {
+        return heap.front().due;
+    }
+
+    size_t size() const
+    {
+        return heap.size();
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    /// Drop, and delete, all the items
+    void clear()
+    {
+        for (auto i = heap.begin(); i != heap.end(); ++i) {
+            delete i->item;
+        }
+        heap.clear();
+    }
+
+private:
+    TimerQueue(TimerQueue const &) = delete;
+    TimerQueue& operator=(TimerQueue const &) = delete;
+
+    struct Entry
+    {
+        time_t due;
+        uint64_t seq;
+        T *item;
+    };
+
+    /// std heaps are max-heaps, so compare the other way around
+    struct Later
+    {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return a.due > b.due || (a.due == b.due && a.seq > b.seq);
+        }
+    };
+
+    std::vector<Entry> heap;
+    /// insertion order, to keep ties first in first out
+    uint64_t counter;
+};
+
+} /* namespace common */
+} /* namespace fts3 */
+
+#endif // TIMERQUEUE_H_
@@ -19,6 +19,10 @@
  */
 
 #include "FileMonitor.h"
+#include <algorithm>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include "common/Logger.h"
 #include "ServerConfig.h"
@@ -72,11 +76,93 @@ void FileMonitor::stop()
 }
 
 
+/// Reload the configuration, keeping the current one if the new file is invalid
+static void reload(ServerConfig *sc, const std::string &path)
+{
+    try {
+        std::string configFile = "--configfile=" + path;
+        char *argv[] = {const_cast<char*>("fts3"), const_cast<char*>(configFile.c_str()), NULL};
+        sc->read(2, argv);
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Configuration reloaded" << commit;
+    }
+    catch (const boost::thread_interrupted&) {
+        throw;
+    }
+    catch (const std::exception &e) {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not reload the configuration, keeping the current one: "
+            << e.what() << commit;
+    }
+}
+
+
+/// Watch the directory, since editors usually replace the file instead of writing into it
+/// Returns false if inotify is not available
+static bool watchDirectory(const std::string &path, ServerConfig *sc)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    const size_t slash = path.rfind('/');
+    const std::string directory = (slash == std::string::npos) ? "." : path.substr(0, std::max<size_t>(slash, 1));
+    const std::string fileName = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+    if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(fd);
+        return false;
+    }
+
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Watching " << path << " for changes" << commit;
+
+    try {
+        char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        while (!boost::this_thread::interruption_requested()) {
+            // Wake up every second to check for the interruption
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 1000) <= 0) {
+                continue;
+            }
+
+            bool changed = false;
+            ssize_t len;
+            while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char *ptr = buffer; ptr < buffer + len;) {
+                    const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(ptr);
+                    if (event->len > 0 && fileName == event->name) {
+                        changed = true;
+                    }
+                    ptr += sizeof(struct inotify_event) + event->len;
+                }
+            }
+
+            if (changed) {
+                reload(sc, path);
+            }
+        }
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+    return true;
+}
+
+
 void FileMonitor::run(FileMonitor *const me)
 {
     struct stat st;
 
     try {
+        if (watchDirectory(me->path, me->sc)) {
+            return;
+        }
+
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "inotify not available, checking "
+            << me->path << " every minute" << commit;
+
         while (!boost::this_thread::interruption_requested()) {
             // we will check the timestamp periodically every minute
             boost::this_thread::sleep(boost::posix_time::seconds(60));
@@ -87,7 +173,7 @@ void FileMonitor::run(FileMonitor *const me)
                 if (new_timestamp != me->timestamp) {
                     // if the file has been changed reload the configuration
                     me->timestamp = new_timestamp;
-                    me->sc->read(0, 0);
+                    reload(me->sc, me->path);
                 }
             }
         }
@@ -32,7 +32,9 @@ class ServerConfig;
 
 /**
  * This class monitors in a background thread if the FTS3 configuration file
- * has been modified. If it has, it triggers a reload of the configuration
+ * has been modified. If it has, it triggers a reload of the configuration.
+ * Changes are notified by inotify, or found checking the timestamp every minute
+ * if inotify is not available.
  */
 class FileMonitor
 {
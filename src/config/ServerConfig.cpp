@@ -31,9 +31,10 @@ using namespace fts3::config;
 using namespace fts3::common;
 
 
-ServerConfig::ServerConfig() : cfgmonitor (this), reading(0), getting(0),
-    readTime(0)
+ServerConfig::ServerConfig() : cfgmonitor (this), readTime(0)
 {
+    snapshots.emplace_back(new Snapshot);
+    current = snapshots.back().get();
     FTS3_COMMON_LOGGER_NEWLOG(TRACE) << "ServerConfig created" << commit;
 }
 
@@ -46,9 +47,10 @@ ServerConfig::~ServerConfig()
 
 const std::string &ServerConfig::_get_str(const std::string &aVariable)
 {
-    _t_vars::iterator itr = _vars.find(aVariable);
+    const _t_vars &vars = current.load(std::memory_order_acquire)->vars;
+    _t_vars::const_iterator itr = vars.find(aVariable);
 
-    if (itr == _vars.end()) {
+    if (itr == vars.end()) {
         throw UserError("Server config variable " + aVariable + " not defined.");
     }
 
@@ -77,35 +79,54 @@ time_t ServerConfig::getReadTime()
 }
 
 
-void ServerConfig::waitIfReading()
+const ServerConfigValues &ServerConfig::values()
 {
-    boost::mutex::scoped_lock lock(qm);
-    while (reading) {
-        qv.wait(lock);
-    }
-    getting++;
+    return current.load(std::memory_order_acquire)->values;
 }
 
 
-void ServerConfig::notifyReaders()
+/// Parse the option into value, if it is set
+template <typename T>
+static void parseValue(const std::map<std::string, std::string> &vars, const std::string &name, T *value)
 {
-    boost::mutex::scoped_lock lock(qm);
-    getting--;
-    qv.notify_all(); // there is anyway only one thread to be notified
+    auto i = vars.find(name);
+    if (i == vars.end()) {
+        return;
+    }
+    try {
+        *value = boost::lexical_cast<T>(i->second);
+    }
+    catch (const boost::bad_lexical_cast &) {
+        throw UserError("Server config variable " + name + " has an invalid value: " + i->second);
+    }
 }
 
 
-void ServerConfig::waitIfGetting()
+static void parseValue(const std::map<std::string, std::string> &vars, const std::string &name, bool *value)
 {
-    boost::mutex::scoped_lock lock(qm);
-    while (getting > 0) qv.wait(lock);
-    reading = true;
+    auto i = vars.find(name);
+    if (i != vars.end()) {
+        std::string str = boost::to_lower_copy(i->second);
+        *value = !(str == "false" || str == "0");
+    }
 }
 
 
-void ServerConfig::notifyGetters()
+void ServerConfig::_publish()
 {
-    boost::mutex::scoped_lock lock(qm);
-    reading = false;
-    qv.notify_all();
+    std::unique_ptr<Snapshot> snapshot(new Snapshot);
+    snapshot->vars = _vars;
+
+    ServerConfigValues &values = snapshot->values;
+    parseValue(_vars, "CancelUnusedMultihopFiles", &values.cancelUnusedMultihopFiles);
+    parseValue(_vars, "MaxUrlCopyProcesses", &values.maxUrlCopyProcesses);
+    parseValue(_vars, "MessagingDirectory", &values.messagingDirectory);
+    parseValue(_vars, "MinRequiredFreeRAM", &values.minRequiredFreeRAM);
+    parseValue(_vars, "RetrieveSEToken", &values.retrieveSEToken);
+    parseValue(_vars, "StagingPollRetries", &values.stagingPollRetries);
+    parseValue(_vars, "UrlCopyProcessPingInterval", &values.urlCopyProcessPingInterval);
+    parseValue(_vars, "UseFixedJobPriority", &values.useFixedJobPriority);
+
+    snapshots.emplace_back(snapshot.release());
+    current.store(snapshots.back().get(), std::memory_order_release);
 }
@@ -26,7 +26,10 @@
 
 #include "FileMonitor.h"
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <string>
 #include <vector>
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
@@ -41,8 +44,34 @@
 namespace fts3 {
 namespace config {
 
+/// Options read on hot paths (i.e. per queue or per transfer), parsed once per reload,
+/// so reading one is a plain field access.
+/// To add one, declare it here and parse it in ServerConfig::_publish
+struct ServerConfigValues
+{
+    ServerConfigValues(): cancelUnusedMultihopFiles(false), maxUrlCopyProcesses(0),
+        minRequiredFreeRAM(0), retrieveSEToken(false), stagingPollRetries(0),
+        urlCopyProcessPingInterval(0), useFixedJobPriority(0)
+    {}
+
+    bool cancelUnusedMultihopFiles;
+    int maxUrlCopyProcesses;
+    std::string messagingDirectory;
+    size_t minRequiredFreeRAM;
+    bool retrieveSEToken;
+    int stagingPollRetries;
+    int urlCopyProcessPingInterval;
+    int useFixedJobPriority;
+};
+
+
 /** \brief Class representing server configuration. Server configuration read once,
- * when the server starts. It provides read-only singleton access. */
+ * when the server starts, and again when the file changes. It provides read-only singleton access.
+ *
+ * Each read publishes an immutable snapshot through an atomic pointer, so readers
+ * never lock nor wait for a reload. Snapshots are kept until the configuration is
+ * destroyed, so a value obtained before a reload stays valid. Reloads are rare
+ * (someone edited the file), so this costs little memory. */
 class ServerConfig: public fts3::common::Singleton<ServerConfig>
 {
 public:
@@ -71,11 +100,21 @@ public:
     /// desired type. Throws exception if the option is not found.
     template <typename RET> RET get(const std::string& aVariable);
 
+    /// Typed options of the current configuration
+    const ServerConfigValues& values();
+
 protected:
 
     /// Type of the internal store of config variables.
     typedef std::map<std::string, std::string> _t_vars;
 
+    /// A published configuration
+    struct Snapshot
+    {
+        _t_vars vars;
+        ServerConfigValues values;
+    };
+
     /// Return the variable value as a string.
     const std::string& _get_str(const std::string& aVariable);
 
@@ -84,10 +123,10 @@ protected:
     void _read(int argc, char** argv)
     {
         READER_TYPE reader;
-        waitIfGetting();
+        boost::mutex::scoped_lock lock(writeMutex);
         _vars = reader(argc, argv);
+        _publish();
         readTime = time(0);
-        notifyGetters();
     }
 
     /// Read the configurations from config file only - using injected reader.
@@ -95,27 +134,28 @@ protected:
     void _read(const std::string& aFileName)
     {
         READER_TYPE reader;
+        boost::mutex::scoped_lock lock(writeMutex);
         _vars = reader(aFileName);
+        _publish();
     }
 
-    /// The internal store of config variables.
+    /// Parse _vars into a new snapshot, and make it the current one
+    /// If a typed option has an invalid value, it throws, and the current snapshot is kept
+    void _publish();
+
+    /// The config variables being read. Readers use the current snapshot instead.
     _t_vars _vars;
 
     /// Configuration file monitor
     FileMonitor cfgmonitor;
 
-    bool reading;
-    int getting;
+    /// Serializes the writers
+    boost::mutex writeMutex;
+    /// Every snapshot published, the last one being the current one
+    std::vector<std::unique_ptr<const Snapshot>> snapshots;
+    std::atomic<const Snapshot*> current;
 
-    boost::mutex qm;
-    boost::condition_variable qv;
-
-    time_t readTime;
-
-    void waitIfReading();
-    void notifyReaders();
-    void waitIfGetting();
-    void notifyGetters();
+    std::atomic<time_t> readTime;
 };
 
 
@@ -123,21 +163,14 @@ template <typename RET>
 RET ServerConfig::get (const std::string& aVariable /**< A config variable name. */)
 {
 
-    waitIfReading();
-    const std::string& str = _get_str(aVariable);
-    notifyReaders();
-
-    return boost::lexical_cast<RET>(str);
+    return boost::lexical_cast<RET>(_get_str(aVariable));
 }
 
 template <>
 inline bool ServerConfig::get<bool> (const std::string& aVariable /**< A config variable name. */)
 {
 
-    waitIfReading();
     std::string str = _get_str(aVariable);
-    notifyReaders();
-
     boost::to_lower(str);
 
     // if the string is 'false' return false
@@ -150,10 +183,7 @@ inline bool ServerConfig::get<bool> (const std::string& aVariable /**< A config
 template <>
 inline boost::posix_time::time_duration ServerConfig::get<boost::posix_time::time_duration> (const std::string& aVariable /**< A config variable name. */)
 {
-    waitIfReading();
-    std::string str = _get_str(aVariable);
-    notifyReaders();
-    return boost::posix_time::seconds(boost::lexical_cast<int>(str));
+    return boost::posix_time::seconds(boost::lexical_cast<int>(_get_str(aVariable)));
 }
 
 
@@ -161,9 +191,7 @@ template <>
 inline std::vector<std::string> ServerConfig::get< std::vector<std::string> > (const std::string& aVariable /**< A config variable name. */)
 {
 
-    waitIfReading();
     const std::string& str = _get_str(aVariable);
-    notifyReaders();
 
     boost::char_separator<char> sep(";");
     boost::tokenizer< boost::char_separator<char> > tokens(str, sep);
@@ -183,16 +211,13 @@ inline std::map<std::string, std::string> ServerConfig::get< std::map<std::strin
     std::map<std::string, std::string> ret;
     boost::regex re(aVariable);
 
-    waitIfReading();
-
-    for (auto it = _vars.begin(); it != _vars.end(); ++it) {
+    const _t_vars &vars = current.load(std::memory_order_acquire)->vars;
+    for (auto it = vars.begin(); it != vars.end(); ++it) {
         if (boost::regex_match(it->first, re)) {
             ret[it->first] = it->second;
         }
     }
 
-    notifyReaders();
-
     return ret;
 }
 
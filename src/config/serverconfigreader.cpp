@@ -263,6 +263,21 @@ po::options_description ServerConfigReader::_defineConfigOptions()
         po::value<std::string>( &(_vars["CleanInterval"]) )->default_value("7"),
         "In days. Entries older than this will be purged"
     )
+    (
+        "CleanThreads",
+        po::value<std::string>( &(_vars["CleanThreads"]) )->default_value("4"),
+        "Number of parallel workers used for cleaning the old records"
+    )
+    (
+        "CleanTargetLockTime",
+        po::value<std::string>( &(_vars["CleanTargetLockTime"]) )->default_value("500"),
+        "In milliseconds. The cleaning bulk size is adjusted so a transaction takes about this long"
+    )
+    (
+        "CleanCheckpointFile",
+        po::value<std::string>( &(_vars["CleanCheckpointFile"]) )->default_value("/var/lib/fts3/fts_db_cleaner.checkpoint"),
+        "Where the cleaner keeps its progress, so an interrupted run can be resumed"
+    )
     (
         "BackupTables",
         po::value<std::string>( &(_vars["BackupTables"]) )->default_value("true"),
@@ -298,6 +313,21 @@ po::options_description ServerConfigReader::_defineConfigOptions()
         po::value<std::string>( &(_vars["LogLevel"]) )->default_value("INFO"),
         "Logging level"
     )
+    (
+        "LogAsync",
+        po::value<std::string>( &(_vars["LogAsync"]) )->default_value("false"),
+        "Write the log from a background thread"
+    )
+    (
+        "LogAsyncQueueSize",
+        po::value<std::string>( &(_vars["LogAsyncQueueSize"]) )->default_value("1024"),
+        "Log lines each thread can queue for the background writer"
+    )
+    (
+        "LogAsyncDropOnFull",
+        po::value<std::string>( &(_vars["LogAsyncDropOnFull"]) )->default_value("false"),
+        "Drop log lines when the queue of a thread is full, instead of waiting"
+    )
     (
         "WithoutSoap",
         po::value<std::string>( &(_vars["WithoutSoap"]) )->default_value("false"),
@@ -333,6 +363,26 @@ po::options_description ServerConfigReader::_defineConfigOptions()
         po::value<std::string>( &(_vars["StagingPollRetries"]) )->default_value("3"),
         "Retry this number of times if a staging poll fails with ECOMM"
     )
+    (
+        "StagingPollRateLimit",
+        po::value<std::string>( &(_vars["StagingPollRateLimit"]) )->default_value("0"),
+        "Maximum number of staging and archiving polls per second sent to a storage. 0 for no limit"
+    )
+    (
+        "StagingCoalesceWindow",
+        po::value<std::string>( &(_vars["StagingCoalesceWindow"]) )->default_value("0"),
+        "In seconds, how long the QoS daemon holds files of the same group waiting for more, to send bigger bulk requests"
+    )
+    (
+        "StagingCoalesceSize",
+        po::value<std::string>( &(_vars["StagingCoalesceSize"]) )->default_value("0"),
+        "Send a group as soon as it has this many files. 0 means StagingBulkSize"
+    )
+    (
+        "StagingLocalityKey",
+        po::value<std::string>( &(_vars["StagingLocalityKey"]) )->default_value("none"),
+        "Sort the files of a bulk request by: none, surl, or metadata:<field>"
+    )
     (
         "HeartBeatInterval",
         po::value<std::string>( &(_vars["HeartBeatInterval"]) )->default_value("60"),
@@ -343,6 +393,11 @@ po::options_description ServerConfigReader::_defineConfigOptions()
         po::value<std::string>( &(_vars["HeartBeatGraceInterval"]) )->default_value("120"),
         "After this many seconds, a host is considered to be down"
     )
+    (
+        "HeartBeatVirtualNodes",
+        po::value<std::string>( &(_vars["HeartBeatVirtualNodes"]) )->default_value("32"),
+        "Positions of each host on the hash ring. More spread the files more evenly, with longer queries"
+    )
     (
         "OptimizerSteadyInterval",
         po::value<std::string>( &(_vars["OptimizerSteadyInterval"]) )->default_value("300"),
@@ -398,11 +453,71 @@ po::options_description ServerConfigReader::_defineConfigOptions()
         po::value<std::string>( &(_vars["SchedulingInterval"]) )->default_value("2"),
         "In seconds, how often to schedule new transfers"
     )
+    (
+        "QueueIndexReconcileInterval",
+        po::value<std::string>( &(_vars["QueueIndexReconcileInterval"]) )->default_value("300"),
+        "In seconds, how often the in-memory queue index is reloaded from the database"
+    )
+    (
+        "TransferLaunchBatchSize",
+        po::value<std::string>( &(_vars["TransferLaunchBatchSize"]) )->default_value("100"),
+        "How many transfers are claimed and launched together"
+    )
+    (
+        "UrlCopyLauncher",
+        po::value<std::string>( &(_vars["UrlCopyLauncher"]) )->default_value("true"),
+        "Spawn fts_url_copy from a helper process forked at start-up, instead of forking the server"
+    )
+    (
+        "UrlCopyWorkers",
+        po::value<std::string>( &(_vars["UrlCopyWorkers"]) )->default_value("0"),
+        "Maximum number of long-lived fts_url_copy workers per credential. 0 to disable them"
+    )
+    (
+        "UrlCopyWorkerMaxTransfers",
+        po::value<std::string>( &(_vars["UrlCopyWorkerMaxTransfers"]) )->default_value("1000"),
+        "How many transfers a fts_url_copy worker runs before exiting"
+    )
+    (
+        "UrlCopyWorkerIdleTimeout",
+        po::value<std::string>( &(_vars["UrlCopyWorkerIdleTimeout"]) )->default_value("300"),
+        "In seconds, how long a fts_url_copy worker waits for a transfer before exiting"
+    )
+    (
+        "ConfigSnapshotCheckInterval",
+        po::value<std::string>( &(_vars["ConfigSnapshotCheckInterval"]) )->default_value("30"),
+        "In seconds, how often to check if the storage, link, share and VO configuration changed"
+    )
     (
         "MessagingConsumeInterval",
         po::value<std::string>( &(_vars["MessagingConsumeInterval"]) )->default_value("1"),
         "In seconds, how often to check for messages"
     )
+    (
+        "MessagingBatchStatusUpdates",
+        po::value<std::string>( &(_vars["MessagingBatchStatusUpdates"]) )->default_value("true"),
+        "Apply the terminal status messages consumed together within a single transaction"
+    )
+    (
+        "MessagingRingBuffer",
+        po::value<std::string>( &(_vars["MessagingRingBuffer"]) )->default_value("false"),
+        "Have fts_url_copy send status messages through a shared memory ring buffer instead of the messaging directory"
+    )
+    (
+        "MessagingRingBufferSlots",
+        po::value<std::string>( &(_vars["MessagingRingBufferSlots"]) )->default_value("4096"),
+        "Number of messages the status ring buffer can hold before falling back to the messaging directory"
+    )
+    (
+        "ProgressFlushSize",
+        po::value<std::string>( &(_vars["ProgressFlushSize"]) )->default_value("1000"),
+        "Write the transfer progress to the database once this many transfers have pending updates"
+    )
+    (
+        "ProgressFlushInterval",
+        po::value<std::string>( &(_vars["ProgressFlushInterval"]) )->default_value("5"),
+        "In seconds, maximum time a transfer progress update waits before being written to the database"
+    )
     (
         "ForceStartTransfersCheckInterval",
         po::value<std::string>( &(_vars["ForceStartTransfersCheckInterval"]) )->default_value("30"),
@@ -448,6 +563,11 @@ po::options_description ServerConfigReader::_defineConfigOptions()
         po::value<int>()->default_value(1),
         "Decrease step size when the optimizer considers the performance is bad"
     )
+    (
+        "OptimizerThreadPool",
+        po::value<int>()->default_value(4),
+        "Number of threads the optimizer uses to compute its decisions"
+    )
     (
         "SigKillDelay",
         po::value<std::string>( &(_vars["SigKillDelay"]) )->default_value("500"),
@@ -631,6 +751,7 @@ void ServerConfigReader::storeValuesAsStrings ()
     storeAsString("OptimizerIncreaseStep");
     storeAsString("OptimizerAggressiveIncreaseStep");
     storeAsString("OptimizerDecreaseStep");
+    storeAsString("OptimizerThreadPool");
 }
 
 void ServerConfigReader::storeRoles ()
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BackupCheckpoint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+#include "common/Exceptions.h"
+
+using fts3::common::SystemError;
+
+
+// Marks a finished task. Job ids never look like this.
+static const std::string DONE_MARK("*");
+
+
+BackupCheckpoint::BackupCheckpoint(const std::string &path): path(path)
+{
+    if (path.empty()) {
+        return;
+    }
+
+    // One "task key" per line
+    std::ifstream input(path);
+    std::string task, key;
+    while (input >> task >> key) {
+        lastKeys[task] = key;
+    }
+}
+
+
+std::string BackupCheckpoint::getLastKey(const std::string &task)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    auto i = lastKeys.find(task);
+    if (i == lastKeys.end() || i->second == DONE_MARK) {
+        return std::string();
+    }
+    return i->second;
+}
+
+
+bool BackupCheckpoint::isDone(const std::string &task)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    auto i = lastKeys.find(task);
+    return i != lastKeys.end() && i->second == DONE_MARK;
+}
+
+
+void BackupCheckpoint::setLastKey(const std::string &task, const std::string &key)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    lastKeys[task] = key;
+    store();
+}
+
+
+void BackupCheckpoint::setDone(const std::string &task)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    lastKeys[task] = DONE_MARK;
+    store();
+}
+
+
+void BackupCheckpoint::clear()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    lastKeys.clear();
+    if (!path.empty()) {
+        unlink(path.c_str());
+    }
+}
+
+
+// Written to a temporary file first, so a crash never leaves a truncated checkpoint behind
+void BackupCheckpoint::store()
+{
+    if (path.empty()) {
+        return;
+    }
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream output(tmpPath, std::ios_base::trunc);
+        for (auto i = lastKeys.begin(); i != lastKeys.end(); ++i) {
+            output << i->first << " " << i->second << "\n";
+        }
+        output.flush();
+        if (!output) {
+            throw SystemError("Could not write the backup checkpoint " + tmpPath);
+        }
+    }
+    if (rename(tmpPath.c_str(), path.c_str()) < 0) {
+        throw SystemError("Could not rename the backup checkpoint " + tmpPath);
+    }
+}
+
+
+const long BackupChunkSize::MIN_SIZE;
+
+
+BackupChunkSize::BackupChunkSize(long maxSize, double target):
+    maxSize(std::max(MIN_SIZE, maxSize)), target(target),
+    size(std::max(MIN_SIZE, maxSize / 4))
+{
+}
+
+
+long BackupChunkSize::get() const
+{
+    return size;
+}
+
+
+void BackupChunkSize::update(long rows, double elapsed)
+{
+    if (elapsed > target) {
+        // Scale down to what would have fit, at least by half
+        long fit = static_cast<long>(size * target / elapsed);
+        size = std::max(MIN_SIZE, std::min(size / 2, fit));
+    }
+    // Only grow if the chunk was full, otherwise the timing says nothing about a bigger one
+    else if (elapsed < target / 2 && rows >= size) {
+        size = std::min(maxSize, size * 2);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef BACKUPCHECKPOINT_H_
+#define BACKUPCHECKPOINT_H_
+
+#include <map>
+#include <string>
+#include <boost/thread/mutex.hpp>
+
+
+/// Progress of a backup run, kept in a file so an interrupted run resumes where it stopped.
+/// The backup is split into tasks (i.e. a range of job ids), and for each one it stores
+/// the last key processed, or that the task is done.
+/// Once the run completes, the file is removed, so the next one starts from the beginning.
+class BackupCheckpoint
+{
+public:
+    /// Load the checkpoint from path, if there is one
+    /// An empty path disables the persistence
+    explicit BackupCheckpoint(const std::string &path);
+
+    /// Last key processed by the task, or an empty string if none
+    std::string getLastKey(const std::string &task);
+
+    /// True if the task was completed
+    bool isDone(const std::string &task);
+
+    /// Record the progress of the task, and write the checkpoint
+    void setLastKey(const std::string &task, const std::string &key);
+
+    /// Mark the task as done, and write the checkpoint
+    void setDone(const std::string &task);
+
+    /// The run is over, remove the checkpoint
+    void clear();
+
+private:
+    std::string path;
+    boost::mutex mutex;
+    std::map<std::string, std::string> lastKeys;
+
+    void store();
+};
+
+
+/// Number of rows processed per transaction by a backup task.
+/// It is tuned so a transaction holds its locks for about a target duration:
+/// halved, or more, when a transaction takes longer, doubled when it takes less than half.
+class BackupChunkSize
+{
+public:
+    /// Smallest chunk size
+    static const long MIN_SIZE = 10;
+
+    /// @param maxSize  Upper limit for the chunk size
+    /// @param target   Target duration of a transaction, in seconds
+    BackupChunkSize(long maxSize, double target);
+
+    /// Current chunk size
+    long get() const;
+
+    /// Adjust the size after a transaction that processed rows in elapsed seconds
+    void update(long rows, double elapsed);
+
+private:
+    long maxSize;
+    double target;
+    long size;
+};
+
+#endif // BACKUPCHECKPOINT_H_
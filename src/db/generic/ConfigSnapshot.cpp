@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ConfigSnapshot.h"
+
+
+ConfigSnapshot::ConfigSnapshot(uint64_t version): version(version)
+{
+}
+
+
+void ConfigSnapshot::addStorage(const std::string &storage, const Storage &entry)
+{
+    storages.insert(std::make_pair(storage, entry));
+}
+
+
+void ConfigSnapshot::addLink(const Link &entry)
+{
+    links.insert(std::make_pair(Pair(entry.config.source, entry.config.destination), entry));
+}
+
+
+void ConfigSnapshot::addShare(const ShareConfig &share)
+{
+    shares[Pair(share.source, share.destination)].push_back(share);
+}
+
+
+void ConfigSnapshot::addVo(const boost::optional<std::string> &voName, const Vo &entry)
+{
+    if (!voName) {
+        if (!nullVo) {
+            nullVo = entry;
+        }
+    }
+    else {
+        vos.insert(std::make_pair(*voName, entry));
+    }
+}
+
+
+uint64_t ConfigSnapshot::getVersion() const
+{
+    return version;
+}
+
+
+StorageConfig ConfigSnapshot::getStorageConfig(const std::string &storage) const
+{
+    StorageConfig seConfig;
+
+    const Storage *entry = findStorage(storage);
+    if (entry) {
+        seConfig = entry->config;
+    }
+    const Storage *star = findStorage("*");
+    if (star) {
+        seConfig.merge(star->config);
+    }
+
+    return seConfig;
+}
+
+
+unsigned ConfigSnapshot::getDebugLevel(const std::string &sourceStorage, const std::string &destStorage) const
+{
+    boost::optional<int> level;
+
+    const Storage *entries[] = {findStorage(sourceStorage), findStorage(destStorage)};
+    for (auto entry: entries) {
+        if (entry && entry->debugLevel && (!level || *entry->debugLevel > *level)) {
+            level = entry->debugLevel;
+        }
+    }
+
+    if (!level) {
+        const Storage *star = findStorage("*");
+        if (star && star->debugLevel) {
+            level = star->debugLevel;
+        }
+    }
+
+    return level ? static_cast<unsigned>(*level) : 0;
+}
+
+
+boost::tribool ConfigSnapshot::isProtocolUDT(const std::string &source, const std::string &dest) const
+{
+    const Storage *src = findStorage(source);
+    const Storage *dst = findStorage(dest);
+    const Storage *star = findStorage("*");
+
+    return resolveProtocol(src ? src->config.udt : boost::indeterminate,
+        dst ? dst->config.udt : boost::indeterminate,
+        star ? star->config.udt : boost::indeterminate);
+}
+
+
+boost::tribool ConfigSnapshot::isProtocolIPv6(const std::string &source, const std::string &dest) const
+{
+    const Storage *src = findStorage(source);
+    const Storage *dst = findStorage(dest);
+    const Storage *star = findStorage("*");
+
+    return resolveProtocol(src ? src->config.ipv6 : boost::indeterminate,
+        dst ? dst->config.ipv6 : boost::indeterminate,
+        star ? star->config.ipv6 : boost::indeterminate);
+}
+
+
+boost::tribool ConfigSnapshot::getEvictionFlag(const std::string &source) const
+{
+    const Storage *entry = findStorage(source);
+    if (!entry || boost::indeterminate(entry->eviction)) {
+        return false;
+    }
+    return entry->eviction;
+}
+
+
+std::unique_ptr<LinkConfig> ConfigSnapshot::getLinkConfig(const std::string &source,
+    const std::string &destination) const
+{
+    const Link *entry = findLink(source, destination);
+    if (!entry) {
+        return std::unique_ptr<LinkConfig>();
+    }
+    return std::unique_ptr<LinkConfig>(new LinkConfig(entry->config));
+}
+
+
+std::vector<ShareConfig> ConfigSnapshot::getShareConfig(const std::string &source,
+    const std::string &destination) const
+{
+    auto i = shares.find(Pair(source, destination));
+    if (i == shares.end()) {
+        return std::vector<ShareConfig>();
+    }
+    return i->second;
+}
+
+
+boost::optional<int> ConfigSnapshot::getStreamsOptimization(const std::string &sourceSe,
+    const std::string &destSe) const
+{
+    std::vector<const Link*> matches = matchingLinks(sourceSe, destSe, true);
+    for (auto i = matches.begin(); i != matches.end(); ++i) {
+        if ((*i)->numberOfStreams) {
+            return (*i)->numberOfStreams;
+        }
+    }
+    return boost::none;
+}
+
+
+bool ConfigSnapshot::getDisableDelegationFlag(const std::string &sourceSe, const std::string &destSe) const
+{
+    std::vector<const Link*> matches = matchingLinks(sourceSe, destSe, true);
+    for (auto i = matches.begin(); i != matches.end(); ++i) {
+        if ((*i)->noDelegation) {
+            return *(*i)->noDelegation == "on";
+        }
+    }
+    return false;
+}
+
+
+std::string ConfigSnapshot::getThirdPartyTURL(const std::string &sourceSe, const std::string &destSe) const
+{
+    std::vector<const Link*> matches = matchingLinks(sourceSe, destSe, false);
+    for (auto i = matches.begin(); i != matches.end(); ++i) {
+        if ((*i)->thirdPartyTURL) {
+            return *(*i)->thirdPartyTURL;
+        }
+    }
+    return std::string();
+}
+
+
+int ConfigSnapshot::getMaxTimeInQueue(const std::string &voName) const
+{
+    const Vo *entry = findVo(voName);
+    if (entry && entry->maxTimeInQueue && *entry->maxTimeInQueue > 0) {
+        return *entry->maxTimeInQueue;
+    }
+    return 0;
+}
+
+
+int ConfigSnapshot::getGlobalTimeout(const std::string &voName) const
+{
+    const Vo *entry = findVo(voName);
+    if (entry && entry->globalTimeout) {
+        return *entry->globalTimeout;
+    }
+    return 0;
+}
+
+
+int ConfigSnapshot::getSecPerMb(const std::string &voName) const
+{
+    const Vo *entry = findVo(voName);
+    if (entry && entry->secPerMb) {
+        return *entry->secPerMb;
+    }
+    return 0;
+}
+
+
+bool ConfigSnapshot::getDisableStreamingFlag(const std::string &voName) const
+{
+    const Vo *entry = findVo(voName);
+    return entry && entry->noStreaming && *entry->noStreaming == "on";
+}
+
+
+bool ConfigSnapshot::publishUserDn(const std::string &voName) const
+{
+    // No fallback here
+    auto i = vos.find(voName);
+    return i != vos.end() && i->second.showUserDn && *i->second.showUserDn == "on";
+}
+
+
+const ConfigSnapshot::Storage *ConfigSnapshot::findStorage(const std::string &storage) const
+{
+    auto i = storages.find(storage);
+    if (i == storages.end()) {
+        return NULL;
+    }
+    return &i->second;
+}
+
+
+const ConfigSnapshot::Link *ConfigSnapshot::findLink(const std::string &source,
+    const std::string &destination) const
+{
+    auto i = links.find(Pair(source, destination));
+    if (i == links.end()) {
+        return NULL;
+    }
+    return &i->second;
+}
+
+
+const ConfigSnapshot::Vo *ConfigSnapshot::findVo(const std::string &voName) const
+{
+    auto i = vos.find(voName);
+    if (i == vos.end()) {
+        i = vos.find("*");
+    }
+    if (i != vos.end()) {
+        return &i->second;
+    }
+    if (nullVo) {
+        return &(*nullVo);
+    }
+    return NULL;
+}
+
+
+std::vector<const ConfigSnapshot::Link*> ConfigSnapshot::matchingLinks(const std::string &source,
+    const std::string &destination, bool withStarStar) const
+{
+    std::vector<const Link*> matches;
+
+    const Link *candidates[] = {
+        findLink(source, destination),
+        findLink(source, "*"),
+        findLink("*", destination),
+        withStarStar ? findLink("*", "*") : NULL
+    };
+    for (auto candidate: candidates) {
+        if (candidate) {
+            matches.push_back(candidate);
+        }
+    }
+
+    return matches;
+}
+
+
+boost::tribool ConfigSnapshot::resolveProtocol(boost::tribool source, boost::tribool dest,
+    boost::tribool star) const
+{
+    // Fallback if both are undefined
+    if (boost::indeterminate(source) && boost::indeterminate(dest)) {
+        return star;
+    }
+    // If only one is undefined, the other decides
+    else if (boost::indeterminate(source)) {
+        return dest;
+    }
+    else if (boost::indeterminate(dest)) {
+        return source;
+    }
+    // Both defined, need to agree
+    return source && dest;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef CONFIGSNAPSHOT_H_
+#define CONFIGSNAPSHOT_H_
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/logic/tribool.hpp>
+#include <boost/optional.hpp>
+
+#include "LinkConfig.h"
+#include "ShareConfig.h"
+#include "StorageConfig.h"
+
+
+/// Copy of the storage, link, share and VO configuration tables.
+/// Once built it is never modified, so it can be shared between threads without locking.
+/// A new snapshot replaces the previous one when the configuration changes.
+/// The lookups reproduce the resolution rules (exact match, then wildcards) of the queries they replace.
+class ConfigSnapshot
+{
+public:
+    /// Row of the storage configuration
+    /// debugLevel and eviction are kept apart because their nullity matters
+    struct Storage {
+        Storage(): eviction(boost::indeterminate) {}
+
+        StorageConfig config;
+        boost::optional<int> debugLevel;
+        boost::tribool eviction;
+    };
+
+    /// Row of the link configuration
+    struct Link {
+        LinkConfig config;
+        boost::optional<int> numberOfStreams;
+        boost::optional<std::string> noDelegation;
+        boost::optional<std::string> thirdPartyTURL;
+    };
+
+    /// Row of the server configuration, which is per VO
+    struct Vo {
+        boost::optional<int> maxTimeInQueue;
+        boost::optional<int> globalTimeout;
+        boost::optional<int> secPerMb;
+        boost::optional<std::string> noStreaming;
+        boost::optional<std::string> showUserDn;
+    };
+
+    /// Constructor
+    /// @param version  Increases every time a new snapshot is built
+    explicit ConfigSnapshot(uint64_t version);
+
+    /// Used by the database backend to populate the snapshot before publishing it
+    void addStorage(const std::string &storage, const Storage &entry);
+    void addLink(const Link &entry);
+    void addShare(const ShareConfig &share);
+    /// A null VO name is the fallback of last resort
+    void addVo(const boost::optional<std::string> &voName, const Vo &entry);
+
+    uint64_t getVersion() const;
+
+    StorageConfig getStorageConfig(const std::string &storage) const;
+    unsigned getDebugLevel(const std::string &sourceStorage, const std::string &destStorage) const;
+    boost::tribool isProtocolUDT(const std::string &source, const std::string &dest) const;
+    boost::tribool isProtocolIPv6(const std::string &source, const std::string &dest) const;
+    boost::tribool getEvictionFlag(const std::string &source) const;
+
+    std::unique_ptr<LinkConfig> getLinkConfig(const std::string &source, const std::string &destination) const;
+    std::vector<ShareConfig> getShareConfig(const std::string &source, const std::string &destination) const;
+    /// Returns none if no link configuration sets the number of streams
+    boost::optional<int> getStreamsOptimization(const std::string &sourceSe, const std::string &destSe) const;
+    bool getDisableDelegationFlag(const std::string &sourceSe, const std::string &destSe) const;
+    std::string getThirdPartyTURL(const std::string &sourceSe, const std::string &destSe) const;
+
+    int getMaxTimeInQueue(const std::string &voName) const;
+    int getGlobalTimeout(const std::string &voName) const;
+    int getSecPerMb(const std::string &voName) const;
+    bool getDisableStreamingFlag(const std::string &voName) const;
+    bool publishUserDn(const std::string &voName) const;
+
+private:
+    typedef std::pair<std::string, std::string> Pair;
+
+    uint64_t version;
+    std::map<std::string, Storage> storages;
+    std::map<Pair, Link> links;
+    std::map<Pair, std::vector<ShareConfig>> shares;
+    std::map<std::string, Vo> vos;
+    boost::optional<Vo> nullVo;
+
+    const Storage *findStorage(const std::string &storage) const;
+    const Link *findLink(const std::string &source, const std::string &destination) const;
+    /// Server configuration for the VO, falling back to '*', and then to the null VO
+    const Vo *findVo(const std::string &voName) const;
+
+    /// Link configurations that apply to the pair, most specific first
+    /// @param withStarStar If false, the */* configuration is not included
+    std::vector<const Link*> matchingLinks(const std::string &source, const std::string &destination,
+        bool withStarStar) const;
+
+    boost::tribool resolveProtocol(boost::tribool source, boost::tribool dest, boost::tribool star) const;
+};
+
+#endif // CONFIGSNAPSHOT_H_
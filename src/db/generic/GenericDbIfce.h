@@ -32,6 +32,8 @@
 #include "JobStatus.h"
 #include "FileTransferStatus.h"
 #include "QueueId.h"
+#include "QueueCounters.h"
+#include "QueueChange.h"
 #include "LinkConfig.h"
 #include "StorageConfig.h"
 #include "ShareConfig.h"
@@ -44,6 +46,7 @@
 #include "DeleteOperation.h"
 #include "Job.h"
 #include "MinFileStatus.h"
+#include "StatusUpdateResult.h"
 #include "StagingOperation.h"
 #include "ArchivingOperation.h"
 #include "QosTransitionOperation.h"
@@ -128,6 +131,15 @@ public:
     /// @note                   If jobId is empty, the pid will be used to decide which job to update
     virtual bool updateJobStatus(const std::string& jobId, const std::string& jobState) = 0;
 
+    /// Bulk version of updateTransferStatus followed by updateJobStatus, for terminal status messages
+    /// The file states are changed within a single transaction, and then the state of each job is recomputed once
+    /// @param messages         Status messages reported by fts_url_copy
+    /// @param[out] results     One entry per message. Messages that are not terminal, that belong to jobs
+    ///                         that need special handling (multiple replica, multihop, archiving),
+    ///                         or that could not be applied because of a conflict, are left with applied set to false
+    virtual void updateTransferStatuses(const std::vector<fts3::events::Message>& messages,
+            std::vector<StatusUpdateResult>& results) = 0;
+
     /// Get the credentials associated with the given delegation ID and user
     /// @param delegationId     Delegation ID. See insertCredentialCache
     /// @param userDn           The user's DN
@@ -153,7 +165,9 @@ public:
     /// @param sourceStorage        The source storage  (as protocol://host)
     /// @param destStorage          The destination storage  (as protocol://host)
     /// @param[out] currentActive   The current number of running transfers is put here
-    virtual bool isTrAllowed(const std::string& sourceStorage, const std::string& destStorage, int &currentActive) = 0;
+    /// @param[out] maxActive       The number of running transfers decided by the optimizer is put here
+    virtual bool isTrAllowed(const std::string& sourceStorage, const std::string& destStorage, int &currentActive,
+        int &maxActive) = 0;
 
     /// Mark a reuse job (and its files) as failed
     /// @param jobId    The job id
@@ -177,8 +191,9 @@ public:
 
     /// Moves old transfer and job records to the archive tables
     /// Delete old entries in other tables (i.e. t_optimize_evolution)
+    /// The work is split in ranges processed in parallel, and an interrupted run resumes where it stopped
     /// @param[in] intervalDays Jobs older than this many days will be purged
-    /// @param[in] bulkSize How many jobs per iteration must be processed
+    /// @param[in] bulkSize Maximum number of jobs processed per transaction
     /// @param[out] nJobs   How many jobs have been moved
     /// @param[out] nFiles  How many files have been moved
     /// @param[out] nDeletions  How many deletions have been moved
@@ -211,6 +226,17 @@ public:
     /// Update the protocol parameters for this particular transfer
     virtual void updateProtocol(const fts3::events::Message& message) = 0;
 
+    /// Move a batch of queued transfers to READY, assigning them to this host,
+    /// and store their protocol parameters, all within a single transaction
+    /// @param transfers    UPDATE messages with the file id and protocol parameters of each transfer
+    /// @param claimed      Filled with the file id and retry count of the transfers that were claimed.
+    ///                     The rest were picked by another node, or changed state meanwhile.
+    virtual void claimTransfers(const std::vector<fts3::events::Message>& transfers,
+        std::map<uint64_t, int>& claimed) = 0;
+
+    /// Store the pid of a batch of transfers that have been forked
+    virtual void setTransfersPid(const std::vector<fts3::events::MessageUpdater>& transfers) = 0;
+
     /// Get the state the transfer identified by jobId/fileId
     virtual std::vector<TransferState> getStateOfTransfer(const std::string& jobId, uint64_t fileId) = 0;
 
@@ -251,11 +277,21 @@ public:
         service_name = std::string("");
     }
 
+    /**
+     * Hash ranges this host processes, as of the last heartbeat, which may not be contiguous.
+     * The queries filter on them every time, so nothing has to be done when they change.
+     */
+    virtual void getHashSegment(std::vector<std::pair<unsigned, unsigned>> *ranges)
+    {
+        ranges->assign(1, std::make_pair(0x0000u, 0xFFFFu));
+    }
+
     /// Update the state of a transfer inside a session reuse job
     virtual unsigned int updateFileStatusReuse(const TransferFile &file, const std::string &status) = 0;
 
-    /// Puts into requestIDs, jobs that have been cancelled, and for which the running fts_url_copy must be killed
-    virtual void getCancelJob(std::vector<int>& requestIDs) = 0;
+    /// Puts into canceled the pid and file id of the transfers that have been cancelled,
+    /// and for which the running fts_url_copy must be killed
+    virtual void getCancelJob(std::vector<std::pair<int, uint64_t>>& canceled) = 0;
 
     /// Returns list of transfers that need to be force started
     virtual std::list<TransferFile> getForceStartTransfers() = 0;
@@ -296,6 +332,21 @@ public:
     /// Puts into the vector queues the Queues for which there are session-reuse pending transfers
     virtual void getQueuesWithSessionReusePending(std::vector<QueueId>& queues) = 0;
 
+    /// Puts into counters how many transfers are queued and running for every queue
+    /// @param[out] counters    One entry per queue with SUBMITTED, READY or ACTIVE transfers
+    /// @return                 The highest queue change id at the moment of the query,
+    ///                         0 if there are no changes to follow
+    virtual uint64_t getQueueCounters(std::vector<QueueCounters>& counters) = 0;
+
+    /// Puts into changes the transfers that entered the SUBMITTED state after the given change,
+    /// either submitted, or updated (staged, next hop or replica, retry...)
+    /// @param afterChangeId    Only changes with a higher id are returned
+    /// @param[out] changes     One entry per change, ordered by id
+    virtual void getQueueChangesSince(uint64_t afterChangeId, std::vector<QueueChange>& changes) = 0;
+
+    /// Delete the queue changes older than the given number of seconds
+    virtual void purgeQueueChanges(int olderThan) = 0;
+
     /// Updates the status for delete operations
     /// @param delOpsStatus  Update for files in delete or started
     virtual void updateDeletionsState(const std::vector<MinFileStatus>& delOpsStatus) = 0;
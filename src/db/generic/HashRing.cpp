@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HashRing.h"
+
+#include <algorithm>
+#include <cstdint>
+
+
+const unsigned HashRing::HASH_MAX;
+const unsigned HashRing::NO_HASH;
+
+
+HashRing::HashRing(unsigned virtualNodes): virtualNodes(std::max(1u, virtualNodes))
+{
+}
+
+
+bool HashRing::setMembers(std::vector<std::string> hosts)
+{
+    std::sort(hosts.begin(), hosts.end());
+    hosts.erase(std::unique(hosts.begin(), hosts.end()), hosts.end());
+    if (hosts == members) {
+        return false;
+    }
+
+    members.swap(hosts);
+    points.clear();
+    points.reserve(members.size() * virtualNodes);
+    for (size_t i = 0; i < members.size(); ++i) {
+        for (unsigned v = 0; v < virtualNodes; ++v) {
+            points.emplace_back(getPosition(members[i], v), i);
+        }
+    }
+    // On collision, the host with the lowest name wins, and the other gets an empty range
+    std::sort(points.begin(), points.end());
+    return true;
+}
+
+
+const std::vector<std::string> &HashRing::getMembers() const
+{
+    return members;
+}
+
+
+unsigned HashRing::getVirtualNodes() const
+{
+    return virtualNodes;
+}
+
+
+std::vector<HashRing::Range> HashRing::getRanges(const std::string &host) const
+{
+    std::vector<Range> ranges;
+    auto member = std::lower_bound(members.begin(), members.end(), host);
+    if (member == members.end() || *member != host) {
+        return ranges;
+    }
+    const size_t index = member - members.begin();
+
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (points[i].second != index) {
+            continue;
+        }
+        if (i == 0) {
+            // The first point also takes the wrap around, past the last one
+            ranges.emplace_back(0, points[0].first);
+            if (points.back().first < HASH_MAX) {
+                ranges.emplace_back(points.back().first + 1, HASH_MAX);
+            }
+        }
+        else if (points[i - 1].first < points[i].first) {
+            ranges.emplace_back(points[i - 1].first + 1, points[i].first);
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<Range> merged;
+    for (auto range = ranges.begin(); range != ranges.end(); ++range) {
+        if (!merged.empty() && merged.back().second + 1 >= range->first) {
+            merged.back().second = std::max(merged.back().second, range->second);
+        }
+        else {
+            merged.push_back(*range);
+        }
+    }
+    return merged;
+}
+
+
+HashRing::Range HashRing::getBounds(const std::vector<Range> &ranges)
+{
+    if (ranges.empty()) {
+        return Range(NO_HASH, NO_HASH);
+    }
+    return Range(ranges.front().first, ranges.back().second);
+}
+
+
+std::string HashRing::getOwner(unsigned hash) const
+{
+    if (points.empty()) {
+        return std::string();
+    }
+    auto point = std::lower_bound(points.begin(), points.end(), std::make_pair(hash, size_t(0)));
+    if (point == points.end()) {
+        point = points.begin();
+    }
+    return members[point->second];
+}
+
+
+unsigned HashRing::getPosition(const std::string &host, unsigned virtualNode)
+{
+    // FNV-1a, mixed so keys differing only by the last characters spread over the ring
+    const std::string key = host + '#' + std::to_string(virtualNode);
+    uint32_t hash = 2166136261u;
+    for (auto c = key.begin(); c != key.end(); ++c) {
+        hash ^= static_cast<unsigned char>(*c);
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return ((hash >> 16) ^ hash) & HASH_MAX;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef HASHRING_H_
+#define HASHRING_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/// Splits the 16 bits hash space of t_file.hashed_id between the hosts of a service.
+/// Each host is placed on a ring at several pseudo-random positions (virtual nodes), and
+/// owns the hashes from the previous position, excluded, up to each of its own.
+/// When a host joins or leaves, only the hashes next to its positions change owner,
+/// about 1/n of the space, instead of every segment as with contiguous slices.
+class HashRing
+{
+public:
+    /// Inclusive interval of hash values
+    typedef std::pair<unsigned, unsigned> Range;
+
+    static const unsigned HASH_MAX = 0xFFFF;
+
+    /// Out of the hash space. Lowest and highest hash of a host that owns none.
+    static const unsigned NO_HASH = HASH_MAX + 1;
+
+    explicit HashRing(unsigned virtualNodes = 32);
+
+    /// Set the hosts alive
+    /// @return true if the membership changed
+    bool setMembers(std::vector<std::string> hosts);
+
+    const std::vector<std::string> &getMembers() const;
+
+    unsigned getVirtualNodes() const;
+
+    /// Hash ranges owned by the host, sorted and merged. Empty if the host is not a member.
+    std::vector<Range> getRanges(const std::string &host) const;
+
+    /// Lowest and highest hash of the ranges, NO_HASH for both if there are none.
+    /// A host can own none when all its positions collide with those of other hosts.
+    static Range getBounds(const std::vector<Range> &ranges);
+
+    /// Host owning the hash value. Empty if there are no members.
+    std::string getOwner(unsigned hash) const;
+
+    /// Position of the virtual node of the host on the ring
+    static unsigned getPosition(const std::string &host, unsigned virtualNode);
+
+private:
+    unsigned virtualNodes;
+    std::vector<std::string> members;
+    /// position, host index in members; sorted
+    std::vector<std::pair<unsigned, size_t>> points;
+};
+
+#endif // HASHRING_H_
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef QUEUECHANGE_H_
+#define QUEUECHANGE_H_
+
+#include <stdint.h>
+#include <string>
+
+/// A transfer entered the SUBMITTED state in the given queue (see QueueId)
+/// Recorded in t_queue_changes by triggers on t_file
+struct QueueChange {
+    QueueChange(uint64_t changeId, const std::string& sourceSe, const std::string& destSe,
+        const std::string& voName):
+        changeId(changeId), sourceSe(sourceSe), destSe(destSe), voName(voName)
+    {}
+
+    uint64_t changeId;
+    std::string sourceSe;
+    std::string destSe;
+    std::string voName;
+};
+
+#endif // QUEUECHANGE_H_
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef QUEUECOUNTERS_H_
+#define QUEUECOUNTERS_H_
+
+#include <stdint.h>
+#include <string>
+
+/// Number of queued and running transfers for a queue (see QueueId)
+struct QueueCounters {
+    QueueCounters(const std::string& sourceSe, const std::string& destSe, const std::string& voName,
+        uint64_t submitted, uint64_t active):
+        sourceSe(sourceSe), destSe(destSe), voName(voName), submitted(submitted), active(active)
+    {}
+
+    std::string sourceSe;
+    std::string destSe;
+    std::string voName;
+    uint64_t submitted;
+    uint64_t active;
+};
+
+#endif // QUEUECOUNTERS_H_
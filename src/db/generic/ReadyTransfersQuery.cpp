@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ReadyTransfersQuery.h"
+
+
+static std::string buildReadyTransfersSubquery(const ReadyTransfersQuery &query, const std::string &hashCondition)
+{
+    std::string select =
+        "(SELECT f.file_state, f.source_surl, f.dest_surl, f.job_id, j.vo_name, "
+        "       f.file_id, j.overwrite_flag, j.archive_timeout, j.dst_file_report, "
+        "       j.user_dn, j.cred_id, f.checksum, j.checksum_method, j.source_space_token, "
+        "       j.space_token, j.copy_pin_lifetime, j.bring_online, "
+        "       f.user_filesize, f.file_metadata, j.job_metadata, f.file_index, f.bringonline_token, "
+        "       f.source_se, f.dest_se, f.selection_strategy, j.internal_job_params, j.job_type, "
+        "       :activity AS activity "
+        " FROM t_file f USE INDEX(idx_link_state_vo), t_job j "
+        " WHERE f.job_id = j.job_id AND f.file_state = 'SUBMITTED' AND "
+        "     f.source_se = :source_se AND f.dest_se = :dest_se AND "
+        "     f.vo_name = :vo_name AND "
+        "     (f.retry_timestamp IS NULL OR f.retry_timestamp < :tTime) AND "
+        "     " + hashCondition + " AND "
+        "     j.priority = :maxPriority AND ";
+
+    if (!query.byActivity) {
+        select += " j.job_type IN ('N', 'R', 'H') ";
+    }
+    else if (query.activity == "default") {
+        select += " (j.job_type = 'N' OR j.job_type = 'R') AND "
+            " (f.activity = :activity OR f.activity IS NULL OR f.activity IN " + query.defaultActivities + ") ";
+    }
+    else {
+        select += " (j.job_type = 'N' OR j.job_type = 'R') AND f.activity = :activity ";
+    }
+
+    select += " ORDER BY f.file_id ASC LIMIT :filesNum)";
+    return select;
+}
+
+
+std::string buildReadyTransfersQuery(const std::vector<ReadyTransfersQuery> &queries, size_t first, size_t last,
+    const std::string &hashCondition)
+{
+    std::string select;
+    for (size_t i = first; i < last && i < queries.size(); ++i) {
+        if (i != first) {
+            select += " UNION ALL ";
+        }
+        select += buildReadyTransfersSubquery(queries[i], hashCondition);
+    }
+    return select;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef READYTRANSFERSQUERY_H_
+#define READYTRANSFERSQUERY_H_
+
+#include <string>
+#include <vector>
+
+#include "QueueId.h"
+
+
+/// Files to be picked from a queue, for a given priority and, optionally, activity
+struct ReadyTransfersQuery {
+    ReadyTransfersQuery(const QueueId &queue, int priority, int limit):
+        sourceSe(queue.sourceSe), destSe(queue.destSe), voName(queue.voName),
+        byActivity(false), priority(priority), limit(limit)
+    {}
+
+    std::string sourceSe;
+    std::string destSe;
+    std::string voName;
+    bool byActivity;
+    /// Given to the transfers picked. Empty if the VO has no activity shares,
+    /// as the transfers of those queues never had one.
+    std::string activity;
+    /// SQL list of activities that fall into the default share
+    std::string defaultActivities;
+    int priority;
+    int limit;
+};
+
+
+/// Statement picking the files of the queries [first, last), joined with UNION ALL.
+/// Each query picks up to limit files from its queue, in file id order, so it can stop
+/// as soon as enough files are found walking the index.
+///
+/// For each query, the values to bind are, in order:
+/// activity, source_se, dest_se, vo_name, retry timestamp, priority,
+/// activity again if byActivity is set, and limit.
+std::string buildReadyTransfersQuery(const std::vector<ReadyTransfersQuery> &queries, size_t first, size_t last,
+    const std::string &hashCondition);
+
+#endif // READYTRANSFERSQUERY_H_
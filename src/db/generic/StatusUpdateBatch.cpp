@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StatusUpdateBatch.h"
+
+#include <set>
+
+
+std::map<std::string, std::vector<size_t>> groupTerminalStatuses(const std::vector<fts3::events::Message> &messages,
+    std::vector<uint64_t> &fileIds)
+{
+    std::map<std::string, std::vector<size_t>> byJob;
+    std::set<uint64_t> fileIdSet;
+
+    for (size_t i = 0; i < messages.size(); ++i) {
+        const fts3::events::Message &msg = messages[i];
+        const std::string &state = msg.transfer_status();
+
+        if (state != "FINISHED" && state != "FAILED" && state != "CANCELED") {
+            continue;
+        }
+        if (msg.job_id().empty() || msg.file_id() == 0 || !fileIdSet.insert(msg.file_id()).second) {
+            continue;
+        }
+
+        byJob[msg.job_id()].push_back(i);
+        fileIds.push_back(msg.file_id());
+    }
+
+    return byJob;
+}
+
+
+bool canUpdateStatusesInBulk(Job::JobType jobType, int archiveTimeout)
+{
+    return (jobType == Job::kTypeRegular || jobType == Job::kTypeSessionReuse) && archiveTimeout < 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef STATUSUPDATEBATCH_H_
+#define STATUSUPDATEBATCH_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Job.h"
+#include "msg-bus/events.h"
+
+
+/// Terminal status messages that can be applied together, grouped by job, as indexes into messages.
+/// Only the first message of a file is kept, so the ones reported after it are applied on their own,
+/// once it has been.
+/// @param[out] fileIds The files of the messages kept
+std::map<std::string, std::vector<size_t>> groupTerminalStatuses(const std::vector<fts3::events::Message> &messages,
+    std::vector<uint64_t> &fileIds);
+
+/// Multiple replica and multihop jobs pick the next file when one terminates,
+/// and archiving jobs move to ARCHIVING instead of FINISHED, so only the other jobs can be updated in bulk
+bool canUpdateStatusesInBulk(Job::JobType jobType, int archiveTimeout);
+
+#endif // STATUSUPDATEBATCH_H_
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef STATUSUPDATERESULT_H_
+#define STATUSUPDATERESULT_H_
+
+#include <string>
+
+
+/// Outcome of a status message applied with updateTransferStatuses
+struct StatusUpdateResult {
+    StatusUpdateResult(): applied(false), updated(false)
+    {
+    }
+
+    /// False if the message could not be applied in bulk, and has to be applied on its own
+    bool applied;
+    /// Same meaning as the return value of updateTransferStatus
+    bool updated;
+    std::string storedState;
+};
+
+
+#endif // STATUSUPDATERESULT_H_
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <boost/thread.hpp>
+
+#include "MySqlAPI.h"
+#include "common/Exceptions.h"
+#include "common/Logger.h"
+#include "config/ServerConfig.h"
+#include "db/generic/BackupCheckpoint.h"
+#include "sociConversions.h"
+
+
+using namespace fts3::common;
+using namespace fts3::config;
+using namespace db;
+
+
+namespace {
+
+/// Shared between the backup workers
+struct BackupRun
+{
+    BackupRun(soci::connection_pool &pool, const std::tm &cutoff, long bulkSize, double targetLockTime,
+        bool doBackup, bool fileStateCounters, const std::string &checkpointPath):
+        pool(pool), cutoff(cutoff), bulkSize(bulkSize), targetLockTime(targetLockTime), doBackup(doBackup),
+        fileStateCounters(fileStateCounters), checkpoint(checkpointPath), stop(false), failed(false), running(0),
+        nJobs(0), nFiles(0), nDeletions(0), nHistory(0)
+    {
+    }
+
+    soci::connection_pool &pool;
+    const std::tm cutoff;
+    const long bulkSize;
+    const double targetLockTime;
+    const bool doBackup;
+    /// t_job_file_counters exists, and has no trigger on delete
+    const bool fileStateCounters;
+
+    BackupCheckpoint checkpoint;
+
+    /// Pending tasks
+    boost::mutex tasksMutex;
+    std::deque<std::string> tasks;
+
+    std::atomic<bool> stop;
+    std::atomic<bool> failed;
+    std::atomic<int> running;
+    std::string error;
+
+    std::atomic<long> nJobs, nFiles, nDeletions, nHistory;
+
+    bool nextTask(std::string *task)
+    {
+        boost::mutex::scoped_lock lock(tasksMutex);
+        if (tasks.empty() || stop) {
+            return false;
+        }
+        *task = tasks.front();
+        tasks.pop_front();
+        return true;
+    }
+};
+
+
+/// History tables, purged by date
+const char *HISTORY_TABLES[] = {"t_optimizer_evolution", "t_file_retry_errors"};
+
+/// Job ids are UUIDs, so the first hex digit splits them in even ranges
+const char JOB_RANGE_PREFIX[] = "0123456789abcdef";
+/// Sorts after any job id
+const std::string JOB_RANGE_END("~");
+const std::string JOB_RANGE_TASK("t_job:");
+
+
+double secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/// Give the database, and the replicas, as much time as the transaction held its locks
+void pause(double elapsed)
+{
+    boost::this_thread::sleep(boost::posix_time::milliseconds(static_cast<long>(elapsed * 1000)));
+}
+
+
+/// Move to the backup tables, and delete, the old jobs with job id in (after, upper)
+/// Walks the primary key, chunkSize jobs per transaction, recording the progress in the checkpoint
+void backupJobRange(BackupRun &run, const std::string &task, const std::string &after, const std::string &upper)
+{
+    soci::session sql(run.pool);
+    BackupChunkSize chunkSize(run.bulkSize, run.targetLockTime);
+
+    std::string lastJobId = run.checkpoint.getLastKey(task);
+    if (lastJobId.empty()) {
+        lastJobId = after;
+    }
+
+    while (!run.stop) {
+        // Upper job id of the next chunk. The set of old jobs is stable, since jobs can only become old,
+        // and for that they must have finished before the cutoff
+        long long chunk = chunkSize.get();
+        long long count = 0;
+        std::string chunkEnd;
+        soci::indicator chunkEndInd = soci::i_ok;
+
+        sql << "SELECT COUNT(*), MAX(job_id) FROM ("
+               "    SELECT job_id FROM t_job "
+               "    WHERE job_id > :after AND job_id < :upper AND job_finished < :cutoff "
+               "    ORDER BY job_id LIMIT :chunk"
+               ") AS chunk",
+            soci::use(lastJobId), soci::use(upper), soci::use(run.cutoff), soci::use(chunk),
+            soci::into(count), soci::into(chunkEnd, chunkEndInd);
+
+        if (count == 0 || chunkEndInd == soci::i_null) {
+            break;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        try {
+            sql.begin();
+
+            if (run.doBackup) {
+                sql << "INSERT INTO t_job_backup SELECT * FROM t_job "
+                       " WHERE job_id > :after AND job_id <= :chunkEnd AND job_finished < :cutoff",
+                    soci::use(lastJobId), soci::use(chunkEnd), soci::use(run.cutoff);
+
+                sql << "INSERT INTO t_file_backup SELECT f.* FROM t_file f "
+                       " INNER JOIN t_job j ON f.job_id = j.job_id "
+                       " WHERE j.job_id > :after AND j.job_id <= :chunkEnd AND j.job_finished < :cutoff",
+                    soci::use(lastJobId), soci::use(chunkEnd), soci::use(run.cutoff);
+            }
+
+            soci::statement deleteFiles = (sql.prepare <<
+                "DELETE f FROM t_file f "
+                " INNER JOIN t_job j ON f.job_id = j.job_id "
+                " WHERE j.job_id > :after AND j.job_id <= :chunkEnd AND j.job_finished < :cutoff",
+                soci::use(lastJobId), soci::use(chunkEnd), soci::use(run.cutoff));
+            deleteFiles.execute(true);
+
+            soci::statement deleteDeletions = (sql.prepare <<
+                "DELETE d FROM t_dm d "
+                " INNER JOIN t_job j ON d.job_id = j.job_id "
+                " WHERE j.job_id > :after AND j.job_id <= :chunkEnd AND j.job_finished < :cutoff",
+                soci::use(lastJobId), soci::use(chunkEnd), soci::use(run.cutoff));
+            deleteDeletions.execute(true);
+
+            if (run.fileStateCounters) {
+                sql << "DELETE c FROM t_job_file_counters c "
+                       " INNER JOIN t_job j ON c.job_id = j.job_id "
+                       " WHERE j.job_id > :after AND j.job_id <= :chunkEnd AND j.job_finished < :cutoff",
+                    soci::use(lastJobId), soci::use(chunkEnd), soci::use(run.cutoff);
+            }
+
+            soci::statement deleteJobs = (sql.prepare <<
+                "DELETE FROM t_job "
+                " WHERE job_id > :after AND job_id <= :chunkEnd AND job_finished < :cutoff",
+                soci::use(lastJobId), soci::use(chunkEnd), soci::use(run.cutoff));
+            deleteJobs.execute(true);
+
+            sql.commit();
+
+            run.nFiles += deleteFiles.get_affected_rows();
+            run.nDeletions += deleteDeletions.get_affected_rows();
+            run.nJobs += deleteJobs.get_affected_rows();
+        }
+        catch (...) {
+            sql.rollback();
+            throw;
+        }
+
+        double elapsed = secondsSince(start);
+        chunkSize.update(count, elapsed);
+
+        lastJobId = chunkEnd;
+        run.checkpoint.setLastKey(task, lastJobId);
+
+        if (count < chunk) {
+            break;
+        }
+        pause(elapsed);
+    }
+
+    if (!run.stop) {
+        run.checkpoint.setDone(task);
+    }
+}
+
+
+/// Delete the entries older than the cutoff from a history table, a bounded number per statement
+/// Every history table has an index on datetime (idx_datetime). The rows are not sorted,
+/// since they all go anyway.
+void purgeHistoryTable(BackupRun &run, const std::string &table)
+{
+    soci::session sql(run.pool);
+    BackupChunkSize chunkSize(run.bulkSize, run.targetLockTime);
+
+    while (!run.stop) {
+        long long chunk = chunkSize.get();
+        auto start = std::chrono::steady_clock::now();
+
+        soci::statement purge = (sql.prepare <<
+            "DELETE FROM " << table << " WHERE datetime < :cutoff LIMIT :chunk",
+            soci::use(run.cutoff), soci::use(chunk));
+        purge.execute(true);
+        long deleted = purge.get_affected_rows();
+        run.nHistory += deleted;
+
+        double elapsed = secondsSince(start);
+        chunkSize.update(deleted, elapsed);
+
+        if (deleted < chunk) {
+            break;
+        }
+        pause(elapsed);
+    }
+
+    if (!run.stop) {
+        run.checkpoint.setDone(table);
+    }
+}
+
+
+void backupWorker(BackupRun &run)
+{
+    std::string task;
+    try {
+        while (run.nextTask(&task)) {
+            if (task.compare(0, JOB_RANGE_TASK.size(), JOB_RANGE_TASK) == 0) {
+                const size_t index = std::string(JOB_RANGE_PREFIX).find(task[JOB_RANGE_TASK.size()]);
+                const std::string after = (index == 0) ? std::string() : std::string(1, JOB_RANGE_PREFIX[index]);
+                const std::string upper = (index + 1 < sizeof(JOB_RANGE_PREFIX) - 1) ?
+                    std::string(1, JOB_RANGE_PREFIX[index + 1]) : JOB_RANGE_END;
+                backupJobRange(run, task, after, upper);
+            }
+            else {
+                purgeHistoryTable(run, task);
+            }
+        }
+    }
+    catch (const std::exception &e) {
+        boost::mutex::scoped_lock lock(run.tasksMutex);
+        if (!run.failed) {
+            run.error = task + ": " + e.what();
+        }
+        run.failed = true;
+        run.stop = true;
+    }
+    --run.running;
+}
+
+} // namespace
+
+
+void MySqlAPI::backup(int intervalDays, long bulkSize, long* nJobs, long* nFiles, long* nDeletions)
+{
+    soci::session sql(*connectionPool);
+
+    unsigned index=0, activeHosts=0, start=0, end=0;
+    std::string serviceName = "fts_backup";
+    *nJobs = 0;
+    *nFiles = 0;
+    *nDeletions = 0;
+    int hostsRunningBackup = 0;
+
+    try
+    {
+        // Total number of working instances, prevent from starting a second one
+        soci::statement stmtActiveHosts = (
+                                              sql.prepare << "SELECT COUNT(hostname) FROM t_hosts "
+                                              "  WHERE beat >= DATE_SUB(UTC_TIMESTAMP(), interval 30 minute) and service_name = :service_name",
+                                              soci::use(serviceName),
+                                              soci::into(hostsRunningBackup));
+        stmtActiveHosts.execute(true);
+
+        if(hostsRunningBackup > 0)
+        {
+            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Backup already running, won't start" << commit;
+            return;
+        }
+
+        updateHeartBeatInternal(sql, &index, &activeHosts, &start, &end, serviceName);
+
+        //prevent more than on server to update the optimizer decisions
+        if(hashSegment.start != 0)
+        {
+            return;
+        }
+
+        // Fixed for the whole run, so every statement agrees on which entries are old
+        std::tm cutoff;
+        sql << "SELECT UTC_TIMESTAMP() - INTERVAL :days DAY", soci::use(intervalDays), soci::into(cutoff);
+
+        // Each worker needs its own connection, and this thread keeps one for the heartbeat
+        if (poolSize < 2) {
+            throw SystemError("The backup needs at least two database connections");
+        }
+        const int nWorkers = std::max(1, std::min(ServerConfig::instance().get<int>("CleanThreads"),
+            static_cast<int>(poolSize) - 1));
+
+        BackupRun run(*connectionPool, cutoff, bulkSize,
+            ServerConfig::instance().get<int>("CleanTargetLockTime") / 1000.0,
+            ServerConfig::instance().get<bool>("BackupTables"), fileStateCounters,
+            ServerConfig::instance().get<std::string>("CleanCheckpointFile"));
+
+        for (size_t i = 0; i < sizeof(JOB_RANGE_PREFIX) - 1; ++i) {
+            std::string task = JOB_RANGE_TASK + JOB_RANGE_PREFIX[i];
+            if (!run.checkpoint.isDone(task)) {
+                run.tasks.push_back(task);
+            }
+        }
+        for (size_t i = 0; i < sizeof(HISTORY_TABLES) / sizeof(HISTORY_TABLES[0]); ++i) {
+            if (!run.checkpoint.isDone(HISTORY_TABLES[i])) {
+                run.tasks.push_back(HISTORY_TABLES[i]);
+            }
+        }
+
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Backup running " << run.tasks.size() << " tasks with "
+            << nWorkers << " workers" << commit;
+
+        boost::thread_group workers;
+        run.running = nWorkers;
+        for (int i = 0; i < nWorkers; ++i) {
+            workers.create_thread(boost::bind(backupWorker, boost::ref(run)));
+        }
+
+        // Keep the heartbeat, and stop if the host is drained
+        auto lastBeat = std::chrono::steady_clock::now();
+        while (run.running > 0) {
+            boost::this_thread::sleep(boost::posix_time::seconds(1));
+            if (secondsSince(lastBeat) < 60) {
+                continue;
+            }
+            lastBeat = std::chrono::steady_clock::now();
+
+            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Backup progress: "
+                << run.nJobs << " jobs and " << run.nFiles << " files affected" << commit;
+
+            try {
+                updateHeartBeatInternal(sql, &index, &activeHosts, &start, &end, serviceName);
+            }
+            catch (const std::exception &e) {
+                FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Backup failed to update the heartbeat: " << e.what() << commit;
+            }
+
+            if (getDrainInternal(sql)) {
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Backup interrupted, the host is drained" << commit;
+                run.stop = true;
+            }
+        }
+        workers.join_all();
+
+        *nJobs = run.nJobs;
+        *nFiles = run.nFiles;
+        *nDeletions = run.nDeletions;
+
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Backup purged " << run.nHistory << " history entries" << commit;
+
+        if (run.failed) {
+            throw SystemError(run.error);
+        }
+        // Finished. Otherwise, the next run resumes from the checkpoint
+        if (!run.stop) {
+            run.checkpoint.clear();
+        }
+    }
+    catch (std::exception& e)
+    {
+        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+    }
+    catch (...)
+    {
+        throw UserError(std::string(__func__) + ": Caught exception " );
+    }
+}
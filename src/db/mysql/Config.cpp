@@ -23,6 +23,8 @@
 
 #include "common/Exceptions.h"
 
+#include <cstdlib>
+#include <sstream>
 #include <boost/logic/tribool.hpp>
 #include <boost/regex.hpp>
 
@@ -89,87 +91,19 @@ std::map<std::string, double> MySqlAPI::getActivityShareConf(soci::session& sql,
 
 unsigned MySqlAPI::getDebugLevel(const std::string& sourceStorage, const std::string& destStorage)
 {
-    soci::session sql(*connectionPool);
-
-    try
-    {
-        unsigned level = 0;
-        soci::indicator levelIndicator = soci::i_ok;
-
-        sql << "SELECT MAX(debug_level) FROM t_se WHERE storage IN (:source, :destination)",
-            soci::use(sourceStorage), soci::use(destStorage), soci::into(level, levelIndicator);
-
-        if (levelIndicator == soci::i_ok) {
-            return level;
-        }
-
-        sql << "SELECT debug_level FROM t_se WHERE storage = '*'", soci::into(level, levelIndicator);
-        return level;
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " +  e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " );
-    }
+    return getConfigSnapshot()->getDebugLevel(sourceStorage, destStorage);
 }
 
 
 std::unique_ptr<LinkConfig> MySqlAPI::getLinkConfig(const std::string &source, const std::string &destination)
 {
-    soci::session sql(*connectionPool);
-
-    try
-    {
-        std::unique_ptr<LinkConfig> config(new LinkConfig);
-
-        sql << "SELECT source_se, dest_se, min_active, max_active, optimizer_mode, tcp_buffer_size, nostreams "
-               "FROM t_link_config WHERE source = :source AND destination = :dest",
-            soci::use(source), soci::use(destination),
-            soci::into(*config);
-
-        if (sql.got_data())
-            return config;
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " );
-    }
-    return std::unique_ptr<LinkConfig>();
+    return getConfigSnapshot()->getLinkConfig(source, destination);
 }
 
 
 std::vector<ShareConfig> MySqlAPI::getShareConfig(const std::string &source, const std::string &destination)
 {
-    soci::session sql(*connectionPool);
-
-    std::vector<ShareConfig> cfg;
-    try
-    {
-        soci::rowset<ShareConfig> rs = (sql.prepare << "SELECT * FROM t_share_config WHERE "
-            "  source = :source AND destination = :dest",
-            soci::use(source), soci::use(destination));
-        for (soci::rowset<ShareConfig>::const_iterator i = rs.begin();
-             i != rs.end(); ++i)
-        {
-            cfg.push_back(*i);
-        }
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " );
-    }
-    return cfg;
+    return getConfigSnapshot()->getShareConfig(source, destination);
 }
 
 
@@ -257,31 +191,7 @@ int MySqlAPI::getRetryTimes(const std::string & jobId, uint64_t fileId)
 
 int MySqlAPI::getMaxTimeInQueue(const std::string &voName)
 {
-    soci::session sql(*connectionPool);
-
-    int maxTime = 0;
-    try
-    {
-        soci::indicator isNull = soci::i_ok;
-
-        sql << "SELECT max_time_queue "
-               " FROM t_server_config WHERE vo_name IN (:vo, '*') OR vo_name IS NULL "
-               " ORDER BY vo_name DESC LIMIT 1",
-            soci::use(voName), soci::into(maxTime, isNull);
-
-        //just in case soci it is reseting the value to NULL
-        if(isNull != soci::i_null && maxTime > 0)
-            return maxTime;
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " );
-    }
-    return maxTime;
+    return getConfigSnapshot()->getMaxTimeInQueue(voName);
 }
 
 
@@ -362,116 +272,41 @@ bool MySqlAPI::getDrainInternal(soci::session& sql)
 
 boost::tribool MySqlAPI::isProtocolUDT(const std::string &source, const std::string &dest)
 {
-    soci::session sql(*connectionPool);
-
-    try {
-        boost::logic::tribool srcEnabled(boost::indeterminate);
-        boost::logic::tribool dstEnabled(boost::indeterminate);
-        boost::logic::tribool starEnabled(boost::indeterminate);
-        sql << "SELECT udt FROM t_se WHERE storage = :source", soci::use(source), soci::into(srcEnabled);
-        sql << "SELECT udt FROM t_se WHERE storage = :dest", soci::use(dest), soci::into(dstEnabled);
-        sql << "SELECT udt FROM t_se WHERE storage = '*'", soci::into(starEnabled);
-
-        // Fallback if both are undefined
-        if (boost::indeterminate(srcEnabled) && boost::indeterminate(dstEnabled)) {
-            return starEnabled;
-        }
-        // If only one is undefined, the other decides
-        else if (boost::indeterminate(srcEnabled)) {
-            return dstEnabled;
-        } else if (boost::indeterminate(dstEnabled)) {
-            return srcEnabled;
-        }
-        // Both defined, need to agree
-        return srcEnabled && dstEnabled;
-    }
-    catch (std::exception &e) {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...) {
-        throw UserError(std::string(__func__) + ": Caught exception ");
-    }
+    return getConfigSnapshot()->isProtocolUDT(source, dest);
 }
 
 
 boost::tribool MySqlAPI::isProtocolIPv6(const std::string &source, const std::string &dest)
 {
-    soci::session sql(*connectionPool);
-
-    try {
-        boost::logic::tribool srcEnabled(boost::indeterminate);
-        boost::logic::tribool dstEnabled(boost::indeterminate);
-        boost::logic::tribool starEnabled(boost::indeterminate);
-        sql << "SELECT ipv6 FROM t_se WHERE storage = :source", soci::use(source), soci::into(srcEnabled);
-        sql << "SELECT ipv6 FROM t_se WHERE storage = :dest", soci::use(dest), soci::into(dstEnabled);
-        sql << "SELECT ipv6 FROM t_se WHERE storage = '*'", soci::into(starEnabled);
-
-        // Fallback if both are undefined
-        if (boost::indeterminate(srcEnabled) && boost::indeterminate(dstEnabled)) {
-            return starEnabled;
-        }
-        // If only one is undefined, the other decides
-        else if (boost::indeterminate(srcEnabled)) {
-            return dstEnabled;
-        } else if (boost::indeterminate(dstEnabled)) {
-            return srcEnabled;
-        }
-        // Both defined, need to agree
-        return srcEnabled && dstEnabled;
-    }
-    catch (std::exception &e) {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...) {
-        throw UserError(std::string(__func__) + ": Caught exception ");
-    }
+    return getConfigSnapshot()->isProtocolIPv6(source, dest);
 }
 
 
 boost::tribool MySqlAPI::getEvictionFlag(const std::string &source)
 {
-    soci::session sql(*connectionPool);
-
-    try {
-        boost::logic::tribool evictionEnabled(boost::indeterminate);
-        sql << "SELECT eviction FROM t_se WHERE storage = :source", soci::use(source), soci::into(evictionEnabled);
-
-        if (boost::indeterminate(evictionEnabled)) {
-            return false;
-        } else {
-            return evictionEnabled;
-        }
-    }
-    catch (std::exception &e) {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...) {
-        throw UserError(std::string(__func__) + ": Caught exception ");
-    }
+    return getConfigSnapshot()->getEvictionFlag(source);
 }
 
 
 int MySqlAPI::getStreamsOptimization(const std::string &sourceSe, const std::string &destSe)
 {
+    boost::optional<int> configured = getConfigSnapshot()->getStreamsOptimization(sourceSe, destSe);
+    if (configured) {
+        return *configured;
+    }
+
     soci::session sql(*connectionPool);
 
     try
     {
         int streams = 0;
-        soci::indicator ind;
+        soci::indicator ind = soci::i_ok;
 
-        sql <<
-        "SELECT nostreams FROM ("
-        "   SELECT nostreams FROM t_link_config WHERE source_se = :source AND dest_se = :dest AND nostreams IS NOT NULL UNION "
-        "   SELECT nostreams FROM t_link_config WHERE source_se = :source AND dest_se = '*' AND nostreams IS NOT NULL UNION "
-        "   SELECT nostreams FROM t_link_config WHERE source_se = '*' AND dest_se = :dest AND nostreams IS NOT NULL UNION "
-        "   SELECT nostreams FROM t_link_config WHERE source_se = '*' AND dest_se = '*' AND nostreams IS NOT NULL UNION "
-        "   SELECT nostreams FROM t_optimizer WHERE source_se = :source AND dest_se = :dest"
-        ") AS cfg LIMIT 1",
-        soci::use(sourceSe, "source"), soci::use(destSe, "dest"),
-        soci::into(streams, ind);
-
-        if (ind == soci::i_null) {
+        sql << "SELECT nostreams FROM t_optimizer WHERE source_se = :source AND dest_se = :dest",
+            soci::use(sourceSe), soci::use(destSe),
+            soci::into(streams, ind);
+
+        if (!sql.got_data() || ind == soci::i_null) {
             streams = 0;
         }
 
@@ -479,12 +314,10 @@ int MySqlAPI::getStreamsOptimization(const std::string &sourceSe, const std::str
     }
     catch (std::exception& e)
     {
-        sql.rollback();
         throw UserError(std::string(__func__) + ": Caught exception " + e.what());
     }
     catch (...)
     {
-        sql.rollback();
         throw UserError(std::string(__func__) + ": Caught exception ");
     }
 }
@@ -492,162 +325,31 @@ int MySqlAPI::getStreamsOptimization(const std::string &sourceSe, const std::str
 
 bool MySqlAPI::getDisableDelegationFlag(const std::string &sourceSe, const std::string &destSe)
 {
-    soci::session sql(*connectionPool);
-
-    try
-    {
-        std::string disable_delegation;
-        soci::indicator ind = soci::i_ok;
-
-        sql <<
-            "SELECT no_delegation FROM ("
-            "   SELECT no_delegation FROM t_link_config WHERE source_se = :source AND dest_se = :dest AND no_delegation IS NOT NULL UNION "
-            "   SELECT no_delegation FROM t_link_config WHERE source_se = :source AND dest_se = '*' AND no_delegation IS NOT NULL UNION "
-            "   SELECT no_delegation FROM t_link_config WHERE source_se = '*' AND dest_se = :dest AND no_delegation IS NOT NULL UNION "
-            "   SELECT no_delegation FROM t_link_config WHERE source_se = '*' AND dest_se = '*' AND no_delegation IS NOT NULL"
-            ") AS dlg LIMIT 1",
-            soci::use(sourceSe, "source"), soci::use(destSe, "dest"),
-            soci::into(disable_delegation, ind);
-
-        if (ind == soci::i_null) {
-            return false;
-        } else {
-            return disable_delegation == "on";
-        }
-    }
-    catch (std::exception& e)
-    {
-        sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception");
-    }
+    return getConfigSnapshot()->getDisableDelegationFlag(sourceSe, destSe);
 }
 
 
 std::string MySqlAPI::getThirdPartyTURL(const std::string &sourceSe, const std::string &destSe)
 {
-    soci::session sql(*connectionPool);
-
-    try
-    {
-        std::string thirdPartyTURL;
-        soci::indicator ind = soci::i_ok;
-
-        sql <<
-            "SELECT 3rd_party_turl FROM ("
-            "   SELECT 3rd_party_turl FROM t_link_config WHERE source_se = :source AND dest_se = :dest AND 3rd_party_turl IS NOT NULL UNION "
-            "   SELECT 3rd_party_turl FROM t_link_config WHERE source_se = :source AND dest_se = '*' AND 3rd_party_turl IS NOT NULL UNION "
-            "   SELECT 3rd_party_turl FROM t_link_config WHERE source_se = '*' AND dest_se = :dest AND 3rd_party_turl IS NOT NULL"
-            ") AS 3rd_turl LIMIT 1",
-            soci::use(sourceSe, "source"), soci::use(destSe, "dest"),
-            soci::into(thirdPartyTURL, ind);
-
-        if (ind == soci::i_null) {
-            thirdPartyTURL.clear();
-        }
-
-        return thirdPartyTURL;
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception");
-    }
+    return getConfigSnapshot()->getThirdPartyTURL(sourceSe, destSe);
 }
 
 
 int MySqlAPI::getGlobalTimeout(const std::string &voName)
 {
-    soci::session sql(*connectionPool);
-
-    try
-    {
-        int timeout = 0;
-        soci::indicator isNullTimeout = soci::i_ok;
-
-        sql << "SELECT global_timeout FROM t_server_config "
-               "WHERE vo_name IN (:vo, '*') OR vo_name IS NULL "
-               "ORDER BY vo_name DESC LIMIT 1",
-               soci::use(voName), soci::into(timeout, isNullTimeout);
-
-        return timeout;
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception ");
-    }
+    return getConfigSnapshot()->getGlobalTimeout(voName);
 }
 
 
 int MySqlAPI::getSecPerMb(const std::string &voName)
 {
-    soci::session sql(*connectionPool);
-
-    try
-    {
-        int seconds = 0;
-        soci::indicator isNullSeconds = soci::i_ok;
-
-        sql << "SELECT sec_per_mb FROM t_server_config "
-               "WHERE vo_name IN (:vo, '*') OR vo_name IS NULL "
-               "ORDER BY vo_name DESC LIMIT 1",
-               soci::use(voName), soci::into(seconds, isNullSeconds);
-
-        return seconds;
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception ");
-    }
+    return getConfigSnapshot()->getSecPerMb(voName);
 }
 
 
 bool MySqlAPI::getDisableStreamingFlag(const std::string& voName)
 {
-    soci::session sql(*connectionPool);
-
-    try
-    {
-        std::string disable_streaming;
-        soci::indicator ind = soci::i_ok;
-
-        sql <<
-            "SELECT no_streaming FROM t_server_config "
-            "WHERE vo_name IN (:vo, '*') OR vo_name IS NULL "
-            "ORDER BY vo_name DESC LIMIT 1",
-            soci::use(voName), soci::into(disable_streaming, ind);
-
-        if (ind == soci::i_null) {
-            return false;
-        } else {
-            return disable_streaming == "on";
-        }
-    }
-    catch (std::exception& e)
-    {
-        sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception");
-    }
+    return getConfigSnapshot()->getDisableStreamingFlag(voName);
 }
 
 
@@ -685,39 +387,52 @@ bool MySqlAPI::getCloudStorageCredentials(const std::string& user_dn,
 }
 
 
-bool MySqlAPI::publishUserDnInternal(soci::session& sql, const std::string &vo)
+bool MySqlAPI::publishUserDn(const std::string &vo)
 {
-    std::string publish;
-    soci::indicator isNullPublish = soci::i_ok;
+    return getConfigSnapshot()->publishUserDn(vo);
+}
 
-    try
-    {
-        sql << "SELECT show_user_dn FROM t_server_config WHERE vo_name = :vo",
-          soci::use(vo), soci::into(publish, isNullPublish);
 
-        if (isNullPublish == soci::i_null) {
-            return false;
-        }
-        return publish == "on";
-    }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " );
-    }
+StorageConfig MySqlAPI::getStorageConfig(const std::string &storage)
+{
+    return getConfigSnapshot()->getStorageConfig(storage);
 }
 
 
-bool MySqlAPI::publishUserDn(const std::string &vo)
+std::shared_ptr<const ConfigSnapshot> MySqlAPI::getConfigSnapshot()
 {
+    std::shared_ptr<const ConfigSnapshot> snapshot = std::atomic_load(&configSnapshot);
+    if (snapshot && time(NULL) - configCheckedAt.load() < configCheckInterval) {
+        return snapshot;
+    }
+
+    // Someone else is checking, so keep using the current snapshot meanwhile
+    boost::unique_lock<boost::mutex> lock(configCheckMutex, boost::try_to_lock);
+    if (!lock.owns_lock()) {
+        if (snapshot) {
+            return snapshot;
+        }
+        lock.lock();
+    }
+
+    // May have been done while waiting for the lock
+    snapshot = std::atomic_load(&configSnapshot);
+    const time_t now = time(NULL);
+    if (snapshot && now - configCheckedAt.load() < configCheckInterval) {
+        return snapshot;
+    }
+
     soci::session sql(*connectionPool);
 
     try
     {
-        return publishUserDnInternal(sql, vo);
+        std::string checksum = getConfigChecksum(sql);
+        if (!snapshot || checksum != configChecksum) {
+            snapshot = loadConfigSnapshot(sql, snapshot ? snapshot->getVersion() + 1 : 1);
+            std::atomic_store(&configSnapshot, snapshot);
+            configChecksum = checksum;
+        }
+        configCheckedAt = now;
     }
     catch (std::exception& e)
     {
@@ -728,29 +443,117 @@ bool MySqlAPI::publishUserDn(const std::string &vo)
         throw UserError(std::string(__func__) + ": Caught exception " );
     }
 
-    return true;
+    return snapshot;
 }
 
 
-StorageConfig MySqlAPI::getStorageConfig(const std::string &storage)
+std::string MySqlAPI::getConfigChecksum(soci::session& sql)
 {
-    soci::session sql(*connectionPool);
-    StorageConfig seConfig, seStarConfig;
+    // The configuration tables have no version column, so their checksum is used instead
+    // They are small, so this is cheap
+    std::ostringstream checksums;
+    std::string table, checksum;
+    soci::indicator checksumInd = soci::i_ok;
 
-    try
-    {
-        sql << "SELECT * FROM t_se WHERE storage = :storage", soci::use(storage), soci::into(seConfig);
-        sql << "SELECT * FROM t_se WHERE storage = '*'", soci::into(seStarConfig);
-        seConfig.merge(seStarConfig);
+    soci::statement stmt = (sql.prepare <<
+        "CHECKSUM TABLE t_se, t_link_config, t_share_config, t_server_config",
+        soci::into(table), soci::into(checksum, checksumInd));
+    stmt.execute();
+    while (stmt.fetch()) {
+        checksums << table << '=' << (checksumInd == soci::i_ok ? checksum : "") << ';';
     }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+
+    return checksums.str();
+}
+
+
+std::shared_ptr<const ConfigSnapshot> MySqlAPI::loadConfigSnapshot(soci::session& sql, uint64_t version)
+{
+    std::shared_ptr<ConfigSnapshot> snapshot = std::make_shared<ConfigSnapshot>(version);
+
+    soci::rowset<soci::row> storages = (sql.prepare <<
+        "SELECT storage, site, metadata, ipv6, udt, debug_level, "
+        "   inbound_max_active, inbound_max_throughput, outbound_max_active, outbound_max_throughput, eviction "
+        "FROM t_se");
+    for (auto i = storages.begin(); i != storages.end(); ++i) {
+        ConfigSnapshot::Storage entry;
+        entry.config.storage = i->get<std::string>("storage");
+        entry.config.site = i->get<std::string>("site", "");
+        entry.config.metadata = i->get<std::string>("metadata", "");
+        entry.config.ipv6 = i->get<boost::tribool>("ipv6", boost::indeterminate);
+        entry.config.udt = i->get<boost::tribool>("udt", boost::indeterminate);
+        entry.config.debugLevel = i->get<int>("debug_level", 0);
+        entry.config.inboundMaxActive = i->get<int>("inbound_max_active", 0);
+        entry.config.outboundMaxActive = i->get<int>("outbound_max_active", 0);
+        entry.config.inboundMaxThroughput = i->get<double>("inbound_max_throughput", 0.0);
+        entry.config.outboundMaxThroughput = i->get<double>("outbound_max_throughput", 0.0);
+        if (i->get_indicator("debug_level") != soci::i_null) {
+            entry.debugLevel = i->get<int>("debug_level");
+        }
+        if (i->get_indicator("eviction") != soci::i_null) {
+            entry.eviction = (atoi(i->get<std::string>("eviction").c_str()) != 0);
+        }
+        snapshot->addStorage(entry.config.storage, entry);
+    }
+
+    soci::rowset<soci::row> links = (sql.prepare <<
+        "SELECT source_se, dest_se, min_active, max_active, optimizer_mode, tcp_buffer_size, nostreams, "
+        "   no_delegation, 3rd_party_turl "
+        "FROM t_link_config");
+    for (auto i = links.begin(); i != links.end(); ++i) {
+        ConfigSnapshot::Link entry;
+        entry.config.source = i->get<std::string>("source_se");
+        entry.config.destination = i->get<std::string>("dest_se");
+        entry.config.minActive = i->get<int>("min_active", 0);
+        entry.config.maxActive = i->get<int>("max_active", 0);
+        entry.config.optimizerMode = i->get<OptimizerMode>("optimizer_mode", kOptimizerDisabled);
+        entry.config.tcpBufferSize = i->get<int>("tcp_buffer_size", 0);
+        entry.config.numberOfStreams = i->get<int>("nostreams", 1);
+        if (i->get_indicator("nostreams") != soci::i_null) {
+            entry.numberOfStreams = i->get<int>("nostreams");
+        }
+        if (i->get_indicator("no_delegation") != soci::i_null) {
+            entry.noDelegation = i->get<std::string>("no_delegation");
+        }
+        if (i->get_indicator("3rd_party_turl") != soci::i_null) {
+            entry.thirdPartyTURL = i->get<std::string>("3rd_party_turl");
+        }
+        snapshot->addLink(entry);
     }
-    catch (...)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " );
+
+    soci::rowset<ShareConfig> shares = (sql.prepare <<
+        "SELECT source, destination, vo, active FROM t_share_config");
+    for (auto i = shares.begin(); i != shares.end(); ++i) {
+        snapshot->addShare(*i);
+    }
+
+    soci::rowset<soci::row> vos = (sql.prepare <<
+        "SELECT vo_name, max_time_queue, global_timeout, sec_per_mb, no_streaming, show_user_dn "
+        "FROM t_server_config");
+    for (auto i = vos.begin(); i != vos.end(); ++i) {
+        ConfigSnapshot::Vo entry;
+        if (i->get_indicator("max_time_queue") != soci::i_null) {
+            entry.maxTimeInQueue = i->get<int>("max_time_queue");
+        }
+        if (i->get_indicator("global_timeout") != soci::i_null) {
+            entry.globalTimeout = i->get<int>("global_timeout");
+        }
+        if (i->get_indicator("sec_per_mb") != soci::i_null) {
+            entry.secPerMb = i->get<int>("sec_per_mb");
+        }
+        if (i->get_indicator("no_streaming") != soci::i_null) {
+            entry.noStreaming = i->get<std::string>("no_streaming");
+        }
+        if (i->get_indicator("show_user_dn") != soci::i_null) {
+            entry.showUserDn = i->get<std::string>("show_user_dn");
+        }
+
+        boost::optional<std::string> voName;
+        if (i->get_indicator("vo_name") != soci::i_null) {
+            voName = i->get<std::string>("vo_name");
+        }
+        snapshot->addVo(voName, entry);
     }
 
-    return seConfig;
+    return snapshot;
 }
@@ -23,11 +23,18 @@
 #include <boost/range/algorithm/transform.hpp>
 
 #include <map>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <tuple>
 #include <soci/mysql/soci-mysql.h>
 #include "MySqlAPI.h"
 #include "sociConversions.h"
 #include "db/generic/DbUtils.h"
+#include "db/generic/ReadyTransfersQuery.h"
+#include "db/generic/StatusUpdateBatch.h"
 #include <random>
 
 #include "common/Exceptions.h"
@@ -76,7 +83,8 @@ static unsigned int get_affected_rows(soci::session& sql)
 }
 
 
-MySqlAPI::MySqlAPI(): poolSize(10), connectionPool(NULL), hostname(getFullHostname())
+MySqlAPI::MySqlAPI(): poolSize(10), connectionPool(NULL), hostname(getFullHostname()),
+    fileStateCounters(false), queueChanges(false), configCheckedAt(0), configCheckInterval(30)
 {
     // Pass
 }
@@ -133,9 +141,10 @@ static void getHostAndPort(const std::string& conn, std::string* host, int* port
 }
 
 
-static void validateSchemaVersion(soci::connection_pool *connectionPool)
+/// Returns the minor version of the schema
+static unsigned validateSchemaVersion(soci::connection_pool *connectionPool)
 {
-    static const unsigned expect[] = {8, 0};
+    static const unsigned expect[] = {8, 1};
     unsigned major, minor;
 
     soci::session sql(*connectionPool);
@@ -158,6 +167,7 @@ static void validateSchemaVersion(soci::connection_pool *connectionPool)
             << " Database minor version is lower than expected. FTS should be able to run, but the schema should be upgraded."
             << commit;
     }
+    return minor;
 }
 
 
@@ -214,7 +224,10 @@ void MySqlAPI::init(const std::string& username, const std::string& password,
             mysql_options(static_cast<MYSQL*>(be->conn_), MYSQL_OPT_RECONNECT, &reconnect);
         }
 
-        validateSchemaVersion(connectionPool);
+        // The file state counters and the queue changes come with the schema 8.1
+        fileStateCounters = queueChanges = (validateSchemaVersion(connectionPool) >= 1);
+
+        configCheckInterval = ServerConfig::instance().get<time_t>("ConfigSnapshotCheckInterval");
     }
     catch (std::exception& e)
     {
@@ -274,39 +287,25 @@ std::list<fts3::events::MessageUpdater> MySqlAPI::getActiveInHost(const std::str
 }
 
 
-std::map<std::string, long long> MySqlAPI::getActivitiesInQueue(soci::session& sql, std::string src, std::string dst, std::string vo)
+std::map<std::pair<std::string, std::string>, std::map<std::string, long long> >
+MySqlAPI::getActivitiesInQueues(soci::session& sql, const std::string &vo)
 {
-    std::map<std::string, long long> ret;
+    std::map<std::pair<std::string, std::string>, std::map<std::string, long long> > ret;
 
     try
     {
-        std::string vo_exists;
-        soci::indicator isNull = soci::i_ok;
-
-        sql << "SELECT vo FROM t_activity_share_config where vo=:vo", soci::use(vo), soci::into(vo_exists, isNull);
-        if(isNull == soci::i_null)
-            return ret;
-
-
         soci::rowset<soci::row> rs = (
                                          sql.prepare <<
-                                         " SELECT activity, COUNT(DISTINCT f.job_id, f.file_index) AS count "
-                                         " FROM t_file f USE INDEX(idx_link_state_vo) INNER JOIN t_job j ON (f.job_id = j.job_id) WHERE "
-                                         "  j.vo_name = f.vo_name AND f.file_state = 'SUBMITTED' AND "
-                                         "  f.source_se = :source AND f.dest_se = :dest AND "
+                                         " SELECT f.source_se, f.dest_se, f.activity, COUNT(DISTINCT f.job_id, f.file_index) AS count "
+                                         " FROM t_file f INNER JOIN t_job j ON (f.job_id = j.job_id) WHERE "
+                                         "  f.file_state = 'SUBMITTED' AND "
                                          "  f.vo_name = :vo_name AND j.vo_name = f.vo_name AND "
-                                         "  (f.hashed_id >= :hStart AND f.hashed_id <= :hEnd) AND "
+                                         "  " + hashCondition("f.hashed_id") + " AND "
                                          "  (j.job_type = 'N' OR j.job_type = 'R' OR j.job_type IS NULL) "
-                                         " GROUP BY activity ORDER BY NULL ",
-                                         soci::use(src),
-                                         soci::use(dst),
-                                         soci::use(vo),
-                                         soci::use(hashSegment.start),
-                                         soci::use(hashSegment.end)
+                                         " GROUP BY f.source_se, f.dest_se, f.activity ORDER BY NULL ",
+                                         soci::use(vo)
                                      );
 
-        ret.clear();
-
         soci::rowset<soci::row>::const_iterator it;
         for (it = rs.begin(); it != rs.end(); it++)
         {
@@ -324,7 +323,9 @@ std::map<std::string, long long> MySqlAPI::getActivitiesInQueue(soci::session& s
 
             boost::algorithm::to_lower(activity_name);
             long long nFiles = it->get<long long>("count");
-            ret[activity_name] = nFiles;
+
+            std::pair<std::string, std::string> pair(it->get<std::string>("source_se"), it->get<std::string>("dest_se"));
+            ret[pair][activity_name] += nFiles;
         }
     }
     catch (std::exception& e)
@@ -340,102 +341,86 @@ std::map<std::string, long long> MySqlAPI::getActivitiesInQueue(soci::session& s
 }
 
 
-//check if called by multiple threads
-
-std::map<std::string, int> MySqlAPI::getFilesNumPerActivity(soci::session& sql,
-        std::string src, std::string dst, std::string vo, int filesNum,
+/// Distribute filesNum slots between the activities present in the queue
+/// @param activityShares       Activity shares configured for the VO
+/// @param activitiesInQueue    Number of files queued per activity
+/// @param filesNum             Slots to distribute
+/// @param defaultActivities    Filled with the queued activities that fall into the default share
+/// @return Number of slots per activity
+static std::map<std::string, int> getFilesNumPerActivity(std::map<std::string, double> activityShares,
+        std::map<std::string, long long> activitiesInQueue, int filesNum,
         std::set<std::string> & defaultActivities)
 {
     std::map<std::string, int> activityFilesNum;
 
-    try
-    {
-        // get activity shares configuration for given VO
-        std::map<std::string, double> activityShares = getActivityShareConf(sql, vo);
+    // sum of all activity shares in the queue (needed for normalization)
+    double sum = 0.0;
 
-        // if there is no configuration no assigment can be made
-        if (activityShares.empty()) return activityFilesNum;
+    std::map<std::string, long long>::iterator it;
+    for (it = activitiesInQueue.begin(); it != activitiesInQueue.end(); it++)
+    {
+        std::map<std::string, double>::iterator pos = activityShares.find(it->first);
+        if (pos != activityShares.end() && it->first != "default")
+        {
+            sum += pos->second;
+        }
+        else
+        {
+            // if the activity has not been defined it falls to default
+            defaultActivities.insert(it->first);
+        }
+    }
 
-        // get the activities in the queue
-        std::map<std::string, long long> activitiesInQueue = getActivitiesInQueue(sql, src, dst, vo);
+    // if default was used add it as well
+    if (!defaultActivities.empty())
+        sum += activityShares["default"];
 
-        // sum of all activity shares in the queue (needed for normalization)
-        double sum = 0.0;
+    // assign slots to activities
+    for (int i = 0; i < filesNum; i++)
+    {
+        // if sum <= 0 there is nothing to assign
+        if (sum <= 0) break;
+        // a random number from (0, 1)
+        double r = ((double) thread_random() / (double)RAND_MAX);
 
-        std::map<std::string, long long>::iterator it;
-        for (it = activitiesInQueue.begin(); it != activitiesInQueue.end(); it++)
-        {
-            std::map<std::string, double>::iterator pos = activityShares.find(it->first);
-            if (pos != activityShares.end() && it->first != "default")
-            {
-                sum += pos->second;
-            }
-            else
-            {
-                // if the activity has not been defined it falls to default
-                defaultActivities.insert(it->first);
-            }
-        }
+        FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << __func__ << ": Dice result: " << r << commit;
 
-        // if default was used add it as well
-        if (!defaultActivities.empty())
-            sum += activityShares["default"];
+        // interval corresponding to given activity
+        double interval = 0;
 
-        // assign slots to activities
-        for (int i = 0; i < filesNum; i++)
+        for (it = activitiesInQueue.begin(); it != activitiesInQueue.end(); it++)
         {
-            // if sum <= 0 there is nothing to assign
-            if (sum <= 0) break;
-            // a random number from (0, 1)
-            double r = ((double) thread_random() / (double)RAND_MAX);
+            // if there are no more files for this activity continue
+            if (it->second <= 0) continue;
+            // get the activity name (if it was not defined use default)
+            std::string activity_name = defaultActivities.count(it->first) ? "default" : it->first;
 
-            FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << __func__ << ": Dice result: " << r << commit;
+            // calculate the interval (normalize)
+            interval += activityShares[activity_name] / sum;
 
-            // interval corresponding to given activity
-            double interval = 0;
+            // if the slot has been assigned to the given activity ...
 
-            for (it = activitiesInQueue.begin(); it != activitiesInQueue.end(); it++)
+            if (r < interval)
             {
-                // if there are no more files for this activity continue
-                if (it->second <= 0) continue;
-                // get the activity name (if it was not defined use default)
-                std::string activity_name = defaultActivities.count(it->first) ? "default" : it->first;
+                ++activityFilesNum[activity_name];
 
-                // calculate the interval (normalize)
-                interval += activityShares[activity_name] / sum;
-
-                // if the slot has been assigned to the given activity ...
-
-                if (r < interval)
+                --it->second;
+                // if there are no more files for the given ativity remove it from the sum
+                if (it->second == 0)
                 {
-                    ++activityFilesNum[activity_name];
-
-                    --it->second;
-                    // if there are no more files for the given ativity remove it from the sum
-                    if (it->second == 0)
-                    {
-                        sum -= activityShares[activity_name];
-                    }
-                    break;
-
+                    sum -= activityShares[activity_name];
                 }
-            }
-        }
+                break;
 
-        // Debug output
-        std::map<std::string, int>::const_iterator j;
-        for (j = activityFilesNum.begin(); j != activityFilesNum.end(); ++j)
-        {
-            FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << __func__ << ": " << j->first << " assigned " << j->second << commit;
+            }
         }
     }
-    catch (std::exception& e)
-    {
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
+
+    // Debug output
+    std::map<std::string, int>::const_iterator j;
+    for (j = activityFilesNum.begin(); j != activityFilesNum.end(); ++j)
     {
-        throw UserError(std::string(__func__) + ": Caught exception " );
+        FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << __func__ << ": " << j->first << " assigned " << j->second << commit;
     }
 
     return activityFilesNum;
@@ -507,9 +492,8 @@ void MySqlAPI::getQueuesWithSessionReusePending(std::vector<QueueId>& queues)
            " INNER JOIN t_job ON t_file.job_id = t_job.job_id "
            " WHERE "
            "      t_file.file_state = 'SUBMITTED' AND "
-           "      (t_file.hashed_id BETWEEN :hStart AND :hEnd) AND"
-           "      t_job.job_type = 'Y' ",
-           soci::use(hashSegment.start), soci::use(hashSegment.end)
+           "      " + hashCondition("t_file.hashed_id") + " AND"
+           "      t_job.job_type = 'Y' "
         );
 
         soci::statement activeStmt = (sql.prepare <<
@@ -547,6 +531,148 @@ void MySqlAPI::getQueuesWithSessionReusePending(std::vector<QueueId>& queues)
     }
 }
 
+
+uint64_t MySqlAPI::getQueueCounters(std::vector<QueueCounters>& counters)
+{
+    soci::session sql(*connectionPool);
+
+    try
+    {
+        // Take the change log position first, so anything queued while counting
+        // is picked by the next getQueueChangesSince
+        uint64_t lastChangeId = 0;
+        soci::indicator lastChangeIdInd = soci::i_ok;
+        if (queueChanges) {
+            sql << "SELECT MAX(change_id) FROM t_queue_changes", soci::into(lastChangeId, lastChangeIdInd);
+        }
+        if (!queueChanges || lastChangeIdInd == soci::i_null) {
+            lastChangeId = 0;
+        }
+
+        soci::rowset<soci::row> rs = (sql.prepare <<
+            "SELECT vo_name, source_se, dest_se, file_state, COUNT(*) AS count "
+            "FROM t_file "
+            "WHERE file_state IN ('SUBMITTED', 'READY', 'ACTIVE') "
+            "GROUP BY source_se, dest_se, file_state, vo_name "
+            "ORDER BY NULL");
+
+        // One row per state, merge them into a single entry per queue
+        std::map<std::tuple<std::string, std::string, std::string>, size_t> positions;
+
+        for (auto i = rs.begin(); i != rs.end(); ++i)
+        {
+            const std::string voName = i->get<std::string>("vo_name", "");
+            const std::string sourceSe = i->get<std::string>("source_se", "");
+            const std::string destSe = i->get<std::string>("dest_se", "");
+            const std::string fileState = i->get<std::string>("file_state");
+            const uint64_t count = i->get<long long>("count");
+
+            auto key = std::make_tuple(sourceSe, destSe, voName);
+            auto position = positions.find(key);
+            if (position == positions.end()) {
+                position = positions.insert(std::make_pair(key, counters.size())).first;
+                counters.emplace_back(sourceSe, destSe, voName, 0, 0);
+            }
+
+            if (fileState == "SUBMITTED") {
+                counters[position->second].submitted += count;
+            }
+            else {
+                counters[position->second].active += count;
+            }
+        }
+
+        return lastChangeId;
+    }
+    catch (std::exception& e)
+    {
+        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+    }
+    catch (...)
+    {
+        throw UserError(std::string(__func__) + ": Caught exception ");
+    }
+}
+
+
+void MySqlAPI::getQueueChangesSince(uint64_t afterChangeId, std::vector<QueueChange>& changes)
+{
+    if (!queueChanges) {
+        return;
+    }
+
+    soci::session sql(*connectionPool);
+
+    try
+    {
+        // Range scan over the primary key. The caller keeps afterChangeId below the changes
+        // not committed yet, so only a few seconds worth of changes are read again
+        soci::rowset<soci::row> rs = (sql.prepare <<
+            "SELECT change_id, vo_name, source_se, dest_se "
+            "FROM t_queue_changes "
+            "WHERE change_id > :afterChangeId "
+            "ORDER BY change_id",
+            soci::use(afterChangeId));
+
+        for (auto i = rs.begin(); i != rs.end(); ++i)
+        {
+            changes.emplace_back(
+                i->get<unsigned long long>("change_id"),
+                i->get<std::string>("source_se", ""),
+                i->get<std::string>("dest_se", ""),
+                i->get<std::string>("vo_name", "")
+            );
+        }
+    }
+    catch (std::exception& e)
+    {
+        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+    }
+    catch (...)
+    {
+        throw UserError(std::string(__func__) + ": Caught exception ");
+    }
+}
+
+
+void MySqlAPI::purgeQueueChanges(int olderThan)
+{
+    if (!queueChanges) {
+        return;
+    }
+
+    soci::session sql(*connectionPool);
+
+    try
+    {
+        // Small chunks, so the triggers inserting into the table are not held back
+        const int chunk = 5000;
+        soci::statement stmt = (sql.prepare <<
+            "DELETE FROM t_queue_changes "
+            "WHERE changed < (UTC_TIMESTAMP() - INTERVAL :olderThan SECOND) "
+            "LIMIT :chunk",
+            soci::use(olderThan), soci::use(chunk));
+
+        long long deleted = 0;
+        do {
+            sql.begin();
+            stmt.execute(true);
+            deleted = get_affected_rows(sql);
+            sql.commit();
+        } while (deleted >= chunk);
+    }
+    catch (std::exception& e)
+    {
+        sql.rollback();
+        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+    }
+    catch (...)
+    {
+        sql.rollback();
+        throw UserError(std::string(__func__) + ": Caught exception ");
+    }
+}
+
 /// Count how many transfers are running for the given pair
 /// @param source Source storage
 /// @param dest Destination storage
@@ -566,6 +692,126 @@ static int getActiveCount(soci::session& sql, const std::string &source, const s
 }
 
 
+/// Count how many transfers are running for every pair
+static std::map<std::pair<std::string, std::string>, int> getActiveCountPerPair(soci::session& sql)
+{
+    std::map<std::pair<std::string, std::string>, int> activeCounts;
+
+    soci::rowset<soci::row> rs = (sql.prepare <<
+        "SELECT source_se, dest_se, COUNT(*) AS count FROM t_file "
+        " WHERE file_state = 'ACTIVE' "
+        " GROUP BY source_se, dest_se ORDER BY NULL");
+
+    for (auto i = rs.begin(); i != rs.end(); ++i) {
+        activeCounts[std::make_pair(i->get<std::string>("source_se"), i->get<std::string>("dest_se"))] =
+            static_cast<int>(i->get<long long>("count"));
+    }
+
+    return activeCounts;
+}
+
+
+/// Maximum number of active transfers decided by the optimizer for every pair
+static std::map<std::pair<std::string, std::string>, int> getOptimizerLimitPerPair(soci::session& sql)
+{
+    std::map<std::pair<std::string, std::string>, int> limits;
+
+    soci::rowset<soci::row> rs = (sql.prepare <<
+        "SELECT source_se, dest_se, active FROM t_optimizer");
+
+    for (auto i = rs.begin(); i != rs.end(); ++i) {
+        if (i->get_indicator("active") != soci::i_null) {
+            limits[std::make_pair(i->get<std::string>("source_se"), i->get<std::string>("dest_se"))] =
+                i->get<int>("active");
+        }
+    }
+
+    return limits;
+}
+
+
+/// Highest priority waiting for every queue
+static std::map<std::tuple<std::string, std::string, std::string>, int> getMaxPriorityPerQueue(soci::session& sql)
+{
+    std::map<std::tuple<std::string, std::string, std::string>, int> priorities;
+
+    soci::rowset<soci::row> rs = (sql.prepare <<
+        "SELECT vo_name, source_se, dest_se, MAX(priority) AS max_priority "
+        "FROM t_file "
+        "WHERE file_state = 'SUBMITTED' "
+        "GROUP BY source_se, dest_se, vo_name "
+        "ORDER BY NULL");
+
+    for (auto i = rs.begin(); i != rs.end(); ++i) {
+        if (i->get_indicator("max_priority") != soci::i_null) {
+            priorities[std::make_tuple(i->get<std::string>("source_se", ""), i->get<std::string>("dest_se", ""),
+                i->get<std::string>("vo_name", ""))] = i->get<int>("max_priority");
+        }
+    }
+
+    return priorities;
+}
+
+
+/// Set lastReplica and lastHop for the multiple replica and multihop transfers,
+/// aggregating the files of all their jobs in a single query
+static void setLastReplicaAndHop(soci::session& sql, std::list<TransferFile> &transfers)
+{
+    std::set<std::string> jobIdSet;
+    for (auto i = transfers.begin(); i != transfers.end(); ++i) {
+        if (i->jobType == Job::kTypeMultipleReplica || i->jobType == Job::kTypeMultiHop) {
+            jobIdSet.insert(i->jobId);
+        }
+    }
+    if (jobIdSet.empty()) {
+        return;
+    }
+
+    const std::vector<std::string> jobIds(jobIdSet.begin(), jobIdSet.end());
+
+    std::string select =
+        "SELECT job_id, COUNT(*) AS total, "
+        "   COUNT(CASE WHEN file_state <> 'NOT_USED' THEN 1 END) AS remain, "
+        "   MAX(file_index) AS max_index "
+        "FROM t_file "
+        "WHERE job_id IN (";
+    for (size_t i = 0; i < jobIds.size(); ++i) {
+        select += (i == 0) ? ":job_id" : ", :job_id";
+    }
+    select += ") GROUP BY job_id ORDER BY NULL";
+
+    soci::details::prepare_temp_type stmt = (sql.prepare << select);
+    for (auto i = jobIds.begin(); i != jobIds.end(); ++i) {
+        stmt, soci::use(*i);
+    }
+    soci::rowset<soci::row> rs = stmt;
+
+    // total, remain, max file index
+    std::map<std::string, std::tuple<long long, long long, int> > jobs;
+    for (auto i = rs.begin(); i != rs.end(); ++i) {
+        jobs[i->get<std::string>("job_id")] = std::make_tuple(
+            i->get<long long>("total"), i->get<long long>("remain"), i->get<int>("max_index", 0));
+    }
+
+    for (auto i = transfers.begin(); i != transfers.end(); ++i) {
+        auto job = jobs.find(i->jobId);
+        if (job == jobs.end()) {
+            continue;
+        }
+        if (i->jobType == Job::kTypeMultipleReplica) {
+            i->lastReplica = (std::get<0>(job->second) == std::get<1>(job->second))? 1: 0;
+        }
+        if (i->jobType == Job::kTypeMultiHop) {
+            i->lastHop = (std::get<2>(job->second) == i->fileIndex)? 1: 0;
+        }
+    }
+}
+
+
+// Queue queries sent to the database in a single statement
+static const size_t READY_TRANSFERS_QUERIES_PER_STATEMENT = 50;
+
+
 void MySqlAPI::getReadyTransfers(const std::vector<QueueId>& queues,
         std::map<std::string, std::list<TransferFile> >& files)
 {
@@ -574,125 +820,79 @@ void MySqlAPI::getReadyTransfers(const std::vector<QueueId>& queues,
 
     try
     {
+        // Load the limits, active counts and priorities for all queues at once
+        const std::map<std::pair<std::string, std::string>, int> activeCounts = getActiveCountPerPair(sql);
+        const std::map<std::pair<std::string, std::string>, int> maxActives = getOptimizerLimitPerPair(sql);
+
+        int fixedPriority =  ServerConfig::instance().values().useFixedJobPriority;
+        std::map<std::tuple<std::string, std::string, std::string>, int> maxPriorities;
+        if (fixedPriority == 0) {
+            // Get highest priority waiting for each queue
+            // We then filter by this, and order by file_id
+            // Doing this, we avoid a order by priority, which would trigger a filesort, which
+            // can be pretty slow...
+            maxPriorities = getMaxPriorityPerQueue(sql);
+        }
+        else {
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << __func__
+            << " Using fixed priority for Jobs."
+            << commit;
+        }
+
+        // Activity shares and queued activities, once per VO
+        std::map<std::string, std::map<std::string, double> > activitySharesPerVo;
+        std::map<std::string, std::map<std::pair<std::string, std::string>, std::map<std::string, long long> > >
+            activitiesPerVo;
+
+        std::vector<ReadyTransfersQuery> queries;
+
         // Iterate through queues, getting jobs IF the VO has not run out of credits
         // AND there are pending file transfers within the job
         for (auto it = queues.begin(); it != queues.end(); ++it)
         {
-            int maxActive = 0;
-            soci::indicator maxActiveNull = soci::i_ok;
+            const std::pair<std::string, std::string> pair(it->sourceSe, it->destSe);
             int filesNum = 10;
 
-            int activeCount = getActiveCount(sql, it->sourceSe, it->destSe);
-
             // How many can we run
-            sql << "SELECT active FROM t_optimizer WHERE source_se = :source_se AND dest_se = :dest_se",
-                   soci::use(it->sourceSe),
-                   soci::use(it->destSe),
-                   soci::into(maxActive, maxActiveNull);
-
-            // Calculate how many tops we should pick
-            if (maxActiveNull != soci::i_null && maxActive > 0)
+            auto maxActive = maxActives.find(pair);
+            if (maxActive != maxActives.end() && maxActive->second > 0)
             {
-                filesNum = (maxActive - activeCount);
+                auto activeCount = activeCounts.find(pair);
+                filesNum = maxActive->second - (activeCount != activeCounts.end() ? activeCount->second : 0);
                 if(filesNum <= 0 ) {
                     continue;
                 }
             }
 
-            int fixedPriority =  ServerConfig::instance().get<int> ("UseFixedJobPriority");
-            soci::indicator isMaxPriorityNull = soci::i_ok;
-            int maxPriority = 3;
+            int maxPriority = fixedPriority;
             if (fixedPriority == 0) {
-                // Get highest priority waiting for this queue
-                // We then filter by this, and order by file_id
-                // Doing this, we avoid a order by priority, which would trigger a filesort, which
-                // can be pretty slow...
-                sql << "SELECT MAX(priority) "
-                   "FROM t_file "
-                   "WHERE "
-                   "    vo_name=:voName AND source_se=:source AND dest_se=:dest AND "
-                   "    file_state = 'SUBMITTED'",
-                   soci::use(it->voName), soci::use(it->sourceSe), soci::use(it->destSe),
-                   soci::into(maxPriority, isMaxPriorityNull);
-                if (isMaxPriorityNull == soci::i_null) {
+                auto priority = maxPriorities.find(std::make_tuple(it->sourceSe, it->destSe, it->voName));
+                if (priority == maxPriorities.end()) {
                    FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "NULL MAX(priority), skip entry" << commit;
                    continue;
                 }
-            } 
-            else 
-            {
-                FTS3_COMMON_LOGGER_NEWLOG(WARNING) << __func__
-                << " Using fixed priority for Jobs."
-                << commit;
+                maxPriority = priority->second;
+            }
 
-                maxPriority=fixedPriority;
+            auto activityShares = activitySharesPerVo.find(it->voName);
+            if (activityShares == activitySharesPerVo.end()) {
+                activityShares = activitySharesPerVo.insert(
+                    std::make_pair(it->voName, getActivityShareConf(sql, it->voName))).first;
+                if (!activityShares->second.empty()) {
+                    activitiesPerVo[it->voName] = getActivitiesInQueues(sql, it->voName);
+                }
             }
-            std::set<std::string> default_activities;
-            std::map<std::string, int> activityFilesNum =
-                getFilesNumPerActivity(sql, it->sourceSe, it->destSe, it->voName, filesNum, default_activities);
 
-            struct tm tTime;
-            gmtime_r(&now, &tTime);
+            std::set<std::string> default_activities;
+            std::map<std::string, int> activityFilesNum;
+            if (!activityShares->second.empty()) {
+                activityFilesNum = getFilesNumPerActivity(activityShares->second,
+                    activitiesPerVo[it->voName][pair], filesNum, default_activities);
+            }
 
             if (activityFilesNum.empty())
             {
-                soci::rowset<TransferFile> rs = (sql.prepare <<
-                      " SELECT f.file_state, f.source_surl, f.dest_surl, f.job_id, j.vo_name, "
-                      "       f.file_id, j.overwrite_flag, j.archive_timeout, j.dst_file_report, "
-                      "       j.user_dn, j.cred_id, f.checksum, j.checksum_method, j.source_space_token, "
-                      "       j.space_token, j.copy_pin_lifetime, j.bring_online, "
-                      "       f.user_filesize, f.file_metadata, j.job_metadata, f.file_index, f.bringonline_token, "
-                      "       f.source_se, f.dest_se, f.selection_strategy, j.internal_job_params, j.job_type "
-                      " FROM t_file f USE INDEX(idx_link_state_vo), t_job j "
-                      " WHERE f.job_id = j.job_id and  f.file_state = 'SUBMITTED' AND "
-                      "     f.source_se = :source_se AND f.dest_se = :dest_se AND  "
-                      "     f.vo_name = :vo_name AND "
-                      "     (f.retry_timestamp is NULL OR f.retry_timestamp < :tTime) AND "
-                      "     j.job_type IN ('N', 'R', 'H') AND "
-                      "     f.hashed_id BETWEEN :hStart AND :hEnd AND "
-                      "     j.priority = :maxPriority "
-                      " ORDER BY file_id ASC "
-                      " LIMIT :filesNum",
-                      soci::use(it->sourceSe),
-                      soci::use(it->destSe),
-                      soci::use(it->voName),
-                      soci::use(tTime),
-                      soci::use(hashSegment.start), soci::use(hashSegment.end),
-                      soci::use(maxPriority),
-                      soci::use(filesNum));
-
-                for (auto ti = rs.begin(); ti != rs.end(); ++ti)
-                {
-                    TransferFile& tfile = *ti;
-
-                    if(tfile.jobType == Job::kTypeMultipleReplica)
-                    {
-                        int total = 0;
-                        int remain = 0;
-                        sql << " select count(*) as c1, "
-                            " (select count(*) from t_file where file_state<>'NOT_USED' and  job_id=:job_id)"
-                            " as c2 from t_file where job_id=:job_id",
-                            soci::use(tfile.jobId),
-                            soci::use(tfile.jobId),
-                            soci::into(total),
-                            soci::into(remain);
-
-                        tfile.lastReplica = (total == remain)? 1: 0;
-                    }
-                    if(tfile.jobType == Job::kTypeMultiHop)
-                    {
-                        int maxIndex = 0;
-                        sql << "SELECT MAX(file_index) "
-                               "FROM t_file "
-                               "WHERE job_id = :job_id ",
-                                soci::use(tfile.jobId),
-                                soci::into(maxIndex);
-
-                        tfile.lastHop = (maxIndex == tfile.fileIndex)? 1: 0;
-                    }
-
-                    files[tfile.voName].push_back(tfile);
-                }
+                queries.emplace_back(*it, maxPriority, filesNum);
             }
             else
             {
@@ -726,77 +926,49 @@ void MySqlAPI::getReadyTransfers(const std::vector<QueueId>& queues,
                 {
                     if (it_act->second == 0) continue;
 
-                    std::string select = " SELECT f.file_state, f.source_surl, f.dest_surl, f.job_id, j.vo_name, "
-                                         "       f.file_id, j.overwrite_flag, j.archive_timeout, j.dst_file_report, "
-                                         "       j.user_dn, j.cred_id, f.checksum, j.checksum_method, j.source_space_token, "
-                                         "       j.space_token, j.copy_pin_lifetime, j.bring_online, "
-                                         "       f.user_filesize, f.file_metadata, j.job_metadata, f.file_index, f.bringonline_token, "
-                                         "       f.source_se, f.dest_se, f.selection_strategy, j.internal_job_params, j.job_type "
-                                         " FROM t_file f USE INDEX(idx_link_state_vo), t_job j "
-                                         " WHERE f.job_id = j.job_id and  f.file_state = 'SUBMITTED' AND    "
-                                         "      f.source_se = :source_se AND f.dest_se = :dest_se AND "
-                                         "      (j.job_type = 'N' OR j.job_type = 'R') AND  "
-                                         "      f.vo_name = :vo_name AND "
-                                         "      (f.retry_timestamp is NULL OR f.retry_timestamp < :tTime) AND ";
-                    select +=
-                        it_act->first == "default" ?
-                        "     (f.activity = :activity OR f.activity IS NULL OR f.activity IN " + def_act + ") AND "
-                        :
-                        "     f.activity = :activity AND ";
-                    select +=
-                        "   (f.hashed_id >= :hStart AND f.hashed_id <= :hEnd) AND "
-                        "   j.priority = :maxPriority "
-                        "   ORDER BY file_id ASC "
-                        "   LIMIT :filesNum";
-
-
-                    soci::rowset<TransferFile> rs = (
-                         sql.prepare <<
-                         select,
-                         soci::use(it->sourceSe),
-                         soci::use(it->destSe),
-                         soci::use(it->voName),
-                         soci::use(tTime),
-                         soci::use(it_act->first),
-                         soci::use(hashSegment.start), soci::use(hashSegment.end),
-                         soci::use(maxPriority),
-                         soci::use(it_act->second)
-                    );
+                    queries.emplace_back(*it, maxPriority, it_act->second);
+                    queries.back().byActivity = true;
+                    queries.back().activity = it_act->first;
+                    queries.back().defaultActivities = def_act;
+                }
+            }
+        }
 
-                    for (auto ti = rs.begin(); ti != rs.end(); ++ti)
-                    {
-                        TransferFile& tfile = *ti;
+        struct tm tTime;
+        gmtime_r(&now, &tTime);
 
-                        if(tfile.jobType == Job::kTypeMultipleReplica)
-                        {
-                            int total = 0;
-                            int remain = 0;
-                            sql << " select count(*) as c1, "
-                                " (select count(*) from t_file where file_state<>'NOT_USED' and  job_id=:job_id)"
-                                " as c2 from t_file where job_id=:job_id",
-                                soci::use(tfile.jobId),
-                                soci::use(tfile.jobId),
-                                soci::into(total),
-                                soci::into(remain);
-
-                            tfile.lastReplica = (total == remain)? 1: 0;
-                        }
-                        if(tfile.jobType == Job::kTypeMultiHop)
-                        {
-                            int maxIndex = 0;
-                            sql << "SELECT MAX(file_index) "
-                                   "FROM t_file "
-                                   "WHERE job_id = :job_id ",
-                                    soci::use(tfile.jobId),
-                                    soci::into(maxIndex);
-
-                            tfile.lastHop = (maxIndex == tfile.fileIndex)? 1: 0;
-                        }
+        // Same hash ranges for every queue, even if the heartbeat changes them meanwhile
+        const std::string hashCond = hashCondition("f.hashed_id");
 
-                        tfile.activity = it_act->first;
-                        files[tfile.voName].push_back(tfile);
-                    }
+        // Pick the files for several queues with a single statement
+        for (size_t first = 0; first < queries.size(); first += READY_TRANSFERS_QUERIES_PER_STATEMENT)
+        {
+            const size_t last = std::min(first + READY_TRANSFERS_QUERIES_PER_STATEMENT, queries.size());
+
+            const std::string select = buildReadyTransfersQuery(queries, first, last, hashCond);
+
+            soci::details::prepare_temp_type stmt = (sql.prepare << select);
+            // In the order given by buildReadyTransfersQuery
+            for (size_t i = first; i < last; ++i) {
+                ReadyTransfersQuery &query = queries[i];
+                stmt, soci::use(query.activity),
+                    soci::use(query.sourceSe), soci::use(query.destSe), soci::use(query.voName),
+                    soci::use(tTime),
+                    soci::use(query.priority);
+                if (query.byActivity) {
+                    stmt, soci::use(query.activity);
                 }
+                stmt, soci::use(query.limit);
+            }
+
+            soci::rowset<TransferFile> rs = stmt;
+            std::list<TransferFile> transfers(rs.begin(), rs.end());
+
+            setLastReplicaAndHop(sql, transfers);
+
+            for (auto ti = transfers.begin(); ti != transfers.end(); ++ti)
+            {
+                files[ti->voName].push_back(*ti);
             }
         }
     }
@@ -1162,10 +1334,9 @@ void MySqlAPI::getReadySessionReuseTransfers(const std::vector<QueueId>& queues,
                         " FROM t_job j INNER JOIN t_file f ON (j.job_id = f.job_id) "
                         " WHERE j.job_id = :job_id AND "
                         "       f.file_state = 'SUBMITTED' AND "
-                        "       f.hashed_id BETWEEN :hStart AND :hEnd AND "
+                        "       " + hashCondition("f.hashed_id") + " AND "
                         "       (f.retry_timestamp is null or f.retry_timestamp < :tTime)",
                         soci::use(jobId),
-                        soci::use(hashSegment.start), soci::use(hashSegment.end),
                         soci::use(tTime)
                     );
 
@@ -1386,14 +1557,169 @@ boost::tuple<bool, std::string>  MySqlAPI::updateFileTransferStatusInternal(soci
     catch (std::exception& e)
     {
         sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+    }
+    catch (...)
+    {
+        sql.rollback();
+        throw UserError(std::string(__func__) + ": Caught exception ");
+    }
+    return  boost::tuple<bool, std::string>(true, storedState);
+}
+
+
+void MySqlAPI::updateTransferStatuses(const std::vector<fts3::events::Message>& messages,
+        std::vector<StatusUpdateResult>& results)
+{
+    results.assign(messages.size(), StatusUpdateResult());
+
+    // Terminal messages, grouped by job
+    std::vector<uint64_t> fileIdList;
+    std::map<std::string, std::vector<size_t> > byJob = groupTerminalStatuses(messages, fileIdList);
+
+    if (byJob.empty()) {
+        return;
+    }
+
+    soci::session sql(*connectionPool);
+    std::set<std::string> bulkJobs;
+
+    try
+    {
+        time_t now = time(NULL);
+        struct tm tTime;
+        gmtime_r(&now, &tTime);
+
+        sql.begin();
+
+        // The jobs that can not be updated in bulk go one by one
+        std::string select = "SELECT job_id, job_type, archive_timeout FROM t_job WHERE job_id IN (";
+        for (auto i = byJob.begin(); i != byJob.end(); ++i) {
+            select += (i == byJob.begin()) ? ":job_id" : ", :job_id";
+        }
+        select += ")";
+
+        soci::details::prepare_temp_type jobStmt = (sql.prepare << select);
+        for (auto i = byJob.begin(); i != byJob.end(); ++i) {
+            jobStmt, soci::use(i->first);
+        }
+        soci::rowset<soci::row> jobs = jobStmt;
+
+        for (auto i = jobs.begin(); i != jobs.end(); ++i) {
+            const Job::JobType jobType = i->get<Job::JobType>("job_type", Job::kTypeRegular);
+            const int archiveTimeout = i->get<int>("archive_timeout", -1);
+
+            if (canUpdateStatusesInBulk(jobType, archiveTimeout)) {
+                bulkJobs.insert(i->get<std::string>("job_id"));
+            }
+        }
+
+        // Lock the files, and get their current state
+        std::ostringstream fileIds;
+        for (auto i = fileIdList.begin(); i != fileIdList.end(); ++i) {
+            if (i != fileIdList.begin()) {
+                fileIds << ", ";
+            }
+            fileIds << *i;
+        }
+
+        std::map<uint64_t, std::string> storedStates;
+        soci::rowset<soci::row> files = (sql.prepare <<
+            "SELECT file_id, file_state FROM t_file "
+            "WHERE file_id IN (" << fileIds.str() << ") "
+            "FOR UPDATE");
+        for (auto i = files.begin(); i != files.end(); ++i) {
+            storedStates[i->get<unsigned long long>("file_id")] = i->get<std::string>("file_state");
+        }
+
+        std::string state, reason, fileMetadata, oldState;
+        soci::indicator fileMetadataInd = soci::i_ok;
+        double throughput = 0, filesize = 0, duration = 0, transferred = 0;
+        int processId = 0, currentFailures = 0;
+        uint64_t fileId = 0;
+
+        soci::statement stmt = (sql.prepare <<
+            "UPDATE t_file SET "
+            "    file_state = :state, reason = :reason, finish_time = :finishTime, dest_surl_uuid = NULL, "
+            "    transfer_host = :hostname, transferred = :transferred, "
+            "    file_metadata = COALESCE(:fileMetadata, file_metadata), "
+            "    pid = :pid, filesize = :filesize, tx_duration = :duration, throughput = :throughput, "
+            "    current_failures = :currentFailures "
+            "WHERE file_id = :fileId AND file_state = :oldState",
+            soci::use(state, "state"), soci::use(reason, "reason"), soci::use(tTime, "finishTime"),
+            soci::use(hostname, "hostname"), soci::use(transferred, "transferred"),
+            soci::use(fileMetadata, fileMetadataInd, "fileMetadata"),
+            soci::use(processId, "pid"), soci::use(filesize, "filesize"), soci::use(duration, "duration"),
+            soci::use(throughput, "throughput"), soci::use(currentFailures, "currentFailures"),
+            soci::use(fileId, "fileId"), soci::use(oldState, "oldState"));
+
+        for (auto job = bulkJobs.begin(); job != bulkJobs.end(); ++job) {
+            const std::vector<size_t> &indexes = byJob[*job];
+
+            for (auto i = indexes.begin(); i != indexes.end(); ++i) {
+                const fts3::events::Message &msg = messages[*i];
+                StatusUpdateResult &result = results[*i];
+
+                result.applied = true;
+                result.storedState = storedStates[msg.file_id()];
+
+                // Already terminal, or gone
+                if (result.storedState.empty() || result.storedState == "FAILED" ||
+                    result.storedState == "FINISHED" || result.storedState == "CANCELED") {
+                    continue;
+                }
+
+                state = msg.transfer_status();
+                reason = msg.transfer_message();
+                fileMetadata = msg.file_metadata();
+                fileMetadataInd = fileMetadata.empty() ? soci::i_null : soci::i_ok;
+                throughput = msg.throughput();
+                filesize = msg.filesize();
+                duration = msg.time_in_secs();
+                transferred = (state == "FINISHED") ? filesize : 0;
+                processId = msg.process_id();
+                currentFailures = static_cast<int>(msg.retry());
+                fileId = msg.file_id();
+                oldState = result.storedState;
+
+                stmt.execute(true);
+                result.updated = (get_affected_rows(sql) > 0);
+            }
+        }
+
+        sql.commit();
+    }
+    catch (std::exception& e)
+    {
+        sql.rollback();
+        results.assign(messages.size(), StatusUpdateResult());
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not apply the status messages in bulk: " << e.what() << commit;
+        return;
     }
     catch (...)
     {
         sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception ");
+        results.assign(messages.size(), StatusUpdateResult());
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not apply the status messages in bulk" << commit;
+        return;
+    }
+
+    // Recompute the state of each job once, from its last message
+    // If that fails, its messages go one by one, so the job state is retried
+    for (auto job = bulkJobs.begin(); job != bulkJobs.end(); ++job) {
+        const std::vector<size_t> &indexes = byJob[*job];
+        try
+        {
+            updateJobTransferStatusInternal(sql, *job, messages[indexes.back()].transfer_status());
+        }
+        catch (std::exception& e)
+        {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not update the state of " << *job << ": " << e.what() << commit;
+            for (auto i = indexes.begin(); i != indexes.end(); ++i) {
+                results[*i] = StatusUpdateResult();
+            }
+        }
     }
-    return  boost::tuple<bool, std::string>(true, storedState);
 }
 
 
@@ -1465,55 +1791,84 @@ bool MySqlAPI::updateJobTransferStatusInternal(soci::session& sql, std::string j
             sql <<  " SELECT source_se FROM t_file WHERE job_id=:job_id AND file_state='FINISHED' LIMIT 1 ", soci::use(jobId), soci::into(sourceSe);
         }
 
-        sql << " SELECT COUNT(DISTINCT file_index) "
-            " FROM t_file "
-            " WHERE job_id = :job_id ",
-            soci::use(jobId),
-            soci::into(numberOfFilesInJob);
-
-        sql << " SELECT COUNT(DISTINCT file_index) "
-            " FROM t_file "
-            " WHERE job_id = :jobId "
-            "   AND file_state <> 'CANCELED' ", // all the replicas have to be in CANCELED state in order to count a file as canceled
-            soci::use(jobId),                  // so if just one replica is in a different state it is enough to count it as not canceled
-            soci::into(numberOfFilesNotCanceled);
-
+        bool counted = false;
+        if (fileStateCounters && jobType != Job::kTypeMultipleReplica)
+        {
+            // Each file has its own index, so the counters kept by the t_file triggers
+            // give the same numbers, without going through the files of the job
+            std::map<std::string, int> counters;
+            soci::rowset<soci::row> rsCounters = (sql.prepare <<
+                " SELECT file_state, n_files "
+                " FROM t_job_file_counters "
+                " WHERE job_id = :jobId ",
+                soci::use(jobId));
+            for (auto i = rsCounters.begin(); i != rsCounters.end(); ++i) {
+                const int count = i->get<int>("n_files");
+                counters[i->get<std::string>("file_state")] = count;
+                numberOfFilesInJob += count;
+            }
 
-        // number of files that were canceled
-        numberOfFilesCanceled = numberOfFilesInJob - numberOfFilesNotCanceled;
+            numberOfFilesNotCanceled = numberOfFilesInJob - counters["CANCELED"];
+            numberOfFilesFinished = counters["FINISHED"];
+            numberOfStaging = counters["STAGING"] + counters["STARTED"];
+            numberOfFilesArchiving = counters["ARCHIVING"];
+            numberOfFilesNotCanceledNorFailed = numberOfFilesNotCanceled - counters["FAILED"];
+            // No counters if the job was submitted before they were introduced
+            counted = !counters.empty();
+        }
 
-        // number of files that were finished
-        sql << " SELECT COUNT(DISTINCT file_index) "
-            " FROM t_file "
-            " WHERE job_id = :jobId "
-            "   AND file_state = 'FINISHED' ", // at least one replica has to be in FINISH state in order to count the file as finished
-            soci::use(jobId),
-            soci::into(numberOfFilesFinished);
+        if (!counted)
+        {
+            // The replicas of a file share its index, so count the indexes
+            sql << " SELECT COUNT(DISTINCT file_index) "
+                " FROM t_file "
+                " WHERE job_id = :job_id ",
+                soci::use(jobId),
+                soci::into(numberOfFilesInJob);
+
+            sql << " SELECT COUNT(DISTINCT file_index) "
+                " FROM t_file "
+                " WHERE job_id = :jobId "
+                "   AND file_state <> 'CANCELED' ", // all the replicas have to be in CANCELED state in order to count a file as canceled
+                soci::use(jobId),                  // so if just one replica is in a different state it is enough to count it as not canceled
+                soci::into(numberOfFilesNotCanceled);
+
+            // number of files that were finished
+            sql << " SELECT COUNT(DISTINCT file_index) "
+                " FROM t_file "
+                " WHERE job_id = :jobId "
+                "   AND file_state = 'FINISHED' ", // at least one replica has to be in FINISH state in order to count the file as finished
+                soci::use(jobId),
+                soci::into(numberOfFilesFinished);
 
-        // number of files still staging
-        sql << " SELECT COUNT(DISTINCT file_index) "
-            " FROM t_file "
-            " WHERE job_id = :jobId "
-            "   AND file_state IN ('STAGING', 'STARTED') ",
-            soci::use(jobId),
-            soci::into(numberOfStaging);
+            // number of files still staging
+            sql << " SELECT COUNT(DISTINCT file_index) "
+                " FROM t_file "
+                " WHERE job_id = :jobId "
+                "   AND file_state IN ('STAGING', 'STARTED') ",
+                soci::use(jobId),
+                soci::into(numberOfStaging);
 
-        // number of files archiving
-        sql << " SELECT COUNT(DISTINCT file_index) "
-            " FROM t_file "
-            " WHERE job_id = :jobId "
-            "   AND file_state = 'ARCHIVING' ",
-            soci::use(jobId),
-            soci::into(numberOfFilesArchiving);
+            // number of files archiving
+            sql << " SELECT COUNT(DISTINCT file_index) "
+                " FROM t_file "
+                " WHERE job_id = :jobId "
+                "   AND file_state = 'ARCHIVING' ",
+                soci::use(jobId),
+                soci::into(numberOfFilesArchiving);
+
+            // number of files that were not canceled nor failed
+            sql << " SELECT COUNT(DISTINCT file_index) "
+                " FROM t_file "
+                " WHERE job_id = :jobId "
+                "   AND file_state <> 'CANCELED' " // for not canceled files see above
+                "   AND file_state <> 'FAILED' ",  // all the replicas have to be either in CANCELED or FAILED state in order to count
+                soci::use(jobId),                 // a files as failed so if just one replica is not in CANCEL neither in FAILED state
+                soci::into(numberOfFilesNotCanceledNorFailed);
+        }
 
-        // number of files that were not canceled nor failed
-        sql << " SELECT COUNT(DISTINCT file_index) "
-            " FROM t_file "
-            " WHERE job_id = :jobId "
-            "   AND file_state <> 'CANCELED' " // for not canceled files see above
-            "   AND file_state <> 'FAILED' ",  // all the replicas have to be either in CANCELED or FAILED state in order to count
-            soci::use(jobId),                 // a files as failed so if just one replica is not in CANCEL neither in FAILED state
-            soci::into(numberOfFilesNotCanceledNorFailed);
+        // number of files that were canceled
+        numberOfFilesCanceled = numberOfFilesInJob - numberOfFilesNotCanceled;
 
         // number of files that failed
         numberOfFilesFailed = numberOfFilesInJob - numberOfFilesNotCanceledNorFailed - numberOfFilesCanceled;
@@ -1590,7 +1945,7 @@ bool MySqlAPI::updateJobTransferStatusInternal(soci::session& sql, std::string j
             }
 
             // Behavior on finished multihop jobs
-            bool cancelUnusedMultihopFiles = ServerConfig::instance().get<bool>("CancelUnusedMultihopFiles");
+            bool cancelUnusedMultihopFiles = ServerConfig::instance().values().cancelUnusedMultihopFiles;
 
             if (cancelUnusedMultihopFiles && jobType == Job::kTypeMultiHop) {
                 sql.begin();
@@ -1669,43 +2024,53 @@ bool MySqlAPI::updateJobTransferStatusInternal(soci::session& sql, std::string j
 
 void MySqlAPI::updateFileTransferProgressVector(const std::vector<fts3::events::MessageUpdater>& messages)
 {
-    soci::session sql(*connectionPool);
+    // Rows updated by each statement
+    static const size_t PROGRESS_CHUNK_SIZE = 500;
 
-    try
+    // Only the last progress of each running transfer matters
+    std::map<uint64_t, const fts3::events::MessageUpdater*> progress;
+    for (auto iter = messages.begin(); iter != messages.end(); ++iter)
+    {
+        if (iter->file_id() > 0 && iter->transfer_status() == "ACTIVE" && iter->throughput() > 0.0 &&
+            std::isfinite(iter->throughput()))
+        {
+            progress[iter->file_id()] = &(*iter);
+        }
+    }
+
+    if (progress.empty())
     {
-        double throughput = 0.0;
-        double transferred = 0.0;
-        uint64_t file_id = 0;
-        std::string file_state;
+        return;
+    }
 
-        soci::statement stmt = (sql.prepare << "UPDATE t_file SET throughput = :throughput, transferred = :transferred WHERE file_id = :fileId ",
-                                soci::use(throughput), soci::use(transferred), soci::use(file_id));
+    soci::session sql(*connectionPool);
 
+    try
+    {
         sql.begin();
 
-        for (auto iter = messages.begin(); iter != messages.end(); ++iter)
+        auto iter = progress.begin();
+        while (iter != progress.end())
         {
-            throughput = 0.0;
-            transferred = 0.0;
-            file_id = 0;
-            file_state = "";
+            std::ostringstream throughputCase, transferredCase, fileIds;
+            throughputCase.precision(std::numeric_limits<double>::max_digits10);
 
-            if ((*iter).file_id() > 0)
+            for (size_t count = 0; iter != progress.end() && count < PROGRESS_CHUNK_SIZE; ++iter, ++count)
             {
-                file_state = (*iter).transfer_status();
-
-                if(file_state == "ACTIVE")
+                if (count > 0)
                 {
-                    file_id = (*iter).file_id();
-
-                    if((*iter).throughput() > 0.0 && file_id > 0 )
-                    {
-                        throughput = (*iter).throughput();
-                        transferred = (*iter).transferred();
-                        stmt.execute(true);
-                    }
+                    fileIds << ",";
                 }
+                throughputCase << " WHEN " << iter->first << " THEN " << iter->second->throughput();
+                transferredCase << " WHEN " << iter->first << " THEN " << iter->second->transferred();
+                fileIds << iter->first;
             }
+
+            // A late progress must not overwrite the final values of a transfer that has already terminated
+            sql << "UPDATE t_file SET "
+                "   throughput = CASE file_id" << throughputCase.str() << " END, "
+                "   transferred = CASE file_id" << transferredCase.str() << " END "
+                "WHERE file_id IN (" << fileIds.str() << ") AND file_state = 'ACTIVE'";
         }
 
         sql.commit();
@@ -1723,7 +2088,7 @@ void MySqlAPI::updateFileTransferProgressVector(const std::vector<fts3::events::
 }
 
 
-void MySqlAPI::getCancelJob(std::vector<int>& requestIDs)
+void MySqlAPI::getCancelJob(std::vector<std::pair<int, uint64_t>>& canceled)
 {
     soci::session sql(*connectionPool);
     int pid = 0;
@@ -1749,7 +2114,7 @@ void MySqlAPI::getCancelJob(std::vector<int>& requestIDs)
             file_id = row.get<unsigned long long>("file_id");
 
             if(pid > 0)
-                requestIDs.push_back(pid);
+                canceled.push_back(std::make_pair(pid, file_id));
 
             stmt1.execute(true);
         }
@@ -1798,13 +2163,13 @@ std::list<TransferFile> MySqlAPI::getForceStartTransfers()
 
 
 bool MySqlAPI::isTrAllowed(const std::string& sourceStorage,
-        const std::string & destStorage, int &currentActive)
+        const std::string & destStorage, int &currentActive, int &maxActive)
 {
     soci::session sql(*connectionPool);
 
     try
     {
-        int maxActive = 0;
+        maxActive = 0;
 
         sql << "SELECT active FROM t_optimizer "
                "WHERE source_se = :source AND dest_se = :dest_se LIMIT 1 ",
@@ -1814,7 +2179,7 @@ bool MySqlAPI::isTrAllowed(const std::string& sourceStorage,
             maxActive = DEFAULT_MIN_ACTIVE;
         }
 
-        int currentActive = getActiveCount(sql, sourceStorage, destStorage);
+        currentActive = getActiveCount(sql, sourceStorage, destStorage);
 
         return (currentActive < maxActive);
     }
@@ -1954,184 +2319,6 @@ void MySqlAPI::setPidForJob(const std::string& jobId, int pid)
 }
 
 
-void MySqlAPI::backup(int intervalDays, long bulkSize, long* nJobs, long* nFiles, long* nDeletions)
-{
-
-    soci::session sql(*connectionPool);
-
-    unsigned index=0, activeHosts=0, start=0, end=0;
-    std::string serviceName = "fts_backup";
-    *nJobs = 0;
-    *nFiles = 0;
-    *nDeletions = 0;
-    std::string job_id;
-    int count = 0;
-    int countBeat = 0;
-    bool drain = false;
-    int hostsRunningBackup = 0;
-    bool doBackup = true;
-    try
-    {
-
-        // Total number of working instances, prevent from starting a second one
-        soci::statement stmtActiveHosts = (
-                                              sql.prepare << "SELECT COUNT(hostname) FROM t_hosts "
-                                              "  WHERE beat >= DATE_SUB(UTC_TIMESTAMP(), interval 30 minute) and service_name = :service_name",
-                                              soci::use(serviceName),
-                                              soci::into(hostsRunningBackup));
-        stmtActiveHosts.execute(true);
-
-        if(hostsRunningBackup > 0)
-        {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Backup already running, won't start" << commit;
-            return;
-        }
-
-        try
-        {
-            //update heartbeat first, the first must get 0
-            updateHeartBeatInternal(sql, &index, &activeHosts, &start, &end, serviceName);
-        }
-        catch(...)
-        {
-            try
-            {
-                sleep(1);
-                //update heartbeat first, the first must get 0
-                updateHeartBeatInternal(sql, &index, &activeHosts, &start, &end, serviceName);
-            }
-            catch(...)
-            {
-
-            }
-
-        }
-        doBackup =  ServerConfig::instance().get<bool> ("BackupTables");
-        //prevent more than on server to update the optimizer decisions
-        if(hashSegment.start == 0)
-        {
-            soci::rowset<soci::row> rs = (
-                 sql.prepare <<
-                 "  select  job_id from t_job where job_finished < (UTC_TIMESTAMP() - interval :days DAY ) ",
-                 soci::use(intervalDays)
-             );
-
-            std::ostringstream jobIdStmt;
-            for (soci::rowset<soci::row>::const_iterator i = rs.begin(); i != rs.end(); ++i)
-            {
-                ++count;
-                ++countBeat;
-
-                if(countBeat == 1000)
-                {
-                    // Give some progress
-                    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Backup progress: "
-                        << *nJobs << " jobs and " << *nFiles << " files affected" << commit;
-
-                    //reset
-                    countBeat = 0;
-
-                    //update heartbeat first
-                    try
-                    {
-                        //update heartbeat first, the first must get 0
-                        updateHeartBeatInternal(sql, &index, &activeHosts, &start, &end, serviceName);
-                    }
-                    catch(...)
-                    {
-                        try
-                        {
-                            sleep(1);
-                            //update heartbeat first, the first must get 0
-                            updateHeartBeatInternal(sql, &index, &activeHosts, &start, &end, serviceName);
-                        }
-                        catch(...)
-                        {
-
-                        }
-
-                    }
-
-                    drain = getDrainInternal(sql);
-                    if(drain)
-                    {
-                        return;
-                    }
-                }
-
-                soci::row const& r = *i;
-                job_id = r.get<std::string>("job_id");
-                jobIdStmt << "'";
-                jobIdStmt << job_id;
-                jobIdStmt << "',";
-                if(count == bulkSize)
-                {
-                    std::string queryStr = jobIdStmt.str();
-                    job_id = queryStr.substr(0, queryStr.length() - 1);
-
-                    sql.begin();
-
-                    if (doBackup) {
-                        sql << "INSERT INTO t_job_backup SELECT * FROM t_job WHERE job_id  in (" +job_id+ ")";
-
-                        soci::statement insertFiles = (sql.prepare <<
-                            "INSERT INTO t_file_backup SELECT * FROM t_file WHERE  job_id in (" +job_id+ ")");
-                        insertFiles.execute();
-                    }
-                      
-                    soci::statement deleteFiles = (sql.prepare << 
-                           "DELETE FROM t_file WHERE job_id in (" +job_id+ ")");
-                    deleteFiles.execute();
-                    (*nFiles) += deleteFiles.get_affected_rows(); 
-
-                    soci::statement deleteDeletions = (sql.prepare <<
-                           "DELETE FROM t_dm WHERE job_id in (" +job_id+ ")");
-                    deleteDeletions.execute();
-                    (*nDeletions) += deleteDeletions.get_affected_rows();
-
-                    sql << "DELETE FROM t_job WHERE job_id in (" +job_id+ ")";
-                    (*nJobs) += count;
-
-                    count = 0;
-                    jobIdStmt.str(std::string());
-                    jobIdStmt.clear();
-                    sql.commit();
-                    sleep(1); // give it sometime to breath
-                }
-            }
-
-            //delete from t_optimizer_evolution old records bigger than the interval of days being passed
-            sql.begin();
-            soci::statement deleteOptEvo = (sql.prepare <<
-                    "delete from t_optimizer_evolution where datetime < (UTC_TIMESTAMP() - interval :days DAY ) ",
-                    soci::use(intervalDays)
-            );
-            deleteOptEvo.execute();
-            sql.commit();
-
-            //delete from t_file_retry_errors old records bigger than the interval of days being passed
-            sql.begin();
-            soci::statement deleteFileRetryErr = (
-                    sql.prepare << "  delete from t_file_retry_errors where datetime < (UTC_TIMESTAMP() - interval :days DAY ) ",
-                    soci::use(intervalDays)
-            );
-            deleteFileRetryErr.execute();
-            sql.commit();
-        }
-    }
-    catch (std::exception& e)
-    {
-        sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
-    }
-    catch (...)
-    {
-        sql.rollback();
-        throw UserError(std::string(__func__) + ": Caught exception " );
-    }
-}
-
-
 void MySqlAPI::forkFailed(const std::string& jobId)
 {
     soci::session sql(*connectionPool);
@@ -2369,6 +2556,144 @@ void MySqlAPI::updateProtocol(const fts3::events::Message& msg)
 }
 
 
+void MySqlAPI::claimTransfers(const std::vector<fts3::events::Message>& transfers,
+    std::map<uint64_t, int>& claimed)
+{
+    if (transfers.empty()) {
+        return;
+    }
+
+    soci::session sql(*connectionPool);
+
+    try
+    {
+        time_t now = time(NULL);
+        struct tm tTime;
+        gmtime_r(&now, &tTime);
+
+        std::ostringstream fileIds;
+        for (auto i = transfers.begin(); i != transfers.end(); ++i) {
+            if (i != transfers.begin()) {
+                fileIds << ", ";
+            }
+            fileIds << i->file_id();
+        }
+
+        sql.begin();
+
+        // Lock the rows first, so we know exactly which ones are ours
+        // The job rows are read by the subquery without being locked
+        soci::rowset<soci::row> rs = (sql.prepare <<
+            "SELECT f.file_id, f.retry, f.job_id, "
+            "   (SELECT j.job_type FROM t_job j WHERE j.job_id = f.job_id) AS job_type "
+            "FROM t_file f "
+            "WHERE f.file_id IN (" << fileIds.str() << ") AND f.file_state IN ('SUBMITTED', 'FORCE_START') "
+            "FOR UPDATE");
+
+        std::ostringstream claimedIds;
+        std::set<std::string> multihopJobs;
+        for (auto i = rs.begin(); i != rs.end(); ++i) {
+            uint64_t fileId = i->get<unsigned long long>("file_id");
+            claimed[fileId] = (i->get_indicator("retry") == soci::i_null) ? 0 : i->get<int>("retry");
+
+            if (i->get<std::string>("job_type", "N") == std::string(1, Job::kTypeMultiHop)) {
+                multihopJobs.insert(i->get<std::string>("job_id"));
+            }
+
+            if (claimed.size() > 1) {
+                claimedIds << ", ";
+            }
+            claimedIds << fileId;
+        }
+
+        if (claimed.empty()) {
+            sql.rollback();
+            return;
+        }
+
+        sql << "UPDATE t_file SET "
+               "    file_state = 'READY', reason = '', start_time = :startTime, transfer_host = :hostname, "
+               "    pid = 0, filesize = 0, tx_duration = 0, throughput = 0, current_failures = 0 "
+               "WHERE file_id IN (" << claimedIds.str() << ")",
+               soci::use(tTime), soci::use(hostname);
+
+        std::string params;
+        uint64_t fileId = 0;
+        soci::statement stmt = (sql.prepare <<
+            "UPDATE t_file SET internal_file_params = :params WHERE file_id = :fileId",
+            soci::use(params), soci::use(fileId));
+
+        for (auto i = transfers.begin(); i != transfers.end(); ++i) {
+            if (claimed.count(i->file_id()) == 0) {
+                continue;
+            }
+
+            std::ostringstream internalParams;
+            internalParams << "nostreams:" << static_cast<int>(i->nostreams())
+                           << ",timeout:" << static_cast<int>(i->timeout())
+                           << ",buffersize:" << static_cast<int>(i->buffersize());
+            params = internalParams.str();
+            fileId = i->file_id();
+            stmt.execute(true);
+        }
+
+        // As updateTransferStatus does when a hop leaves the queue
+        for (auto i = multihopJobs.begin(); i != multihopJobs.end(); ++i) {
+            setNullDestSURLMultiHop(sql, *i);
+        }
+
+        sql.commit();
+    }
+    catch (std::exception& e)
+    {
+        sql.rollback();
+        claimed.clear();
+        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+    }
+    catch (...)
+    {
+        sql.rollback();
+        claimed.clear();
+        throw UserError(std::string(__func__) + ": Caught exception " );
+    }
+}
+
+
+void MySqlAPI::setTransfersPid(const std::vector<fts3::events::MessageUpdater>& transfers)
+{
+    soci::session sql(*connectionPool);
+
+    try
+    {
+        int pid = 0;
+        uint64_t fileId = 0;
+
+        // If the transfer already moved to ACTIVE, it has reported its pid by itself
+        soci::statement stmt = (sql.prepare <<
+            "UPDATE t_file SET pid = :pid WHERE file_id = :fileId AND file_state = 'READY'",
+            soci::use(pid), soci::use(fileId));
+
+        sql.begin();
+        for (auto i = transfers.begin(); i != transfers.end(); ++i) {
+            pid = i->process_id();
+            fileId = i->file_id();
+            stmt.execute(true);
+        }
+        sql.commit();
+    }
+    catch (std::exception& e)
+    {
+        sql.rollback();
+        throw UserError(std::string(__func__) + ": Caught exception " + e.what());
+    }
+    catch (...)
+    {
+        sql.rollback();
+        throw UserError(std::string(__func__) + ": Caught exception " );
+    }
+}
+
+
 void MySqlAPI::transferLogFileVector(std::map<int, fts3::events::MessageLog>& messagesLog)
 {
     soci::session sql(*connectionPool);
@@ -2492,7 +2817,7 @@ std::vector<TransferState> MySqlAPI::getStateOfDeleteInternal(soci::session& sql
             ret.source_se = it->get<std::string>("source_se");
             ret.dest_se = "";
 
-            bool publishUserDn = publishUserDnInternal(sql, ret.vo_name);
+            bool publishUserDn = getConfigSnapshot()->publishUserDn(ret.vo_name);
             if(!publishUserDn)
                 ret.user_dn = std::string("");
             else
@@ -2594,7 +2919,7 @@ std::vector<TransferState> MySqlAPI::getStateOfTransferInternal(soci::session& s
             ret.source_se = it->get<std::string>("source_se");
             ret.dest_se = it->get<std::string>("dest_se");
 
-            bool publishUserDn = publishUserDnInternal(sql, ret.vo_name);
+            bool publishUserDn = getConfigSnapshot()->publishUserDn(ret.vo_name);
             if(!publishUserDn)
                 ret.user_dn = std::string("");
             else
@@ -2759,6 +3084,35 @@ void MySqlAPI::updateHeartBeat(unsigned* index, unsigned* count, unsigned* start
 }
 
 
+void MySqlAPI::getHashSegment(std::vector<std::pair<unsigned, unsigned>> *ranges)
+{
+    boost::mutex::scoped_lock lock(hashSegmentMutex);
+    *ranges = hashSegment.ranges;
+}
+
+
+std::string MySqlAPI::hashCondition(const std::string &column)
+{
+    boost::mutex::scoped_lock lock(hashSegmentMutex);
+
+    // Nothing owned, nothing matches
+    if (hashSegment.ranges.empty()) {
+        return "(0=1)";
+    }
+
+    std::ostringstream condition;
+    condition << "(";
+    for (auto range = hashSegment.ranges.begin(); range != hashSegment.ranges.end(); ++range) {
+        if (range != hashSegment.ranges.begin()) {
+            condition << " OR ";
+        }
+        condition << column << " BETWEEN " << range->first << " AND " << range->second;
+    }
+    condition << ")";
+    return condition.str();
+}
+
+
 void MySqlAPI::updateHeartBeatInternal(soci::session& sql, unsigned* index, unsigned* count, unsigned* start, unsigned* end, std::string serviceName)
 {
     try
@@ -2775,56 +3129,50 @@ void MySqlAPI::updateHeartBeatInternal(soci::session& sql, unsigned* index, unsi
                                     soci::use(hostname), soci::use(serviceName));
         stmt1.execute(true);
 
-        // Will be replaced by a simple count later on since we get the total number of hosts
-        // Total number of working instances
-        //soci::statement stmt2 = (
-        //                            sql.prepare << "SELECT COUNT(hostname) FROM t_hosts "
-        //                            "  WHERE beat >= DATE_SUB(UTC_TIMESTAMP(), interval :grace second) and service_name = :service_name",
-        //                            soci::use(heartBeatGraceInterval),
-        //                            soci::use(serviceName),
-        //                            soci::into(*count));
-        //stmt2.execute(true);
-
-        // This instance index
-        // Mind that MySQL does not have rownum
-        soci::rowset<soci::row> rsHosts = (sql.prepare <<
-                                             "SELECT (SELECT count(hostname) FROM t_hosts WHERE beat >= DATE_SUB(UTC_TIMESTAMP(), interval :grace second) and service_name = :service_name) as totalhosts, "
-                                             "hostname FROM t_hosts "
-                                             "WHERE beat >= DATE_SUB(UTC_TIMESTAMP(), interval :grace second) and service_name = :service_name "
-                                             "ORDER BY hostname",
-                                             soci::use(heartBeatGraceInterval), soci::use(serviceName), soci::use(heartBeatGraceInterval), soci::use(serviceName)
+        // Hosts alive, which includes this one
+        soci::rowset<std::string> rsHosts = (sql.prepare <<
+                                             "SELECT hostname FROM t_hosts "
+                                             "WHERE beat >= DATE_SUB(UTC_TIMESTAMP(), interval :grace second) and service_name = :service_name",
+                                             soci::use(heartBeatGraceInterval), soci::use(serviceName)
                                             );
-        soci::rowset<soci::row>::const_iterator i;
-
-        *count = 0;
-
-        for (*index = 0, i = rsHosts.begin(); i != rsHosts.end(); ++i, ++(*index))
-        {
-        soci::row const& row = *i;
-            if (row.get<std::string>(1) == hostname)
-            {
-            *count = row.get<unsigned>(0);
-            std::string& host = hostname;
-            break;
-            }
-        }
+        std::vector<std::string> hosts(rsHosts.begin(), rsHosts.end());
 
         sql.commit();
 
-        // Calculate start and end hash values
-        unsigned segsize = UINT16_MAX / *count;
-        unsigned segmod  = UINT16_MAX % *count;
+        // Sorted here, so the order does not depend on the collation
+        std::sort(hosts.begin(), hosts.end());
+
+        auto self = std::lower_bound(hosts.begin(), hosts.end(), hostname);
+        if (self == hosts.end() || *self != hostname) {
+            self = hosts.insert(self, hostname);
+        }
+        *index = self - hosts.begin();
+        *count = hosts.size();
+
+        // Each host owns its share of the hash ring, so a host joining or leaving
+        // only moves the hashes next to its own virtual nodes
+        boost::mutex::scoped_lock lock(hashSegmentMutex);
+
+        // The number of virtual nodes can be changed without a restart
+        const unsigned virtualNodes = ServerConfig::instance().get<unsigned>("HeartBeatVirtualNodes");
+        auto ring = hashRings.find(serviceName);
+        if (ring == hashRings.end() || ring->second.getVirtualNodes() != std::max(1u, virtualNodes)) {
+            hashRings.erase(serviceName);
+            ring = hashRings.emplace(serviceName, HashRing(virtualNodes)).first;
+        }
+        ring->second.setMembers(hosts);
 
-        *start = segsize * (*index);
-        *end   = segsize * (*index + 1) - 1;
+        hashSegment.ranges = ring->second.getRanges(hostname);
 
-        // Last one take over what is left
-        if (*index == *count - 1)
-            *end += segmod + 1;
+        const HashRing::Range bounds = HashRing::getBounds(hashSegment.ranges);
+        *start = bounds.first;
+        *end   = bounds.second;
 
         this->hashSegment.start = *start;
         this->hashSegment.end   = *end;
 
+        lock.unlock();
+
         if(hashSegment.start == 0)
         {
             // Delete old entries
@@ -2954,7 +3302,7 @@ void MySqlAPI::updateArchivingStateInternal(soci::session& sql, const std::vecto
 
         sql.commit();
 
-        Producer producer(ServerConfig::instance().get<std::string>("MessagingDirectory"));
+        Producer producer(ServerConfig::instance().values().messagingDirectory);
 
         for (auto i = archivingOpStatus.begin(); i < archivingOpStatus.end(); ++i) {
             updateJobTransferStatusInternal(sql, i->jobId, i->state);
@@ -3211,7 +3559,7 @@ void MySqlAPI::updateDeletionsStateInternal(soci::session& sql, const std::vecto
         sql.commit();
 
         //now send monitoring messages
-        Producer producer(ServerConfig::instance().get<std::string>("MessagingDirectory"));
+        Producer producer(ServerConfig::instance().values().messagingDirectory);
         for (auto i = delOpsStatus.begin(); i < delOpsStatus.end(); ++i)
         {
             //send state message
@@ -3247,7 +3595,7 @@ void MySqlAPI::getFilesForDeletion(std::vector<DeleteOperation>& delOps)
     std::vector<fts3::events::MessageBringonline> messages;
     std::vector<MinFileStatus> filesState;
 
-    Consumer consumer(ServerConfig::instance().get<std::string>("MessagingDirectory"));
+    Consumer consumer(ServerConfig::instance().values().messagingDirectory);
 
     try
     {
@@ -3276,8 +3624,7 @@ void MySqlAPI::getFilesForDeletion(std::vector<DeleteOperation>& delOps)
                                        " FROM t_dm "
                                        " WHERE "
                                        "      file_state = 'DELETE' AND "
-                                       "      (hashed_id >= :hStart AND hashed_id <= :hEnd)  ",
-                                       soci::use(hashSegment.start), soci::use(hashSegment.end)
+                                       "      " + hashCondition("hashed_id") + "  "
                                       );
 
 
@@ -3341,9 +3688,8 @@ void MySqlAPI::getFilesForDeletion(std::vector<DeleteOperation>& delOps)
                                              " WHERE "
                                              "  f.file_state = 'DELETE' "
                                              "  AND f.start_time IS NULL and j.job_finished is null "
-                                             "  AND (f.hashed_id >= :hStart AND f.hashed_id <= :hEnd)"
+                                             "  AND " + hashCondition("f.hashed_id") +
                                              "  AND f.vo_name = :vo_name AND f.source_se=:source_se ",
-                                             soci::use(hashSegment.start), soci::use(hashSegment.end),
                                              soci::use(vo_name), soci::use(source_se)
                                          );
 
@@ -3362,12 +3708,11 @@ void MySqlAPI::getFilesForDeletion(std::vector<DeleteOperation>& delOps)
                                                   " WHERE  "
                                                   " f.start_time is NULL "
                                                   " AND f.file_state = 'DELETE' "
-                                                  " AND (f.hashed_id >= :hStart AND f.hashed_id <= :hEnd)"
+                                                  " AND " + hashCondition("f.hashed_id") +
                                                   " AND f.source_se = :source_se  "
                                                   " AND j.user_dn = :user_dn "
                                                   " AND j.vo_name = :vo_name "
                                                   " AND j.job_finished is null  ORDER BY j.submit_time LIMIT :limit ",
-                                                  soci::use(hashSegment.start), soci::use(hashSegment.end),
                                                   soci::use(source_se),
                                                   soci::use(user_dn),
                                                   soci::use(vo_name),
@@ -3402,7 +3747,7 @@ void MySqlAPI::getFilesForDeletion(std::vector<DeleteOperation>& delOps)
             }
             catch(...)
             {
-                Producer producer(ServerConfig::instance().get<std::string>("MessagingDirectory"));
+                Producer producer(ServerConfig::instance().values().messagingDirectory);
                 //save state and restore afterwards
                 if(!filesState.empty())
                 {
@@ -3443,8 +3788,7 @@ void MySqlAPI::requeueStartedDeletes()
         sql <<
             " UPDATE t_dm SET file_state = 'DELETE', start_time = NULL "
             " WHERE file_state = 'STARTED' "
-            "   AND (hashed_id >= :hStart AND hashed_id <= :hEnd)",
-            soci::use(hashSegment.start), soci::use(hashSegment.end)
+            "   AND " + hashCondition("hashed_id")
             ;
         sql.commit();
     }
@@ -3475,8 +3819,7 @@ void MySqlAPI::getFilesForArchiving(std::vector<ArchivingOperation> &archivingOp
                                                    " WHERE "
                                                    "         f.file_state = 'ARCHIVING' AND "
                                                    "         f.archive_start_time IS NULL AND "
-                                                   "      (hashed_id >= :hStart AND hashed_id <= :hEnd)  ",
-                soci::use(hashSegment.start), soci::use(hashSegment.end)
+                                                   "      " + hashCondition("hashed_id") + "  "
         );
 
         for (auto i2 = rs2.begin(); i2 != rs2.end(); ++i2)
@@ -3518,14 +3861,14 @@ void MySqlAPI::getFilesForQosTransition(std::vector<QosTransitionOperation> &qos
               << " INNER JOIN t_credential c ON (j.cred_id = c.dlg_id) "
               << " WHERE "
               << "      f.file_state = :qosOp AND "
-              << "      (hashed_id >= :hStart AND hashed_id <= :hEnd) ";
+              << "      " << hashCondition("hashed_id") << " ";
 
         if (matchHost) {
             query << "AND f.transfer_host = \"" << hostname << "\"";
         }
 
         soci::rowset<soci::row> rs2 = (sql.prepare << query.str(),
-                soci::use(qosOp), soci::use(hashSegment.start), soci::use(hashSegment.end));
+                soci::use(qosOp));
 
         for (auto i2 = rs2.begin(); i2 != rs2.end(); ++i2)
             {
@@ -3705,6 +4048,13 @@ void MySqlAPI::getFilesForStaging(std::vector<StagingOperation> &stagingOps)
     int stagingWaitingFactor = ServerConfig::instance().get<int>("StagingWaitingFactor");
     int maxStagingConcurrentRequests = ServerConfig::instance().get<int>("StagingConcurrentRequests");
 
+    // Files held by the coalescing window are fetched again on every pass,
+    // so fetch enough for a group to reach its target size
+    int maxStagingFetch = maxStagingBulkSize;
+    if (ServerConfig::instance().get<int>("StagingCoalesceWindow") > 0) {
+        maxStagingFetch = std::max(maxStagingFetch, ServerConfig::instance().get<int>("StagingCoalesceSize"));
+    }
+
     try
     {
         //now get fresh states/files from the database
@@ -3713,8 +4063,7 @@ void MySqlAPI::getFilesForStaging(std::vector<StagingOperation> &stagingOps)
             " FROM t_file "
             " WHERE "
             "      file_state = 'STAGING' AND "
-            "      (hashed_id >= :hStart AND hashed_id <= :hEnd)  ",
-            soci::use(hashSegment.start), soci::use(hashSegment.end)
+            "      " + hashCondition("hashed_id") + "  "
         );
 
         for (auto i2 = rs2.begin(); i2 != rs2.end(); ++i2)
@@ -3758,12 +4107,12 @@ void MySqlAPI::getFilesForStaging(std::vector<StagingOperation> &stagingOps)
             }
             else
             {
-                limit = maxStagingBulkSize; // Use a sensible default
+                limit = maxStagingFetch; // Use a sensible default
             }
 
-            // Make sure we do not grab more than the limit for a bulk
-            if (limit > maxStagingBulkSize)
-                limit = maxStagingBulkSize;
+            // Make sure we do not grab more than the limit for a bulk, or a coalesced group
+            if (limit > maxStagingFetch)
+                limit = maxStagingFetch;
 
             //now check for max concurrent active requests, must no exceed the limit
             int countActiveRequests = 0;
@@ -3810,9 +4159,8 @@ void MySqlAPI::getFilesForStaging(std::vector<StagingOperation> &stagingOps)
                                              " FROM t_file f INNER JOIN t_job j ON (f.job_id = j.job_id) "
                                              " WHERE "
                                              "  f.file_state = 'STAGING' "
-                                             "  AND (f.hashed_id >= :hStart AND f.hashed_id <= :hEnd)"
+                                             "  AND " + hashCondition("f.hashed_id") +
                                              "  AND f.vo_name = :vo_name AND f.source_se=:source_se ",
-                                             soci::use(hashSegment.start), soci::use(hashSegment.end),
                                              soci::use(vo_name), soci::use(source_se)
                                          );
 
@@ -3829,12 +4177,12 @@ void MySqlAPI::getFilesForStaging(std::vector<StagingOperation> &stagingOps)
                     "FROM t_file f JOIN t_job j ON f.job_id = j.job_id "
                     "WHERE "
                     "   f.file_state = 'STAGING'"
-                    "   AND f.hashed_id BETWEEN :hStart AND :hEnd "
+                    "   AND " + hashCondition("f.hashed_id") + " "
                     "   AND f.source_se=:source_se "
                     "   AND j.cred_id=:cred_id "
                     "   AND j.vo_name=:vo_name "
+                    "ORDER BY f.file_id "
                     "LIMIT :limit",
-                    soci::use(hashSegment.start), soci::use(hashSegment.end),
                     soci::use(source_se),
                     soci::use(cred_id),
                     soci::use(vo_name),
@@ -3901,8 +4249,7 @@ void MySqlAPI::getAlreadyStartedArchiving(std::vector<ArchivingOperation> &archi
                         " j.archive_timeout >= 0  "
                         " AND f.archive_start_time IS NOT NULL "
                         " AND f.file_state = 'ARCHIVING' "
-                        " AND (f.hashed_id >= :hStart AND f.hashed_id <= :hEnd)",
-                        soci::use(hashSegment.start), soci::use(hashSegment.end)
+                        " AND " + hashCondition("f.hashed_id")
                 );
 
         for (soci::rowset<soci::row>::const_iterator i3 = rs.begin(); i3 != rs.end(); ++i3)
@@ -3958,8 +4305,7 @@ void MySqlAPI::getAlreadyStartedStaging(std::vector<StagingOperation> &stagingOp
             "   AND (bringonline_token = '' OR bringonline_token IS NULL)"
             "   AND start_time IS NOT NULL "
             "   AND staging_start IS NOT NULL "
-            "   AND (hashed_id >= :hStart AND hashed_id <= :hEnd)",
-            soci::use(hashSegment.start), soci::use(hashSegment.end)
+            "   AND " + hashCondition("hashed_id")
             ;
         sql.commit();
 
@@ -3973,8 +4319,7 @@ void MySqlAPI::getAlreadyStartedStaging(std::vector<StagingOperation> &stagingOp
                 " (j.BRING_ONLINE >= 0 OR j.COPY_PIN_LIFETIME >= 0) "
                 " AND f.start_time IS NOT NULL "
                 " AND f.file_state = 'STARTED' "
-                " AND (f.hashed_id >= :hStart AND f.hashed_id <= :hEnd)",
-                soci::use(hashSegment.start), soci::use(hashSegment.end)
+                " AND " + hashCondition("f.hashed_id")
             );
 
         for (soci::rowset<soci::row>::const_iterator i3 = rs3.begin(); i3 != rs3.end(); ++i3)
@@ -4179,7 +4524,7 @@ void MySqlAPI::updateStagingStateInternal(soci::session& sql, const std::vector<
             filesMsg = getStateOfTransferInternal(sql, i->jobId, i->fileId);
             if(!filesMsg.empty())
             {
-                Producer producer(ServerConfig::instance().get<std::string>("MessagingDirectory"));
+                Producer producer(ServerConfig::instance().values().messagingDirectory);
                 for (auto it = filesMsg.begin(); it != filesMsg.end(); ++it)
                 {
                     TransferState tmp = (*it);
@@ -20,8 +20,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <soci/soci.h>
+#include <boost/thread/mutex.hpp>
+#include "db/generic/ConfigSnapshot.h"
 #include "db/generic/GenericDbIfce.h"
+#include "db/generic/HashRing.h"
 #include "db/generic/StoragePairState.h"
 #include "msg-bus/consumer.h"
 #include "msg-bus/producer.h"
@@ -36,10 +41,13 @@ public:
 
     struct HashSegment
     {
+        /// Lowest and highest hash owned, HashRing::NO_HASH if none. Only the host owning 0 has start == 0.
         unsigned start;
         unsigned end;
+        /// Hash ranges owned, which may not be contiguous
+        std::vector<HashRing::Range> ranges;
 
-        HashSegment(): start(0), end(0xFFFF) {}
+        HashSegment(): start(0), end(0xFFFF), ranges(1, HashRing::Range(0, 0xFFFF)) {}
     } hashSegment;
 
     /// Initialize database connection by providing information from fts3config file
@@ -87,6 +95,10 @@ public:
     /// @param jobState         The job state
     virtual bool updateJobStatus(const std::string& jobId, const std::string& jobState);
 
+    /// Bulk version of updateTransferStatus followed by updateJobStatus, for terminal status messages
+    virtual void updateTransferStatuses(const std::vector<fts3::events::Message>& messages,
+            std::vector<StatusUpdateResult>& results);
+
     /// Get the credentials associated with the given delegation ID and user
     /// @param delegationId     Delegation ID. See insertCredentialCache
     /// @param userDn           The user's DN
@@ -112,7 +124,8 @@ public:
     /// @param sourceStorage        The source storage  (as protocol://host)
     /// @param destStorage          The destination storage  (as protocol://host)
     /// @param[out] currentActive   The current number of running transfers is put here
-    virtual bool isTrAllowed(const std::string& sourceStorage, const std::string& destStorage, int &currentActive);
+    virtual bool isTrAllowed(const std::string& sourceStorage, const std::string& destStorage, int &currentActive,
+        int &maxActive);
 
     /// Mark a reuse job (and its files) as failed
     /// @param jobId    The job id
@@ -169,6 +182,14 @@ public:
     /// Update the protocol parameters for this particular transfer
     virtual void updateProtocol(const fts3::events::Message& message);
 
+    /// Move a batch of queued transfers to READY, assigning them to this host,
+    /// and store their protocol parameters, all within a single transaction
+    virtual void claimTransfers(const std::vector<fts3::events::Message>& transfers,
+        std::map<uint64_t, int>& claimed);
+
+    /// Store the pid of a batch of transfers that have been forked
+    virtual void setTransfersPid(const std::vector<fts3::events::MessageUpdater>& transfers);
+
     /// Get the state the transfer identified by jobId/fileId
     virtual std::vector<TransferState> getStateOfTransfer(const std::string& jobId, uint64_t fileId);
 
@@ -203,11 +224,15 @@ public:
     virtual void updateHeartBeat(unsigned* index, unsigned* count, unsigned* start, unsigned* end,
         std::string service_name);
 
+    /// Hash ranges this host processes
+    virtual void getHashSegment(std::vector<std::pair<unsigned, unsigned>> *ranges);
+
     /// Update the state of a transfer inside a session reuse job
     virtual unsigned int updateFileStatusReuse(const TransferFile &file, const std::string &status);
 
-    /// Puts into requestIDs, jobs that have been cancelled, and for which the running fts_url_copy must be killed
-    virtual void getCancelJob(std::vector<int>& requestIDs);
+    /// Puts into canceled the pid and file id of the transfers that have been cancelled,
+    /// and for which the running fts_url_copy must be killed
+    virtual void getCancelJob(std::vector<std::pair<int, uint64_t>>& canceled);
 
     /// Returns list of transfers that need to be force started
     virtual std::list<TransferFile> getForceStartTransfers();
@@ -248,6 +273,20 @@ public:
     /// Puts into the vector queues the Queues for which there are session-reuse pending transfers
     virtual void getQueuesWithSessionReusePending(std::vector<QueueId>& queues);
 
+    /// Puts into counters how many transfers are queued and running for every queue
+    /// @param[out] counters    One entry per queue with SUBMITTED, READY or ACTIVE transfers
+    /// @return                 The highest queue change id at the moment of the query
+    virtual uint64_t getQueueCounters(std::vector<QueueCounters>& counters);
+
+    /// Puts into changes the transfers that entered the SUBMITTED state after the given change,
+    /// either submitted, or updated (staged, next hop or replica, retry...)
+    /// @param afterChangeId    Only changes with a higher id are returned
+    /// @param[out] changes     One entry per change, ordered by id
+    virtual void getQueueChangesSince(uint64_t afterChangeId, std::vector<QueueChange>& changes);
+
+    /// Delete the queue changes older than the given number of seconds
+    virtual void purgeQueueChanges(int olderThan);
+
     /// Updates the status for delete operations
     /// @param delOpsStatus  Update for files in delete or started
     virtual void updateDeletionsState(const std::vector<MinFileStatus>& delOpsStatus);
@@ -336,16 +375,44 @@ private:
     std::string           hostname;
     std::string username_;
     std::map<std::string, boost::posix_time::ptime> queuedStagingFiles;
+    // True if the schema has t_job_file_counters, kept by triggers on t_file
+    bool fileStateCounters;
+    // True if the schema has t_queue_changes, kept by triggers on t_file
+    bool queueChanges;
+
+    // Configuration snapshot, swapped atomically so readers never lock (see getConfigSnapshot)
+    std::shared_ptr<const ConfigSnapshot> configSnapshot;
+    std::atomic<time_t> configCheckedAt;
+    time_t configCheckInterval;
+    // Only held by the thread checking if the configuration changed
+    boost::mutex configCheckMutex;
+    std::string configChecksum;
+
+    /// Current configuration snapshot
+    /// Every ConfigSnapshotCheckInterval seconds, one of the callers verifies if the configuration
+    /// tables changed, and builds a new snapshot if they did. Everyone else keeps using the current one.
+    std::shared_ptr<const ConfigSnapshot> getConfigSnapshot();
+
+    /// Checksum of the configuration tables, used as their version
+    std::string getConfigChecksum(soci::session& sql);
+
+    /// Build a new snapshot from the configuration tables
+    std::shared_ptr<const ConfigSnapshot> loadConfigSnapshot(soci::session& sql, uint64_t version);
+
+    /// Protects hashSegment.ranges and hashRings
+    boost::mutex hashSegmentMutex;
+    /// Hosts alive, per service
+    std::map<std::string, HashRing> hashRings;
 
     void updateHeartBeatInternal(soci::session& sql, unsigned* index, unsigned* count, unsigned* start, unsigned* end,
         std::string serviceName);
 
-    std::map<std::string, int> getFilesNumPerActivity(soci::session& sql,
-        std::string src, std::string dst, std::string vo, int filesNum,
-        std::set<std::string> & defaultActivities);
+    /// SQL condition matching the hash ranges of this host on the given column
+    std::string hashCondition(const std::string &column);
 
-    std::map<std::string, long long> getActivitiesInQueue(soci::session& sql, std::string src,
-        std::string dst, std::string vo);
+    /// Number of queued files per activity, for every pair with files queued for the VO
+    std::map<std::pair<std::string, std::string>, std::map<std::string, long long> >
+        getActivitiesInQueues(soci::session& sql, const std::string &vo);
 
     std::map<std::string, double> getActivityShareConf(soci::session& sql, std::string vo);
 
@@ -387,8 +454,6 @@ private:
 
     int getMaxTimeInQueue(const std::string &voName);
 
-    bool publishUserDnInternal(soci::session& sql, const std::string &vo);
-
     // Sanity checks
     void fixJobNonTerminallAllFilesTerminal(soci::session &sql);
     void fixJobTerminalFileNonTerminal(soci::session &sql);
@@ -400,6 +465,7 @@ private:
     void fixEmptyJob(soci::session &sql, const std::string &jobId);
     void fixNonTerminalJob(soci::session &sql, const std::string &jobId,
         uint64_t filesInJob, uint64_t cancelCount, uint64_t finishedCount, uint64_t failedCount);
+    void fixJobFileCounters(soci::session &sql, const std::string &jobId);
 
     std::vector<std::string> getVos(void);
     void cancelExpiredJobsForVo(std::vector<std::string>& jobs, int maxTime, const std::string &vo);
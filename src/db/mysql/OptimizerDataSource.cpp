@@ -19,6 +19,8 @@
  */
 
 #include <numeric>
+#include <sstream>
+#include <boost/lexical_cast.hpp>
 #include "MySqlAPI.h"
 #include "db/generic/DbUtils.h"
 #include "common/Exceptions.h"
@@ -82,6 +84,112 @@ static void updateOptimizerEvolution(soci::session &sql,
 }
 
 
+// How many decisions are written with a single statement
+static const size_t OPTIMIZER_STORE_BATCH_SIZE = 500;
+
+typedef std::vector<std::map<Pair, PairDecision>::const_iterator> DecisionList;
+
+// Bulk version of setNewOptimizerValue, which also stores the number of streams
+static void setNewOptimizerValues(soci::session &sql, const DecisionList &decisions, size_t begin, size_t end)
+{
+    std::ostringstream query;
+    soci::statement stmt(sql);
+
+    query << "INSERT INTO t_optimizer (source_se, dest_se, active, ema, nostreams, datetime) VALUES ";
+    for (size_t i = begin; i < end; ++i) {
+        const std::string index = boost::lexical_cast<std::string>(i - begin);
+        const Pair &pair = decisions[i]->first;
+        const PairDecision &decision = decisions[i]->second;
+
+        if (i > begin) {
+            query << ", ";
+        }
+        query << "(:source" << index << ", :dest" << index << ", :active" << index
+              << ", :ema" << index << ", :nostreams" << index << ", UTC_TIMESTAMP())";
+
+        stmt.exchange(soci::use(pair.source, "source" + index));
+        stmt.exchange(soci::use(pair.destination, "dest" + index));
+        stmt.exchange(soci::use(decision.decision, "active" + index));
+        stmt.exchange(soci::use(decision.current.ema, "ema" + index));
+        stmt.exchange(soci::use(decision.streams, "nostreams" + index));
+    }
+    query << " ON DUPLICATE KEY UPDATE "
+             "   active = VALUES(active), ema = VALUES(ema), nostreams = VALUES(nostreams), "
+             "   datetime = UTC_TIMESTAMP()";
+
+    try {
+        sql.begin();
+        stmt.alloc();
+        stmt.prepare(query.str());
+        stmt.define_and_bind();
+        stmt.execute(true);
+        sql.commit();
+    }
+    catch (...) {
+        sql.rollback();
+        throw;
+    }
+}
+
+// Bulk version of updateOptimizerEvolution
+static void updateOptimizerEvolutions(soci::session &sql, const DecisionList &decisions, size_t begin, size_t end)
+{
+    try {
+        std::ostringstream query;
+        soci::statement stmt(sql);
+
+        query << "INSERT INTO t_optimizer_evolution "
+            " (datetime, source_se, dest_se, "
+            "  ema, active, throughput, success, "
+            "  filesize_avg, filesize_stddev, "
+            "  actual_active, queue_size, "
+            "  rationale, diff) "
+            " VALUES ";
+        for (size_t i = begin; i < end; ++i) {
+            const std::string index = boost::lexical_cast<std::string>(i - begin);
+            const Pair &pair = decisions[i]->first;
+            const PairDecision &decision = decisions[i]->second;
+
+            if (i > begin) {
+                query << ", ";
+            }
+            query << "(UTC_TIMESTAMP(), :source" << index << ", :dest" << index << ", "
+                  << ":ema" << index << ", :active" << index << ", :throughput" << index << ", :success" << index << ", "
+                  << ":filesize_avg" << index << ", :filesize_stddev" << index << ", "
+                  << ":actual_active" << index << ", :queue_size" << index << ", "
+                  << ":rationale" << index << ", :diff" << index << ")";
+
+            stmt.exchange(soci::use(pair.source, "source" + index));
+            stmt.exchange(soci::use(pair.destination, "dest" + index));
+            stmt.exchange(soci::use(decision.current.ema, "ema" + index));
+            stmt.exchange(soci::use(decision.decision, "active" + index));
+            stmt.exchange(soci::use(decision.current.throughput, "throughput" + index));
+            stmt.exchange(soci::use(decision.current.successRate, "success" + index));
+            stmt.exchange(soci::use(decision.current.filesizeAvg, "filesize_avg" + index));
+            stmt.exchange(soci::use(decision.current.filesizeStdDev, "filesize_stddev" + index));
+            stmt.exchange(soci::use(decision.current.activeCount, "actual_active" + index));
+            stmt.exchange(soci::use(decision.current.queueSize, "queue_size" + index));
+            stmt.exchange(soci::use(decision.rationale, "rationale" + index));
+            stmt.exchange(soci::use(decision.diff, "diff" + index));
+        }
+
+        sql.begin();
+        stmt.alloc();
+        stmt.prepare(query.str());
+        stmt.define_and_bind();
+        stmt.execute(true);
+        sql.commit();
+    }
+    catch (std::exception &e) {
+        sql.rollback();
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not update the optimizer evolution: " << e.what() << commit;
+    }
+    catch (...) {
+        sql.rollback();
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not update the optimizer evolution: unknown reason" << commit;
+    }
+}
+
 // Count how many files are in the given state for the given pair
 // Only non terminal!
 static int getCountInState(soci::session &sql, const Pair &pair, const std::string &state)
@@ -96,6 +204,37 @@ static int getCountInState(soci::session &sql, const Pair &pair, const std::stri
 }
 
 
+// Limits configured for a storage, as used by the optimizer
+struct StorageOptimizerLimits {
+    int inboundMaxActive, outboundMaxActive;
+    double inboundMaxThroughput, outboundMaxThroughput;
+};
+
+// Link configuration, as used by the optimizer
+struct LinkOptimizerConfig {
+    OptimizerMode mode;
+    bool rangeSet;
+    int minActive, maxActive;
+};
+
+// Pick the configuration for the pair, from the most specific to the least one
+// Returns NULL if there is none
+template <typename T>
+static const T* findLinkConfig(const std::map<Pair, T> &configs, const Pair &pair, bool *specific)
+{
+    const Pair candidates[] = {
+        pair, Pair(pair.source, "*"), Pair("*", pair.destination), Pair("*", "*")
+    };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i) {
+        auto config = configs.find(candidates[i]);
+        if (config != configs.end()) {
+            *specific = (i < 3);
+            return &config->second;
+        }
+    }
+    return NULL;
+}
+
 class MySqlOptimizerDataSource: public OptimizerDataSource {
 private:
     soci::session sql;
@@ -380,6 +519,181 @@ public:
 
         sql.commit();
     }
+
+    void getPairsData(std::map<Pair, PairData> *pairs) {
+        const time_t now = time(NULL);
+
+        // Pairs with active or submitted transfers, and how many of each
+        soci::rowset<soci::row> counts = (sql.prepare <<
+            "SELECT source_se, dest_se, file_state, COUNT(*) AS total "
+            "FROM t_file "
+            "WHERE file_state IN ('ACTIVE', 'SUBMITTED') "
+            "GROUP BY source_se, dest_se, file_state "
+            "ORDER BY NULL"
+        );
+        for (auto i = counts.begin(); i != counts.end(); ++i) {
+            PairData &data = (*pairs)[Pair(i->get<std::string>("source_se"), i->get<std::string>("dest_se"))];
+            data.current.timestamp = now;
+            if (i->get<std::string>("file_state") == "ACTIVE") {
+                data.current.activeCount = i->get<long long>("total");
+            }
+            else {
+                data.current.queueSize = i->get<long long>("total");
+            }
+        }
+
+        if (pairs->empty()) {
+            return;
+        }
+
+        // Configuration
+        std::map<std::string, StorageOptimizerLimits> storageLimits;
+        soci::rowset<soci::row> storages = (sql.prepare <<
+            "SELECT storage, inbound_max_active, inbound_max_throughput, outbound_max_active, outbound_max_throughput "
+            "FROM t_se"
+        );
+        for (auto i = storages.begin(); i != storages.end(); ++i) {
+            StorageOptimizerLimits &limits = storageLimits[i->get<std::string>("storage")];
+            limits.inboundMaxActive = i->get<int>("inbound_max_active", 0);
+            limits.outboundMaxActive = i->get<int>("outbound_max_active", 0);
+            limits.inboundMaxThroughput = i->get<double>("inbound_max_throughput", 0);
+            limits.outboundMaxThroughput = i->get<double>("outbound_max_throughput", 0);
+        }
+
+        std::map<Pair, LinkOptimizerConfig> linkConfigs;
+        soci::rowset<soci::row> links = (sql.prepare <<
+            "SELECT source_se, dest_se, optimizer_mode, min_active, max_active FROM t_link_config"
+        );
+        for (auto i = links.begin(); i != links.end(); ++i) {
+            LinkOptimizerConfig &config = linkConfigs[Pair(i->get<std::string>("source_se"), i->get<std::string>("dest_se"))];
+            config.mode = i->get<OptimizerMode>("optimizer_mode", kOptimizerDisabled);
+            config.rangeSet = (i->get_indicator("min_active") != soci::i_null &&
+                i->get_indicator("max_active") != soci::i_null);
+            config.minActive = i->get<int>("min_active", 0);
+            config.maxActive = i->get<int>("max_active", 0);
+        }
+
+        // Previous decisions
+        soci::rowset<soci::row> optimizer = (sql.prepare <<
+            "SELECT source_se, dest_se, active FROM t_optimizer"
+        );
+        for (auto i = optimizer.begin(); i != optimizer.end(); ++i) {
+            auto data = pairs->find(Pair(i->get<std::string>("source_se"), i->get<std::string>("dest_se")));
+            if (data != pairs->end()) {
+                data->second.previousValue = i->get<int>("active", 0);
+            }
+        }
+
+        // Running transfers
+        static struct tm nulltm = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+        std::map<std::string, double> throughputAsSource, throughputAsDestination;
+        soci::rowset<soci::row> active = (sql.prepare <<
+            "SELECT source_se, dest_se, start_time, transferred, filesize, throughput "
+            "FROM t_file "
+            "WHERE file_state = 'ACTIVE'"
+        );
+        for (auto i = active.begin(); i != active.end(); ++i) {
+            const Pair pair(i->get<std::string>("source_se"), i->get<std::string>("dest_se"));
+            const double throughput = i->get<double>("throughput", 0);
+            throughputAsSource[pair.source] += throughput;
+            throughputAsDestination[pair.destination] += throughput;
+
+            auto data = pairs->find(pair);
+            if (data == pairs->end()) {
+                continue;
+            }
+
+            auto starttm = i->get<struct tm>("start_time", nulltm);
+            RunningTransfer transfer;
+            transfer.start = timegm(&starttm);
+            transfer.transferred = i->get<long long>("transferred", 0);
+            transfer.filesize = i->get<long long>("filesize", 0);
+            data->second.running.push_back(transfer);
+        }
+
+        // Put everything together
+        for (auto i = pairs->begin(); i != pairs->end(); ++i) {
+            const Pair &pair = i->first;
+            PairData &data = i->second;
+
+            bool specific = false;
+            const LinkOptimizerConfig *link = findLinkConfig(linkConfigs, pair, &specific);
+            data.optMode = link ? link->mode : kOptimizerConservative;
+            if (link) {
+                data.range.specific = specific;
+                if (link->rangeSet) {
+                    data.range.min = link->minActive;
+                    data.range.max = link->maxActive;
+                }
+            }
+
+            auto source = storageLimits.find(pair.source);
+            if (source == storageLimits.end()) {
+                source = storageLimits.find("*");
+            }
+            if (source != storageLimits.end()) {
+                data.limits.source = source->second.outboundMaxActive;
+                data.limits.throughputSource = source->second.outboundMaxThroughput;
+            }
+            auto destination = storageLimits.find(pair.destination);
+            if (destination == storageLimits.end()) {
+                destination = storageLimits.find("*");
+            }
+            if (destination != storageLimits.end()) {
+                data.limits.destination = destination->second.inboundMaxActive;
+                data.limits.throughputDestination = destination->second.inboundMaxThroughput;
+            }
+
+            data.throughputAsSource = throughputAsSource[pair.source];
+            data.throughputAsDestination = throughputAsDestination[pair.destination];
+        }
+    }
+
+    void getTerminatedSince(time_t since, std::vector<TerminatedTransfer> *transfers) {
+        static struct tm nulltm = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+        struct tm sinceTm;
+        gmtime_r(&since, &sinceTm);
+
+        soci::rowset<soci::row> terminated = (sql.prepare <<
+            "SELECT file_id, source_se, dest_se, file_state, start_time, finish_time, "
+            "   filesize, tx_duration, retry, current_failures AS recoverable "
+            "FROM t_file USE INDEX(idx_finish_time) "
+            "WHERE finish_time >= :since AND file_state <> 'NOT_USED'",
+            soci::use(sinceTm)
+        );
+        for (auto i = terminated.begin(); i != terminated.end(); ++i) {
+            TerminatedTransfer transfer(i->get<unsigned long long>("file_id"),
+                Pair(i->get<std::string>("source_se"), i->get<std::string>("dest_se")),
+                i->get<std::string>("file_state", ""));
+
+            auto starttm = i->get<struct tm>("start_time", nulltm);
+            auto endtm = i->get<struct tm>("finish_time", nulltm);
+            transfer.start = timegm(&starttm);
+            transfer.end = timegm(&endtm);
+            transfer.filesize = i->get<long long>("filesize", 0);
+            transfer.txDuration = i->get<double>("tx_duration", 0);
+            transfer.retry = i->get<int>("retry", 0);
+            transfer.recoverable = i->get<bool>("recoverable", false);
+            transfers->push_back(transfer);
+        }
+    }
+
+    void storeOptimizerDecisions(const std::map<Pair, PairDecision> &decisions) {
+        std::vector<std::map<Pair, PairDecision>::const_iterator> stored;
+        for (auto i = decisions.begin(); i != decisions.end(); ++i) {
+            if (i->second.store) {
+                stored.push_back(i);
+            }
+        }
+
+        for (size_t begin = 0; begin < stored.size(); begin += OPTIMIZER_STORE_BATCH_SIZE) {
+            const size_t end = std::min(begin + OPTIMIZER_STORE_BATCH_SIZE, stored.size());
+            setNewOptimizerValues(sql, stored, begin, end);
+            updateOptimizerEvolutions(sql, stored, begin, end);
+        }
+    }
 };
 
 
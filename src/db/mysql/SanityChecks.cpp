@@ -89,9 +89,69 @@ void MySqlAPI::fixNonTerminalJob(soci::session &sql, const std::string &jobId,
 }
 
 
+/// Non zero file state counters of a job
+static std::map<std::string, long long> getJobFileCounters(soci::session &sql, const std::string &jobId,
+    bool forUpdate = false)
+{
+    std::map<std::string, long long> counters;
+    soci::rowset<soci::row> rs = (sql.prepare <<
+        "SELECT file_state, n_files FROM t_job_file_counters WHERE job_id = :jobId" <<
+        (forUpdate ? " FOR UPDATE" : ""),
+        soci::use(jobId)
+    );
+    for (auto i = rs.begin(); i != rs.end(); ++i) {
+        long long count = i->get<int>("n_files");
+        if (count != 0) {
+            counters[i->get<std::string>("file_state")] = count;
+        }
+    }
+    return counters;
+}
+
+
+/// Rebuild the file state counters of a job from its files
+void MySqlAPI::fixJobFileCounters(soci::session &sql, const std::string &jobId)
+{
+    sql.begin();
+
+    // Locking the files of the job holds their transitions, and so the triggers, meanwhile
+    std::map<std::string, long long> stateCount;
+    soci::rowset<soci::row> fileStates = (sql.prepare <<
+        "SELECT file_state, COUNT(*) AS cnt "
+        "FROM t_file "
+        "WHERE job_id = :jobId "
+        "GROUP BY file_state "
+        "FOR UPDATE",
+        soci::use(jobId)
+    );
+    for (auto i = fileStates.begin(); i != fileStates.end(); ++i) {
+        stateCount[i->get<std::string>("file_state")] = i->get<long long>("cnt");
+    }
+
+    // The difference may have been a transition in between the two reads of the check
+    if (getJobFileCounters(sql, jobId, true) == stateCount) {
+        sql.commit();
+        return;
+    }
+
+    sql << "DELETE FROM t_job_file_counters WHERE job_id = :jobId", soci::use(jobId);
+    for (auto i = stateCount.begin(); i != stateCount.end(); ++i) {
+        int count = static_cast<int>(i->second);
+        sql << "INSERT INTO t_job_file_counters (job_id, file_state, n_files) VALUES (:jobId, :state, :count)",
+            soci::use(jobId), soci::use(i->first), soci::use(count);
+    }
+    sql.commit();
+
+    logInconsistency(jobId, "The file state counters did not match the files");
+}
+
+
 /// Search for jobs in non terminal state for which all transfers are in terminal
+/// Also verifies their file state counters
 void MySqlAPI::fixJobNonTerminallAllFilesTerminal(soci::session &sql)
 {
+    std::vector<std::string> driftedCounters;
+
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Sanity check non terminal jobs with all transfers terminal" << commit;
 
     sql.begin();
@@ -126,6 +186,10 @@ void MySqlAPI::fixJobNonTerminallAllFilesTerminal(soci::session &sql)
             filesInJob += count;
         }
 
+        if (fileStateCounters && getJobFileCounters(sql, jobId) != stateCount) {
+            driftedCounters.push_back(jobId);
+        }
+
         // Fix empty jobs
         if (filesInJob == 0) {
             fixEmptyJob(sql, jobId);
@@ -171,6 +235,10 @@ void MySqlAPI::fixJobNonTerminallAllFilesTerminal(soci::session &sql)
         }
     }
     sql.commit();
+
+    for (auto i = driftedCounters.begin(); i != driftedCounters.end(); ++i) {
+        fixJobFileCounters(sql, *i);
+    }
 }
 
 /// Search for jobs in terminal state with files still in non terminal
@@ -234,7 +302,7 @@ void MySqlAPI::fixDeleteInconsistencies(soci::session &sql)
 void MySqlAPI::recoverFromDeadHosts(soci::session &sql)
 {
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Sanity check from dead hosts" << commit;
-    Producer producer(ServerConfig::instance().get<std::string>("MessagingDirectory"));
+    Producer producer(ServerConfig::instance().values().messagingDirectory);
 
     soci::rowset<std::string> deadHosts = (
         sql.prepare <<
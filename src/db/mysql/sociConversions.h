@@ -171,6 +171,13 @@ struct type_conversion<TransferFile>
             // optional
         }
 
+        try {
+            file.activity = v.get<std::string>("activity", "");
+        }
+        catch (...) {
+            // optional
+        }
+
         // filesize and reason are NOT queried by any method that uses this
         // type
         file.filesize = 0;
@@ -0,0 +1,64 @@
+--
+-- FTS3 Schema 8.1.0
+-- Number of files of each job per state, kept up to date by triggers on t_file,
+-- so the job state can be recomputed without counting the files of the job.
+-- Log of the transfers entering the queue, followed by the scheduler queue index.
+--
+-- With binary logging enabled, creating the triggers requires the SUPER privilege,
+-- or log_bin_trust_function_creators set
+--
+
+CREATE TABLE IF NOT EXISTS `t_job_file_counters` (
+  `job_id` char(36) NOT NULL,
+  `file_state` enum('STAGING','ARCHIVING','QOS_TRANSITION','QOS_REQUEST_SUBMITTED','STARTED','SUBMITTED','READY','ACTIVE','FINISHED','FAILED','CANCELED','NOT_USED','ON_HOLD','ON_HOLD_STAGING','FORCE_START') NOT NULL,
+  `n_files` int(11) NOT NULL DEFAULT '0',
+  PRIMARY KEY (`job_id`,`file_state`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1;
+
+DROP TRIGGER IF EXISTS `t_file_counters_insert`;
+DROP TRIGGER IF EXISTS `t_file_counters_update`;
+
+CREATE TRIGGER `t_file_counters_insert` AFTER INSERT ON `t_file` FOR EACH ROW
+    INSERT INTO t_job_file_counters (job_id, file_state, n_files)
+    VALUES (NEW.job_id, NEW.file_state, 1)
+    ON DUPLICATE KEY UPDATE n_files = n_files + 1;
+
+CREATE TRIGGER `t_file_counters_update` AFTER UPDATE ON `t_file` FOR EACH ROW
+    INSERT INTO t_job_file_counters (job_id, file_state, n_files)
+        SELECT NEW.job_id, NEW.file_state, 1 FROM DUAL WHERE NEW.file_state <> OLD.file_state
+        UNION ALL
+        SELECT OLD.job_id, OLD.file_state, -1 FROM DUAL WHERE NEW.file_state <> OLD.file_state
+    ON DUPLICATE KEY UPDATE n_files = n_files + VALUES(n_files);
+
+-- Counters of the existing jobs. Transitions happening meanwhile are fixed by the sanity checks.
+INSERT INTO t_job_file_counters (job_id, file_state, n_files)
+    SELECT job_id, file_state, COUNT(*) FROM t_file GROUP BY job_id, file_state
+    ON DUPLICATE KEY UPDATE n_files = VALUES(n_files);
+
+-- Transfers entering the SUBMITTED state, kept for a while so the scheduler queue index
+-- of every node can follow them. Several triggers for the same event require MySQL 5.7.2
+CREATE TABLE IF NOT EXISTS `t_queue_changes` (
+  `change_id` bigint(20) unsigned NOT NULL AUTO_INCREMENT,
+  `source_se` varchar(255) DEFAULT NULL,
+  `dest_se` varchar(255) DEFAULT NULL,
+  `vo_name` varchar(50) DEFAULT NULL,
+  `changed` timestamp NULL DEFAULT NULL,
+  PRIMARY KEY (`change_id`),
+  KEY `idx_changed` (`changed`)
+) ENGINE=InnoDB DEFAULT CHARSET=latin1;
+
+DROP TRIGGER IF EXISTS `t_file_queue_insert`;
+DROP TRIGGER IF EXISTS `t_file_queue_update`;
+
+CREATE TRIGGER `t_file_queue_insert` AFTER INSERT ON `t_file` FOR EACH ROW
+    INSERT INTO t_queue_changes (source_se, dest_se, vo_name, changed)
+        SELECT NEW.source_se, NEW.dest_se, NEW.vo_name, UTC_TIMESTAMP() FROM DUAL
+        WHERE NEW.file_state = 'SUBMITTED';
+
+CREATE TRIGGER `t_file_queue_update` AFTER UPDATE ON `t_file` FOR EACH ROW
+    INSERT INTO t_queue_changes (source_se, dest_se, vo_name, changed)
+        SELECT NEW.source_se, NEW.dest_se, NEW.vo_name, UTC_TIMESTAMP() FROM DUAL
+        WHERE NEW.file_state = 'SUBMITTED' AND OLD.file_state <> 'SUBMITTED';
+
+INSERT INTO t_schema_vers (major, minor, patch, message)
+VALUES (8, 1, 0, 'FTS v3.13.0 job file state counters and queue changes');
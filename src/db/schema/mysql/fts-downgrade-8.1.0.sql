@@ -0,0 +1,17 @@
+--
+-- Script to downgrade from FTS3 Schema 8.1.0 to the previous schema (8.0.1)
+--
+
+DROP TRIGGER IF EXISTS `t_file_counters_insert`;
+DROP TRIGGER IF EXISTS `t_file_counters_update`;
+
+DROP TABLE IF EXISTS `t_job_file_counters`;
+
+DROP TRIGGER IF EXISTS `t_file_queue_insert`;
+DROP TRIGGER IF EXISTS `t_file_queue_update`;
+
+DROP TABLE IF EXISTS `t_queue_changes`;
+
+-- Update schema version number
+DELETE FROM t_schema_vers WHERE major = 8 AND minor = 1;
+UPDATE t_schema_vers SET message = 'Downgrade from 8.1.0' WHERE major = 8 AND minor = 0 AND patch = 1;
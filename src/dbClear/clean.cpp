@@ -40,7 +40,10 @@ static void initializeDbBackend()
     std::string dbPassword = ServerConfig::instance().get<std::string>("DbPassword");
     std::string dbConnectString = ServerConfig::instance().get<std::string>("DbConnectString");
 
-    db::DBSingleton::instance().getDBObjectInstance()->init(dbUserName, dbPassword, dbConnectString, 1);
+    // One connection per backup worker, plus one for the heartbeat
+    int connections = ServerConfig::instance().get<int>("CleanThreads") + 1;
+
+    db::DBSingleton::instance().getDBObjectInstance()->init(dbUserName, dbPassword, dbConnectString, connections);
 }
 
 
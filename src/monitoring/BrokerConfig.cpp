@@ -15,6 +15,7 @@
  */
 
 #include "BrokerConfig.h"
+#include <algorithm>
 #include <fstream>
 #include "config/ServerConfig.h"
 
@@ -121,6 +122,11 @@ BrokerConfig::BrokerConfig(const std::string &path)
         po::value<std::string>()->default_value("transfer.fts_monitoring_queue_state"),
         "Destination for optimizer messages"
     )
+    (
+        "BATCH_SIZE",
+        po::value<int>()->default_value(100),
+        "Maximum number of messages sent within a single transaction"
+    )
     ;
 
     std::ifstream in(path.c_str());
@@ -221,6 +227,12 @@ int BrokerConfig::GetTTL() const
 }
 
 
+int BrokerConfig::GetBatchSize() const
+{
+    return std::max(1, vm["BATCH_SIZE"].as<int>());
+}
+
+
 bool BrokerConfig::UseSSL() const
 {
     return vm["SSL"].as<bool>();
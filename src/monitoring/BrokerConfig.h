@@ -65,6 +65,9 @@ public:
     /// Messages time-to-live, in hours
     int GetTTL() const;
 
+    /// Maximum number of messages sent within a single transaction
+    int GetBatchSize() const;
+
     /// If true, enable SSL for the producer
     bool UseSSL() const;
 
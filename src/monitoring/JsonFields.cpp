@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JsonFields.h"
+#include "JsonWriter.h"
+
+
+static void skipSpaces(const std::string &json, size_t &pos)
+{
+    while (pos < json.size() && isspace(static_cast<unsigned char>(json[pos]))) {
+        ++pos;
+    }
+}
+
+
+// pos must be on the opening quote, and is left after the closing one
+static bool skipString(const std::string &json, size_t &pos)
+{
+    for (++pos; pos < json.size(); ++pos) {
+        if (json[pos] == '\\') {
+            ++pos;
+        }
+        else if (json[pos] == '"') {
+            ++pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static bool skipValue(const std::string &json, size_t &pos)
+{
+    if (pos >= json.size()) {
+        return false;
+    }
+
+    if (json[pos] == '"') {
+        return skipString(json, pos);
+    }
+
+    if (json[pos] == '{' || json[pos] == '[') {
+        int depth = 0;
+        while (pos < json.size()) {
+            const char c = json[pos];
+            if (c == '"') {
+                if (!skipString(json, pos)) {
+                    return false;
+                }
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                ++depth;
+            }
+            else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    ++pos;
+                    return true;
+                }
+            }
+            ++pos;
+        }
+        return false;
+    }
+
+    // Number, true, false or null
+    const size_t start = pos;
+    while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' &&
+           !isspace(static_cast<unsigned char>(json[pos]))) {
+        ++pos;
+    }
+    return pos > start;
+}
+
+
+// Look for key among the top level fields of the object
+// On success, objectEnd points to the closing brace, and if found, [valueBegin, valueEnd) to the value
+static bool scanObject(const std::string &json, const std::string &key,
+    bool *found, size_t *valueBegin, size_t *valueEnd, size_t *objectEnd, bool *empty)
+{
+    *found = false;
+    *empty = true;
+
+    size_t pos = 0;
+    skipSpaces(json, pos);
+    if (pos >= json.size() || json[pos] != '{') {
+        return false;
+    }
+    ++pos;
+
+    while (true) {
+        skipSpaces(json, pos);
+        if (pos >= json.size()) {
+            return false;
+        }
+        if (json[pos] == '}') {
+            *objectEnd = pos;
+            return true;
+        }
+        if (json[pos] != '"') {
+            return false;
+        }
+
+        const size_t keyBegin = pos + 1;
+        if (!skipString(json, pos)) {
+            return false;
+        }
+        const size_t keyEnd = pos - 1;
+
+        skipSpaces(json, pos);
+        if (pos >= json.size() || json[pos] != ':') {
+            return false;
+        }
+        ++pos;
+        skipSpaces(json, pos);
+
+        const size_t begin = pos;
+        if (!skipValue(json, pos)) {
+            return false;
+        }
+        *empty = false;
+
+        if (!*found && json.compare(keyBegin, keyEnd - keyBegin, key) == 0) {
+            *found = true;
+            *valueBegin = begin;
+            *valueEnd = pos;
+        }
+
+        skipSpaces(json, pos);
+        if (pos < json.size() && json[pos] == ',') {
+            ++pos;
+        }
+    }
+}
+
+
+bool getJsonRawField(const std::string &json, const std::string &key, std::string *value)
+{
+    bool found, empty;
+    size_t valueBegin, valueEnd, objectEnd;
+
+    if (!scanObject(json, key, &found, &valueBegin, &valueEnd, &objectEnd, &empty) || !found) {
+        return false;
+    }
+    value->assign(json, valueBegin, valueEnd - valueBegin);
+    return true;
+}
+
+
+std::string getJsonField(const std::string &json, const std::string &key)
+{
+    std::string raw;
+    if (!getJsonRawField(json, key, &raw)) {
+        return std::string();
+    }
+    if (raw.size() < 2 || raw[0] != '"') {
+        return raw;
+    }
+
+    std::string value;
+    value.reserve(raw.size() - 2);
+    for (size_t i = 1; i < raw.size() - 1; ++i) {
+        if (raw[i] != '\\' || i + 1 >= raw.size() - 1) {
+            value.push_back(raw[i]);
+            continue;
+        }
+        switch (raw[++i]) {
+            case 'b': value.push_back('\b'); break;
+            case 'f': value.push_back('\f'); break;
+            case 'n': value.push_back('\n'); break;
+            case 'r': value.push_back('\r'); break;
+            case 't': value.push_back('\t'); break;
+            case 'u':
+                // Only used here for control characters, which are not worth decoding
+                value.push_back('?');
+                i += 4;
+                break;
+            default:
+                value.push_back(raw[i]);
+        }
+    }
+    return value;
+}
+
+
+bool setJsonRawField(std::string &json, const std::string &key, const std::string &rawValue)
+{
+    bool found, empty;
+    size_t valueBegin, valueEnd, objectEnd;
+
+    if (!scanObject(json, key, &found, &valueBegin, &valueEnd, &objectEnd, &empty)) {
+        return false;
+    }
+
+    if (found) {
+        json.replace(valueBegin, valueEnd - valueBegin, rawValue);
+    }
+    else {
+        std::string field;
+        field.reserve(key.size() + rawValue.size() + 4);
+        if (!empty) {
+            field.push_back(',');
+        }
+        JsonWriter::appendQuoted(field, key);
+        field.push_back(':');
+        field.append(rawValue);
+        json.insert(objectEnd, field);
+    }
+    return true;
+}
+
+
+bool setJsonField(std::string &json, const std::string &key, const std::string &value)
+{
+    std::string quoted;
+    JsonWriter::appendQuoted(quoted, value);
+    return setJsonRawField(json, key, quoted);
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef JSONFIELDS_H
+#define JSONFIELDS_H
+
+#include <string>
+
+// Access to the top level fields of a serialized JSON object, without parsing it into a document.
+// Nested values are skipped over, so their content never matches a top level key.
+
+/// Raw text of the value of key
+/// @return false if json is not an object, or key is not there
+bool getJsonRawField(const std::string &json, const std::string &key, std::string *value);
+
+/// Value of key, unquoted if it is a string
+/// @return An empty string if not found
+std::string getJsonField(const std::string &json, const std::string &key);
+
+/// Set key to the raw JSON value, replacing the existing value in place or appending it at the end
+/// @return false if json is not an object
+bool setJsonRawField(std::string &json, const std::string &key, const std::string &rawValue);
+
+/// Set key to the string value
+/// @return false if json is not an object
+bool setJsonField(std::string &json, const std::string &key, const std::string &value);
+
+#endif // JSONFIELDS_H
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <stdint.h>
+
+
+/// Writes a flat JSON object straight into a string, without building a document first.
+/// The output is compact: no white space between tokens.
+class JsonWriter
+{
+public:
+    /// Start the object at the end of out
+    explicit JsonWriter(std::string &out): out(out), first(true) {
+        out.push_back('{');
+    }
+
+    /// Close the object
+    void end() {
+        out.push_back('}');
+    }
+
+    JsonWriter &add(const char *key, const std::string &value) {
+        appendKey(key);
+        appendQuoted(out, value);
+        return *this;
+    }
+
+    JsonWriter &add(const char *key, const char *value) {
+        return add(key, std::string(value));
+    }
+
+    JsonWriter &add(const char *key, bool value) {
+        appendKey(key);
+        out.append(value ? "true" : "false");
+        return *this;
+    }
+
+    JsonWriter &add(const char *key, int value) {
+        return addInteger(key, static_cast<int64_t>(value));
+    }
+
+    JsonWriter &add(const char *key, unsigned value) {
+        return addInteger(key, static_cast<uint64_t>(value));
+    }
+
+    JsonWriter &add(const char *key, long value) {
+        return addInteger(key, static_cast<int64_t>(value));
+    }
+
+    JsonWriter &add(const char *key, unsigned long value) {
+        return addInteger(key, static_cast<uint64_t>(value));
+    }
+
+    JsonWriter &add(const char *key, long long value) {
+        return addInteger(key, static_cast<int64_t>(value));
+    }
+
+    JsonWriter &add(const char *key, unsigned long long value) {
+        return addInteger(key, static_cast<uint64_t>(value));
+    }
+
+    JsonWriter &add(const char *key, double value) {
+        appendKey(key);
+        if (!std::isfinite(value)) {
+            out.append("null");
+        }
+        else {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%.17g", value);
+            out.append(buffer);
+        }
+        return *this;
+    }
+
+    /// value must already be valid JSON
+    JsonWriter &addRaw(const char *key, const std::string &value) {
+        appendKey(key);
+        out.append(value);
+        return *this;
+    }
+
+    /// Append value to out as a quoted and escaped JSON string
+    static void appendQuoted(std::string &out, const std::string &value) {
+        static const char hex[] = "0123456789abcdef";
+
+        out.reserve(out.size() + value.size() + 2);
+        out.push_back('"');
+        for (auto i = value.begin(); i != value.end(); ++i) {
+            const unsigned char c = *i;
+            switch (c) {
+                case '"': out.append("\\\""); break;
+                case '\\': out.append("\\\\"); break;
+                case '\b': out.append("\\b"); break;
+                case '\f': out.append("\\f"); break;
+                case '\n': out.append("\\n"); break;
+                case '\r': out.append("\\r"); break;
+                case '\t': out.append("\\t"); break;
+                default:
+                    if (c < 0x20) {
+                        out.append("\\u00");
+                        out.push_back(hex[c >> 4]);
+                        out.push_back(hex[c & 0x0f]);
+                    }
+                    else {
+                        out.push_back(c);
+                    }
+            }
+        }
+        out.push_back('"');
+    }
+
+private:
+    std::string &out;
+    bool first;
+
+    void appendKey(const char *key) {
+        if (!first) {
+            out.push_back(',');
+        }
+        first = false;
+        out.push_back('"');
+        out.append(key);
+        out.append("\":");
+    }
+
+    template <typename T>
+    JsonWriter &addInteger(const char *key, T value) {
+        appendKey(key);
+        out.append(std::to_string(value));
+        return *this;
+    }
+};
+
+#endif // JSONWRITER_H
@@ -78,7 +78,10 @@ void MsgPipe::run()
             }
 
             for (auto iter = messages.begin(); iter != messages.end(); ++iter) {
-                ConcurrentQueue::getInstance()->push(*iter);
+                // Back to disk if the broker can not keep up
+                if (!ConcurrentQueue::getInstance()->push(std::move(*iter))) {
+                    producer.runProducerMonitoring(*iter);
+                }
             }
             messages.clear();
         }
@@ -27,10 +27,10 @@
 #include "common/ConcurrentQueue.h"
 #include "common/Exceptions.h"
 
-#include <cajun/json/reader.h>
-#include <cajun/json/writer.h>
 #include <decaf/lang/System.h>
 
+#include "JsonFields.h"
+
 using namespace fts3::config;
 
 
@@ -77,76 +77,52 @@ void MsgProducer::sendMessage(const std::string &rawMsg)
 {
     std::string type = rawMsg.substr(0, 2);
 
-    // Modify on the fly to add the endpoint
-    std::istringstream input(rawMsg.substr(2));
-    json::Object msg;
-    json::Reader::Read(msg, input);
-
-    msg["endpnt"] = json::String(FTSEndpoint);
-
-    if (brokerConfig.PublishFQDN()) {
-        msg["fqdn"] = json::String(FQDN);
+    // Modify on the fly to add the endpoint, without parsing the whole message
+    std::string body(rawMsg, std::min<size_t>(3, rawMsg.size()));
+    if (!setJsonField(body, "endpnt", FTSEndpoint) ||
+        (brokerConfig.PublishFQDN() && !setJsonField(body, "fqdn", FQDN))) {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Dropping malformed message: " << rawMsg << commit;
+        return;
     }
 
-    std::ostringstream output;
-    json::Writer::Write(msg, output);
-
-    FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << type << " " << output.str() << commit;
+    FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << type << " " << body << commit;
     // Add EOT character
-    output << EOT;
+    body.push_back(EOT);
 
     // Create message and set VO attribute if available
-    std::unique_ptr<cms::TextMessage> message(session->createTextMessage(output.str()));
-    auto iVo = msg.Find("vo_name");
-    if (iVo != msg.End()) {
-        message->setStringProperty("vo", json::String(iVo->element).Value());
+    std::unique_ptr<cms::TextMessage> message(session->createTextMessage(body));
+    std::string rawVo;
+    if (getJsonRawField(body, "vo_name", &rawVo)) {
+        message->setStringProperty("vo", getJsonField(body, "vo_name"));
     }
 
     // Route
     if (type == "ST") {
         producer_transfer_started->send(message.get());
-
-        auto transferId = msg.Find("transfer_id");
-        if (transferId != msg.End()) {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Start message: "
-                << json::String(transferId->element).Value()
-                << commit;
-        }
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Start message: "
+            << getJsonField(body, "transfer_id")
+            << commit;
     }
     else if (type == "CO") {
         producer_transfer_completed->send(message.get());
-        auto transferId = msg.Find("tr_id");
-        if (transferId != msg.End()) {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Completion message: "
-                << json::String(transferId->element).Value()
-                << commit;
-        }
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Completion message: "
+            << getJsonField(body, "tr_id")
+            << commit;
     }
     else if (type == "SS") {
         producer_transfer_state->send(message.get());
-
-        auto state = msg.Find("file_state");
-        auto jobId = msg.Find("job_id");
-        auto fileId = msg.Find("file_id");
-        if (jobId != msg.End() && fileId != msg.End()) {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "State change: "
-                << json::String(state->element).Value() << " "
-                << json::String(jobId->element).Value() << "/"
-                << uint64_t(json::Number(fileId->element).Value())
-                << commit;
-        }
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "State change: "
+            << getJsonField(body, "file_state") << " "
+            << getJsonField(body, "job_id") << "/"
+            << getJsonField(body, "file_id")
+            << commit;
     }
     else if (type == "OP") {
         producer_optimizer->send(message.get());
-        auto sourceSe = msg.Find("source_se");
-        auto destSe = msg.Find("dest_se");
-
-        if (sourceSe != msg.End() && destSe != msg.End()) {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Optimizer update: "
-                << json::String(sourceSe->element).Value() << " => "
-                << json::String(destSe->element).Value()
-                << commit;
-        }
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Optimizer update: "
+            << getJsonField(body, "source_se") << " => "
+            << getJsonField(body, "dest_se")
+            << commit;
     }
     else {
         FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Dropping unknown message type: " << type << commit;
@@ -197,7 +173,7 @@ bool MsgProducer::getConnection()
 			//connection->setExceptionListener(this);
 			connection->start();
 
-			session = connection->createSession(cms::Session::AUTO_ACKNOWLEDGE);
+			session = connection->createSession(cms::Session::SESSION_TRANSACTED);
 
 			// Create the destination (Topic or Queue)
 			if (brokerConfig.UseTopics()) {
@@ -269,9 +245,20 @@ void MsgProducer::onException(const cms::CMSException &ex AMQCPP_UNUSED)
 }
 
 
+// Put back on disk messages that did not make it to the broker
+void MsgProducer::requeue(std::vector<std::string> &batch)
+{
+    for (auto i = batch.begin(); i != batch.end(); ++i) {
+        localProducer.runProducerMonitoring(*i);
+    }
+    batch.clear();
+}
+
+
 void MsgProducer::run()
 {
-    std::string msg("");
+    std::vector<std::string> batch;
+    batch.reserve(brokerConfig.GetBatchSize());
 
     while (stopThreads == false) {
         try {
@@ -288,27 +275,33 @@ void MsgProducer::run()
                 }
             }
 
-            //send messages
-            msg = ConcurrentQueue::getInstance()->pop();
-            if (!msg.empty()) {
-                sendMessage(msg);
+            //send messages, committing them together
+            ConcurrentQueue::getInstance()->popBatch(batch, brokerConfig.GetBatchSize(), 1);
+            if (!batch.empty()) {
+                for (auto i = batch.begin(); i != batch.end(); ++i) {
+                    sendMessage(*i);
+                }
+                session->commit();
+                batch.clear();
             }
-            usleep(100);
         }
         catch (cms::CMSException &e) {
-            localProducer.runProducerMonitoring(msg);
+            rollback();
+            requeue(batch);
             FTS3_COMMON_LOGGER_LOG(ERR, e.getMessage());
             connected = false;
             sleep(5);
         }
         catch (std::exception &e) {
-            localProducer.runProducerMonitoring(msg);
+            rollback();
+            requeue(batch);
             FTS3_COMMON_LOGGER_LOG(ERR, e.what());
             connected = false;
             sleep(5);
         }
         catch (...) {
-            localProducer.runProducerMonitoring(msg);
+            rollback();
+            requeue(batch);
             FTS3_COMMON_LOGGER_LOG(CRIT, "Unexpected exception");
             connected = false;
             sleep(5);
@@ -317,6 +310,19 @@ void MsgProducer::run()
 }
 
 
+void MsgProducer::rollback()
+{
+    try {
+        if (session != NULL) {
+            session->rollback();
+        }
+    }
+    catch (...) {
+        // The connection is re-established anyway
+    }
+}
+
+
 void MsgProducer::cleanup()
 {
     delete destination_transfer_started;
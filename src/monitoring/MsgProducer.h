@@ -19,6 +19,8 @@
  */
 
 
+#include <string>
+#include <vector>
 #include <decaf/lang/Thread.h>
 #include <decaf/lang/Runnable.h>
 #include <decaf/util/concurrent/CountDownLatch.h>
@@ -62,6 +64,8 @@ private:
     const BrokerConfig& brokerConfig;
 
     bool getConnection();
+    void rollback();
+    void requeue(std::vector<std::string> &batch);
 
 public:
     MsgProducer(const std::string &localBaseDir, const BrokerConfig& config);
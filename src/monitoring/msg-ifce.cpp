@@ -22,8 +22,10 @@
 #include <iomanip>
 #include <fstream>
 #include <cajun/json/elements.h>
+#include <cajun/json/reader.h>
 #include <cajun/json/writer.h>
 #include "msg-ifce.h"
+#include "JsonWriter.h"
 #include "common/Logger.h"
 
 bool MsgIfce::instanceFlag = false;
@@ -82,14 +84,16 @@ MsgIfce::~MsgIfce()
 }
 
 
-static void set_metadata(json::Object &json, const std::string &key, const std::string &value)
+static void set_metadata(JsonWriter &json, const char *key, const std::string &value)
 {
     if (!value.empty()) {
         try {
             std::istringstream valueStream(value);
             json::UnknownElement metadata;
             json::Reader::Read(metadata, valueStream);
-            json[key] = metadata;
+            std::ostringstream serialized;
+            json::Writer::Write(metadata, serialized);
+            json.addRaw(key, serialized.str());
             return;
         }
         catch (...) {
@@ -97,108 +101,116 @@ static void set_metadata(json::Object &json, const std::string &key, const std::
         }
     }
 
-    json[key] = json::String(value);
+    json.add(key, value);
+}
+
+
+static std::string send(Producer &producer, const std::string &msgStr)
+{
+    int errCode = producer.runProducerMonitoring(msgStr);
+    if (errCode == 0) {
+        return msgStr;
+    }
+    else {
+        char buffer[512];
+        return strerror_r(errCode, buffer, sizeof(buffer));
+    }
 }
 
 
 std::string MsgIfce::SendTransferStartMessage(Producer &producer, const TransferCompleted &tr_started)
 {
-    json::Object message;
-
-    message["transfer_id"] = json::String(tr_started.transfer_id);
-    message["job_id"] = json::String(tr_started.job_id);
-    message["file_id"] = json::Number(tr_started.file_id);
-    message["endpnt"] = json::String(tr_started.endpoint);
-    message["timestamp"] = json::Number(getTimestampMillisecs());
-    message["src_srm_v"] = json::String(tr_started.source_srm_version);
-    message["dest_srm_v"] = json::String(tr_started.destination_srm_version);
-    message["vo"] = json::String(tr_started.vo);
-    message["src_url"] = json::String(tr_started.source_url);
-    message["dst_url"] = json::String(tr_started.dest_url);
-    message["src_hostname"] = json::String(tr_started.source_hostname);
-    message["dst_hostname"] = json::String(tr_started.dest_hostname);
-    message["src_site_name"] = json::String(tr_started.source_site_name);
-    message["dst_site_name"] = json::String(tr_started.dest_site_name);
-    message["t_channel"] = json::String(tr_started.t_channel);
-    message["srm_space_token_src"] = json::String(tr_started.srm_space_token_source);
-    message["srm_space_token_dst"] = json::String(tr_started.srm_space_token_dest);
-    message["user_dn"] = json::String(tr_started.user_dn);
+    std::string msgStr;
+    msgStr.reserve(2048);
+    msgStr.append("ST ");
+    JsonWriter message(msgStr);
+
+    message.add("transfer_id", tr_started.transfer_id);
+    message.add("job_id", tr_started.job_id);
+    message.add("file_id", tr_started.file_id);
+    message.add("endpnt", tr_started.endpoint);
+    message.add("timestamp", getTimestampMillisecs());
+    message.add("src_srm_v", tr_started.source_srm_version);
+    message.add("dest_srm_v", tr_started.destination_srm_version);
+    message.add("vo", tr_started.vo);
+    message.add("src_url", tr_started.source_url);
+    message.add("dst_url", tr_started.dest_url);
+    message.add("src_hostname", tr_started.source_hostname);
+    message.add("dst_hostname", tr_started.dest_hostname);
+    message.add("src_site_name", tr_started.source_site_name);
+    message.add("dst_site_name", tr_started.dest_site_name);
+    message.add("t_channel", tr_started.t_channel);
+    message.add("srm_space_token_src", tr_started.srm_space_token_source);
+    message.add("srm_space_token_dst", tr_started.srm_space_token_dest);
+    message.add("user_dn", tr_started.user_dn);
 
     if (tr_started.file_metadata != "x") {
         set_metadata(message, "file_metadata", tr_started.file_metadata);
     }
     else {
-        message["file_metadata"] = json::String();
+        message.add("file_metadata", "");
     }
 
     set_metadata(message, "job_metadata", tr_started.job_metadata);
 
-    std::ostringstream stream;
+    message.end();
 
-    stream << "ST ";
-    json::Writer::Write(message, stream);
-
-    std::string msgStr = stream.str();
-    int errCode = producer.runProducerMonitoring(msgStr);
-    if (errCode == 0) {
-        return msgStr;
-    }
-    else {
-        char buffer[512];
-        return strerror_r(errCode, buffer, sizeof(buffer));
-    }
+    return send(producer, msgStr);
 }
 
 
 std::string MsgIfce::SendTransferFinishMessage(Producer &producer, const TransferCompleted &tr_completed)
 {
-    json::Object message;
-
-    message["tr_id"] = json::String(tr_completed.transfer_id);
-    message["job_id"] = json::String(tr_completed.job_id);
-    message["file_id"] = json::Number(tr_completed.file_id);
-    message["endpnt"] = json::String(tr_completed.endpoint);
-    message["src_srm_v"] = json::String(tr_completed.source_srm_version);
-    message["dest_srm_v"] = json::String(tr_completed.destination_srm_version);
-    message["vo"] = json::String(tr_completed.vo);
-    message["src_url"] = json::String(tr_completed.source_url);
-    message["dst_url"] = json::String(tr_completed.dest_url);
-    message["src_hostname"] = json::String(tr_completed.source_hostname);
-    message["dst_hostname"] = json::String(tr_completed.dest_hostname);
-    message["src_se"] = json::String(tr_completed.source_se);
-    message["dst_se"] = json::String(tr_completed.dest_se);
-    message["protocol"] = json::String(tr_completed.protocol);
-    message["src_site_name"] = json::String(tr_completed.source_site_name);
-    message["dst_site_name"] = json::String(tr_completed.dest_site_name);
-    message["t_channel"] = json::String(tr_completed.t_channel);
-    message["timestamp_tr_st"] = json::Number(tr_completed.timestamp_transfer_started);
-    message["timestamp_tr_comp"] = json::Number(tr_completed.timestamp_transfer_completed);
-    message["timestamp_chk_src_st"] = json::Number(tr_completed.timestamp_checksum_source_started);
-    message["timestamp_chk_src_ended"] = json::Number(tr_completed.timestamp_checksum_source_ended);
-    message["timestamp_checksum_dest_st"] = json::Number(tr_completed.timestamp_checksum_dest_started);
-    message["timestamp_checksum_dest_ended"] = json::Number(tr_completed.timestamp_checksum_dest_ended);
-    message["t_timeout"] = json::Number(tr_completed.transfer_timeout);
-    message["chk_timeout"] = json::Number(tr_completed.checksum_timeout);
-    message["t_error_code"] = json::Number(tr_completed.transfer_error_code);
-    message["tr_error_scope"] = json::String(tr_completed.transfer_error_scope);
-    message["t_failure_phase"] = json::String(tr_completed.failure_phase);
-    message["tr_error_category"] = json::String(tr_completed.transfer_error_category);
-    message["t_final_transfer_state"] = json::String(tr_completed.final_transfer_state);
-    message["t_final_transfer_state_flag"] = json::Number(tr_completed.final_transfer_state_flag);
-    message["tr_bt_transfered"] = json::Number(tr_completed.total_bytes_transferred);
-    message["nstreams"] = json::Number(tr_completed.number_of_streams);
-    message["buf_size"] = json::Number(tr_completed.tcp_buffer_size);
-    message["tcp_buf_size"] = json::Number(tr_completed.tcp_buffer_size);
-    message["block_size"] = json::Number(tr_completed.block_size);
+    std::string msgStr;
+    msgStr.reserve(2048);
+    msgStr.append("CO ");
+    JsonWriter message(msgStr);
+
+    message.add("tr_id", tr_completed.transfer_id);
+    message.add("job_id", tr_completed.job_id);
+    message.add("file_id", tr_completed.file_id);
+    message.add("endpnt", tr_completed.endpoint);
+    message.add("src_srm_v", tr_completed.source_srm_version);
+    message.add("dest_srm_v", tr_completed.destination_srm_version);
+    message.add("vo", tr_completed.vo);
+    message.add("src_url", tr_completed.source_url);
+    message.add("dst_url", tr_completed.dest_url);
+    message.add("src_hostname", tr_completed.source_hostname);
+    message.add("dst_hostname", tr_completed.dest_hostname);
+    message.add("src_se", tr_completed.source_se);
+    message.add("dst_se", tr_completed.dest_se);
+    message.add("protocol", tr_completed.protocol);
+    message.add("src_site_name", tr_completed.source_site_name);
+    message.add("dst_site_name", tr_completed.dest_site_name);
+    message.add("t_channel", tr_completed.t_channel);
+    message.add("timestamp_tr_st", tr_completed.timestamp_transfer_started);
+    message.add("timestamp_tr_comp", tr_completed.timestamp_transfer_completed);
+    message.add("timestamp_chk_src_st", tr_completed.timestamp_checksum_source_started);
+    message.add("timestamp_chk_src_ended", tr_completed.timestamp_checksum_source_ended);
+    message.add("timestamp_checksum_dest_st", tr_completed.timestamp_checksum_dest_started);
+    message.add("timestamp_checksum_dest_ended", tr_completed.timestamp_checksum_dest_ended);
+    message.add("t_timeout", tr_completed.transfer_timeout);
+    message.add("chk_timeout", tr_completed.checksum_timeout);
+    message.add("t_error_code", tr_completed.transfer_error_code);
+    message.add("tr_error_scope", tr_completed.transfer_error_scope);
+    message.add("t_failure_phase", tr_completed.failure_phase);
+    message.add("tr_error_category", tr_completed.transfer_error_category);
+    message.add("t_final_transfer_state", tr_completed.final_transfer_state);
+    message.add("t_final_transfer_state_flag", tr_completed.final_transfer_state_flag);
+    message.add("tr_bt_transfered", tr_completed.total_bytes_transferred);
+    message.add("nstreams", tr_completed.number_of_streams);
+    message.add("buf_size", tr_completed.tcp_buffer_size);
+    message.add("tcp_buf_size", tr_completed.tcp_buffer_size);
+    message.add("block_size", tr_completed.block_size);
     // Prepare to drop "f_size" field in the future
-    message["f_size"] = json::Number(tr_completed.file_size);
-    message["file_size"] = json::Number(tr_completed.file_size);
-    message["time_srm_prep_st"] = json::Number(tr_completed.time_spent_in_srm_preparation_start);
-    message["time_srm_prep_end"] = json::Number(tr_completed.time_spent_in_srm_preparation_end);
-    message["time_srm_fin_st"] = json::Number(tr_completed.time_spent_in_srm_finalization_start);
-    message["time_srm_fin_end"] = json::Number(tr_completed.time_spent_in_srm_finalization_end);
-    message["srm_space_token_src"] = json::String(tr_completed.srm_space_token_source);
-    message["srm_space_token_dst"] = json::String(tr_completed.srm_space_token_dest);
+    message.add("f_size", tr_completed.file_size);
+    message.add("file_size", tr_completed.file_size);
+    message.add("time_srm_prep_st", tr_completed.time_spent_in_srm_preparation_start);
+    message.add("time_srm_prep_end", tr_completed.time_spent_in_srm_preparation_end);
+    message.add("time_srm_fin_st", tr_completed.time_spent_in_srm_finalization_start);
+    message.add("time_srm_fin_end", tr_completed.time_spent_in_srm_finalization_end);
+    message.add("srm_space_token_src", tr_completed.srm_space_token_source);
+    message.add("srm_space_token_dst", tr_completed.srm_space_token_dest);
 
     std::string temp = ReplaceNonPrintableCharacters(tr_completed.transfer_error_message);
     temp.erase(std::remove(temp.begin(), temp.end(), '\n'), temp.end());
@@ -208,149 +220,128 @@ std::string MsgIfce::SendTransferFinishMessage(Producer &producer, const Transfe
         temp.erase(1024);
     }
 
-    message["t__error_message"] = json::String(temp);
-    message["tr_timestamp_start"] = json::Number(tr_completed.tr_timestamp_start);
+    message.add("t__error_message", temp);
+    message.add("tr_timestamp_start", tr_completed.tr_timestamp_start);
 
     if (tr_completed.tr_timestamp_complete) {
-        message["tr_timestamp_complete"] = json::Number(tr_completed.tr_timestamp_complete);
+        message.add("tr_timestamp_complete", tr_completed.tr_timestamp_complete);
     } else {
-        message["tr_timestamp_complete"] = json::Number(getTimestampMillisecs());
+        message.add("tr_timestamp_complete", getTimestampMillisecs());
     }
 
-    message["transfer_time"] = json::Number(tr_completed.transfer_time_ms);
-    message["operation_time"] = json::Number(tr_completed.operation_time_ms);
-    message["throughput"] = json::Number(tr_completed.throughput_bps);
+    message.add("transfer_time", tr_completed.transfer_time_ms);
+    message.add("operation_time", tr_completed.operation_time_ms);
+    message.add("throughput", tr_completed.throughput_bps);
 
-    message["srm_preparation_time"] = json::Number(tr_completed.srm_preparation_time_ms);
-    message["srm_finalization_time"] = json::Number(tr_completed.srm_finalization_time_ms);
-    message["srm_overhead_time"] = json::Number(tr_completed.srm_overhead_time_ms);
-    message["srm_overhead_percentage"] = json::Number(tr_completed.srm_overhead_percentage);
+    message.add("srm_preparation_time", tr_completed.srm_preparation_time_ms);
+    message.add("srm_finalization_time", tr_completed.srm_finalization_time_ms);
+    message.add("srm_overhead_time", tr_completed.srm_overhead_time_ms);
+    message.add("srm_overhead_percentage", tr_completed.srm_overhead_percentage);
 
-    message["timestamp_checksum_src_diff"] = json::Number(tr_completed.checksum_source_time_ms);
-    message["timestamp_checksum_dst_diff"] = json::Number(tr_completed.checksum_dest_time_ms);
+    message.add("timestamp_checksum_src_diff", tr_completed.checksum_source_time_ms);
+    message.add("timestamp_checksum_dst_diff", tr_completed.checksum_dest_time_ms);
 
-    message["channel_type"] = json::String(tr_completed.channel_type);
-    message["user_dn"] = json::String(tr_completed.user_dn);
+    message.add("preparation_time", tr_completed.preparation_time_ms);
+    message.add("token_retrieval_time", tr_completed.token_retrieval_time_ms);
+    message.add("source_stat_time", tr_completed.source_stat_time_ms);
+    message.add("dest_stat_time", tr_completed.dest_stat_time_ms);
+    message.add("finalization_time", tr_completed.finalization_time_ms);
+
+    message.add("channel_type", tr_completed.channel_type);
+    message.add("user_dn", tr_completed.user_dn);
 
     if (tr_completed.file_metadata != "x") {
         set_metadata(message, "file_metadata", tr_completed.file_metadata);
     }
     else {
-        message["file_metadata"] = json::String("");
+        message.add("file_metadata", "");
     }
 
     set_metadata(message, "job_metadata", tr_completed.job_metadata);
-    message["retry"] = json::Number(tr_completed.retry);
-    message["retry_max"] = json::Number(tr_completed.retry_max);
-    message["job_m_replica"] = json::Boolean(tr_completed.job_m_replica);
-    message["job_multihop"] = json::Boolean(tr_completed.job_multihop);
-    message["transfer_lasthop"] = json::Boolean(tr_completed.is_lasthop);
-    message["job_state"] = json::String(tr_completed.job_state);
-    message["is_recoverable"] = json::Boolean(tr_completed.is_recoverable);
-    message["ipv6"] = json::Boolean(tr_completed.ipv6);
-    message["ipver"] = json::String(tr_completed.ipver);
-    message["eviction_code"] = json::Number(tr_completed.eviction_code);
-    message["final_destination"] = json::String(tr_completed.final_destination);
-    message["transfer_type"] = json::String(tr_completed.transfer_type);
-
-    std::ostringstream stream;
-
-    stream << "CO ";
-    json::Writer::Write(message, stream);
-
-    std::string msgStr = stream.str();
-    int errCode = producer.runProducerMonitoring(msgStr);
-    if (errCode == 0) {
-        return msgStr;
-    }
-    else {
-        char buffer[512];
-        return strerror_r(errCode, buffer, sizeof(buffer));
-    }
+    message.add("retry", tr_completed.retry);
+    message.add("retry_max", tr_completed.retry_max);
+    message.add("job_m_replica", tr_completed.job_m_replica);
+    message.add("job_multihop", tr_completed.job_multihop);
+    message.add("transfer_lasthop", tr_completed.is_lasthop);
+    message.add("job_state", tr_completed.job_state);
+    message.add("is_recoverable", tr_completed.is_recoverable);
+    message.add("ipv6", tr_completed.ipv6);
+    message.add("ipver", tr_completed.ipver);
+    message.add("eviction_code", tr_completed.eviction_code);
+    message.add("final_destination", tr_completed.final_destination);
+    message.add("transfer_type", tr_completed.transfer_type);
+
+    message.end();
+
+    return send(producer, msgStr);
 }
 
 
 std::string MsgIfce::SendTransferStatusChange(Producer &producer, const TransferState &tr_state)
 {
-    json::Object message;
-
-    message["user_dn"] = json::String(tr_state.user_dn);
-    message["src_url"] = json::String(tr_state.source_url);
-    message["dst_url"] = json::String(tr_state.dest_url);
-    message["vo_name"] = json::String(tr_state.vo_name);
-    message["source_se"] = json::String(tr_state.source_se);
-    message["dest_se"] = json::String(tr_state.dest_se);
-    message["job_id"] = json::String(tr_state.job_id);
-    message["file_id"] = json::Number(tr_state.file_id);
-    message["job_state"] = json::String(tr_state.job_state);
-    message["file_state"] = json::String(tr_state.file_state);
-    message["retry_counter"] = json::Number(tr_state.retry_counter);
-    message["retry_max"] = json::Number(tr_state.retry_max);
-    message["user_filesize"] = json::Number(tr_state.user_filesize);
-    message["timestamp"] = json::Number(tr_state.timestamp);
-    message["staging"] = json::Boolean(tr_state.staging);
-    message["staging_start"] = json::Number(tr_state.staging_start);
-    message["staging_finished"] = json::Number(tr_state.staging_finished);
-    message["submit_time"] = json::Number(tr_state.submit_time);
-    message["reason"] = json::String(tr_state.reason);
+    std::string msgStr;
+    msgStr.reserve(2048);
+    msgStr.append("SS ");
+    JsonWriter message(msgStr);
+
+    message.add("user_dn", tr_state.user_dn);
+    message.add("src_url", tr_state.source_url);
+    message.add("dst_url", tr_state.dest_url);
+    message.add("vo_name", tr_state.vo_name);
+    message.add("source_se", tr_state.source_se);
+    message.add("dest_se", tr_state.dest_se);
+    message.add("job_id", tr_state.job_id);
+    message.add("file_id", tr_state.file_id);
+    message.add("job_state", tr_state.job_state);
+    message.add("file_state", tr_state.file_state);
+    message.add("retry_counter", tr_state.retry_counter);
+    message.add("retry_max", tr_state.retry_max);
+    message.add("user_filesize", tr_state.user_filesize);
+    message.add("timestamp", tr_state.timestamp);
+    message.add("staging", tr_state.staging);
+    message.add("staging_start", tr_state.staging_start);
+    message.add("staging_finished", tr_state.staging_finished);
+    message.add("submit_time", tr_state.submit_time);
+    message.add("reason", tr_state.reason);
 
     set_metadata(message, "job_metadata", tr_state.job_metadata);
     set_metadata(message, "file_metadata", tr_state.file_metadata);
 
-    std::ostringstream stream;
+    message.end();
 
-    stream << "SS ";
-    json::Writer::Write(message, stream);
-
-    std::string msgStr = stream.str();
-    int errCode = producer.runProducerMonitoring(msgStr);
-    if (errCode == 0) {
-        return msgStr;
-    }
-    else {
-        char buffer[512];
-        return strerror_r(errCode, buffer, sizeof(buffer));
-    }
+    return send(producer, msgStr);
 }
 
 
 std::string MsgIfce::SendOptimizer(Producer &producer, const OptimizerInfo &opt_info)
 {
-    json::Object message;
+    std::string msgStr;
+    msgStr.reserve(2048);
+    msgStr.append("OP ");
+    JsonWriter message(msgStr);
 
-    message["source_se"] = json::String(opt_info.source_se);
-    message["dest_se"] = json::String(opt_info.dest_se);
-    message["timestamp"] = json::Number(opt_info.timestamp);
+    message.add("source_se", opt_info.source_se);
+    message.add("dest_se", opt_info.dest_se);
+    message.add("timestamp", opt_info.timestamp);
 
-    message["throughput"] = json::Number(opt_info.throughput);
-    message["throughput_ema"] = json::Number(opt_info.ema);
+    message.add("throughput", opt_info.throughput);
+    message.add("throughput_ema", opt_info.ema);
 
-    message["duration_avg"] = json::Number(opt_info.avgDuration);
+    message.add("duration_avg", opt_info.avgDuration);
 
-    message["filesize_avg"] = json::Number(opt_info.filesizeAvg);
-    message["filesize_stddev"] = json::Number(opt_info.filesizeAvg);
+    message.add("filesize_avg", opt_info.filesizeAvg);
+    message.add("filesize_stddev", opt_info.filesizeAvg);
 
-    message["success_rate"] = json::Number(opt_info.successRate);
-    message["retry_count"] = json::Number(opt_info.retryCount);
+    message.add("success_rate", opt_info.successRate);
+    message.add("retry_count", opt_info.retryCount);
 
-    message["active_count"] = json::Number(opt_info.activeCount);
-    message["submitted_count"] = json::Number(opt_info.queueSize);
+    message.add("active_count", opt_info.activeCount);
+    message.add("submitted_count", opt_info.queueSize);
 
-    message["connections"] = json::Number(opt_info.connections);
-    message["rationale"] = json::String(opt_info.rationale);
+    message.add("connections", opt_info.connections);
+    message.add("rationale", opt_info.rationale);
 
-    std::ostringstream stream;
+    message.end();
 
-    stream << "OP ";
-    json::Writer::Write(message, stream);
-
-    std::string msgStr = stream.str();
-    int errCode = producer.runProducerMonitoring(msgStr);
-    if (errCode == 0) {
-        return msgStr;
-    }
-    else {
-        char buffer[512];
-        return strerror_r(errCode, buffer, sizeof(buffer));
-    }
+    return send(producer, msgStr);
 }
@@ -49,6 +49,8 @@ public:
         srm_preparation_time_ms(0), srm_finalization_time_ms(0),
         srm_overhead_time_ms(0), srm_overhead_percentage(0),
         checksum_source_time_ms(0), checksum_dest_time_ms(0),
+        preparation_time_ms(0), token_retrieval_time_ms(0), source_stat_time_ms(0), dest_stat_time_ms(0),
+        finalization_time_ms(0),
         retry(0), retry_max(0),
         job_m_replica(false), job_multihop(false), is_lasthop(false),
         is_recoverable(false), ipv6(false), eviction_code(-1)
@@ -110,6 +112,11 @@ public:
     double      srm_overhead_percentage;
     int64_t     checksum_source_time_ms;
     int64_t     checksum_dest_time_ms;
+    int64_t     preparation_time_ms;
+    int64_t     token_retrieval_time_ms;
+    int64_t     source_stat_time_ms;
+    int64_t     dest_stat_time_ms;
+    int64_t     finalization_time_ms;
     std::string channel_type;
     std::string user_dn;
     std::string file_metadata;
@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/Exceptions.h"
+#include "common/Logger.h"
+
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+    "The ring buffer needs address-free atomics to be shared between processes");
+
+static const uint64_t RING_MAGIC = 0x46545352494e4731ULL; // FTSRING1
+static const uint32_t RING_VERSION = 2;
+
+// How long a slot claimed by an unknown producer is waited for
+static const time_t RING_ABANDONED_TIMEOUT = 60;
+// How long a closed ring buffer is kept, for producers that checked it just before it was closed
+static const time_t RING_CLOSED_GRACE = 5;
+
+
+struct RingHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slotSize;
+    uint32_t generation;
+    // Set by the consumer before the ring buffer is replaced or removed
+    std::atomic<uint32_t> closed;
+    // Times the consumer found the fallback directory queue empty
+    std::atomic<uint64_t> drained;
+    // Next position to be claimed by the producers
+    alignas(64) std::atomic<uint64_t> head;
+    // Next position to be read by the consumer
+    alignas(64) std::atomic<uint64_t> tail;
+};
+
+
+struct RingSlot {
+    // position when free, position + 1 when published, position + slots once consumed
+    std::atomic<uint64_t> sequence;
+    // Producer that claimed the slot, 0 if unknown
+    std::atomic<int32_t> pid;
+    uint32_t length;
+
+    char *payload() {
+        return reinterpret_cast<char*>(this) + sizeof(RingSlot);
+    }
+};
+
+
+static const uint32_t RING_PAYLOAD_SIZE = RingBuffer::SLOT_SIZE - sizeof(RingSlot);
+
+
+static size_t getRingLength(uint32_t slots)
+{
+    return sizeof(RingHeader) + static_cast<size_t>(slots) * RingBuffer::SLOT_SIZE;
+}
+
+
+static std::string getErrorString(int errnum)
+{
+    char buffer[256] = {0};
+    return strerror_r(errnum, buffer, sizeof(buffer));
+}
+
+
+// Map the file, and check it is a valid ring buffer
+static void *mapRing(int fd, size_t *length)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(RingHeader)) {
+        return NULL;
+    }
+
+    void *address = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        return NULL;
+    }
+
+    const RingHeader *header = static_cast<const RingHeader*>(address);
+    if (header->magic != RING_MAGIC || header->version != RING_VERSION ||
+        header->slotSize != RingBuffer::SLOT_SIZE || header->slots == 0 ||
+        (header->slots & (header->slots - 1)) != 0 ||
+        getRingLength(header->slots) != static_cast<size_t>(st.st_size)) {
+        munmap(address, st.st_size);
+        return NULL;
+    }
+
+    *length = st.st_size;
+    return address;
+}
+
+
+RingBuffer::RingBuffer(const std::string &path, void *address, size_t length):
+    path(path), address(address), length(length), header(static_cast<RingHeader*>(address)),
+    stuckPosition(0), stuckSince(0), closedSince(0)
+{
+}
+
+
+RingBuffer::~RingBuffer()
+{
+    munmap(address, length);
+}
+
+
+std::unique_ptr<RingBuffer> RingBuffer::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return std::unique_ptr<RingBuffer>();
+    }
+
+    size_t length = 0;
+    void *address = mapRing(fd, &length);
+    ::close(fd);
+
+    if (!address) {
+        return std::unique_ptr<RingBuffer>();
+    }
+    return std::unique_ptr<RingBuffer>(new RingBuffer(path, address, length));
+}
+
+
+std::unique_ptr<RingBuffer> RingBuffer::create(const std::string &path, uint32_t slots,
+    std::unique_ptr<RingBuffer> *replaced)
+{
+    uint32_t rounded = 1;
+    while (rounded < slots) {
+        rounded <<= 1;
+    }
+
+    uint32_t generation = 1;
+    std::unique_ptr<RingBuffer> existing = open(path);
+    if (existing) {
+        if (existing->getSlots() == rounded && !existing->isClosed()) {
+            return existing;
+        }
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Replacing the ring buffer " << path
+            << " with " << rounded << " slots" << fts3::common::commit;
+        // Producers still using it go to the directory queue until they notice the replacement
+        generation = existing->getGeneration() + 1;
+        existing->close();
+        if (replaced) {
+            *replaced = std::move(existing);
+        }
+    }
+
+    // Build it aside, and move it in place once ready, so producers never see it half initialized
+    const std::string tmpPath = path + ".tmp";
+    const size_t length = getRingLength(rounded);
+
+    int fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw fts3::common::SystemError("Could not create the ring buffer " + tmpPath + ": " + getErrorString(errno));
+    }
+    if (ftruncate(fd, length) < 0) {
+        int errnum = errno;
+        ::close(fd);
+        unlink(tmpPath.c_str());
+        throw fts3::common::SystemError("Could not size the ring buffer " + tmpPath + ": " + getErrorString(errnum));
+    }
+
+    void *address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        int errnum = errno;
+        unlink(tmpPath.c_str());
+        throw fts3::common::SystemError("Could not map the ring buffer " + tmpPath + ": " + getErrorString(errnum));
+    }
+
+    RingHeader *header = new (address) RingHeader;
+    header->version = RING_VERSION;
+    header->slots = rounded;
+    header->slotSize = SLOT_SIZE;
+    header->generation = generation;
+    header->closed.store(0);
+    header->drained.store(0);
+    header->head.store(0);
+    header->tail.store(0);
+
+    std::unique_ptr<RingBuffer> ring(new RingBuffer(path, address, length));
+    for (uint32_t i = 0; i < rounded; ++i) {
+        RingSlot *slot = new (ring->getSlot(i)) RingSlot;
+        slot->sequence.store(i);
+        slot->pid.store(0);
+        slot->length = 0;
+    }
+    header->magic = RING_MAGIC;
+
+    if (rename(tmpPath.c_str(), path.c_str()) < 0) {
+        int errnum = errno;
+        unlink(tmpPath.c_str());
+        throw fts3::common::SystemError("Could not install the ring buffer " + path + ": " + getErrorString(errnum));
+    }
+
+    return ring;
+}
+
+
+RingSlot *RingBuffer::getSlot(uint64_t position) const
+{
+    char *base = static_cast<char*>(address) + sizeof(RingHeader);
+    return reinterpret_cast<RingSlot*>(base + (position & (header->slots - 1)) * SLOT_SIZE);
+}
+
+
+void RingBuffer::close()
+{
+    header->closed.store(1, std::memory_order_release);
+    if (closedSince == 0) {
+        closedSince = time(NULL);
+    }
+}
+
+
+bool RingBuffer::isClosed() const
+{
+    return header->closed.load(std::memory_order_acquire) != 0;
+}
+
+
+bool RingBuffer::isFinished()
+{
+    if (!isClosed()) {
+        return false;
+    }
+
+    // Closed by someone else
+    const time_t now = time(NULL);
+    if (closedSince == 0) {
+        closedSince = now;
+    }
+    if (now - closedSince <= RING_CLOSED_GRACE) {
+        return false;
+    }
+
+    return header->head.load(std::memory_order_acquire) == header->tail.load(std::memory_order_acquire);
+}
+
+
+uint32_t RingBuffer::getGeneration() const
+{
+    return header->generation;
+}
+
+
+void RingBuffer::markDrained()
+{
+    header->drained.fetch_add(1, std::memory_order_release);
+}
+
+
+uint64_t RingBuffer::getDrained() const
+{
+    return header->drained.load(std::memory_order_acquire);
+}
+
+
+uint32_t RingBuffer::getSlots() const
+{
+    return header->slots;
+}
+
+
+const std::string &RingBuffer::getPath() const
+{
+    return path;
+}
+
+
+bool RingBuffer::push(const std::string &frame)
+{
+    if (frame.size() > RING_PAYLOAD_SIZE || isClosed()) {
+        return false;
+    }
+
+    RingSlot *slot = NULL;
+    uint64_t position = header->head.load(std::memory_order_relaxed);
+    while (true) {
+        slot = getSlot(position);
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const int64_t diff = static_cast<int64_t>(sequence - position);
+
+        if (diff == 0) {
+            if (header->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // Full
+            return false;
+        }
+        else {
+            position = header->head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->pid.store(getpid(), std::memory_order_relaxed);
+    memcpy(slot->payload(), frame.data(), frame.size());
+    slot->length = static_cast<uint32_t>(frame.size());
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    return true;
+}
+
+
+bool RingBuffer::isAbandoned(RingSlot *slot, uint64_t position)
+{
+    const pid_t pid = slot->pid.load(std::memory_order_relaxed);
+    if (pid > 0) {
+        return kill(pid, 0) < 0 && errno == ESRCH;
+    }
+
+    // Claimed, but the producer did not even get to say who it is
+    const time_t now = time(NULL);
+    if (stuckSince == 0 || stuckPosition != position) {
+        stuckPosition = position;
+        stuckSince = now;
+        return false;
+    }
+    return now - stuckSince > RING_ABANDONED_TIMEOUT;
+}
+
+
+bool RingBuffer::pop(std::string &frame)
+{
+    while (true) {
+        const uint64_t position = header->tail.load(std::memory_order_relaxed);
+        RingSlot *slot = getSlot(position);
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+
+        if (sequence == position + 1) {
+            frame.assign(slot->payload(), std::min(slot->length, RING_PAYLOAD_SIZE));
+            slot->pid.store(0, std::memory_order_relaxed);
+            slot->sequence.store(position + header->slots, std::memory_order_release);
+            header->tail.store(position + 1, std::memory_order_release);
+            stuckSince = 0;
+            return true;
+        }
+
+        // Nothing claimed
+        if (header->head.load(std::memory_order_acquire) <= position) {
+            return false;
+        }
+
+        // Claimed, but not published yet
+        if (!isAbandoned(slot, position)) {
+            return false;
+        }
+
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Skipping a slot of " << path
+            << " abandoned by its producer (" << slot->pid.load() << ")" << fts3::common::commit;
+        slot->pid.store(0, std::memory_order_relaxed);
+        slot->sequence.store(position + header->slots, std::memory_order_release);
+        header->tail.store(position + 1, std::memory_order_release);
+        stuckSince = 0;
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <ctime>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+struct RingHeader;
+struct RingSlot;
+
+/// Multi-producer, single-consumer queue of frames kept in a memory mapped file,
+/// so processes on the same host can exchange messages without a file per message.
+/// Frames are published only once fully written, so a producer dying half way does not corrupt the queue,
+/// and the slot it left claimed is skipped by the consumer once the producer is gone.
+/// push fails when the frame does not fit in a slot, the queue is full, or the consumer has closed it,
+/// so the caller can fall back to the directory queue.
+/// The consumer closes a ring buffer before replacing or removing it, since producers may still have it mapped,
+/// and keeps draining it.
+class RingBuffer {
+public:
+    /// Size of each slot, including its header. Bigger frames are rejected.
+    static const uint32_t SLOT_SIZE = 4096;
+
+    /// Create the ring buffer at path, or reuse the existing one. Used by the consumer.
+    /// An existing ring buffer with a different number of slots, or closed, is closed and replaced
+    /// by a new generation.
+    /// @param slots    Rounded up to a power of two
+    /// @param replaced Set to the replaced ring buffer, so what is left in it can still be consumed
+    static std::unique_ptr<RingBuffer> create(const std::string &path, uint32_t slots,
+        std::unique_ptr<RingBuffer> *replaced = NULL);
+
+    /// Map the ring buffer at path. Used by the producers.
+    /// @return NULL if there is none, or it is not valid
+    static std::unique_ptr<RingBuffer> open(const std::string &path);
+
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator = (const RingBuffer&) = delete;
+
+    /// Queue a frame
+    /// @return false if it does not fit, the ring buffer is full, or closed
+    bool push(const std::string &frame);
+
+    /// Get the next frame. Must be called only by the consumer.
+    /// @return false if there is none ready
+    bool pop(std::string &frame);
+
+    /// Tell the producers to stop using this ring buffer. Must be called only by the consumer.
+    void close();
+
+    bool isClosed() const;
+
+    /// True once the ring buffer has been closed for a few seconds and everything claimed in it
+    /// has been consumed, so it can be dropped. Must be called only by the consumer.
+    bool isFinished();
+
+    /// Incremented each time the ring buffer at the path is replaced
+    uint32_t getGeneration() const;
+
+    /// The consumer found the fallback queue empty
+    void markDrained();
+
+    /// How many times the consumer found the fallback queue empty.
+    /// Once it has moved by two since a producer wrote there, the consumer has gone through a whole pass
+    /// started after the write.
+    uint64_t getDrained() const;
+
+    uint32_t getSlots() const;
+
+    const std::string &getPath() const;
+
+private:
+    std::string path;
+    void *address;
+    size_t length;
+    RingHeader *header;
+    // Slot found claimed but not published, and since when
+    uint64_t stuckPosition;
+    time_t stuckSince;
+    // When the consumer saw the ring buffer closed
+    time_t closedSince;
+
+    RingBuffer(const std::string &path, void *address, size_t length);
+
+    RingSlot *getSlot(uint64_t position) const;
+
+    /// True if the producer that claimed the slot is not going to publish it
+    bool isAbandoned(RingSlot *slot, uint64_t position);
+};
+
+#endif // RINGBUFFER_H
@@ -18,10 +18,16 @@
  * limitations under the License.
  */
 
-#include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "common/Logger.h"
 #include "consumer.h"
 #include "DirQ.h"
+#include "RingBuffer.h"
 
 
 Consumer::Consumer(const std::string &baseDir, unsigned limit):
@@ -38,41 +44,132 @@ Consumer::~Consumer()
 }
 
 
+void Consumer::setupStatusRing(unsigned slots)
+{
+    const std::string path = baseDir + "/status.ring";
+
+    if (slots > 0) {
+        std::unique_ptr<RingBuffer> replaced;
+        statusRing = RingBuffer::create(path, slots, &replaced);
+        if (replaced) {
+            retiredStatusRings.push_back(std::move(replaced));
+        }
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Status messages go through " << path
+            << " (" << statusRing->getSlots() << " slots)" << fts3::common::commit;
+    }
+    else {
+        statusRing.reset();
+        std::unique_ptr<RingBuffer> existing = RingBuffer::open(path);
+        if (existing) {
+            existing->close();
+            unlink(path.c_str());
+            retiredStatusRings.push_back(std::move(existing));
+            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Removed " << path << ", status messages go through the directory queue"
+                << fts3::common::commit;
+        }
+    }
+}
+
+
+// Consume up to limit messages from the ring buffer
+// Returns how many were consumed
 template <typename MSG>
-static int genericConsumer(std::unique_ptr<DirQ> &dirq, unsigned limit, std::vector<MSG> &messages)
+static unsigned ringConsumer(RingBuffer &ring, unsigned limit, std::vector<MSG> &messages)
+{
+    std::string frame;
+
+    unsigned i = 0;
+    while (i < limit && ring.pop(frame)) {
+        ++i;
+        messages.emplace_back();
+        if (!messages.back().ParseFromString(frame)) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not parse message from " << ring.getPath()
+                << fts3::common::commit;
+            messages.pop_back();
+        }
+    }
+
+    return i;
+}
+
+
+// Read the whole file into buffer, reusing its storage
+static bool readFile(const char *path, std::string &buffer)
 {
-    MSG event;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+
+    buffer.resize(st.st_size);
+    size_t offset = 0;
+    while (offset < buffer.size()) {
+        ssize_t n = read(fd, &buffer[offset], buffer.size() - offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        offset += n;
+    }
+    buffer.resize(offset);
+
+    close(fd);
+    return true;
+}
+
+
+// Iterate over up to limit entries of the queue, passing the content of each to handler,
+// which returns false if it could not make sense of it. Entries are removed once handled.
+// If visited is not NULL, it is set to the number of entries found
+template <typename HANDLER>
+static int consumeQueue(DirQ &dirq, unsigned limit, HANDLER handler, unsigned *visited = NULL)
+{
+    // Reused between calls, so the storage only grows up to the biggest message
+    static thread_local std::string buffer;
 
     const char *error = NULL;
-    dirq_clear_error(*dirq);
+    dirq_clear_error(dirq);
 
     unsigned i = 0;
-    for (auto iter = dirq_first(*dirq); iter != NULL && i < limit; iter = dirq_next(*dirq), ++i) {
-        if (dirq_lock(*dirq, iter, 0) == 0) {
-            const char *path = dirq_get_path(*dirq, iter);
+    for (auto iter = dirq_first(dirq); iter != NULL && i < limit; iter = dirq_next(dirq), ++i) {
+        if (dirq_lock(dirq, iter, 0) == 0) {
+            const char *path = dirq_get_path(dirq, iter);
 
-            try {
-                std::ifstream fstream(path);
-                event.ParseFromIstream(&fstream);
+            if (!readFile(path, buffer)) {
+                char errbuf[256] = {0};
+                FTS3_COMMON_LOGGER_NEWLOG(ERR)
+                    << "Could not load message from " << path << " (" << strerror_r(errno, errbuf, sizeof(errbuf)) << ")"
+                    << fts3::common::commit;
             }
-            catch (const std::exception &ex) {
+            else if (!handler(buffer)) {
                 FTS3_COMMON_LOGGER_NEWLOG(ERR)
-                    << "Could not load message from " << path << " (" << ex.what() << ")"
+                    << "Could not parse message from " << path
                     << fts3::common::commit;
             }
 
-            messages.emplace_back(event);
-            if (dirq_remove(*dirq, iter) < 0) {
-                error = dirq_get_errstr(*dirq);
+            if (dirq_remove(dirq, iter) < 0) {
+                error = dirq_get_errstr(dirq);
                 FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to remove message from queue (" << path << "): "
                     << error
                     << fts3::common::commit;
-                dirq_clear_error(*dirq);
+                dirq_clear_error(dirq);
             }
         }
     }
 
-    error = dirq_get_errstr(*dirq);
+    if (visited) {
+        *visited = i;
+    }
+
+    error = dirq_get_errstr(dirq);
     if (error) {
         FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to consume messages: " << error << fts3::common::commit;
         return -1;
@@ -82,9 +179,54 @@ static int genericConsumer(std::unique_ptr<DirQ> &dirq, unsigned limit, std::vec
 }
 
 
+template <typename MSG>
+static int genericConsumer(std::unique_ptr<DirQ> &dirq, unsigned limit, std::vector<MSG> &messages,
+    unsigned *visited = NULL)
+{
+    messages.reserve(messages.size() + std::min(limit, 1024u));
+
+    // Parse in place, dropping what could not be parsed
+    return consumeQueue(*dirq, limit, [&messages](const std::string &content) {
+        messages.emplace_back();
+        if (!messages.back().ParseFromArray(content.data(), content.size())) {
+            messages.pop_back();
+            return false;
+        }
+        return true;
+    }, visited);
+}
+
+
 int Consumer::runConsumerStatus(std::vector<fts3::events::Message> &messages)
 {
-    return genericConsumer<fts3::events::Message>(statusQueue, limit, messages);
+    unsigned consumed = 0;
+    // Producers move from the retired ring buffers to the current one, so their messages are older
+    auto retired = retiredStatusRings.begin();
+    while (retired != retiredStatusRings.end() && consumed < limit) {
+        consumed += ringConsumer<fts3::events::Message>(**retired, limit - consumed, messages);
+        if ((*retired)->isFinished()) {
+            retired = retiredStatusRings.erase(retired);
+        }
+        else {
+            ++retired;
+        }
+    }
+    if (statusRing && consumed < limit) {
+        consumed += ringConsumer<fts3::events::Message>(*statusRing, limit - consumed, messages);
+    }
+    // Producers only fall back to the directory queue once the ring is full,
+    // so its messages are newer than anything still in the ring
+    if (consumed >= limit) {
+        return 0;
+    }
+
+    unsigned visited = 0;
+    int ret = genericConsumer<fts3::events::Message>(statusQueue, limit - consumed, messages, &visited);
+    // Producers that fell back to the directory queue can use the ring buffer again once it has been emptied
+    if (statusRing && ret == 0 && visited < limit - consumed) {
+        statusRing->markDrained();
+    }
+    return ret;
 }
 
 
@@ -98,42 +240,13 @@ int Consumer::runConsumerLog(std::map<int, fts3::events::MessageLog> &messages)
 {
     fts3::events::MessageLog buffer;
 
-    const char *error = NULL;
-    dirq_clear_error(*logQueue);
-
-    unsigned i = 0;
-    for (auto iter = dirq_first(*logQueue); iter != NULL && i < limit; iter = dirq_next(*logQueue), ++i) {
-        if (dirq_lock(*logQueue, iter, 0) == 0) {
-            const char *path = dirq_get_path(*logQueue, iter);
-
-            try {
-                std::ifstream fstream(path);
-                buffer.ParseFromIstream(&fstream);
-            }
-            catch (const std::exception &ex) {
-                FTS3_COMMON_LOGGER_NEWLOG(ERR)
-                << "Could not load message from " << path << " (" << ex.what() << ")"
-                << fts3::common::commit;
-            }
-
-            messages[buffer.file_id()] = buffer;
-            if (dirq_remove(*logQueue, iter) < 0) {
-                error = dirq_get_errstr(*logQueue);
-                FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to remove message from queue (" << path << "): "
-                    << error
-                    << fts3::common::commit;
-                dirq_clear_error(*logQueue);
-            }
+    return consumeQueue(*logQueue, limit, [&messages, &buffer](const std::string &content) {
+        if (!buffer.ParseFromArray(content.data(), content.size())) {
+            return false;
         }
-    }
-
-    error = dirq_get_errstr(*logQueue);
-    if (error) {
-        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to consume messages: " << error << fts3::common::commit;
-        return -1;
-    }
-
-    return 0;
+        messages[buffer.file_id()].Swap(&buffer);
+        return true;
+    });
 }
 
 
@@ -151,45 +264,10 @@ int Consumer::runConsumerStaging(std::vector<fts3::events::MessageBringonline> &
 
 int Consumer::runConsumerMonitoring(std::vector<std::string> &messages)
 {
-    std::string content;
-
-    const char *error = NULL;
-    dirq_clear_error(*monitoringQueue);
-
-    unsigned i = 0;
-    for (auto iter = dirq_first(*monitoringQueue); iter != NULL && i < limit; iter = dirq_next(*monitoringQueue), ++i) {
-        if (dirq_lock(*monitoringQueue, iter, 0) == 0) {
-            const char *path = dirq_get_path(*monitoringQueue, iter);
-
-            try {
-                std::ifstream fstream(path);
-                content.assign((std::istreambuf_iterator<char>(fstream)), std::istreambuf_iterator<char>());
-                messages.emplace_back(content);
-            }
-            catch (const std::exception &ex) {
-                FTS3_COMMON_LOGGER_NEWLOG(ERR)
-                << "Could not load message from " << path << " (" << ex.what() << ")"
-                << fts3::common::commit;
-            }
-
-
-            if (dirq_remove(*monitoringQueue, iter) < 0) {
-                error = dirq_get_errstr(*monitoringQueue);
-                FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to remove message from queue (" << path << "): "
-                    << error
-                    << fts3::common::commit;
-                dirq_clear_error(*monitoringQueue);
-            }
-        }
-    }
-
-    error = dirq_get_errstr(*monitoringQueue);
-    if (error) {
-        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to consume messages: " << error << fts3::common::commit;
-        return -1;
-    }
-
-    return 0;
+    return consumeQueue(*monitoringQueue, limit, [&messages](const std::string &content) {
+        messages.emplace_back(content);
+        return true;
+    });
 }
 
 
@@ -22,6 +22,7 @@
 #ifndef CONSUMER_H
 #define CONSUMER_H
 
+#include <list>
 #include <map>
 #include <memory>
 #include <string>
@@ -29,6 +30,7 @@
 #include "events.h"
 
 struct DirQ;
+class RingBuffer;
 
 class Consumer
 {
@@ -41,6 +43,9 @@ private:
     std::unique_ptr<DirQ> logQueue;
     std::unique_ptr<DirQ> stagingQueue;
     std::unique_ptr<DirQ> deletionQueue;
+    std::unique_ptr<RingBuffer> statusRing;
+    // Replaced or removed ring buffers, oldest first, still used by the producers that did not notice yet
+    std::list<std::unique_ptr<RingBuffer>> retiredStatusRings;
 
 public:
 
@@ -48,6 +53,13 @@ public:
 
     ~Consumer();
 
+    /// Have the producers send status messages through a ring buffer of the given number of slots,
+    /// instead of the directory queue, which remains the fallback when it is full.
+    /// With 0 slots the ring buffer is removed, so producers go back to the directory queue.
+    /// A ring buffer replaced or removed is closed first, and still drained of what producers send to it
+    /// until they notice.
+    void setupStatusRing(unsigned slots);
+
     int runConsumerStatus(std::vector<fts3::events::Message> &messages);
 
     int runConsumerStall(std::vector<fts3::events::MessageUpdater> &messages);
@@ -24,6 +24,7 @@
 #include <glib.h>
 #include <boost/thread/tss.hpp>
 #include "DirQ.h"
+#include "RingBuffer.h"
 
 #include "common/Logger.h"
 
@@ -31,7 +32,8 @@
 Producer::Producer(const std::string &baseDir): baseDir(baseDir),
     monitoringQueue(new DirQ(baseDir + "/monitoring")), statusQueue(new DirQ(baseDir + "/status")),
     stalledQueue(new DirQ(baseDir + "/stalled")), logQueue(new DirQ(baseDir + "/logs")),
-    deletionQueue(new DirQ(baseDir + "/deletion")), stagingQueue(new DirQ(baseDir + "/staging"))
+    deletionQueue(new DirQ(baseDir + "/deletion")), stagingQueue(new DirQ(baseDir + "/staging")),
+    statusRing(RingBuffer::open(baseDir + "/status.ring")), statusRingBypassed(false), statusRingDrained(0)
 {
 }
 
@@ -73,7 +75,35 @@ static int writeMessage(std::unique_ptr<DirQ> &dirqHandle, const google::protobu
 
 int Producer::runProducerStatus(const fts3::events::Message &msg)
 {
-    return writeMessage(statusQueue, msg);
+    boost::mutex::scoped_lock lock(statusRingMutex);
+
+    if (statusRing && statusRing->isClosed()) {
+        // Replaced or removed by the consumer, which still drains it
+        std::unique_ptr<RingBuffer> current = RingBuffer::open(baseDir + "/status.ring");
+        if (!current) {
+            statusRing.reset();
+        }
+        else if (!current->isClosed() && current->getGeneration() != statusRing->getGeneration()) {
+            statusRing = std::move(current);
+            statusRingDrained = statusRing->getDrained();
+        }
+    }
+
+    if (statusRing && !statusRing->isClosed()) {
+        if (statusRingBypassed && statusRing->getDrained() >= statusRingDrained + 2) {
+            statusRingBypassed = false;
+        }
+        if (!statusRingBypassed && statusRing->push(msg.SerializeAsString())) {
+            return 0;
+        }
+    }
+
+    int ret = writeMessage(statusQueue, msg);
+    if (statusRing) {
+        statusRingBypassed = true;
+        statusRingDrained = statusRing->getDrained();
+    }
+    return ret;
 }
 
 
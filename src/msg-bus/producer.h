@@ -24,9 +24,11 @@
 
 #include <memory>
 #include <string>
+#include <boost/thread/mutex.hpp>
 #include "events.h"
 
 struct DirQ;
+class RingBuffer;
 
 class Producer {
 private:
@@ -37,6 +39,13 @@ private:
     std::unique_ptr<DirQ> logQueue;
     std::unique_ptr<DirQ> deletionQueue;
     std::unique_ptr<DirQ> stagingQueue;
+    // Status messages go here when the server has set it up
+    std::unique_ptr<RingBuffer> statusRing;
+    // Once a message has gone to the directory queue, the following ones go there too,
+    // so they are not consumed before it, until the consumer has emptied it
+    bool statusRingBypassed;
+    uint64_t statusRingDrained;
+    boost::mutex statusRingMutex;
 
 public:
     Producer(const std::string &baseDir);
@@ -48,6 +48,7 @@ static void heartBeat(void)
 {
     unsigned myIndex=0, count=0;
     unsigned hashStart=0, hashEnd=0;
+    std::vector<std::pair<unsigned, unsigned>> hashRanges, lastHashRanges;
     const std::string service_name = "fts_qosdaemon";
     int heartBeatInterval;
     try {
@@ -76,6 +77,13 @@ static void heartBeat(void)
                 << std::dec
                 << commit;
 
+            db::DBSingleton::instance().getDBObjectInstance()->getHashSegment(&hashRanges);
+            if (hashRanges != lastHashRanges) {
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Hash ranges changed: " << hashRanges.size()
+                    << " ranges owned" << commit;
+                lastHashRanges = hashRanges;
+            }
+
             boost::this_thread::sleep(boost::posix_time::seconds(heartBeatInterval));
         }
         catch (const std::exception& ex) {
@@ -94,6 +102,36 @@ static void heartBeat(void)
 }
 
 
+/// Log, every few minutes, how the tasks of each type use the shared thread pool
+/// This is a thread! Do not let exceptions exit the scope
+static void reportThreadPool(ThreadPool<Gfal2Task> &threadpool)
+{
+    while (!boost::this_thread::interruption_requested()) {
+        try {
+            boost::this_thread::sleep(boost::posix_time::minutes(5));
+
+            auto metrics = threadpool.getMetrics();
+            for (auto i = metrics.begin(); i != metrics.end(); ++i) {
+                const ThreadPoolMetrics &m = i->second;
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Thread pool: " << i->first
+                    << " executed=" << m.executed
+                    << " stolen=" << m.stolen
+                    << " avg_queue_time=" << (m.executed ? m.queueTime / m.executed : 0)
+                    << " avg_run_time=" << (m.executed ? m.runTime / m.executed : 0)
+                    << commit;
+            }
+            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Thread pool: pending=" << threadpool.pending() << commit;
+        }
+        catch (const boost::thread_interrupted&) {
+            return;
+        }
+        catch (const std::exception& ex) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << ex.what() << commit;
+        }
+    }
+}
+
+
 QoSServer::QoSServer(): threadpool(10)
 {
 }
@@ -125,6 +163,8 @@ void QoSServer::start(void)
     cdmiWaitingRoom.attach(threadpool);
     archivingWaitingRoom.attach(threadpool);
 
+    pollScheduler.setRateLimit(ServerConfig::instance().get<unsigned>("StagingPollRateLimit"));
+
     systemThreads.create_thread(boost::bind(&WaitingRoom<PollTask>::run, &waitingRoom));
     systemThreads.create_thread(boost::bind(&WaitingRoom<HttpPollTask>::run, &httpWaitingRoom));
     systemThreads.create_thread(boost::bind(&WaitingRoom<CDMIPollTask>::run, &cdmiWaitingRoom));
@@ -132,6 +172,7 @@ void QoSServer::start(void)
 
     // Heartbeat
     systemThreads.create_thread(heartBeat);
+    systemThreads.create_thread(boost::bind(reportThreadPool, boost::ref(threadpool)));
 
     // Give heartbeat some time to be processed
     if (!ServerConfig::instance().get<bool>("rush")) {
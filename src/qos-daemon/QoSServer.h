@@ -28,6 +28,7 @@
 #include "state/StagingStateUpdater.h"
 #include "state/ArchivingStateUpdater.h"
 #include "task/Gfal2Task.h"
+#include "task/PollScheduler.h"
 #include "task/WaitingRoom.h"
 
 class PollTask;
@@ -73,6 +74,10 @@ public:
         return archivingWaitingRoom;
     }
 
+    PollScheduler& getPollScheduler() {
+        return pollScheduler;
+    }
+
 private:
     boost::thread_group systemThreads;
     fts3::common::ThreadPool<Gfal2Task> threadpool;
@@ -80,6 +85,7 @@ private:
     WaitingRoom<HttpPollTask> httpWaitingRoom;
     WaitingRoom<CDMIPollTask> cdmiWaitingRoom;
     WaitingRoom<ArchivingPollTask> archivingWaitingRoom;
+    PollScheduler pollScheduler;
 
     DeletionStateUpdater deletionStateUpdater;
     StagingStateUpdater stagingStateUpdater;
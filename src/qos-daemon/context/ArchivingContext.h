@@ -67,7 +67,8 @@ public:
 
     ArchivingContext(QoSServer &qosServer, const ArchivingOperation &archiveOp):
         JobContext(archiveOp.user, archiveOp.voName, archiveOp.credId, ""),
-        stateUpdater(qosServer.getArchivingStateUpdater()), waitingRoom(qosServer.getArchivingWaitingRoom())
+        stateUpdater(qosServer.getArchivingStateUpdater()), waitingRoom(qosServer.getArchivingWaitingRoom()),
+        pollScheduler(qosServer.getPollScheduler())
     {
         add(archiveOp);
         startTime = time(0);
@@ -75,13 +76,13 @@ public:
 
     ArchivingContext(const ArchivingContext &copy) :
         JobContext(copy), stateUpdater(copy.stateUpdater), waitingRoom(copy.waitingRoom),
-        errorCount(copy.errorCount), expiryMap(copy.expiryMap), startTime(copy.startTime),
+        pollScheduler(copy.pollScheduler), errorCount(copy.errorCount), expiryMap(copy.expiryMap), startTime(copy.startTime),
         storageEndpoint(copy.storageEndpoint)
     {}
 
     ArchivingContext(ArchivingContext && copy) :
         JobContext(std::move(copy)), stateUpdater(copy.stateUpdater), waitingRoom(copy.waitingRoom),
-        errorCount(std::move(copy.errorCount)), expiryMap(std::move(copy.expiryMap)), startTime(copy.startTime),
+        pollScheduler(copy.pollScheduler), errorCount(std::move(copy.errorCount)), expiryMap(std::move(copy.expiryMap)), startTime(copy.startTime),
         storageEndpoint(std::move(copy.storageEndpoint))
     {}
 
@@ -155,6 +156,10 @@ public:
         return waitingRoom;
     }
 
+    PollScheduler& getPollScheduler() {
+        return pollScheduler;
+    }
+
     inline time_t getStartTime() const
     {
         return startTime;
@@ -168,6 +173,7 @@ public:
 private:
     ArchivingStateUpdater &stateUpdater;
     WaitingRoom<ArchivingPollTask> &waitingRoom;
+    PollScheduler &pollScheduler;
     std::map<std::string, int> errorCount;
     /// Map of FileID --> expire timestamp
     std::map<uint64_t, time_t> expiryMap;
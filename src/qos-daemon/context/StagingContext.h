@@ -68,20 +68,22 @@ public:
     StagingContext(QoSServer &qosServer, const StagingOperation &stagingOp) :
         JobContext(stagingOp.userDn, stagingOp.voName, stagingOp.credId, stagingOp.spaceToken),
         stateUpdater(qosServer.getStagingStateUpdater()), waitingRoom(qosServer.getWaitingRoom()),
-        maxPinLifetime(stagingOp.pinLifetime), maxBringonlineTimeout(stagingOp.timeout), minStagingStartTime(time(0)),
+        pollScheduler(qosServer.getPollScheduler()), maxPinLifetime(stagingOp.pinLifetime), maxBringonlineTimeout(stagingOp.timeout), minStagingStartTime(time(0)),
         storageEndpoint()
     {
         add(stagingOp);
     }
 
     StagingContext(const StagingContext &copy) :
-        JobContext(copy), stateUpdater(copy.stateUpdater), waitingRoom(copy.waitingRoom), errorCount(copy.errorCount),
+        JobContext(copy), stateUpdater(copy.stateUpdater), waitingRoom(copy.waitingRoom),
+        pollScheduler(copy.pollScheduler), errorCount(copy.errorCount),
         maxPinLifetime(copy.maxPinLifetime), maxBringonlineTimeout(copy.maxBringonlineTimeout), minStagingStartTime(copy.minStagingStartTime),
         storageEndpoint(copy.storageEndpoint)
     {}
 
     StagingContext(StagingContext && copy) :
-        JobContext(std::move(copy)), stateUpdater(copy.stateUpdater), waitingRoom(copy.waitingRoom), errorCount(std::move(copy.errorCount)),
+        JobContext(std::move(copy)), stateUpdater(copy.stateUpdater), waitingRoom(copy.waitingRoom),
+        pollScheduler(copy.pollScheduler), errorCount(std::move(copy.errorCount)),
         maxPinLifetime(copy.maxPinLifetime), maxBringonlineTimeout(copy.maxBringonlineTimeout), minStagingStartTime(copy.minStagingStartTime),
         storageEndpoint(std::move(copy.storageEndpoint))
     {}
@@ -146,6 +148,10 @@ public:
         return waitingRoom;
     }
 
+    PollScheduler& getPollScheduler() {
+        return pollScheduler;
+    }
+
     int incrementErrorCountForSurl(const std::string &surl) {
         return (errorCount[surl] += 1);
     }
@@ -157,6 +163,7 @@ public:
 protected:
     StagingStateUpdater &stateUpdater;
     WaitingRoom<PollTask> &waitingRoom;
+    PollScheduler &pollScheduler;
     std::map<std::string, int> errorCount;
     int maxPinLifetime; ///< maximum copy pin lifetime of the batch
     int maxBringonlineTimeout; ///< maximum bringonline timeout of the batch
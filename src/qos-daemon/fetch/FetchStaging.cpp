@@ -32,12 +32,36 @@
 #include "qos-daemon/task/PollTask.h"
 #include "qos-daemon/task/HttpPollTask.h"
 
+#include <algorithm>
 #include <ctime>
 
+// A group can not grow beyond what is fetched for it (see MySqlAPI::getFilesForStaging)
+static size_t getCoalesceSize()
+{
+    size_t bulkSize = fts3::config::ServerConfig::instance().get<size_t>("StagingBulkSize");
+    size_t coalesceSize = fts3::config::ServerConfig::instance().get<size_t>("StagingCoalesceSize");
+
+    size_t fetchSize = bulkSize;
+    if (fts3::config::ServerConfig::instance().get<time_t>("StagingCoalesceWindow") > 0) {
+        fetchSize = std::max(bulkSize, coalesceSize);
+    }
+    return std::min(coalesceSize > 0 ? coalesceSize : bulkSize, fetchSize);
+}
+
+
+FetchStaging::FetchStaging(fts3::common::ThreadPool<Gfal2Task> & threadpool) : threadpool(threadpool),
+    coalescer(
+        fts3::config::ServerConfig::instance().get<time_t>("StagingCoalesceWindow"),
+        getCoalesceSize(),
+        fts3::config::ServerConfig::instance().get<size_t>("StagingBulkSize"),
+        StagingCoalescer::getLocalityKey(fts3::config::ServerConfig::instance().get<std::string>("StagingLocalityKey"))
+    )
+{
+}
+
+
 void FetchStaging::fetch()
 {
-    // VO, user dn, storage, space token
-    typedef std::tuple<std::string, std::string, std::string> GroupByType;
     StagingSchedulingInterval = fts3::config::ServerConfig::instance().get<boost::posix_time::time_duration>("StagingSchedulingInterval");
 
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "FetchStaging starting" << commit;
@@ -65,7 +89,6 @@ void FetchStaging::fetch()
                 continue;
             }
 
-            std::map<GroupByType, std::unique_ptr<StagingContext>> tasks;
             std::vector<StagingOperation> files;
 
             time_t start = time(0);
@@ -77,31 +100,32 @@ void FetchStaging::fetch()
                                             << "time=\"" << end - start << "\""
                                             << commit;
 
-            for (auto it_f = files.begin(); it_f != files.end(); ++it_f)
+            // Files still waiting for more of their group to arrive are not started yet
+            coalescer.update(files, end);
+            std::vector<std::vector<StagingOperation>> requests = coalescer.release(end);
+
+            std::vector<std::unique_ptr<StagingContext>> tasks;
+            for (auto it_r = requests.begin(); it_r != requests.end(); ++it_r)
             {
-                std::string storage = Uri::parse(it_f->surl).host;
-                GroupByType key(it_f->credId, storage, it_f->spaceToken);
-                auto it_t = tasks.find(key);
-                if (it_t == tasks.end()) {
-                    tasks.insert(std::make_pair(
-                        key, StagingContext::createStagingContext(QoSServer::instance(), *it_f))
-                    );
-                }
-                else {
-                    it_t->second->add(*it_f);
+                auto it_f = it_r->begin();
+                tasks.push_back(StagingContext::createStagingContext(QoSServer::instance(), *it_f));
+                for (++it_f; it_f != it_r->end(); ++it_f) {
+                    tasks.back()->add(*it_f);
                 }
             }
 
+            logCoalescerMetrics();
+
             for (auto it_t = tasks.begin(); it_t != tasks.end(); ++it_t)
             {
                 try
                 {
-                    if (it_t->second->updateStateToStarted()) {
-                        std::string protocol = it_t->second->getStorageProtocol();
+                    if ((*it_t)->updateStateToStarted()) {
+                        std::string protocol = (*it_t)->getStorageProtocol();
                         if (protocol == "http" || protocol == "https" || protocol == "dav" || protocol == "davs") {
-                            threadpool.start(new HttpBringOnlineTask(static_cast<HttpStagingContext&&>(std::move(*(it_t->second)))));
+                            threadpool.start(new HttpBringOnlineTask(static_cast<HttpStagingContext&&>(std::move(**it_t))));
                         } else {
-                            threadpool.start(new BringOnlineTask(std::move(*(it_t->second))));
+                            threadpool.start(new BringOnlineTask(std::move(**it_t)));
                         }
                     }
                 }
@@ -132,6 +156,23 @@ void FetchStaging::fetch()
 }
 
 
+void FetchStaging::logCoalescerMetrics()
+{
+    StagingCoalescer::Metrics metrics = coalescer.getMetrics();
+    if (metrics.requests == 0) {
+        return;
+    }
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "FetchStaging"
+        << " requests=" << metrics.requests
+        << " files=" << metrics.files
+        << " avg_request_size=" << metrics.files / metrics.requests
+        << " max_request_size=" << metrics.maxRequestSize
+        << " avg_hold_time=" << metrics.totalHoldTime / metrics.files
+        << " held=" << coalescer.size()
+        << commit;
+}
+
+
 void FetchStaging::recoverStartedTasks()
 {
     std::vector<StagingOperation> startedStagingOps;
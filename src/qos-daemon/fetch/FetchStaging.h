@@ -32,6 +32,7 @@
 
 #include "../task/Gfal2Task.h"
 #include "../context/StagingContext.h"
+#include "StagingCoalescer.h"
 
 
 /**
@@ -41,14 +42,17 @@ class FetchStaging
 {
 
 public:
-    FetchStaging(fts3::common::ThreadPool<Gfal2Task> & threadpool) : threadpool(threadpool) {}
+    FetchStaging(fts3::common::ThreadPool<Gfal2Task> & threadpool);
     virtual ~FetchStaging() {}
 
     void fetch();
 
 private:
     void recoverStartedTasks();
+    void logCoalescerMetrics();
     fts3::common::ThreadPool<Gfal2Task> & threadpool;
+    /// holds the files of each group until there are enough for a bulk request
+    StagingCoalescer coalescer;
     boost::posix_time::time_duration StagingSchedulingInterval;
 
 };
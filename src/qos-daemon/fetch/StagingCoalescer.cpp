@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StagingCoalescer.h"
+
+#include <algorithm>
+#include <set>
+
+#include "common/Exceptions.h"
+#include "common/Uri.h"
+#include "monitoring/JsonFields.h"
+
+using fts3::common::UserError;
+
+
+StagingCoalescer::StagingCoalescer(time_t window, size_t targetSize, size_t maxSize, LocalityKey locality):
+    window(window), targetSize(targetSize), maxSize(std::max<size_t>(1, maxSize)), locality(locality)
+{
+    if (this->targetSize == 0) {
+        this->targetSize = this->maxSize;
+    }
+}
+
+
+void StagingCoalescer::update(const std::vector<StagingOperation> &ops, time_t now)
+{
+    std::map<GroupKey, std::vector<StagingOperation>> fetched;
+    std::set<uint64_t> seen;
+
+    for (auto op = ops.begin(); op != ops.end(); ++op) {
+        // the same file may be fetched twice within a pass
+        if (!seen.insert(op->fileId).second) {
+            continue;
+        }
+        auto arrival = arrivals.find(op->fileId);
+        if (arrival == arrivals.end()) {
+            arrivals.insert(std::make_pair(op->fileId, Arrival(now)));
+        }
+        else {
+            arrival->second.last = now;
+        }
+
+        std::string storage = fts3::common::Uri::parse(op->surl).host;
+        fetched[GroupKey(op->credId, storage, op->spaceToken)].push_back(*op);
+    }
+
+    // Forget the files not fetched for a whole window: cancelled, or taken by another node
+    for (auto arrival = arrivals.begin(); arrival != arrivals.end();) {
+        if (now - arrival->second.last > window) {
+            arrivals.erase(arrival++);
+        }
+        else {
+            ++arrival;
+        }
+    }
+
+    groups.swap(fetched);
+}
+
+
+std::vector<std::vector<StagingOperation>> StagingCoalescer::release(time_t now)
+{
+    std::vector<std::vector<StagingOperation>> requests;
+
+    for (auto group = groups.begin(); group != groups.end();) {
+        std::vector<StagingOperation> &ops = group->second;
+
+        time_t oldest = now;
+        for (auto op = ops.begin(); op != ops.end(); ++op) {
+            oldest = std::min(oldest, arrivals.at(op->fileId).first);
+        }
+        if (ops.size() < targetSize && now - oldest < window) {
+            ++group;
+            continue;
+        }
+
+        if (locality) {
+            std::vector<std::pair<std::string, size_t>> order;
+            order.reserve(ops.size());
+            for (size_t i = 0; i < ops.size(); ++i) {
+                order.emplace_back(locality(ops[i]), i);
+            }
+            std::sort(order.begin(), order.end());
+            std::vector<StagingOperation> sorted;
+            sorted.reserve(ops.size());
+            for (auto i = order.begin(); i != order.end(); ++i) {
+                sorted.push_back(ops[i->second]);
+            }
+            ops.swap(sorted);
+        }
+
+        for (size_t begin = 0; begin < ops.size(); begin += maxSize) {
+            size_t end = std::min(ops.size(), begin + maxSize);
+            requests.emplace_back(ops.begin() + begin, ops.begin() + end);
+
+            ++metrics.requests;
+            metrics.files += end - begin;
+            metrics.maxRequestSize = std::max<uint64_t>(metrics.maxRequestSize, end - begin);
+        }
+
+        for (auto op = ops.begin(); op != ops.end(); ++op) {
+            auto arrival = arrivals.find(op->fileId);
+            metrics.totalHoldTime += now - arrival->second.first;
+            arrivals.erase(arrival);
+        }
+        groups.erase(group++);
+    }
+
+    return requests;
+}
+
+
+size_t StagingCoalescer::size() const
+{
+    size_t held = 0;
+    for (auto group = groups.begin(); group != groups.end(); ++group) {
+        held += group->second.size();
+    }
+    return held;
+}
+
+
+StagingCoalescer::Metrics StagingCoalescer::getMetrics()
+{
+    Metrics current = metrics;
+    metrics = Metrics();
+    return current;
+}
+
+
+StagingCoalescer::LocalityKey StagingCoalescer::getLocalityKey(const std::string &name)
+{
+    static const std::string METADATA_PREFIX("metadata:");
+
+    if (name.empty() || name == "none") {
+        return LocalityKey();
+    }
+    else if (name == "surl") {
+        return [](const StagingOperation &op) {
+            return fts3::common::Uri::parse(op.surl).path;
+        };
+    }
+    else if (name.compare(0, METADATA_PREFIX.size(), METADATA_PREFIX) == 0 && name.size() > METADATA_PREFIX.size()) {
+        std::string field = name.substr(METADATA_PREFIX.size());
+        // The separator keeps "ab" + "c" apart from "a" + "bc"
+        return [field](const StagingOperation &op) {
+            return getJsonField(op.stagingMetadata, field) + '\0' + fts3::common::Uri::parse(op.surl).path;
+        };
+    }
+    throw UserError("Unknown staging locality key: " + name);
+}
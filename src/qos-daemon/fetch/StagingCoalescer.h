@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef STAGINGCOALESCER_H_
+#define STAGINGCOALESCER_H_
+
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "db/generic/StagingOperation.h"
+
+
+/**
+ * Holds the staging operations of each group (credential, storage, space token)
+ * for a bounded window, so files arriving over several scheduling intervals for
+ * the same endpoint go into one bulk request instead of several small ones.
+ *
+ * Files stay in the STAGING state in the database while held, so every fetch
+ * returns them again: update() replaces the held operations with the ones fetched,
+ * and only remembers since when each file has been waiting.
+ * This way files cancelled meanwhile are simply dropped. A file missing from a fetch
+ * (i.e. beyond its limit) keeps its arrival time for a window, in case it comes back.
+ *
+ * A group is released once it reaches the target size, or once its oldest file
+ * waited for the whole window. Released files are sorted by a locality key
+ * (i.e. which tape they are likely on), and split into requests of at most
+ * maxSize files, so files close to each other end up in the same request.
+ */
+class StagingCoalescer
+{
+public:
+    /// credential id, storage, space token
+    typedef std::tuple<std::string, std::string, std::string> GroupKey;
+
+    /// Tape locality of a file. Files are released sorted by it.
+    typedef std::function<std::string (const StagingOperation&)> LocalityKey;
+
+    /// Statistics of the requests released
+    struct Metrics
+    {
+        Metrics(): requests(0), files(0), maxRequestSize(0), totalHoldTime(0) {}
+
+        /// number of bulk requests
+        uint64_t requests;
+        /// number of files in them
+        uint64_t files;
+        /// size of the biggest one
+        uint64_t maxRequestSize;
+        /// seconds the files were held, summed
+        uint64_t totalHoldTime;
+    };
+
+    /**
+     * @param window     Seconds a file can be held. 0 releases everything right away.
+     * @param targetSize A group is released as soon as it has this many files. 0 means maxSize.
+     * @param maxSize    Maximum number of files per request
+     * @param locality   Sort key, or empty to keep the files as fetched
+     */
+    StagingCoalescer(time_t window, size_t targetSize, size_t maxSize,
+        LocalityKey locality = LocalityKey());
+
+    /**
+     * Replace the held operations with the ones still waiting, as fetched from the database
+     */
+    void update(const std::vector<StagingOperation> &ops, time_t now);
+
+    /**
+     * Take the requests ready to be sent
+     *
+     * @return groups of operations. Each one shares the credential, storage and space token.
+     */
+    std::vector<std::vector<StagingOperation>> release(time_t now);
+
+    /// Number of files held
+    size_t size() const;
+
+    /// Statistics since the last call, which resets them
+    Metrics getMetrics();
+
+    /**
+     * Locality key by name
+     *
+     *  - "" or "none": keep the files as fetched
+     *  - "surl": the path, so files in the same directory (often the same tape family) go together
+     *  - "metadata:<field>": a field of the staging metadata (i.e. the tape id given by the
+     *    experiment), then the path
+     */
+    static LocalityKey getLocalityKey(const std::string &name);
+
+private:
+    struct Arrival
+    {
+        Arrival(time_t first): first(first), last(first) {}
+        time_t first;
+        time_t last;
+    };
+
+    time_t window;
+    size_t targetSize;
+    size_t maxSize;
+    LocalityKey locality;
+
+    std::map<GroupKey, std::vector<StagingOperation>> groups;
+    /// by file id
+    std::map<uint64_t, Arrival> arrivals;
+    Metrics metrics;
+};
+
+#endif // STAGINGCOALESCER_H_
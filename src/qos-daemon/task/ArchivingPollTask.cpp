@@ -36,13 +36,20 @@ void ArchivingPollTask::run(const boost::any&)
     handle_timeouts();
 
 	// Use the same var for staging pool retries now
-	int maxPollRetries = fts3::config::ServerConfig::instance().get<int>("StagingPollRetries");
-	bool forcePoll = false;
+	int maxPollRetries = fts3::config::ServerConfig::instance().values().stagingPollRetries;
 
 	std::set<std::string> urlSet = ctx.getUrls();
 	if (urlSet.empty())
 		return;
 
+	// Only the URLs due, all of them in the same request
+	time_t now = time(NULL);
+	urlSet = pollTimes.getDue(urlSet, now + ctx.getPollScheduler().getMinInterval());
+	if (urlSet.empty()) {
+		reschedule(now);
+		return;
+	}
+
 	std::vector<const char*> urls;
 	urls.reserve(urlSet.size());
 	for (auto set_i = urlSet.begin(); set_i != urlSet.end(); ++set_i) {
@@ -60,6 +67,13 @@ void ArchivingPollTask::run(const boost::any&)
 	std::vector<GError*> errors(urls.size(), NULL);
 	int status = gfal2_archive_poll_list(gfal2_ctx, static_cast<int>(urls.size()), urls.data(), errors.data());
 
+    // When to poll again the files still pending: retries back off as before,
+    // the others go by how long this endpoint usually takes
+    now = time(NULL);
+    time_t retryInterval = getPollInterval(++nPolls);
+    time_t pollInterval = ctx.getPollScheduler().getPollInterval("ARCHIVING", ctx.getStorageEndpoint(),
+        now - ctx.getStartTime(), retryInterval);
+
 	// Status return code meaning:
 	//  0  - Not all files are in terminal state
 	//  1  - All files are in terminal successful state
@@ -74,10 +88,11 @@ void ArchivingPollTask::run(const boost::any&)
                 FTS3_COMMON_LOGGER_NEWLOG(NOTICE) << "ARCHIVING ONGOING for " << urls[i] << "."
                                                   << " Communication error, soft failure: " << errors[i]->message
                                                   << commit;
-                forcePoll = true;
+                pollTimes.set(urls[i], now + retryInterval);
             } else if (errors[i]->code == EAGAIN) {
                 if (status == 0) {
                     FTS3_COMMON_LOGGER_NEWLOG(NOTICE) << "ARCHIVING ONGOING for " << urls[i] << commit;
+                    pollTimes.set(urls[i], now + pollInterval);
                 } else {
                     FTS3_COMMON_LOGGER_NEWLOG(NOTICE) << "ARCHIVING polling FAILED for " << urls[i] << "."
                                                        << " EAGAIN error code not expected in terminal state: "
@@ -85,6 +100,8 @@ void ArchivingPollTask::run(const boost::any&)
                     for (auto it = ids.begin(); it != ids.end(); ++it) {
                         ctx.updateState(it->first, it->second, "FAILED", JobError("ARCHIVING", errors[i]));
                     }
+                    ctx.removeUrlWithIds(urls[i], ids);
+                    pollTimes.remove(urls[i]);
                 }
             } else {
                 FTS3_COMMON_LOGGER_NEWLOG(NOTICE) << "ARCHIVING polling FAILED for " << urls[i] << ": "
@@ -92,6 +109,8 @@ void ArchivingPollTask::run(const boost::any&)
                 for (auto it = ids.begin(); it != ids.end(); ++it) {
                     ctx.updateState(it->first, it->second, "FAILED", JobError("ARCHIVING", errors[i]));
                 }
+                ctx.removeUrlWithIds(urls[i], ids);
+                pollTimes.remove(urls[i]);
             }
         } else {
             if (status >= 0) {
@@ -99,7 +118,7 @@ void ArchivingPollTask::run(const boost::any&)
                 for (auto it = ids.begin(); it != ids.end(); ++it) {
                     ctx.updateState(it->first, it->second, "FINISHED", JobError());
                 }
-                ctx.removeUrlWithIds(urls[i], ids);
+                ctx.getPollScheduler().addSample("ARCHIVING", ctx.getStorageEndpoint(), now - ctx.getStartTime());
             } else {
                 FTS3_COMMON_LOGGER_NEWLOG(NOTICE) << "ARCHIVING polling FAILED for " << urls[i] << ": "
                                                   << errors[i]->code << " " << errors[i]->message << commit;
@@ -108,24 +127,31 @@ void ArchivingPollTask::run(const boost::any&)
                                     JobError("ARCHIVING", -1, "Error not set by Gfal2"));
                 }
             }
+            ctx.removeUrlWithIds(urls[i], ids);
+            pollTimes.remove(urls[i]);
         }
 
         g_clear_error(&errors[i]);
     }
 
-	// Schedule a new poll
-	if (status == 0 || forcePoll) {
-		time_t interval = getPollInterval(++nPolls);
-		time_t now = time(NULL);
-		wait_until = now + interval;
-
-		FTS3_COMMON_LOGGER_NEWLOG(INFO) << "ARCHIVING polling " << ctx.getLogMsg() << commit;
-		FTS3_COMMON_LOGGER_NEWLOG(INFO) << "ARCHIVING polling next attempt in " << interval << " seconds" << commit;
-		ctx.getWaitingRoom().add(new ArchivingPollTask(std::move(*this)));
+	// Schedule a new poll if some files are not terminal yet, or were not polled this time
+	if (!ctx.getUrls().empty()) {
+		reschedule(now);
 	}
 }
 
 
+void ArchivingPollTask::reschedule(time_t now)
+{
+    time_t next = pollTimes.getNext(ctx.getUrls());
+    wait_until = ctx.getPollScheduler().reserve(ctx.getStorageEndpoint(), next, now);
+
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "ARCHIVING polling " << ctx.getLogMsg() << commit;
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "ARCHIVING polling next attempt in " << wait_until - now << " seconds" << commit;
+    ctx.getWaitingRoom().add(new ArchivingPollTask(std::move(*this)));
+}
+
+
 void ArchivingPollTask::handle_timeouts()
 {
     std::list<std::tuple<std::string, std::string, uint64_t>> timeout_transfers;
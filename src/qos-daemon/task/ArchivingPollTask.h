@@ -32,6 +32,7 @@
 
 #include "db/generic/SingleDbInstance.h"
 #include "Gfal2Task.h"
+#include "PollScheduler.h"
 #include "../context/ArchivingContext.h"
 
 
@@ -66,7 +67,7 @@ public:
      * @param copy : a archive task (stills the gfal2 context of this object)
      */
     ArchivingPollTask(ArchivingPollTask &&copy) : Gfal2Task(std::move(copy)), ctx(std::move(copy.ctx)),
-        nPolls(copy.nPolls), wait_until(copy.wait_until)
+        nPolls(copy.nPolls), wait_until(copy.wait_until), pollTimes(std::move(copy.pollTimes))
     {
     }
 
@@ -84,11 +85,11 @@ public:
     virtual void run(const boost::any &);
 
     /**
-     * @return : true if the task is still waiting, false otherwise
+     * @return : the time the task is due to run again
      */
-    bool waiting(time_t now)
+    time_t getWaitUntil() const
     {
-        return wait_until > now;
+        return wait_until;
     }
 
     static void cancel(const std::set<std::pair<std::string, std::string> > &urls)
@@ -114,6 +115,9 @@ private:
     /// aborts the operation for the given URLs
     void abort(std::set<std::string> const & urls, bool report = true);
 
+    /// puts the task back in the waiting room, until the next URL is due
+    void reschedule(time_t now);
+
     /**
      * Gets the interval after next polling should be done
      *
@@ -136,6 +140,9 @@ private:
     /// wait in the wait room until given time
     time_t wait_until;
 
+    /// when to poll each URL next
+    PollTimes pollTimes;
+
     /// prevents concurrent access to active_tokens
     static boost::shared_mutex mx;
     
@@ -29,7 +29,7 @@ void CDMIPollTask::run(const boost::any&)
 	std::vector<QosTransitionOperation> files;
 	ctx.cdmiGetFilesForQosRequestSubmitted(files, "QOS_REQUEST_SUBMITTED");
 
-	int maxPollRetries = fts3::config::ServerConfig::instance().get<int>("StagingPollRetries");
+	int maxPollRetries = fts3::config::ServerConfig::instance().values().stagingPollRetries;
 	bool anyPending = false;
 
 	for (auto it_f = files.begin(); it_f != files.end(); ++it_f)
@@ -32,7 +32,7 @@ void HttpPollTask::run(const boost::any&)
     // handle cancelled jobs/files
     handle_canceled();
 
-    int maxPollRetries = fts3::config::ServerConfig::instance().get<int>("StagingPollRetries");
+    int maxPollRetries = fts3::config::ServerConfig::instance().values().stagingPollRetries;
     bool forcePoll = false;
 
     std::set<std::string> urlSet = ctx.getUrls();
@@ -126,6 +126,7 @@ void HttpPollTask::run(const boost::any&)
                 FTS3_COMMON_LOGGER_NEWLOG(NOTICE)
                     << "BRINGONLINE FINISHED for "
                     << urls[i]
+                    << " time_to_stage=" << time(NULL) - ctx.getStartTime()
                     << commit;
                 for (auto it = ids.begin(); it != ids.end(); ++it) {
                     ctx.updateState(it->first, it->second, "FINISHED", JobError());
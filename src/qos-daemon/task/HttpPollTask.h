@@ -88,11 +88,11 @@ public:
     virtual void run(const boost::any &);
 
     /**
-     * @return : true if the task is still waiting, false otherwise
+     * @return : the time the task is due to run again
      */
-    bool waiting(time_t now)
+    time_t getWaitUntil() const
     {
-        return wait_until > now;
+        return wait_until;
     }
 
 private:
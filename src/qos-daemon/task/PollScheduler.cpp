@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PollScheduler.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+
+// Latencies kept per endpoint
+static const size_t MAX_SAMPLES = 256;
+// Operations that took at least as long as the current one needed to trust the history
+static const size_t MIN_SAMPLES = 8;
+
+
+PollScheduler::PollScheduler(time_t minInterval, time_t maxInterval):
+    minInterval(minInterval), maxInterval(std::max(minInterval, maxInterval)), rateLimit(0)
+{
+}
+
+
+void PollScheduler::setRateLimit(unsigned limit)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    rateLimit = limit;
+}
+
+
+time_t PollScheduler::getMinInterval() const
+{
+    return minInterval;
+}
+
+
+void PollScheduler::addSample(const std::string &operation, const std::string &endpoint, time_t latency)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    std::deque<time_t> &samples = history[HistoryKey(operation, endpoint)];
+    samples.push_back(latency);
+    if (samples.size() > MAX_SAMPLES) {
+        samples.pop_front();
+    }
+}
+
+
+time_t PollScheduler::getPollInterval(const std::string &operation, const std::string &endpoint,
+    time_t elapsed, time_t fallback)
+{
+    std::vector<time_t> longer;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        auto i = history.find(HistoryKey(operation, endpoint));
+        if (i != history.end()) {
+            std::copy_if(i->second.begin(), i->second.end(), std::back_inserter(longer),
+                [elapsed](time_t latency) { return latency > elapsed; });
+        }
+    }
+
+    time_t interval = fallback;
+    if (longer.size() >= MIN_SAMPLES) {
+        // Poll when a quarter of the similar operations had completed
+        auto quartile = longer.begin() + longer.size() / 4;
+        std::nth_element(longer.begin(), quartile, longer.end());
+        interval = *quartile - elapsed;
+    }
+    return std::max(minInterval, std::min(maxInterval, interval));
+}
+
+
+time_t PollScheduler::reserve(const std::string &endpoint, time_t when, time_t now)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    if (rateLimit == 0) {
+        return when;
+    }
+
+    std::map<time_t, unsigned> &perSecond = booked[endpoint];
+    perSecond.erase(perSecond.begin(), perSecond.lower_bound(now));
+
+    // first second with room left
+    time_t slot = std::max(when, now);
+    for (auto i = perSecond.lower_bound(slot);
+         i != perSecond.end() && i->first == slot && i->second >= rateLimit; ++i) {
+        ++slot;
+    }
+    ++perSecond[slot];
+    return slot;
+}
+
+
+std::set<std::string> PollTimes::getDue(const std::set<std::string> &urls, time_t until) const
+{
+    std::set<std::string> due;
+    for (auto url = urls.begin(); url != urls.end(); ++url) {
+        auto i = times.find(*url);
+        if (i == times.end() || i->second <= until) {
+            due.insert(due.end(), *url);
+        }
+    }
+    return due;
+}
+
+
+time_t PollTimes::getNext(const std::set<std::string> &urls) const
+{
+    time_t next = 0;
+    for (auto url = urls.begin(); url != urls.end(); ++url) {
+        auto i = times.find(*url);
+        time_t when = (i == times.end()) ? 0 : i->second;
+        if (url == urls.begin() || when < next) {
+            next = when;
+        }
+    }
+    return next;
+}
+
+
+void PollTimes::set(const std::string &url, time_t when)
+{
+    times[url] = when;
+}
+
+
+void PollTimes::remove(const std::string &url)
+{
+    times.erase(url);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef POLLSCHEDULER_H_
+#define POLLSCHEDULER_H_
+
+#include <ctime>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <boost/thread/mutex.hpp>
+
+
+/**
+ * Decides when to poll an endpoint again for an asynchronous operation (staging, archiving)
+ *
+ * It keeps, per endpoint and kind of operation, how long the latest operations took
+ * to complete. An operation still pending after some time is polled again when,
+ * according to that history, the first quarter of the operations that took at least
+ * as long had completed.
+ * So a fast endpoint is polled often, and a slow one is left alone.
+ * Without enough history, the caller's own rule (usually an exponential backoff) is used.
+ *
+ * On top of it, the number of polls sent to an endpoint per second can be limited,
+ * whatever the operation.
+ */
+class PollScheduler
+{
+public:
+    /**
+     * @param minInterval Shortest interval between polls, in seconds
+     * @param maxInterval Longest interval between polls, in seconds
+     */
+    PollScheduler(time_t minInterval = 2, time_t maxInterval = 600);
+
+    /// Maximum number of polls per second sent to an endpoint. 0 for no limit.
+    void setRateLimit(unsigned limit);
+
+    /// Shortest interval between polls
+    time_t getMinInterval() const;
+
+    /// An operation (e.g. "STAGING") on the endpoint completed after latency seconds
+    void addSample(const std::string &operation, const std::string &endpoint, time_t latency);
+
+    /**
+     * Seconds to wait before polling again
+     *
+     * @param operation The kind of operation polled
+     * @param endpoint  The storage polled
+     * @param elapsed   Seconds since the operation started
+     * @param fallback  Interval to use if the history says nothing
+     */
+    time_t getPollInterval(const std::string &operation, const std::string &endpoint,
+        time_t elapsed, time_t fallback);
+
+    /**
+     * Book a poll of the endpoint, respecting the rate limit
+     *
+     * @param when  Preferred time
+     * @param now   Current time
+     * @return      The time booked, when or later
+     */
+    time_t reserve(const std::string &endpoint, time_t when, time_t now);
+
+private:
+    PollScheduler(PollScheduler const &) = delete;
+    PollScheduler& operator=(PollScheduler const &) = delete;
+
+    /// operation, endpoint
+    typedef std::pair<std::string, std::string> HistoryKey;
+
+    time_t minInterval;
+    time_t maxInterval;
+    unsigned rateLimit;
+
+    boost::mutex mutex;
+    /// latency of the latest operations, oldest first
+    std::map<HistoryKey, std::deque<time_t>> history;
+    /// polls booked per endpoint and second
+    std::map<std::string, std::map<time_t, unsigned>> booked;
+};
+
+
+/**
+ * When each URL of a request is to be polled next, so a poll only includes
+ * the URLs that are due. URLs never scheduled are due right away.
+ */
+class PollTimes
+{
+public:
+    /// The URLs of urls due by the given time
+    std::set<std::string> getDue(const std::set<std::string> &urls, time_t until) const;
+
+    /// Earliest poll time of urls
+    time_t getNext(const std::set<std::string> &urls) const;
+
+    void set(const std::string &url, time_t when);
+
+    void remove(const std::string &url);
+
+private:
+    std::map<std::string, time_t> times;
+};
+
+#endif // POLLSCHEDULER_H_
@@ -32,13 +32,20 @@ void PollTask::run(const boost::any&)
     // handle cancelled jobs/files
     handle_canceled();
 
-    int maxPollRetries = fts3::config::ServerConfig::instance().get<int>("StagingPollRetries");
-    bool forcePoll = false;
+    int maxPollRetries = fts3::config::ServerConfig::instance().values().stagingPollRetries;
 
     std::set<std::string> urlSet = ctx.getUrls();
     if (urlSet.empty())
         return;
 
+    // Only the URLs due, all of them in the same request
+    time_t now = time(NULL);
+    urlSet = pollTimes.getDue(urlSet, now + ctx.getPollScheduler().getMinInterval());
+    if (urlSet.empty()) {
+        reschedule(now);
+        return;
+    }
+
     std::vector<const char*> urls;
     urls.reserve(urlSet.size());
     for (auto set_i = urlSet.begin(); set_i != urlSet.end(); ++set_i) {
@@ -60,6 +67,13 @@ void PollTask::run(const boost::any&)
 
     int status = gfal2_bring_online_poll_list(gfal2_ctx, static_cast<int>(urls.size()), urls.data(), token.c_str(), errors.data());
 
+    // When to poll again the files still pending: retries back off as before,
+    // the others go by how long this endpoint usually takes
+    now = time(NULL);
+    time_t retryInterval = getPollInterval(++nPolls);
+    time_t pollInterval = ctx.getPollScheduler().getPollInterval("STAGING", ctx.getStorageEndpoint(),
+        now - ctx.getStartTime(), retryInterval);
+
     if (status < 0) {
         for (size_t i = 0; i < urls.size(); ++i) {
             auto ids = ctx.getIDs(urls[i]);
@@ -69,7 +83,7 @@ void PollTask::run(const boost::any&)
                     << "BRINGONLINE NOT FINISHED for " << urls[i]
                     << ". Communication error, soft failure: " << errors[i]->message
                     << commit;
-                forcePoll = true;
+                pollTimes.set(urls[i], now + retryInterval);
             }
             else if (errors[i]) {
                 failedUrls.push_back(urls[i]);
@@ -84,6 +98,8 @@ void PollTask::run(const boost::any&)
                         "FAILED", JobError("STAGING", errors[i])
                     );
                 }
+                ctx.removeUrl(urls[i]);
+                pollTimes.remove(urls[i]);
             } else {
                 failedUrls.push_back(urls[i]);
 
@@ -96,6 +112,8 @@ void PollTask::run(const boost::any&)
                         "FAILED", JobError("STAGING", -1, "Error not set by gfal2")
                     );
                 }
+                ctx.removeUrl(urls[i]);
+                pollTimes.remove(urls[i]);
             }
             g_clear_error(&errors[i]);
         }
@@ -112,11 +130,14 @@ void PollTask::run(const boost::any&)
                 FTS3_COMMON_LOGGER_NEWLOG(NOTICE)
                     << "BRINGONLINE FINISHED for "
                     << urls[i]
+                    << " time_to_stage=" << now - ctx.getStartTime()
                     << commit;
                 for (auto it = ids.begin(); it != ids.end(); ++it) {
                     ctx.updateState(it->first, it->second, "FINISHED", JobError());
                 }
                 ctx.removeUrl(urls[i]);
+                pollTimes.remove(urls[i]);
+                ctx.getPollScheduler().addSample("STAGING", ctx.getStorageEndpoint(), now - ctx.getStartTime());
             }
             else if (errors[i]->code == EAGAIN)
             {
@@ -124,13 +145,14 @@ void PollTask::run(const boost::any&)
                     << "BRINGONLINE NOT FINISHED for " << urls[i]
                     << ": " << errors[i]->message
                     << commit;
+                pollTimes.set(urls[i], now + pollInterval);
             }
             else if (errors[i] && errors[i]->code == ECOMM && ctx.incrementErrorCountForSurl(urls[i]) < maxPollRetries) {
                 FTS3_COMMON_LOGGER_NEWLOG(NOTICE)
                     << "BRINGONLINE NOT FINISHED for " << urls[i]
                     << ". Communication error, soft failure: " << errors[i]->message
                     << commit;
-                forcePoll = true;
+                pollTimes.set(urls[i], now + retryInterval);
             } else {
                 failedUrls.push_back(urls[i]);
 
@@ -175,19 +197,24 @@ void PollTask::run(const boost::any&)
         }
     }
 
-    // If status was 0, not everything is terminal, so schedule a new poll
-    if (status == 0 || forcePoll) {
-        time_t interval = getPollInterval(++nPolls);
-        time_t now = time(NULL);
-        wait_until = now + interval;
-
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "BRINGONLINE polling " << ctx.getLogMsg() << commit;
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "BRINGONLINE next attempt in " << interval << " seconds" << commit;
-        ctx.getWaitingRoom().add(new PollTask(std::move(*this)));
+    // Schedule a new poll if some files are not terminal yet, or were not polled this time
+    if (!ctx.getUrls().empty()) {
+        reschedule(now);
     }
 }
 
 
+void PollTask::reschedule(time_t now)
+{
+    time_t next = pollTimes.getNext(ctx.getUrls());
+    wait_until = ctx.getPollScheduler().reserve(ctx.getStorageEndpoint(), next, now);
+
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "BRINGONLINE polling " << ctx.getLogMsg() << commit;
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "BRINGONLINE next attempt in " << wait_until - now << " seconds" << commit;
+    ctx.getWaitingRoom().add(new PollTask(std::move(*this)));
+}
+
+
 void PollTask::handle_canceled()
 {
     std::set<std::pair<std::string, std::string>> remove;
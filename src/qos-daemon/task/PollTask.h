@@ -33,6 +33,7 @@
 #include "db/generic/SingleDbInstance.h"
 
 #include "BringOnlineTask.h"
+#include "PollScheduler.h"
 
 
 /**
@@ -76,7 +77,7 @@ public:
      */
     PollTask(PollTask && copy) :
         BringOnlineTask(std::move(copy)), token(copy.token), nPolls(copy.nPolls), wait_until(
-            copy.wait_until)
+            copy.wait_until), pollTimes(std::move(copy.pollTimes))
     {
     }
 
@@ -91,11 +92,11 @@ public:
     virtual void run(const boost::any &);
 
     /**
-     * @return : true if the task is still waiting, false otherwise
+     * @return : the time the task is due to run again
      */
-    bool waiting(time_t now)
+    time_t getWaitUntil() const
     {
-        return wait_until > now;
+        return wait_until;
     }
 
 private:
@@ -108,6 +109,9 @@ private:
     /// aborts the bring online operation for the given URLs
     void abort(std::set<std::string> const & urls, bool report = true);
 
+    /// puts the task back in the waiting room, until the next URL is due
+    void reschedule(time_t now);
+
     /**
      * Gets the interval after next polling should be done
      *
@@ -129,6 +133,9 @@ private:
 
     /// wait in the wait room until given time
     time_t wait_until;
+
+    /// when to poll each URL next
+    PollTimes pollTimes;
 };
 
 #endif // POLLTASK_H_
@@ -22,16 +22,22 @@
 #ifndef WAITINGROOM_H_
 #define WAITINGROOM_H_
 
-#include <boost/ptr_container/ptr_list.hpp> // think about using a lockfree queue
+#include <vector>
+#include <boost/core/demangle.hpp>
 #include <boost/thread.hpp>
 
+#include "common/Logger.h"
 #include "common/ThreadPool.h"
+#include "common/TimerQueue.h"
 
 #include "qos-daemon/task/Gfal2Task.h"
 
 
 /**
  * A waiting room for task that will be executed in a while
+ *
+ * Tasks are kept ordered by the time they are due (TASK::getWaitUntil),
+ * so every pass only looks at the ones that expired.
  */
 template<typename TASK, typename BASE = Gfal2Task>
 class WaitingRoom
@@ -41,7 +47,7 @@ public:
     /**
      * Default constructor
      */
-    WaitingRoom(): pool(NULL) {}
+    WaitingRoom(): pool(NULL), dispatched(0), totalLateness(0), maxLateness(0) {}
 
 
     /**
@@ -52,7 +58,7 @@ public:
     void add(TASK* task)
     {
         boost::mutex::scoped_lock lock(m);
-        tasks.push_back(task);
+        tasks.push(task->getWaitUntil(), task);
     }
 
     /**
@@ -65,6 +71,15 @@ public:
         this->pool = &pool;
     }
 
+    /**
+     * @return number of tasks waiting
+     */
+    size_t size()
+    {
+        boost::mutex::scoped_lock lock(m);
+        return tasks.size();
+    }
+
     /**
      * Destructor
      */
@@ -87,12 +102,21 @@ private:
      */
     WaitingRoom& operator=(WaitingRoom const &) = delete;
 
-    /// the queue with tasks that are waiting
-    boost::ptr_list<TASK> tasks;
+    /// log the backlog, and how late the tasks were started, then reset the counters
+    void report();
+
+    /// the tasks that are waiting, earliest first
+    fts3::common::TimerQueue<TASK> tasks;
     /// the mutex preventing concurrent access
     boost::mutex m;
     /// the threadpool items are waiting for
     ThreadPool<BASE> * pool;
+
+    /// tasks started since the last report
+    uint64_t dispatched;
+    /// seconds they were started after they were due, summed and worst
+    uint64_t totalLateness;
+    time_t maxLateness;
 };
 
 template <typename TASK, typename BASE>
@@ -100,26 +124,40 @@ void WaitingRoom<TASK, BASE>::run()
 {
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "WaitingRoom starting" << commit;
 
+    // how often the backlog is logged, in seconds
+    const time_t reportInterval = 300;
+    time_t lastReport = time(NULL);
+    std::vector<TASK*> expired;
+
     while (!boost::this_thread::interruption_requested()) {
         try {
             boost::this_thread::sleep(boost::posix_time::seconds(1));
 
-            // lock the mutex
-            boost::mutex::scoped_lock lock(this->m);
             // get current time
             time_t now = time(NULL);
-            // iterate over all all tasks
-            typename boost::ptr_list<TASK>::iterator it, next = this->tasks.begin();
-            while ((it = next) != this->tasks.end()) {
-                if (boost::this_thread::interruption_requested())
-                    return;
-                // next item to check
-                ++next;
-                // if the time has not yet come for the task simply continue
-                if (it->waiting(now))
-                    continue;
-                // otherwise start the task
-                this->pool->start(this->tasks.release(it).release());
+            // only take the expired tasks under the lock, so add is not blocked
+            // while they are handed to the thread pool
+            {
+                boost::mutex::scoped_lock lock(this->m);
+                time_t due;
+                while (TASK *task = this->tasks.pop(now, &due)) {
+                    expired.push_back(task);
+                    ++dispatched;
+                    totalLateness += now - due;
+                    maxLateness = std::max(maxLateness, now - due);
+                }
+            }
+            for (size_t i = 0; i < expired.size(); ++i) {
+                // the pool takes ownership, even if interrupted right after
+                TASK *task = expired[i];
+                expired[i] = NULL;
+                this->pool->start(task);
+            }
+            expired.clear();
+
+            if (now - lastReport >= reportInterval) {
+                report();
+                lastReport = now;
             }
         }
         catch (const boost::thread_interrupted&) {
@@ -132,10 +170,30 @@ void WaitingRoom<TASK, BASE>::run()
         catch (...) {
             FTS3_COMMON_LOGGER_NEWLOG(ERR) << "WaitingRoom unknown exception" << commit;
         }
+        // any task not handed over yet
+        for (size_t i = 0; i < expired.size(); ++i) {
+            delete expired[i];
+        }
+        expired.clear();
     }
 
+    boost::mutex::scoped_lock lock(this->m);
     tasks.clear();
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "WaitingRoom exiting" << commit;
 }
 
+template <typename TASK, typename BASE>
+void WaitingRoom<TASK, BASE>::report()
+{
+    size_t backlog = size();
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "WaitingRoom " << boost::core::demangle(typeid(TASK).name())
+        << ": backlog=" << backlog
+        << " dispatched=" << dispatched
+        << " avg_lateness=" << (dispatched ? totalLateness / dispatched : 0)
+        << " max_lateness=" << maxLateness
+        << commit;
+    dispatched = totalLateness = 0;
+    maxLateness = 0;
+}
+
 #endif // WAITINGROOM_H_
@@ -76,7 +76,7 @@ public:
             return true;
         }
 
-        size_t requiredRam = config::ServerConfig::instance().get<size_t>("MinRequiredFreeRAM");
+        size_t requiredRam = config::ServerConfig::instance().values().minRequiredFreeRAM;
         size_t availableRam = getFreeRamInMb();
         bool drain = DBSingleton::instance().getDBObjectInstance()->getDrain();
 
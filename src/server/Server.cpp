@@ -22,6 +22,7 @@
 
 #include "common/Logger.h"
 #include "config/ServerConfig.h"
+#include "db/generic/SingleDbInstance.h"
 #include "services/cleaner/CleanerService.h"
 #include "services/transfers/TransfersService.h"
 #include "services/transfers/ReuseTransfersService.h"
@@ -74,7 +75,7 @@ void Server::start()
 {
     auto heartBeatService = new HeartBeat;
     addService(new CleanerService);
-    addService(new MessageProcessingService);
+    addService(new MessageProcessingService(db::DBSingleton::instance().getDBObjectInstance()));
     addService(heartBeatService);
 
     // Give cleaner and heartbeat some time ahead
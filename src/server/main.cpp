@@ -34,6 +34,7 @@
 #include "db/generic/SingleDbInstance.h"
 
 #include "Server.h"
+#include "services/transfers/ProcessLauncher.h"
 
 
 namespace fs = boost::filesystem;
@@ -100,6 +101,9 @@ static void doServer(void)
     }
     theLogger().setLogLevel(Logger::getLogLevel(ServerConfig::instance().get<std::string>("LogLevel")));
     theLogger().setProfiling(ServerConfig::instance().get<bool>("Profiling"));
+    theLogger().setAsync(ServerConfig::instance().get<bool>("LogAsync"),
+        ServerConfig::instance().get<unsigned>("LogAsyncQueueSize"),
+        ServerConfig::instance().get<bool>("LogAsyncDropOnFull"));
 
     FTS3_COMMON_LOGGER_NEWLOG(INFO)<< "Starting server..." << commit;
 
@@ -210,6 +214,16 @@ static void spawnServer(int argc, char** argv)
     // Register PID file
     createPidFile(pidDir, "fts-server.pid");
 
+    // Fork the launcher of fts_url_copy while this process is still small, and has no threads
+    if (ServerConfig::instance().get<bool>("UrlCopyLauncher")) {
+        try {
+            ProcessLauncher::instance().start();
+        }
+        catch (const std::exception &e) {
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << e.what() << ". fts_url_copy will be forked by the server" << commit;
+        }
+    }
+
     // Register signal handlers
     panic::setup_signal_handlers(shutdownCallback, NULL);
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Signal handlers installed" << commit;
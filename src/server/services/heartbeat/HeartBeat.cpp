@@ -96,6 +96,14 @@ void HeartBeat::runService()
                 << " [" << start << ':' << end << ']'
                 << commit;
 
+            std::vector<std::pair<unsigned, unsigned>> previousRanges;
+            previousRanges.swap(hashRanges);
+            db::DBSingleton::instance().getDBObjectInstance()->getHashSegment(&hashRanges);
+            if (hashRanges != previousRanges) {
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Hash ranges changed: " << hashRanges.size()
+                    << " ranges owned" << commit;
+            }
+
             // It the update was successful, we sleep here
             // If it wasn't, only one second will pass until the next retry
             boost::this_thread::sleep(heartBeatInterval);
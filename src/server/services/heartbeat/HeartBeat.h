@@ -22,7 +22,10 @@
 #ifndef HEARTBEAT_H_
 #define HEARTBEAT_H_
 
+#include <cstdint>
 #include <ctime>
+#include <utility>
+#include <vector>
 #include "../BaseService.h"
 
 
@@ -43,6 +46,8 @@ public:
 
 private:
     unsigned index, count, start, end;
+    /// Hash ranges owned as of the last beat
+    std::vector<std::pair<unsigned, unsigned>> hashRanges;
 
     bool criticalThreadExpired(time_t retrieveRecords, time_t updateRecords,
             time_t stallRecords);
@@ -18,11 +18,15 @@
  * limitations under the License.
  */
 
+#include <vector>
+
 #include "config/ServerConfig.h"
 #include "Optimizer.h"
 #include "OptimizerConstants.h"
+#include "PairStatistics.h"
 #include "common/Exceptions.h"
 #include "common/Logger.h"
+#include "common/ThreadPool.h"
 
 using namespace fts3::common;
 using namespace fts3::config;
@@ -31,12 +35,49 @@ namespace fts3 {
 namespace optimizer {
 
 
+// Computes the decisions for a contiguous shard of the pairs
+class OptimizerShard {
+public:
+    typedef std::vector<std::map<Pair, PairData>::const_iterator> Items;
+
+    OptimizerShard(const boost::function<PairDecision (const Pair&, const PairData&)> &optimize,
+        const Items &items, std::map<Pair, PairDecision> &decisions, size_t begin, size_t end):
+        optimize(optimize), items(items), decisions(decisions), begin(begin), end(end)
+    {
+    }
+
+    void run(boost::any&)
+    {
+        for (size_t i = begin; i < end; ++i) {
+            // decisions is pre-populated, so each shard only touches its own values
+            PairDecision &decision = decisions.find(items[i]->first)->second;
+            try {
+                decision = optimize(items[i]->first, items[i]->second);
+            }
+            catch (const std::exception &e) {
+                FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Optimizer failed for " << items[i]->first
+                    << ": " << e.what() << commit;
+            }
+            catch (...) {
+                FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Optimizer failed for " << items[i]->first << commit;
+            }
+        }
+    }
+
+private:
+    boost::function<PairDecision (const Pair&, const PairData&)> optimize;
+    const Items &items;
+    std::map<Pair, PairDecision> &decisions;
+    size_t begin, end;
+};
+
+
 Optimizer::Optimizer(OptimizerDataSource *ds, OptimizerCallbacks *callbacks):
     dataSource(ds), callbacks(callbacks),
     optimizerSteadyInterval(boost::posix_time::seconds(60)), maxNumberOfStreams(10),
     maxSuccessRate(100), lowSuccessRate(97), baseSuccessRate(96),
     decreaseStepSize(1), increaseStepSize(1), increaseAggressiveStepSize(2),
-    emaAlpha(EMA_ALPHA)
+    emaAlpha(EMA_ALPHA), workers(1), statistics(new PairStatistics)
 {
 }
 
@@ -90,18 +131,59 @@ void Optimizer::setEmaAlpha(double alpha)
 }
 
 
+void Optimizer::setWorkers(int newValue)
+{
+    workers = std::max(newValue, 1);
+}
+
+
 void Optimizer::run(void)
 {
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Optimizer run" << commit;
     try {
-        std::list<Pair> pairs = dataSource->getActivePairs();
-        // Make sure the order is always the same
-        // See FTS-1094
-        pairs.sort();
+        const time_t now = time(NULL);
+        updateStatistics(now);
+
+        std::map<Pair, PairData> pairs;
+        dataSource->getPairsData(&pairs);
+        for (auto i = pairs.begin(); i != pairs.end(); ++i) {
+            statistics->getState(i->first, i->second.running, now, &i->second.current);
+        }
 
+        // The map keeps the order always the same
+        // See FTS-1094
+        OptimizerShard::Items items;
+        std::map<Pair, PairDecision> decisions;
         for (auto i = pairs.begin(); i != pairs.end(); ++i) {
-            runOptimizerForPair(*i);
+            items.push_back(i);
+            decisions.insert(decisions.end(), std::make_pair(i->first, PairDecision()));
+        }
+
+        boost::function<PairDecision (const Pair&, const PairData&)> optimize =
+            boost::bind(&Optimizer::optimizePair, this, _1, _2);
+
+        const size_t shardSize = std::max<size_t>(1, (items.size() + workers - 1) / workers);
+        if (workers == 1 || items.size() <= shardSize) {
+            boost::any context;
+            OptimizerShard(optimize, items, decisions, 0, items.size()).run(context);
         }
+        else {
+            if (!pool || pool->size() != static_cast<size_t>(workers)) {
+                pool.reset(new ThreadPool<OptimizerShard>(workers));
+            }
+            for (size_t begin = 0; begin < items.size(); begin += shardSize) {
+                pool->start(new OptimizerShard(optimize, items, decisions,
+                    begin, std::min(begin + shardSize, items.size())));
+            }
+            pool->wait();
+        }
+
+        for (auto i = decisions.begin(); i != decisions.end(); ++i) {
+            applyDecision(i->first, i->second);
+        }
+        commitDecisions(decisions);
+
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Optimizer run over " << pairs.size() << " pairs" << commit;
     }
     catch (std::exception &e) {
         throw SystemError(std::string(__func__) + ": Caught exception " + e.what());
@@ -112,12 +194,97 @@ void Optimizer::run(void)
 }
 
 
+void Optimizer::updateStatistics(time_t now)
+{
+    std::vector<TerminatedTransfer> terminated;
+    dataSource->getTerminatedSince(statistics->getScanStart(now), &terminated);
+    for (auto i = terminated.begin(); i != terminated.end(); ++i) {
+        statistics->add(*i);
+    }
+    statistics->expire(now);
+
+    FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Optimizer folded " << terminated.size()
+        << " terminated transfers into the statistics" << commit;
+}
+
+
 void Optimizer::runOptimizerForPair(const Pair &pair)
 {
-    OptimizerMode optMode = dataSource->getOptimizerMode(pair.source, pair.destination);
-    if(optimizeConnectionsForPair(optMode, pair)) {
-        // Optimize streams only if optimizeConnectionsForPair did store something
-        optimizeStreamsForPair(optMode, pair);
+    PairData data;
+    getPairData(pair, &data);
+
+    std::map<Pair, PairDecision> decisions;
+    decisions[pair] = optimizePair(pair, data);
+    applyDecision(pair, decisions[pair]);
+    commitDecisions(decisions);
+}
+
+
+void Optimizer::getPairData(const Pair &pair, PairData *data)
+{
+    data->optMode = dataSource->getOptimizerMode(pair.source, pair.destination);
+    dataSource->getPairLimits(pair, &data->range, &data->limits);
+    data->previousValue = dataSource->getOptimizerValue(pair);
+
+    PairState &current = data->current;
+    current.timestamp = time(NULL);
+    current.avgDuration = dataSource->getAverageDuration(pair, boost::posix_time::minutes(30));
+
+    boost::posix_time::time_duration timeFrame = calculateTimeFrame(current.avgDuration);
+
+    dataSource->getThroughputInfo(pair, timeFrame,
+        &current.throughput, &current.filesizeAvg, &current.filesizeStdDev);
+    current.successRate = dataSource->getSuccessRateForPair(pair, timeFrame, &current.retryCount);
+    current.activeCount = dataSource->getActive(pair);
+    current.queueSize = dataSource->getSubmitted(pair);
+
+    if (data->limits.throughputSource > 0) {
+        data->throughputAsSource = dataSource->getThroughputAsSource(pair.source);
+    }
+    if (data->limits.throughputDestination > 0) {
+        data->throughputAsDestination = dataSource->getThroughputAsDestination(pair.destination);
+    }
+}
+
+
+PairDecision Optimizer::optimizePair(const Pair &pair, const PairData &data) const
+{
+    PairDecision decision = optimizeConnectionsForPair(pair, data);
+    // Optimize streams only if there is a new decision for the connections
+    if (decision.store) {
+        decision.streams = optimizeStreamsForPair(data.optMode, decision.memory);
+    }
+    return decision;
+}
+
+
+void Optimizer::applyDecision(const Pair &pair, const PairDecision &decision)
+{
+    if (decision.store) {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO)
+            << "Optimizer: Active for " << pair << " set to " << decision.decision
+            << ", running " << decision.current.activeCount
+            << " (" << decision.elapsed.wall << "ns)" << commit;
+        FTS3_COMMON_LOGGER_NEWLOG(INFO)
+            << decision.rationale << commit;
+    }
+    if (decision.remember) {
+        inMemoryStore[pair] = decision.memory;
+    }
+}
+
+
+void Optimizer::commitDecisions(const std::map<Pair, PairDecision> &decisions)
+{
+    dataSource->storeOptimizerDecisions(decisions);
+
+    if (callbacks) {
+        for (auto i = decisions.begin(); i != decisions.end(); ++i) {
+            if (i->second.store) {
+                callbacks->notifyDecision(i->first, i->second.decision, i->second.current,
+                    i->second.diff, i->second.rationale);
+            }
+        }
     }
 }
 
@@ -23,7 +23,9 @@
 
 #include <list>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/noncopyable.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -32,6 +34,7 @@
 #include <db/generic/Pair.h>
 #include <msg-bus/producer.h>
 
+#include "common/ThreadPool.h"
 #include "common/Uri.h"
 
 
@@ -81,6 +84,84 @@ struct PairState {
         activeCount(ac), queueSize(qs), ema(ema), filesizeAvg(0), filesizeStdDev(0), connections(conn) {}
 };
 
+// Transfer that reached a terminal state, or went back to SUBMITTED to be retried
+struct TerminatedTransfer {
+    uint64_t fileId;
+    Pair pair;
+    std::string state;
+    time_t start, end;
+    int64_t filesize;
+    double txDuration;
+    int retry;
+    // Set if the failure can be recovered from
+    bool recoverable;
+
+    TerminatedTransfer(uint64_t fileId, const Pair &pair, const std::string &state):
+        fileId(fileId), pair(pair), state(state), start(0), end(0), filesize(0), txDuration(0),
+        retry(0), recoverable(false) {}
+};
+
+// Transfer still running
+struct RunningTransfer {
+    time_t start;
+    int64_t transferred, filesize;
+
+    RunningTransfer(): start(0), transferred(0), filesize(0) {}
+};
+
+// Everything the optimizer needs to know about a pair to take a decision
+struct PairData {
+    OptimizerMode optMode;
+    // As configured, before applying the defaults
+    Range range;
+    StorageLimits limits;
+    // Last stored decision, 0 if there is none
+    int previousValue;
+    // Observed state, ema and connections are not set
+    PairState current;
+    // Transfers of the pair still running
+    std::vector<RunningTransfer> running;
+    // Current throughput of the source and destination, only needed if they are limited
+    double throughputAsSource, throughputAsDestination;
+
+    PairData(): optMode(kOptimizerDisabled), previousValue(0),
+                throughputAsSource(0), throughputAsDestination(0) {}
+};
+
+// Outcome of running the optimizer for a pair
+struct PairDecision {
+    // Set if there is a decision to store
+    bool store;
+    int decision;
+    int diff;
+    std::string rationale;
+    int streams;
+    // State stored and notified with the decision
+    PairState current;
+    // Set if the optimizer must remember memory for the next run
+    bool remember;
+    PairState memory;
+    boost::timer::cpu_times elapsed;
+
+    PairDecision(): store(false), decision(0), diff(0), streams(1), remember(false) {
+        elapsed.clear();
+    }
+};
+
+// Pick the time window to look at, depending on how long transfers take
+inline boost::posix_time::time_duration calculateTimeFrame(time_t avgDuration)
+{
+    if(avgDuration > 0 && avgDuration < 30) {
+        return boost::posix_time::minutes(5);
+    }
+    else if(avgDuration > 30 && avgDuration < 900) {
+        return boost::posix_time::minutes(15);
+    }
+    else {
+        return boost::posix_time::minutes(30);
+    }
+}
+
 // To decouple the optimizer core logic from the data storage/representation
 class OptimizerDataSource {
 public:
@@ -122,6 +203,17 @@ public:
 
     // Permanently register the number of streams per active
     virtual void storeOptimizerStreams(const Pair &pair, int streams) = 0;
+
+    // Bulk version of the above, for all the pairs with active or submitted transfers
+    // Throughput, file size statistics, average duration and success rate are not set,
+    // since they are derived from the terminated transfers
+    virtual void getPairsData(std::map<Pair, PairData> *pairs) = 0;
+
+    // Get the transfers that terminated since the given time
+    virtual void getTerminatedSince(time_t since, std::vector<TerminatedTransfer> *transfers) = 0;
+
+    // Permanently register the decisions that have store set, and their number of streams
+    virtual void storeOptimizerDecisions(const std::map<Pair, PairDecision> &decisions) = 0;
 };
 
 // Used by the optimizer to notify decisions
@@ -131,6 +223,9 @@ public:
         int diff, const std::string &rationale) = 0;
 };
 
+class PairStatistics;
+class OptimizerShard;
+
 // Optimizer implementation
 class Optimizer: public boost::noncopyable {
 protected:
@@ -146,20 +241,39 @@ protected:
     int decreaseStepSize;
     int increaseStepSize, increaseAggressiveStepSize;
     double emaAlpha;
+    int workers;
+    // Runs the shards when there is more than one worker. Kept between runs.
+    std::unique_ptr<fts3::common::ThreadPool<OptimizerShard>> pool;
+    // Kept up to date with the transfers that terminate between runs
+    std::unique_ptr<PairStatistics> statistics;
+
+    // Fold into the statistics the transfers that terminated since the last run
+    void updateStatistics(time_t now);
+
+    // Query the data source for everything needed to optimize the pair
+    void getPairData(const Pair &pair, PairData *data);
+
+    // Run the optimization algorithms for the pair. Only reads the in-memory state,
+    // so it can run concurrently for different pairs.
+    PairDecision optimizePair(const Pair &pair, const PairData &data) const;
 
     // Run the optimization algorithm for the number of connections.
-    // Returns true if a decision is stored
-    bool optimizeConnectionsForPair(OptimizerMode optMode, const Pair &);
+    PairDecision optimizeConnectionsForPair(const Pair &pair, const PairData &data) const;
 
     // Run the optimization algorithm for the number of streams.
-    void optimizeStreamsForPair(OptimizerMode optMode, const Pair &);
+    int optimizeStreamsForPair(OptimizerMode optMode, const PairState &state) const;
 
     // Stores into rangeActiveMin and rangeActiveMax the working range for the optimizer
     void getOptimizerWorkingRange(const Pair &pair, Range *range, StorageLimits *limits);
 
-    // Updates decision
-    void setOptimizerDecision(const Pair &pair, int decision, const PairState &current,
-        int diff, const std::string &rationale, boost::timer::cpu_times elapsed);
+    // Apply the defaults to the configured working range
+    void setWorkingRangeDefaults(const Pair &pair, Range *range, StorageLimits *limits) const;
+
+    // Updates the in-memory state with the decision
+    void applyDecision(const Pair &pair, const PairDecision &decision);
+
+    // Stores and notifies the decisions
+    void commitDecisions(const std::map<Pair, PairDecision> &decisions);
 
 public:
     Optimizer(OptimizerDataSource *ds, OptimizerCallbacks *callbacks);
@@ -172,6 +286,8 @@ public:
     void setBaseSuccessRate(int);
     void setStepSize(int increase, int increaseAggressive, int decrease);
     void setEmaAlpha(double);
+    // Number of threads used to compute the decisions
+    void setWorkers(int);
     void run(void);
     void runOptimizerForPair(const Pair&);
 };
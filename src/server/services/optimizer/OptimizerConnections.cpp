@@ -40,25 +40,16 @@ static inline double exponentialMovingAverage(double sample, double alpha, doubl
 }
 
 
-static boost::posix_time::time_duration calculateTimeFrame(time_t avgDuration)
-{
-    if(avgDuration > 0 && avgDuration < 30) {
-        return boost::posix_time::minutes(5);
-    }
-    else if(avgDuration > 30 && avgDuration < 900) {
-        return boost::posix_time::minutes(15);
-    }
-    else {
-        return boost::posix_time::minutes(30);
-    }
-}
-
-
 void Optimizer::getOptimizerWorkingRange(const Pair &pair, Range *range, StorageLimits *limits)
 {
     // Query specific limits
     dataSource->getPairLimits(pair, range, limits);
+    setWorkingRangeDefaults(pair, range, limits);
+}
 
+
+void Optimizer::setWorkingRangeDefaults(const Pair &pair, Range *range, StorageLimits *limits) const
+{
     // If range not set, use defaults
     if (range->min <= 0) {
         if (pair.isLanTransfer()) {
@@ -152,13 +143,29 @@ static int optimizeGoodSuccessRate(const PairState &current, const PairState &pr
     return decision;
 }
 
+// Set the decision to be stored, and remembered for the next run
+static void setDecision(PairDecision *result, int decision, const PairState &current,
+    int diff, const std::string &rationale, const boost::timer::cpu_timer &timer)
+{
+    result->store = true;
+    result->decision = decision;
+    result->diff = diff;
+    result->rationale = rationale;
+    result->current = current;
+    result->remember = true;
+    result->memory = current;
+    result->memory.connections = decision;
+    result->elapsed = timer.elapsed();
+}
+
 // This algorithm idea is similar to the TCP congestion window.
 // It gives priority to success rate. If it gets worse, it will back off reducing
 // the total number of connections between storages.
 // If the success rate is good, and the throughput improves, it will increase the number
 // of connections.
-bool Optimizer::optimizeConnectionsForPair(OptimizerMode optMode, const Pair &pair)
+PairDecision Optimizer::optimizeConnectionsForPair(const Pair &pair, const PairData &data) const
 {
+    PairDecision result;
     int decision = 0;
     std::stringstream rationale;
 
@@ -166,27 +173,19 @@ bool Optimizer::optimizeConnectionsForPair(OptimizerMode optMode, const Pair &pa
     boost::timer::cpu_timer timer;
 
     // Optimizer working values
-    Range range;
-    StorageLimits limits;
-    getOptimizerWorkingRange(pair, &range, &limits);
+    Range range = data.range;
+    StorageLimits limits = data.limits;
+    setWorkingRangeDefaults(pair, &range, &limits);
 
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Optimizer range for " << pair << ": " << range  << commit;
 
-    // Previous decision
-    int previousValue = dataSource->getOptimizerValue(pair);
-
-    // Initialize current state
-    PairState current;
-    current.timestamp = time(NULL);
-    current.avgDuration = dataSource->getAverageDuration(pair, boost::posix_time::minutes(30));
+    const OptimizerMode optMode = data.optMode;
 
-    boost::posix_time::time_duration timeFrame = calculateTimeFrame(current.avgDuration);
+    // Previous decision
+    const int previousValue = data.previousValue;
 
-    dataSource->getThroughputInfo(pair, timeFrame,
-        &current.throughput, &current.filesizeAvg, &current.filesizeStdDev);
-    current.successRate = dataSource->getSuccessRateForPair(pair, timeFrame, &current.retryCount);
-    current.activeCount = dataSource->getActive(pair);
-    current.queueSize = dataSource->getSubmitted(pair);
+    // Current state
+    PairState current = data.current;
 
     // There is no value yet. In this case, pick the high value if configured, mid-range otherwise.
     if (previousValue == 0) {
@@ -198,50 +197,50 @@ bool Optimizer::optimizeConnectionsForPair(OptimizerMode optMode, const Pair &pa
             rationale << "No information. Start halfway.";
         }
 
-        setOptimizerDecision(pair, decision, current, decision, rationale.str(), timer.elapsed());
+        setDecision(&result, decision, current, decision, rationale.str(), timer);
 
         current.ema = current.throughput;
-        inMemoryStore[pair] = current;
+        result.memory = current;
 
-        return true;
+        return result;
     }
 
     // There is information, but it is the first time seen since the restart
-    if (inMemoryStore.find(pair) == inMemoryStore.end()) {
+    auto previousIter = inMemoryStore.find(pair);
+    if (previousIter == inMemoryStore.end()) {
         current.ema = current.throughput;
-        inMemoryStore[pair] = current;
+        result.remember = true;
+        result.memory = current;
         FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Store first feedback from " << pair << commit;
-        return false;
+        return result;
     }
 
-    const PairState previous = inMemoryStore[pair];
+    const PairState previous = previousIter->second;
 
     // Calculate new Exponential Moving Average
     current.ema = exponentialMovingAverage(current.throughput, emaAlpha, previous.ema);
 
     // If we have no range, leave it here
     if (range.min == range.max) {
-        setOptimizerDecision(pair, range.min, current, 0, "Range fixed", timer.elapsed());
-        return true;
+        setDecision(&result, range.min, current, 0, "Range fixed", timer);
+        return result;
     }
 
     // Apply bandwidth limits
     if (limits.throughputSource > 0) {
-        double throughput = dataSource->getThroughputAsSource(pair.source);
-        if (throughput > limits.throughputSource) {
+        if (data.throughputAsSource > limits.throughputSource) {
             decision = previousValue - decreaseStepSize;
             rationale << "Source throughput limitation reached (" << limits.throughputSource << ")";
-            setOptimizerDecision(pair, decision, current, 0, rationale.str(), timer.elapsed());
-            return true;
+            setDecision(&result, decision, current, 0, rationale.str(), timer);
+            return result;
         }
     }
     if (limits.throughputDestination > 0) {
-        double throughput = dataSource->getThroughputAsDestination(pair.destination);
-        if (throughput > limits.throughputDestination) {
+        if (data.throughputAsDestination > limits.throughputDestination) {
             decision = previousValue - decreaseStepSize;
             rationale << "Destination throughput limitation reached (" << limits.throughputDestination << ")";
-            setOptimizerDecision(pair, decision, current, 0, rationale.str(), timer.elapsed());
-            return true;
+            setDecision(&result, decision, current, 0, rationale.str(), timer);
+            return result;
         }
     }
 
@@ -255,7 +254,7 @@ bool Optimizer::optimizeConnectionsForPair(OptimizerMode optMode, const Pair &pa
             << "Optimizer for " << pair
             << ": Same success rate and throughput EMA, not enough time passed since last update. Skip"
             << commit;
-        return false;
+        return result;
     }
 
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG)
@@ -321,27 +320,8 @@ bool Optimizer::optimizeConnectionsForPair(OptimizerMode optMode, const Pair &pa
     BOOST_ASSERT(decision > 0);
     BOOST_ASSERT(!rationale.str().empty());
 
-    setOptimizerDecision(pair, decision, current, decision - previousValue, rationale.str(), timer.elapsed());
-    return true;
-}
-
-
-void Optimizer::setOptimizerDecision(const Pair &pair, int decision, const PairState &current,
-    int diff, const std::string &rationale, boost::timer::cpu_times elapsed)
-{
-    FTS3_COMMON_LOGGER_NEWLOG(INFO)
-        << "Optimizer: Active for " << pair << " set to " << decision << ", running " << current.activeCount
-        << " (" << elapsed.wall << "ns)" << commit;
-    FTS3_COMMON_LOGGER_NEWLOG(INFO)
-        << rationale << commit;
-
-    inMemoryStore[pair] = current;
-    inMemoryStore[pair].connections = decision;
-    dataSource->storeOptimizerDecision(pair, decision, current, diff, rationale);
-
-    if (callbacks) {
-        callbacks->notifyDecision(pair, decision, current, diff, rationale);
-    }
+    setDecision(&result, decision, current, decision - previousValue, rationale.str(), timer);
+    return result;
 }
 
 }
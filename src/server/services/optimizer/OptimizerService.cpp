@@ -97,6 +97,7 @@ void OptimizerService::runService()
     auto increaseStep = config::ServerConfig::instance().get<int>("OptimizerIncreaseStep");
     auto increaseAggressiveStep = config::ServerConfig::instance().get<int>("OptimizerAggressiveIncreaseStep");
     auto decreaseStep = config::ServerConfig::instance().get<int>("OptimizerDecreaseStep");
+    auto workers = config::ServerConfig::instance().get<int>("OptimizerThreadPool");
 
     OptimizerNotifier optimizerCallbacks(
         config::ServerConfig::instance().get<bool>("MonitoringMessaging"),
@@ -114,6 +115,7 @@ void OptimizerService::runService()
     optimizer.setBaseSuccessRate(baseSuccessRate);
     optimizer.setEmaAlpha(emaAlpha);
     optimizer.setStepSize(increaseStep, increaseAggressiveStep, decreaseStep);
+    optimizer.setWorkers(workers);
 
     while (!boost::this_thread::interruption_requested()) {
         try {
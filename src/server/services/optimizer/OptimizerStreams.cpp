@@ -33,16 +33,13 @@ namespace optimizer {
 // This part of the algorithm will check how to split the number of connections
 // between the number of available transfers.
 // Basically, divide the number of connections between the number of queued+active
-void Optimizer::optimizeStreamsForPair(OptimizerMode optMode, const Pair &pair)
+int Optimizer::optimizeStreamsForPair(OptimizerMode optMode, const PairState &state) const
 {
     // No optimization for streams, so go for 1
     if (optMode <= kOptimizerConservative) {
-        dataSource->storeOptimizerStreams(pair, 1);
-        return;
+        return 1;
     }
 
-    auto state = inMemoryStore[pair];
-
     int connectionsAvailable = state.connections;
     int availableTransfers = state.activeCount + state.queueSize;
     int streamsDecision = 1;
@@ -57,7 +54,7 @@ void Optimizer::optimizeStreamsForPair(OptimizerMode optMode, const Pair &pair)
         }
     }
 
-    dataSource->storeOptimizerStreams(pair, streamsDecision);
+    return streamsDecision;
 }
 
 
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+
+#include "PairStatistics.h"
+
+
+namespace fts3 {
+namespace optimizer {
+
+// Transfers may be committed a bit after their finish time, so each retrieval
+// goes back this many seconds over the previous one
+static const time_t SCAN_OVERLAP = 120;
+
+
+PairStatistics::PairStatistics(time_t bucketWidth, size_t nBuckets):
+    bucketWidth(bucketWidth), nBuckets(nBuckets), lastEnd(0)
+{
+}
+
+
+PairStatistics::Bucket *PairStatistics::getBucket(std::vector<Bucket> &buckets, time_t when)
+{
+    const time_t start = when - (when % bucketWidth);
+    Bucket &bucket = buckets[(start / bucketWidth) % nBuckets];
+    if (bucket.start > start) {
+        return NULL;
+    }
+    else if (bucket.start < start) {
+        bucket = Bucket();
+        bucket.start = start;
+    }
+    return &bucket;
+}
+
+
+void PairStatistics::add(const TerminatedTransfer &transfer)
+{
+    if (!seen.insert(std::make_pair(transfer.end, transfer.fileId)).second) {
+        return;
+    }
+    lastEnd = std::max(lastEnd, transfer.end);
+
+    std::vector<Bucket> &buckets = pairs[transfer.pair];
+    if (buckets.empty()) {
+        buckets.resize(nBuckets);
+    }
+
+    // Older than what the buckets hold now
+    Bucket *bucket = getBucket(buckets, transfer.end);
+    if (!bucket) {
+        return;
+    }
+    Bucket &endBucket = *bucket;
+    const bool finished = (transfer.state == "FINISHED" || transfer.state == "ARCHIVING");
+
+    if (finished) {
+        ++endBucket.finished;
+        if (transfer.txDuration > 0) {
+            endBucket.durationSum += transfer.txDuration;
+            ++endBucket.durationCount;
+        }
+        if (transfer.filesize > 0) {
+            endBucket.filesizeSum += transfer.filesize;
+            endBucket.filesizeSquaredSum += double(transfer.filesize) * transfer.filesize;
+            ++endBucket.filesizeCount;
+        }
+    }
+    else if (transfer.state == "FAILED" && transfer.recoverable) {
+        ++endBucket.failed;
+    }
+    else if (transfer.state == "SUBMITTED" && transfer.retry) {
+        ++endBucket.failed;
+        endBucket.retries += transfer.retry;
+    }
+
+    if (!finished) {
+        return;
+    }
+
+    // Spread the bytes over the period the transfer was running, so a window only
+    // accounts for the part that happened within it
+    const long duration = transfer.end - transfer.start;
+    if (duration <= 0) {
+        endBucket.bytes += transfer.filesize;
+    }
+    else if (transfer.filesize > 0) {
+        const double rate = double(transfer.filesize) / duration;
+        const time_t horizon = transfer.end - bucketWidth * static_cast<time_t>(nBuckets);
+        time_t from = std::max(transfer.start, horizon);
+        while (from < transfer.end) {
+            const time_t to = std::min(transfer.end, from - (from % bucketWidth) + bucketWidth);
+            bucket = getBucket(buckets, from);
+            if (bucket) {
+                bucket->bytes += rate * (to - from);
+            }
+            from = to;
+        }
+    }
+}
+
+
+void PairStatistics::expire(time_t now)
+{
+    const time_t horizon = now - bucketWidth * static_cast<time_t>(nBuckets);
+
+    while (!seen.empty() && seen.begin()->first < horizon) {
+        seen.erase(seen.begin());
+    }
+
+    for (auto i = pairs.begin(); i != pairs.end();) {
+        bool expired = true;
+        for (auto bucket = i->second.begin(); bucket != i->second.end(); ++bucket) {
+            if (bucket->start + bucketWidth > horizon) {
+                expired = false;
+                break;
+            }
+        }
+        if (expired) {
+            i = pairs.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+
+time_t PairStatistics::getScanStart(time_t now) const
+{
+    const time_t horizon = now - bucketWidth * static_cast<time_t>(nBuckets);
+    if (lastEnd == 0) {
+        return horizon;
+    }
+    return std::max(horizon, lastEnd - SCAN_OVERLAP);
+}
+
+
+PairStatistics::Bucket PairStatistics::summarize(const std::vector<Bucket> &buckets, time_t now,
+    time_t interval) const
+{
+    Bucket summary;
+    const time_t windowStart = now - interval;
+
+    for (auto bucket = buckets.begin(); bucket != buckets.end(); ++bucket) {
+        if (bucket->start == 0 || bucket->start + bucketWidth <= windowStart || bucket->start > now) {
+            continue;
+        }
+        summary.bytes += bucket->bytes;
+        summary.durationSum += bucket->durationSum;
+        summary.durationCount += bucket->durationCount;
+        summary.finished += bucket->finished;
+        summary.failed += bucket->failed;
+        summary.retries += bucket->retries;
+        summary.filesizeSum += bucket->filesizeSum;
+        summary.filesizeSquaredSum += bucket->filesizeSquaredSum;
+        summary.filesizeCount += bucket->filesizeCount;
+    }
+
+    return summary;
+}
+
+
+void PairStatistics::getState(const Pair &pair, const std::vector<RunningTransfer> &running, time_t now,
+    PairState *state) const
+{
+    static const std::vector<Bucket> noBuckets;
+
+    auto i = pairs.find(pair);
+    const std::vector<Bucket> &buckets = (i != pairs.end()) ? i->second : noBuckets;
+
+    // Average duration is always over the last 30 minutes
+    Bucket summary = summarize(buckets, now, boost::posix_time::minutes(30).total_seconds());
+    state->avgDuration = 0;
+    if (summary.durationCount > 0) {
+        state->avgDuration = summary.durationSum / summary.durationCount;
+    }
+
+    const time_t interval = calculateTimeFrame(state->avgDuration).total_seconds();
+    summary = summarize(buckets, now, interval);
+
+    // Running transfers count for the part that happened within the window
+    const time_t windowStart = now - interval;
+    double bytes = summary.bytes;
+    double filesizeSum = summary.filesizeSum;
+    double filesizeSquaredSum = summary.filesizeSquaredSum;
+    int filesizeCount = summary.filesizeCount;
+
+    for (auto j = running.begin(); j != running.end(); ++j) {
+        time_t periodInWindow = now - std::max(j->start, windowStart);
+        long duration = now - j->start;
+        if (duration > 0) {
+            bytes += double(j->transferred) / duration * periodInWindow;
+        }
+        if (j->filesize > 0) {
+            filesizeSum += j->filesize;
+            filesizeSquaredSum += double(j->filesize) * j->filesize;
+            ++filesizeCount;
+        }
+    }
+
+    state->throughput = bytes / interval;
+
+    state->filesizeAvg = state->filesizeStdDev = 0;
+    if (filesizeCount > 0) {
+        state->filesizeAvg = filesizeSum / filesizeCount;
+        double variance = filesizeSquaredSum / filesizeCount - state->filesizeAvg * state->filesizeAvg;
+        state->filesizeStdDev = sqrt(std::max(variance, 0.0));
+    }
+
+    // If there are no terminal, use 100% success rate rather than 0 to avoid
+    // the optimizer stepping back
+    state->retryCount = summary.retries;
+    const int total = summary.finished + summary.failed;
+    if (total > 0) {
+        state->successRate = ceil((summary.finished * 100.0) / total);
+    }
+    else {
+        state->successRate = 100.0;
+    }
+}
+
+}
+}
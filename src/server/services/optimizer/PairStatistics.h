@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FTS3_PAIRSTATISTICS_H
+#define FTS3_PAIRSTATISTICS_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "Optimizer.h"
+
+
+namespace fts3 {
+namespace optimizer {
+
+// Rolling statistics of the terminated transfers of each pair, kept in time buckets,
+// so the optimizer does not need to aggregate t_file over its time windows on every run.
+// Each terminated transfer is folded in once, and summaries only cost as much as the number of buckets.
+class PairStatistics {
+public:
+    // bucketWidth in seconds. bucketWidth * nBuckets is the widest window that can be summarized.
+    PairStatistics(time_t bucketWidth = 30, size_t nBuckets = 60);
+
+    // Fold in a terminated transfer. Transfers already folded in are ignored.
+    void add(const TerminatedTransfer &transfer);
+
+    // Forget everything that is older than the widest window
+    void expire(time_t now);
+
+    // From when the terminated transfers have to be retrieved to be up to date
+    // Overlaps a bit with the previous retrieval, to cope with late commits
+    time_t getScanStart(time_t now) const;
+
+    // Fills into state the average duration, throughput, file size statistics, success rate and retry count,
+    // as the windowed queries of the data source would do.
+    // running are the transfers of the pair still running.
+    void getState(const Pair &pair, const std::vector<RunningTransfer> &running, time_t now,
+        PairState *state) const;
+
+private:
+    struct Bucket {
+        time_t start;
+        double bytes;
+        double durationSum;
+        int durationCount;
+        int finished, failed, retries;
+        double filesizeSum, filesizeSquaredSum;
+        int filesizeCount;
+
+        Bucket(): start(0), bytes(0), durationSum(0), durationCount(0), finished(0), failed(0), retries(0),
+                  filesizeSum(0), filesizeSquaredSum(0), filesizeCount(0) {}
+    };
+
+    time_t bucketWidth;
+    size_t nBuckets;
+    std::map<Pair, std::vector<Bucket>> pairs;
+    // Transfers already folded in, as (end, file id), so they can be expired in order
+    std::set<std::pair<time_t, uint64_t>> seen;
+    time_t lastEnd;
+
+    // Bucket for the given time, reset if it was holding an older period
+    // NULL if it is already holding a newer period
+    Bucket *getBucket(std::vector<Bucket> &buckets, time_t when);
+
+    // Summarize the buckets that overlap the last interval seconds
+    Bucket summarize(const std::vector<Bucket> &buckets, time_t now, time_t interval) const;
+};
+
+}
+}
+
+#endif // FTS3_PAIRSTATISTICS_H
@@ -27,8 +27,10 @@
 #include "common/Logger.h"
 #include "config/ServerConfig.h"
 #include "server/DrainMode.h"
+#include "QueueIndex.h"
 #include "SingleTrStateInstance.h"
 #include "ThreadSafeList.h"
+#include "UrlCopyWorkerPool.h"
 
 
 using namespace fts3::common;
@@ -51,6 +53,17 @@ CancelerService::~CancelerService()
 }
 
 
+/// Kill the process running the transfer
+/// Url copy workers run several transfers one after the other, so a worker is only killed
+/// while it still runs this one
+static void killTransfer(pid_t pid, uint64_t fileId, int signal)
+{
+    if (UrlCopyWorkerPool::instance().mayKill(pid, fileId)) {
+        kill(pid, signal);
+    }
+}
+
+
 void CancelerService::markAsStalled()
 {
     auto db = DBSingleton::instance().getDBObjectInstance();
@@ -63,7 +76,7 @@ void CancelerService::markAsStalled()
     if (!messages.empty()) {
         FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Reaping stalled transfers" << commit;
 
-        boost::filesystem::path p(ServerConfig::instance().get<std::string>("MessagingDirectory"));
+        boost::filesystem::path p(ServerConfig::instance().values().messagingDirectory);
         boost::filesystem::space_info s = boost::filesystem::space(p);
         bool diskFull = (s.free <= 0 || s.available <= 0);
         std::stringstream reason;
@@ -80,7 +93,7 @@ void CancelerService::markAsStalled()
         for (auto i = messages.begin(); i != messages.end(); ++i) {
             // Make sure we don't kill ourselves
             if (i->process_id()) {
-                kill(i->process_id(), SIGKILL);
+                killTransfer(i->process_id(), i->file_id(), SIGKILL);
             }
             boost::tuple<bool, std::string> updated = db->updateTransferStatus(i->job_id(), i->file_id(), 0,
                 "FAILED", reason.str(), i->process_id(),
@@ -88,6 +101,7 @@ void CancelerService::markAsStalled()
             db->updateJobStatus(i->job_id(), "FAILED");
 
             if (updated.get<0>()) {
+                QueueIndex::instance().transferTerminated(i->file_id());
                 SingleTrStateInstance::instance().sendStateMessage(i->job_id(), i->file_id());
             }
             else {
@@ -102,12 +116,12 @@ void CancelerService::markAsStalled()
 
 void CancelerService::killCanceledByUser()
 {
-    std::vector<int> requestIDs;
-    DBSingleton::instance().getDBObjectInstance()->getCancelJob(requestIDs);
-    if (!requestIDs.empty())
+    std::vector<std::pair<int, uint64_t>> canceled;
+    DBSingleton::instance().getDBObjectInstance()->getCancelJob(canceled);
+    if (!canceled.empty())
     {
         FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Killing transfers canceled by the user" << commit;
-        killRunningJob(requestIDs);
+        killRunningJob(canceled);
     }
 }
 
@@ -143,7 +157,7 @@ void CancelerService::applyActiveTimeouts()
             FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Killing pid:" << i->pid
                 << ", jobid:" << i->jobId << ", fileid:" << i->fileId
                 << " because it was stalled" << commit;
-            kill(i->pid, SIGKILL);
+            killTransfer(i->pid, i->fileId, SIGKILL);
         }
         else {
             FTS3_COMMON_LOGGER_NEWLOG(WARNING)
@@ -154,6 +168,7 @@ void CancelerService::applyActiveTimeouts()
             "FAILED", "Transfer has been forced-killed because it was stalled",
             i->pid, 0, 0, false);
         db->updateJobStatus(i->jobId, "FAILED");
+        QueueIndex::instance().transferTerminated(i->fileId);
         SingleTrStateInstance::instance().sendStateMessage(i->jobId, i->fileId);
 
         fts3::events::MessageUpdater msg;
@@ -270,23 +285,32 @@ void CancelerService::runService()
 }
 
 
-void CancelerService::killRunningJob(const std::vector<int>& pids)
+void CancelerService::killRunningJob(const std::vector<std::pair<int, uint64_t>>& transfers)
 {
     int sigKillDelay = ServerConfig::instance().get<int>("SigKillDelay");
+    UrlCopyWorkerPool &pool = UrlCopyWorkerPool::instance();
 
-    for (auto iter = pids.begin(); iter != pids.end(); ++iter)
+    for (auto iter = transfers.begin(); iter != transfers.end(); ++iter)
     {
-        int pid = *iter;
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Canceling and killing running processes: " << pid << commit;
-        kill(pid, SIGTERM);
+        int pid = iter->first;
+        // The worker cancels the transfer, and goes on with the next one
+        if (pool.cancel(iter->second)) {
+            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Canceling transfer " << iter->second
+                << " in url copy worker " << pid << commit;
+        }
+        else if (pool.mayKill(pid, iter->second)) {
+            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Canceling and killing running processes: " << pid << commit;
+            kill(pid, SIGTERM);
+        }
     }
 
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Giving " << sigKillDelay << " ms for graceful termination" << commit;
     boost::this_thread::sleep(boost::posix_time::milliseconds(sigKillDelay));
 
-    for (auto iter = pids.begin(); iter != pids.end(); ++iter) {
-        int pid = *iter;
-        if (kill(pid, 0) == 0) {
+    for (auto iter = transfers.begin(); iter != transfers.end(); ++iter) {
+        int pid = iter->first;
+        // A worker done with the transfer is running another one by now
+        if (pool.mayKill(pid, iter->second) && kill(pid, 0) == 0) {
             FTS3_COMMON_LOGGER_NEWLOG(INFO) << "SIGKILL pid: " << pid << commit;
             kill(pid, SIGKILL);
         }
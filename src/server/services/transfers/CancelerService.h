@@ -43,7 +43,7 @@ public:
     virtual void runService();
 
 private:
-    void killRunningJob(const std::vector<int>& pids);
+    void killRunningJob(const std::vector<std::pair<int, uint64_t>>& transfers);
     void markAsStalled();
     void killCanceledByUser();
     void applyQueueTimeouts();
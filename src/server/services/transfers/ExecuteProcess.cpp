@@ -46,12 +46,10 @@
 #include <dirent.h>
 #include <sys/socket.h>
 
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
-
 #include "db/generic/SingleDbInstance.h"
 #include "common/Logger.h"
 #include "ExecuteProcess.h"
+#include "ProcessLauncher.h"
 #include "common/Exceptions.h"
 
 
@@ -59,35 +57,39 @@ using namespace fts3::common;
 using namespace db;
 
 
-ExecuteProcess::ExecuteProcess(const std::string &app, const std::string &arguments)
+ExecuteProcess::ExecuteProcess(const std::string &app, const std::vector<std::string> &arguments)
     : pid(0), m_app(app), m_arguments(arguments)
 {
 }
 
 int ExecuteProcess::executeProcessShell(std::string &forkMessage)
 {
+    fts3::server::ProcessLauncher &launcher = fts3::server::ProcessLauncher::instance();
+    if (launcher.isRunning()) {
+        int error = 0;
+        pid = launcher.spawn(m_app, m_arguments, &error);
+        if (pid < 0) {
+            pid = 0;
+            forkMessage = "Failed to spawn " + m_app + ": " + std::string(strerror(error));
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << forkMessage << commit;
+            return -1;
+        }
+        return 0;
+    }
     return execProcessShell(forkMessage);
 }
 
-// argsHolder is used to keep the argument pointers alive
-// for as long as needed
-void ExecuteProcess::getArgv(std::list<std::string> &argsHolder, size_t *argc, char ***argv)
+// The pointers are valid for as long as m_arguments is
+std::vector<char*> ExecuteProcess::getArgv()
 {
-    boost::split(argsHolder, m_arguments, boost::is_any_of(" "));
-
-    *argc = argsHolder.size() + 2; // Need place for the binary and the NULL
-    *argv = new char *[*argc];
-
-    std::list<std::string>::iterator it;
-    int i = 0;
-    (*argv)[i] = const_cast<char *> (m_app.c_str());
-    for (it = argsHolder.begin(); it != argsHolder.end(); ++it) {
-        ++i;
-        (*argv)[i] = const_cast<char *> (it->c_str());
+    std::vector<char*> argv;
+    argv.reserve(m_arguments.size() + 2); // Need place for the binary and the NULL
+    argv.push_back(const_cast<char *> (m_app.c_str()));
+    for (auto it = m_arguments.begin(); it != m_arguments.end(); ++it) {
+        argv.push_back(const_cast<char *> (it->c_str()));
     }
-
-    ++i;
-    (*argv)[i] = NULL;
+    argv.push_back(NULL);
+    return argv;
 }
 
 static void closeAllFilesExcept(int exception)
@@ -148,13 +150,10 @@ int ExecuteProcess::execProcessShell(std::string &forkMessage)
         //stderr = freopen("/dev/null", "a", stderr);
 
         // Get parameter array
-        std::list<std::string> argsHolder;
-        size_t argc;
-        char **argv;
-        getArgv(argsHolder, &argc, &argv);
+        std::vector<char*> argv = getArgv();
 
         // Execute the new binary
-        execvp(m_app.c_str(), argv);
+        execvp(m_app.c_str(), argv.data());
 
         // If we are here, execvp failed, so write the errno to the pipe
         if (write(pipefds[1], &errno, sizeof(int)) < 0) {
@@ -21,13 +21,16 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <vector>
 
 
 class ExecuteProcess
 {
 public:
-    ExecuteProcess(const std::string& app, const std::string& arguments);
+    ExecuteProcess(const std::string& app, const std::vector<std::string>& arguments);
+
+    /// Spawn the process through the ProcessLauncher if it is running,
+    /// fork and exec it otherwise
     int executeProcessShell(std::string& forkMessage);
 
     inline int getPid()
@@ -37,10 +40,10 @@ public:
 
 protected:
     int execProcessShell(std::string& forkMessage);
-    void getArgv(std::list<std::string>& argsHolder, size_t* argc, char*** argv);
+    std::vector<char*> getArgv();
 
 private:
     int pid;
     std::string m_app;
-    std::string m_arguments;
+    std::vector<std::string> m_arguments;
 };
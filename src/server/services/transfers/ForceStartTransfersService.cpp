@@ -15,7 +15,6 @@
  */
 
 #include "common/Logger.h"
-#include "common/ThreadPool.h"
 #include "common/DaemonTools.h"
 
 #include "config/ServerConfig.h"
@@ -27,7 +26,6 @@
 #include "server/DrainMode.h"
 
 #include "ForceStartTransfersService.h"
-#include "FileTransferExecutor.h"
 
 using namespace fts3::config;
 using namespace fts3::common;
@@ -44,12 +42,15 @@ ForceStartTransfersService::ForceStartTransfersService(HeartBeat *beat) : BaseSe
 
     monitoringMessages = config::ServerConfig::instance().get<bool>("MonitoringMessaging");
     pollInterval = config::ServerConfig::instance().get<boost::posix_time::time_duration>("ForceStartTransfersCheckInterval");
+
+    launcher.reset(new TransferLauncher(db::DBSingleton::instance().getDBObjectInstance(), execPoolSize,
+        monitoringMessages, infosys, ftsHostName, logDir, msgDir));
 }
 
 void ForceStartTransfersService::forceRunJobs() {
 
     // Bail out as soon as possible if there are too many fts_url_copy processes
-    int maxUrlCopy = config::ServerConfig::instance().get<int>("MaxUrlCopyProcesses");
+    int maxUrlCopy = config::ServerConfig::instance().values().maxUrlCopyProcesses;
     int urlCopyCount = countProcessesWithName("fts_url_copy");
     int availableUrlCopySlots = maxUrlCopy - urlCopyCount;
 
@@ -59,8 +60,6 @@ void ForceStartTransfersService::forceRunJobs() {
         return;
     }
 
-    ThreadPool<FileTransferExecutor> execPool(execPoolSize);
-
     try {
         auto tfs = db::DBSingleton::instance().getDBObjectInstance()->getForceStartTransfers();
 
@@ -69,10 +68,10 @@ void ForceStartTransfersService::forceRunJobs() {
         }
 
         std::map<std::pair<std::string, std::string>, std::string> proxies;
+        std::vector<TransferToLaunch> batch;
 
         for (auto& tf: tfs) {
             if (boost::this_thread::interruption_requested()) {
-                execPool.interrupt();
                 return;
             }
 
@@ -86,9 +85,7 @@ void ForceStartTransfersService::forceRunJobs() {
                 proxies[proxy_key] = DelegCred::getProxyFile(tf.userDn, tf.credId);
             }
 
-            FileTransferExecutor *exec = new FileTransferExecutor(tf, monitoringMessages, infosys, ftsHostName,
-                                                                  proxies[proxy_key], logDir, msgDir);
-            execPool.start(exec);
+            batch.emplace_back(tf, proxies[proxy_key]);
 
             if (--availableUrlCopySlots <= 0) {
                 FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Reached limitation of MaxUrlCopyProcesses (ForceStartTransfers)"
@@ -97,16 +94,14 @@ void ForceStartTransfersService::forceRunJobs() {
             }
         }
 
-        // Wait for all the workers to finish
-        execPool.join();
-        int scheduled = execPool.reduce(std::plus<int>());
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Force Start Threadpool processed: " << tfs.size() << " files ("
+        // Wait for all the forks to be done
+        int scheduled = launcher->launch(batch);
+        launcher->flush();
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Force Start launcher processed: " << tfs.size() << " files ("
                                         << scheduled << " have been scheduled)" << commit;
 
     } catch (const boost::thread_interrupted &) {
         FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Interruption requested in ForceStartTransfersService:forceRunJobs" << commit;
-        execPool.interrupt();
-        execPool.join();
     } catch (std::exception &e) {
         FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Exception in ForceStartTransfersService:forceRunJobs " << e.what() << commit;
     } catch (...) {
@@ -17,7 +17,10 @@
 #pragma once
 
 #include "services/BaseService.h"
+#include <memory>
+
 #include "services/heartbeat/HeartBeat.h"
+#include "TransferLauncher.h"
 
 namespace fts3 {
 namespace server {
@@ -36,6 +39,7 @@ protected:
     std::string logDir;
     std::string msgDir;
     boost::posix_time::time_duration pollInterval;
+    std::unique_ptr<TransferLauncher> launcher;
 
     HeartBeat *beat;
     void forceRunJobs();
@@ -26,7 +26,8 @@
 #include "common/Exceptions.h"
 #include "config/ServerConfig.h"
 #include "common/Logger.h"
-#include "db/generic/SingleDbInstance.h"
+#include "ProgressCoalescer.h"
+#include "QueueIndex.h"
 #include "SingleTrStateInstance.h"
 #include "ThreadSafeList.h"
 
@@ -41,11 +42,25 @@ namespace server {
 extern time_t updateRecords;
 
 
-MessageProcessingService::MessageProcessingService(): BaseService("MessageProcessingService"),
+MessageProcessingService::MessageProcessingService(GenericDbIfce *db): BaseService("MessageProcessingService"),
+    db(db),
     consumer(ServerConfig::instance().get<std::string>("MessagingDirectory")),
     producer(ServerConfig::instance().get<std::string>("MessagingDirectory"))
 {
     messages.reserve(600);
+    batchStatusUpdates = ServerConfig::instance().get<bool>("MessagingBatchStatusUpdates");
+
+    unsigned ringSlots = 0;
+    if (ServerConfig::instance().get<bool>("MessagingRingBuffer")) {
+        ringSlots = ServerConfig::instance().get<unsigned>("MessagingRingBufferSlots");
+    }
+    try {
+        consumer.setupStatusRing(ringSlots);
+    }
+    catch (const std::exception &e) {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not set up the status ring buffer, using the messaging directory: "
+            << e.what() << commit;
+    }
 }
 
 
@@ -75,7 +90,7 @@ void MessageProcessingService::runService()
             // use one fast query
             try
             {
-                db::DBSingleton::instance().getDBObjectInstance()->getDrain();
+                db->getDrain();
             }
             catch (...) {
                 boost::this_thread::sleep(boost::posix_time::seconds(10));
@@ -106,7 +121,7 @@ void MessageProcessingService::runService()
             }
 
             if (!messagesLog.empty()) {
-                db::DBSingleton::instance().getDBObjectInstance()->transferLogFileVector(messagesLog);
+                db->transferLogFileVector(messagesLog);
                 messagesLog.clear();
             }
 
@@ -133,11 +148,11 @@ void MessageProcessingService::runService()
                         << "\nTransferred: " << (*iterUpdater).transferred()
                         << commit;
                     ThreadSafeList::get_instance().updateMsg(*iterUpdater);
+                    ProgressCoalescer::instance().add(*iterUpdater);
                 }
-
-                db::DBSingleton::instance().getDBObjectInstance()->updateFileTransferProgressVector(messagesUpdater);
                 messagesUpdater.clear();
             }
+            ProgressCoalescer::instance().flush();
         }
         catch (const std::exception& e) {
             FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Message queue thrown exception: " << e.what() << commit;
@@ -148,7 +163,20 @@ void MessageProcessingService::runService()
             dumpMessages();
         }
 
-        boost::this_thread::sleep(msgCheckInterval);
+        try {
+            boost::this_thread::sleep(msgCheckInterval);
+        }
+        catch (const boost::thread_interrupted&) {
+            break;
+        }
+    }
+
+    // Do not lose the progress still pending on shutdown
+    try {
+        ProgressCoalescer::instance().flush(true);
+    }
+    catch (const std::exception &e) {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not write the pending progress: " << e.what() << commit;
     }
 }
 
@@ -172,7 +200,7 @@ void MessageProcessingService::performUpdateMessageDbChange(const fts3::events::
                                          << " file_params=" << internal_params.str()
                                          << commit;
 
-        db::DBSingleton::instance().getDBObjectInstance()->updateProtocol(msg);
+        db->updateProtocol(msg);
     }
     catch (const std::exception& e)
     {
@@ -181,7 +209,7 @@ void MessageProcessingService::performUpdateMessageDbChange(const fts3::events::
         // Encountered unexpected DB error. Terminate all files of a given job
         if (isUnrecoverableErrorMessage(e.what())) {
             FTS3_COMMON_LOGGER_NEWLOG(CRIT) << "Attempted database change with invalid values: " << e.what() << commit;
-            db::DBSingleton::instance().getDBObjectInstance()->terminateReuseProcess(
+            db->terminateReuseProcess(
                     msg.job_id(), msg.process_id(), "Database change failed due to invalid values", true);
             return;
         }
@@ -204,50 +232,24 @@ void MessageProcessingService::performOtherMessageDbChange(const fts3::events::M
         if (msg.transfer_status().compare("UPDATE") == 0)
             return;
 
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Job id: " << msg.job_id()
-                                        << "\nFile id: " << msg.file_id()
-                                        << "\nPid: " << msg.process_id()
-                                        << "\nState: " << msg.transfer_status()
-                                        << "\nSource: " << msg.source_se()
-                                        << "\nDest: " << msg.dest_se() << commit;
-
-        if (msg.transfer_status().compare("FINISHED") == 0) {
-            FTS3_COMMON_LOGGER_NEWLOG(PROF) << "[profiling:transfer]"
-                                            << " file_id=" << msg.file_id()
-                                            << " timestamp=" << msg.gfal_perf_timestamp() / 1000
-                                            << " inst_throughput=" << msg.instantaneous_throughput()
-                                            << " dif_transferred=" << msg.transferred_since_last_ping()
-                                            << " source_se=" << msg.source_se()
-                                            << " dest_se=" << msg.dest_se()
-                                            << commit;
-        }
-
-
-        if (msg.transfer_status().compare("FINISHED") == 0 ||
-            msg.transfer_status().compare("FAILED") == 0 ||
-            msg.transfer_status().compare("CANCELED") == 0)
-        {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO)
-                << "Removing job from monitoring list " << msg.job_id() << " " << msg.file_id()
-                << commit;
-            ThreadSafeList::get_instance().removeFinishedTr(msg.job_id(), msg.file_id());
-        }
+        announceOtherMessage(msg);
 
         if (msg.transfer_status().compare("FAILED") == 0)
         {
             try
             {
                 // multiple replica files belonging to a job will not be retried
-                int retry = db::DBSingleton::instance().getDBObjectInstance()->getRetry(msg.job_id());
+                int retry = db->getRetry(msg.job_id());
 
                 if (msg.retry() == true && retry > 0 && msg.file_id() > 0)
                 {
-                    int retryTimes = db::DBSingleton::instance().getDBObjectInstance()->getRetryTimes(msg.job_id(), msg.file_id());
+                    int retryTimes = db->getRetryTimes(msg.job_id(), msg.file_id());
 
                     if (retryTimes <= retry - 1)
                     {
-                        db::DBSingleton::instance().getDBObjectInstance()->setRetryTransfer(
+                        db->setRetryTransfer(
                             msg.job_id(), msg.file_id(), retryTimes+1, msg.transfer_message(), msg.errcode());
+                        QueueIndex::instance().transferRequeued(msg.file_id());
                         return;
                     }
                 }
@@ -265,29 +267,20 @@ void MessageProcessingService::performOtherMessageDbChange(const fts3::events::M
         // session reuse process died or terminated unexpected. Terminate all files of a given job
         if (isUnrecoverableErrorMessage(msg.transfer_message()))
         {
-            db::DBSingleton::instance().getDBObjectInstance()->terminateReuseProcess(
+            db->terminateReuseProcess(
                 msg.job_id(), msg.process_id(), msg.transfer_message());
         }
 
         // update file and job state
-        boost::tuple<bool, std::string> updated = db::DBSingleton::instance()
-            .getDBObjectInstance()->updateTransferStatus(
+        boost::tuple<bool, std::string> updated = db->updateTransferStatus(
                 msg.job_id(), msg.file_id(), msg.throughput(), msg.transfer_status(),
                 msg.transfer_message(), msg.process_id(), msg.filesize(), msg.time_in_secs(), msg.retry(),
                 msg.file_metadata());
 
-        db::DBSingleton::instance().getDBObjectInstance()->updateJobStatus(
+        db->updateJobStatus(
             msg.job_id(), msg.transfer_status());
 
-        if (!updated.get<0>() && msg.transfer_status() != "CANCELED") {
-            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Entry in the database not updated for "
-                << msg.job_id() << " " << msg.file_id()
-                << ". Probably already in a different terminal state. Tried to set "
-                << msg.transfer_status() << " over " << updated.get<1>() << commit;
-        }
-        else if (!msg.job_id().empty() && msg.file_id() > 0) {
-            SingleTrStateInstance::instance().sendStateMessage(msg.job_id(), msg.file_id());
-        }
+        notifyTransferStatusUpdate(msg, updated.get<0>(), updated.get<1>());
     }
     catch (const std::exception& e)
     {
@@ -296,7 +289,7 @@ void MessageProcessingService::performOtherMessageDbChange(const fts3::events::M
         // Encountered unexpected DB error. Terminate all files of a given job
         if (isUnrecoverableErrorMessage(e.what())) {
             FTS3_COMMON_LOGGER_NEWLOG(CRIT) << "Attempted database change with invalid values: " << e.what() << commit;
-            db::DBSingleton::instance().getDBObjectInstance()->terminateReuseProcess(
+            db->terminateReuseProcess(
                     msg.job_id(), msg.process_id(), "Database change failed due to invalid values", true);
             return;
         }
@@ -311,6 +304,124 @@ void MessageProcessingService::performOtherMessageDbChange(const fts3::events::M
 }
 
 
+void MessageProcessingService::announceOtherMessage(const fts3::events::Message& msg)
+{
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Job id: " << msg.job_id()
+                                    << "\nFile id: " << msg.file_id()
+                                    << "\nPid: " << msg.process_id()
+                                    << "\nState: " << msg.transfer_status()
+                                    << "\nSource: " << msg.source_se()
+                                    << "\nDest: " << msg.dest_se() << commit;
+
+    if (msg.transfer_status().compare("FINISHED") == 0) {
+        FTS3_COMMON_LOGGER_NEWLOG(PROF) << "[profiling:transfer]"
+                                        << " file_id=" << msg.file_id()
+                                        << " timestamp=" << msg.gfal_perf_timestamp() / 1000
+                                        << " inst_throughput=" << msg.instantaneous_throughput()
+                                        << " dif_transferred=" << msg.transferred_since_last_ping()
+                                        << " source_se=" << msg.source_se()
+                                        << " dest_se=" << msg.dest_se()
+                                        << commit;
+    }
+
+    if (msg.transfer_status().compare("FINISHED") == 0 ||
+        msg.transfer_status().compare("FAILED") == 0 ||
+        msg.transfer_status().compare("CANCELED") == 0)
+    {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO)
+            << "Removing job from monitoring list " << msg.job_id() << " " << msg.file_id()
+            << commit;
+        ThreadSafeList::get_instance().removeFinishedTr(msg.job_id(), msg.file_id());
+    }
+}
+
+
+void MessageProcessingService::notifyTransferStatusUpdate(const fts3::events::Message& msg,
+    bool updated, const std::string& storedState)
+{
+    if (!updated && msg.transfer_status() != "CANCELED") {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Entry in the database not updated for "
+            << msg.job_id() << " " << msg.file_id()
+            << ". Probably already in a different terminal state. Tried to set "
+            << msg.transfer_status() << " over " << storedState << commit;
+    }
+    else if (!msg.job_id().empty() && msg.file_id() > 0) {
+        if (updated && (msg.transfer_status() == "FINISHED" ||
+            msg.transfer_status() == "FAILED" || msg.transfer_status() == "CANCELED")) {
+            QueueIndex::instance().transferTerminated(msg.file_id());
+        }
+        SingleTrStateInstance::instance().sendStateMessage(msg.job_id(), msg.file_id());
+    }
+}
+
+
+bool MessageProcessingService::canApplyInBulk(const fts3::events::Message& msg, std::map<std::string, int>& retries)
+{
+    const std::string &state = msg.transfer_status();
+
+    if (state != "FINISHED" && state != "FAILED" && state != "CANCELED") {
+        return false;
+    }
+    if (msg.job_id().empty() || msg.file_id() == 0 || isUnrecoverableErrorMessage(msg.transfer_message())) {
+        return false;
+    }
+
+    // Failures that may be retried go one by one
+    if (state == "FAILED" && msg.retry()) {
+        auto retry = retries.find(msg.job_id());
+        if (retry == retries.end()) {
+            try {
+                int nRetries = db->getRetry(msg.job_id());
+                retry = retries.insert(std::make_pair(msg.job_id(), nRetries)).first;
+            }
+            catch (...) {
+                return false;
+            }
+        }
+        if (retry->second > 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void MessageProcessingService::applyInBulk(const std::vector<fts3::events::Message>& messages)
+{
+    std::vector<StatusUpdateResult> results;
+
+    try {
+        db->updateTransferStatuses(messages, results);
+    }
+    catch (const std::exception& e) {
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not apply the status messages in bulk: " << e.what() << commit;
+        results.assign(messages.size(), StatusUpdateResult());
+    }
+
+    for (size_t i = 0; i < messages.size(); ++i) {
+        const fts3::events::Message &msg = messages[i];
+
+        // Fall back to the message on its own
+        if (!results[i].applied) {
+            performOtherMessageDbChange(msg);
+            continue;
+        }
+
+        try {
+            announceOtherMessage(msg);
+            notifyTransferStatusUpdate(msg, results[i].updated, results[i].storedState);
+        }
+        catch (const std::exception& e) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Caught exception " << e.what() << commit;
+        }
+        catch (...) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Caught exception " << commit;
+        }
+    }
+}
+
+
 void MessageProcessingService::handleUpdateMessages(const std::vector<fts3::events::Message>& messages)
 {
     for (auto iter = messages.begin(); iter != messages.end(); ++iter)
@@ -348,6 +459,11 @@ void MessageProcessingService::handleOtherMessages(const std::vector<fts3::event
 {
     fts3::events::MessageUpdater msgUpdater;
 
+    // Terminal messages are put aside and applied together at the end,
+    // after the ones that have to go one by one
+    std::vector<fts3::events::Message> bulk;
+    std::map<std::string, int> retries;
+
     for (auto iter = messages.begin(); iter != messages.end(); ++iter)
     {
         try
@@ -369,7 +485,12 @@ void MessageProcessingService::handleOtherMessages(const std::vector<fts3::event
 
             if ((*iter).transfer_status().compare("UPDATE") != 0)
             {
-                performOtherMessageDbChange(*iter);
+                if (batchStatusUpdates && canApplyInBulk(*iter, retries)) {
+                    bulk.push_back(*iter);
+                }
+                else {
+                    performOtherMessageDbChange(*iter);
+                }
             }
         }
         catch (const boost::filesystem::filesystem_error& e)
@@ -385,6 +506,11 @@ void MessageProcessingService::handleOtherMessages(const std::vector<fts3::event
             FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Caught exception " << commit;
         }
     }
+
+    if (!bulk.empty())
+    {
+        applyInBulk(bulk);
+    }
 }
 
 
@@ -22,8 +22,11 @@
 #ifndef PROCESSQUEUE_H_
 #define PROCESSQUEUE_H_
 
+#include <map>
+#include <string>
 #include <vector>
 
+#include "db/generic/GenericDbIfce.h"
 #include "msg-bus/consumer.h"
 #include "msg-bus/producer.h"
 #include "../BaseService.h"
@@ -34,7 +37,9 @@ namespace server {
 
 class MessageProcessingService: public BaseService
 {
-private:
+protected:
+    GenericDbIfce *db;
+
     std::vector<fts3::events::Message> messages;
     std::map<int, fts3::events::MessageLog> messagesLog;
     std::vector<fts3::events::MessageUpdater> messagesUpdater;
@@ -42,17 +47,21 @@ private:
     Consumer consumer;
     Producer producer;
 
+    /// If true, terminal messages are applied together
+    bool batchStatusUpdates;
+
 public:
 
     /// Constructor
-    MessageProcessingService();
+    /// @param db   Where the messages are applied
+    MessageProcessingService(GenericDbIfce *db);
 
     /// Destructor
     virtual ~MessageProcessingService();
 
     virtual void runService();
 
-private:
+protected:
     /// Handle only messages whose message state is UPDATE.
     /// These messages are usually sent to update certain fields such as filesize.
     void handleUpdateMessages(const std::vector<fts3::events::Message>& messages);
@@ -66,6 +75,20 @@ private:
     /// Perform the database change associated with a non-UPDATE type message
     void performOtherMessageDbChange(const fts3::events::Message& msg);
 
+    /// Log a non-UPDATE type message, and stop monitoring the transfer if it is terminal
+    void announceOtherMessage(const fts3::events::Message& msg);
+
+    /// Follow up on the database change associated with a non-UPDATE type message
+    void notifyTransferStatusUpdate(const fts3::events::Message& msg, bool updated, const std::string& storedState);
+
+    /// Return whether a non-UPDATE type message can be applied together with others
+    /// @param retries  Number of retries of the jobs already looked up
+    bool canApplyInBulk(const fts3::events::Message& msg, std::map<std::string, int>& retries);
+
+    /// Apply the terminal messages together, and fall back to performOtherMessageDbChange
+    /// for those that could not be
+    void applyInBulk(const std::vector<fts3::events::Message>& messages);
+
     /// Dump the messages and messages logs onto disk
     void dumpMessages();
 
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProcessLauncher.h"
+
+#include <cerrno>
+#include <cstring>
+#include <future>
+#include <dirent.h>
+#include <fcntl.h>
+#include <paths.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "common/Exceptions.h"
+#include "common/Logger.h"
+
+extern char **environ;
+
+using namespace fts3::common;
+
+
+namespace fts3 {
+namespace server {
+
+/// Sent by the server: header, followed by argc strings, each one ending with '\0'
+/// The first string is the program
+struct SpawnRequest {
+    uint64_t id;
+    uint32_t argc;
+};
+
+/// Sent back by the helper
+struct SpawnReply {
+    uint64_t id;
+    int32_t pid;
+    int32_t error;
+};
+
+/// Biggest request. The socket keeps the message boundaries, so it is received in one go.
+static const size_t MAX_REQUEST_SIZE = 128 * 1024;
+
+/// The helper moves its end of the socket here, and closes everything above
+static const int HELPER_FD = 3;
+
+
+/// Close all file descriptors from lowfd up
+static void closeFrom(int lowfd)
+{
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, lowfd, ~0U, 0) == 0) {
+        return;
+    }
+#endif
+    // Older kernels: only go through the ones actually open
+    std::vector<int> fds;
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            int fd = atoi(entry->d_name);
+            if (fd >= lowfd && fd != dirfd(dir)) {
+                fds.push_back(fd);
+            }
+        }
+        closedir(dir);
+        for (auto fd = fds.begin(); fd != fds.end(); ++fd) {
+            close(*fd);
+        }
+    }
+    else {
+        long maxfd = sysconf(_SC_OPEN_MAX);
+        for (int fd = lowfd; fd < maxfd; ++fd) {
+            close(fd);
+        }
+    }
+}
+
+
+/// Split a request into its id and argv
+/// argv points into buffer, and ends with NULL
+static bool parseRequest(char *buffer, size_t size, uint64_t *id, std::vector<char*> *argv)
+{
+    if (size < sizeof(SpawnRequest)) {
+        return false;
+    }
+    SpawnRequest header;
+    memcpy(&header, buffer, sizeof(header));
+    *id = header.id;
+
+    char *p = buffer + sizeof(header);
+    char *end = buffer + size;
+    for (uint32_t i = 0; i < header.argc; ++i) {
+        char *nul = static_cast<char*>(memchr(p, '\0', end - p));
+        if (!nul) {
+            return false;
+        }
+        argv->push_back(p);
+        p = nul + 1;
+    }
+    argv->push_back(NULL);
+    return header.argc > 0;
+}
+
+
+/// Main loop of the helper process. Never returns.
+static void helperMain(int sock)
+{
+    // Keep only the socket, so the spawned processes inherit nothing from the server
+    if (sock != HELPER_FD) {
+        dup2(sock, HELPER_FD);
+    }
+    fcntl(HELPER_FD, F_SETFD, FD_CLOEXEC);
+    closeFrom(HELPER_FD + 1);
+
+    // Spawned processes run from the temporary directory, as they always did
+    if (chdir(_PATH_TMP) != 0) {
+        // Nowhere to report it, they will run from the current one
+    }
+
+    // Children are reaped automatically. SIGPIPE stays ignored in the children, as it always was.
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Children start with no signal blocked, and the default SIGCHLD handling
+    sigset_t noSignals, defaultSignals;
+    sigemptyset(&noSignals);
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGCHLD);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &noSignals);
+    posix_spawnattr_setsigdefault(&attr, &defaultSignals);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+    // Detach from the server session
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    std::vector<char> buffer(MAX_REQUEST_SIZE);
+    while (true) {
+        ssize_t size = recv(HELPER_FD, buffer.data(), buffer.size(), 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        // The server is gone, or stopped the launcher
+        if (size <= 0) {
+            break;
+        }
+
+        SpawnReply reply;
+        reply.id = 0;
+        reply.pid = -1;
+
+        std::vector<char*> argv;
+        if (!parseRequest(buffer.data(), size, &reply.id, &argv)) {
+            reply.error = EINVAL;
+        }
+        else {
+            pid_t pid = -1;
+            reply.error = posix_spawnp(&pid, argv[0], NULL, &attr, argv.data(), environ);
+            if (reply.error == 0) {
+                reply.pid = pid;
+            }
+        }
+
+        if (send(HELPER_FD, &reply, sizeof(reply), MSG_NOSIGNAL) < 0 && errno != EINTR) {
+            break;
+        }
+    }
+
+    posix_spawnattr_destroy(&attr);
+    _exit(EXIT_SUCCESS);
+}
+
+
+ProcessLauncher::ProcessLauncher(): helperPid(-1), sock(-1), running(false), stopping(false), lastId(0)
+{
+}
+
+
+ProcessLauncher::~ProcessLauncher()
+{
+    stop();
+}
+
+
+void ProcessLauncher::start()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    if (sock >= 0) {
+        return;
+    }
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+        throw SystemError(std::string("Could not create the socket for the process launcher: ") + strerror(errno));
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        int err = errno;
+        close(fds[0]);
+        close(fds[1]);
+        throw SystemError(std::string("Could not fork the process launcher: ") + strerror(err));
+    }
+    else if (pid == 0) {
+        close(fds[0]);
+        helperMain(fds[1]);
+    }
+    close(fds[1]);
+
+    helperPid = pid;
+    sock = fds[0];
+    running = true;
+    stopping = false;
+    reader = boost::thread(&ProcessLauncher::readReplies, this);
+
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Process launcher started with pid " << helperPid << commit;
+}
+
+
+void ProcessLauncher::stop()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (sock < 0) {
+            return;
+        }
+        stopping = true;
+    }
+
+    // The helper sees the end of the stream and exits, and so the reader
+    shutdown(sock, SHUT_RDWR);
+    reader.join();
+
+    boost::mutex::scoped_lock sendLock(sendMutex);
+    boost::mutex::scoped_lock lock(mutex);
+    close(sock);
+    sock = -1;
+    helperPid = -1;
+}
+
+
+bool ProcessLauncher::isRunning()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return running;
+}
+
+
+void ProcessLauncher::spawnAsync(const std::string &program, const std::vector<std::string> &args,
+    Callback callback)
+{
+    SpawnRequest header;
+    memset(&header, 0, sizeof(header));
+    header.argc = static_cast<uint32_t>(args.size() + 1);
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (!running) {
+            lock.unlock();
+            callback(-1, ESRCH);
+            return;
+        }
+        header.id = ++lastId;
+        pending[header.id] = callback;
+    }
+
+    std::string message(reinterpret_cast<const char*>(&header), sizeof(header));
+    message.append(program).push_back('\0');
+    for (auto arg = args.begin(); arg != args.end(); ++arg) {
+        message.append(*arg).push_back('\0');
+    }
+
+    int error = 0;
+    if (message.size() > MAX_REQUEST_SIZE) {
+        error = E2BIG;
+    }
+    else {
+        boost::mutex::scoped_lock lock(sendMutex);
+        if (sock < 0) {
+            error = ESRCH;
+        }
+        while (!error && send(sock, message.data(), message.size(), MSG_NOSIGNAL) < 0) {
+            if (errno != EINTR) {
+                error = errno;
+            }
+        }
+    }
+
+    // The reader may have failed it already if the helper went away meanwhile
+    if (error) {
+        Callback failed = takeCallback(header.id);
+        if (failed) {
+            failed(-1, error);
+        }
+    }
+}
+
+
+pid_t ProcessLauncher::spawn(const std::string &program, const std::vector<std::string> &args, int *error)
+{
+    std::promise<std::pair<pid_t, int>> promise;
+    std::future<std::pair<pid_t, int>> result = promise.get_future();
+
+    spawnAsync(program, args, [&promise](pid_t pid, int err) {
+        promise.set_value(std::make_pair(pid, err));
+    });
+
+    std::pair<pid_t, int> reply = result.get();
+    *error = reply.second;
+    return reply.second ? -1 : reply.first;
+}
+
+
+ProcessLauncher::Callback ProcessLauncher::takeCallback(uint64_t id)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    Callback callback;
+    auto i = pending.find(id);
+    if (i != pending.end()) {
+        callback = i->second;
+        pending.erase(i);
+    }
+    return callback;
+}
+
+
+void ProcessLauncher::readReplies()
+{
+    SpawnReply reply;
+    while (true) {
+        ssize_t size = recv(sock, &reply, sizeof(reply), 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size != sizeof(reply)) {
+            break;
+        }
+
+        Callback callback = takeCallback(reply.id);
+        if (!callback) {
+            continue;
+        }
+        try {
+            callback(reply.pid, reply.error);
+        }
+        catch (const std::exception &e) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Process launcher callback failed: " << e.what() << commit;
+        }
+        catch (...) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Process launcher callback failed" << commit;
+        }
+    }
+
+    // The helper is gone. New requests are refused, so callers go back to forking by themselves.
+    std::map<uint64_t, Callback> orphans;
+    bool expected;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        running = false;
+        expected = stopping;
+        orphans.swap(pending);
+    }
+
+    int status = 0;
+    while (waitpid(helperPid, &status, 0) < 0 && errno == EINTR);
+
+    if (!expected) {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "The process launcher exited unexpectedly (status " << status
+            << "), processes will be forked by the server" << commit;
+    }
+
+    // They may or may not have been spawned
+    for (auto i = orphans.begin(); i != orphans.end(); ++i) {
+        try {
+            i->second(-1, ECONNABORTED);
+        }
+        catch (...) {
+            // Nothing else to do
+        }
+    }
+}
+
+} // end namespace server
+} // end namespace fts3
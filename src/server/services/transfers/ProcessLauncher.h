@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef PROCESSLAUNCHER_H_
+#define PROCESSLAUNCHER_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include <boost/thread.hpp>
+
+#include "common/Singleton.h"
+
+
+namespace fts3 {
+namespace server {
+
+/// Spawns processes (fts_url_copy) on behalf of the server from a small helper process.
+///
+/// The helper is forked once at start-up, before the server opens the database connections
+/// and starts its threads. It only keeps the socket to the server open, so for each request
+/// it spawns the process with posix_spawn, without copying the page tables of the server,
+/// nor closing every possible file descriptor.
+/// Requests and replies go through a unix socket, so the server does not wait for the spawn.
+class ProcessLauncher: public fts3::common::Singleton<ProcessLauncher>
+{
+public:
+    /// Called with the pid of the process, or with the errno if it could not be spawned
+    /// ESRCH or EPIPE mean the request never reached the helper, so it can be retried somewhere else
+    /// ECONNABORTED means the helper exited before replying
+    typedef std::function<void (pid_t pid, int error)> Callback;
+
+    ProcessLauncher();
+
+    /// Stops the helper
+    ~ProcessLauncher();
+
+    /// Fork the helper process
+    /// Must be called before the server starts any thread
+    void start();
+
+    /// Close the socket, which makes the helper exit
+    /// Pending requests are failed
+    void stop();
+
+    /// True if the helper is up. Otherwise the caller has to spawn by itself.
+    bool isRunning();
+
+    /// Send a request to spawn program with the given arguments
+    /// The callback is always called once, from another thread, unless the request can not
+    /// be sent at all, in which case it is called right away
+    void spawnAsync(const std::string &program, const std::vector<std::string> &args, Callback callback);
+
+    /// Spawn program with the given arguments, and wait for the result
+    /// @return The pid, or -1 with error set
+    pid_t spawn(const std::string &program, const std::vector<std::string> &args, int *error);
+
+private:
+    ProcessLauncher(ProcessLauncher const &) = delete;
+    ProcessLauncher& operator=(ProcessLauncher const &) = delete;
+
+    pid_t helperPid;
+    int sock;
+
+    boost::mutex mutex;
+    bool running;
+    bool stopping;
+    uint64_t lastId;
+    std::map<uint64_t, Callback> pending;
+
+    /// Requests may be sent by several threads
+    boost::mutex sendMutex;
+    boost::thread reader;
+
+    /// Reader thread main loop
+    void readReplies();
+
+    /// Remove and return the callback of a request
+    Callback takeCallback(uint64_t id);
+};
+
+} // end namespace server
+} // end namespace fts3
+
+#endif // PROCESSLAUNCHER_H_
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProgressCoalescer.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "common/Logger.h"
+#include "config/ServerConfig.h"
+#include "db/generic/SingleDbInstance.h"
+
+using namespace fts3::common;
+using fts3::config::ServerConfig;
+
+
+namespace fts3 {
+namespace server {
+
+
+ProgressCoalescer::ProgressCoalescer(): pendingSince(0)
+{
+}
+
+
+void ProgressCoalescer::add(const fts3::events::MessageUpdater &msg)
+{
+    // Only progress of running transfers is stored
+    if (msg.file_id() == 0 || msg.transfer_status() != "ACTIVE" || msg.throughput() <= 0.0) {
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    ++metrics.received;
+
+    auto i = pending.find(msg.file_id());
+    if (i == pending.end()) {
+        if (pending.empty()) {
+            pendingSince = time(NULL);
+        }
+        pending.emplace(msg.file_id(), msg);
+    }
+    else if (msg.timestamp() >= i->second.timestamp()) {
+        i->second = msg;
+    }
+}
+
+
+bool ProgressCoalescer::collect(std::vector<fts3::events::MessageUpdater> &batch, time_t now,
+    size_t maxPending, time_t interval, bool force)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    if (pending.empty()) {
+        return false;
+    }
+    if (!force && pending.size() < maxPending && difftime(now, pendingSince) < interval) {
+        return false;
+    }
+
+    batch.reserve(batch.size() + pending.size());
+    for (auto i = pending.begin(); i != pending.end(); ++i) {
+        batch.emplace_back();
+        batch.back().Swap(&i->second);
+    }
+    metrics.written += pending.size();
+    pending.clear();
+    return true;
+}
+
+
+void ProgressCoalescer::flush(bool force)
+{
+    const size_t maxPending = ServerConfig::instance().get<int>("ProgressFlushSize");
+    const time_t interval = ServerConfig::instance().get<int>("ProgressFlushInterval");
+
+    boost::mutex::scoped_lock flushLock(flushMutex);
+
+    std::vector<fts3::events::MessageUpdater> batch;
+    if (!collect(batch, time(NULL), maxPending, interval, force)) {
+        return;
+    }
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    db::DBSingleton::instance().getDBObjectInstance()->updateFileTransferProgressVector(batch);
+    double latency = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+
+    ProgressMetrics snapshot;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        ++metrics.flushes;
+        metrics.lastFlushLatency = latency;
+        metrics.maxFlushLatency = std::max(metrics.maxFlushLatency, latency);
+        metrics.totalFlushLatency += latency;
+        snapshot = metrics;
+    }
+
+    FTS3_COMMON_LOGGER_NEWLOG(PROF) << "[profiling:progress]"
+        << " rows=" << batch.size()
+        << " flush_latency=" << latency
+        << " avg_flush_latency=" << snapshot.totalFlushLatency / snapshot.flushes
+        << " max_flush_latency=" << snapshot.maxFlushLatency
+        << " coalescing_ratio=" << snapshot.getCoalescingRatio()
+        << commit;
+}
+
+
+ProgressMetrics ProgressCoalescer::getMetrics()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return metrics;
+}
+
+} // end namespace server
+} // end namespace fts3
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef PROGRESSCOALESCER_H_
+#define PROGRESSCOALESCER_H_
+
+#include <ctime>
+#include <map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "common/Singleton.h"
+#include "msg-bus/events.h"
+
+
+namespace fts3 {
+namespace server {
+
+/// Counters of the progress coalescer
+struct ProgressMetrics {
+    ProgressMetrics(): received(0), written(0), flushes(0),
+        lastFlushLatency(0), maxFlushLatency(0), totalFlushLatency(0) {}
+
+    /// Progress messages received
+    uint64_t received;
+    /// Rows handed to the database
+    uint64_t written;
+    uint64_t flushes;
+    /// In seconds
+    double lastFlushLatency, maxFlushLatency, totalFlushLatency;
+
+    /// How many messages were received for each row written
+    double getCoalescingRatio() const {
+        return written > 0 ? double(received) / written : 0;
+    }
+};
+
+/// Keeps only the latest progress reported for each transfer, and writes them
+/// to the database together once enough of them are pending, or the oldest one has waited long enough.
+/// Fed by both the ping socket and the stalled message queue, which flush whatever is left when they stop.
+class ProgressCoalescer: public fts3::common::Singleton<ProgressCoalescer>
+{
+public:
+    ProgressCoalescer();
+
+    /// Remember the progress of a transfer, replacing any older one still pending
+    void add(const fts3::events::MessageUpdater &msg);
+
+    /// Write the pending progress to the database if the thresholds configured are reached,
+    /// or if force is true
+    void flush(bool force = false);
+
+    /// Move into batch the pending progress if there are at least maxPending of them,
+    /// if the oldest has been pending for interval seconds, or if force is true
+    /// @return true if batch was filled
+    bool collect(std::vector<fts3::events::MessageUpdater> &batch, time_t now,
+        size_t maxPending, time_t interval, bool force = false);
+
+    ProgressMetrics getMetrics();
+
+private:
+    boost::mutex mutex;
+    // Serializes the writes, so an older batch can not overwrite a newer one
+    boost::mutex flushMutex;
+    std::map<uint64_t, fts3::events::MessageUpdater> pending;
+    // When the oldest pending progress was added
+    time_t pendingSince;
+    ProgressMetrics metrics;
+};
+
+} // end namespace server
+} // end namespace fts3
+
+#endif // PROGRESSCOALESCER_H_
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "QueueIndex.h"
+
+#include <algorithm>
+
+#include "common/Logger.h"
+#include "config/ServerConfig.h"
+#include "db/generic/SingleDbInstance.h"
+
+using namespace fts3::common;
+using fts3::config::ServerConfig;
+
+
+namespace fts3 {
+namespace server {
+
+// Running transfers not heard of after this many seconds are forgotten on reload
+static const time_t RUNNING_EXPIRATION = 86400;
+// Missing changes are waited for this many seconds. Longer transactions are caught by the next reconcile,
+// rolled back ones never show up
+static const time_t CHANGE_GAP_TIMEOUT = 60;
+// Larger holes in the change log are not waited for
+static const uint64_t MAX_CHANGE_GAP = 10000;
+// Changes older than this many seconds are deleted from the log on reload
+static const int CHANGE_RETENTION = 3600;
+
+
+QueueIndex::QueueIndex(): lastChangeId(0), lastReload(0), loaded(false)
+{
+}
+
+
+void QueueIndex::refresh()
+{
+    auto db = db::DBSingleton::instance().getDBObjectInstance();
+    const int reconcileInterval = ServerConfig::instance().get<int>("QueueIndexReconcileInterval");
+
+    bool wasLoaded, mustReload;
+    uint64_t afterChangeId;
+    time_t now = time(NULL);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        wasLoaded = loaded;
+        mustReload = !loaded || lastChangeId == 0 || difftime(now, lastReload) >= reconcileInterval;
+        afterChangeId = lastChangeId;
+    }
+
+    std::vector<QueueChange> changes;
+    if (wasLoaded) {
+        db->getQueueChangesSince(afterChangeId, changes);
+    }
+
+    if (mustReload) {
+        // Whatever has been read so far is covered by the counters.
+        // Changes committed in between are counted twice until the next reconcile, which is harmless.
+        skipChanges(changes, now);
+
+        std::vector<QueueCounters> counters;
+        uint64_t changeId = db->getQueueCounters(counters);
+        reload(counters, changeId, now);
+        FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Queue index reconciled with the database: "
+            << counters.size() << " queues" << commit;
+
+        try {
+            db->purgeQueueChanges(CHANGE_RETENTION);
+        }
+        catch (const std::exception &e) {
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not purge the queue changes: " << e.what() << commit;
+        }
+    }
+    else {
+        addChanges(changes, now);
+    }
+}
+
+
+void QueueIndex::reload(const std::vector<QueueCounters> &counters, uint64_t changeId, time_t now)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    queues.clear();
+    for (auto i = counters.begin(); i != counters.end(); ++i) {
+        Counters &queue = queues[Key(i->sourceSe, i->destSe, i->voName)];
+        queue.submitted += i->submitted;
+        queue.active += i->active;
+    }
+
+    for (auto i = running.begin(); i != running.end();) {
+        if (difftime(now, i->second.since) > RUNNING_EXPIRATION) {
+            i = running.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+
+    if (!loaded) {
+        lastChangeId = changeId;
+        seenChanges.clear();
+        missingChanges.clear();
+    }
+    lastReload = now;
+    loaded = true;
+}
+
+
+void QueueIndex::addChanges(const std::vector<QueueChange> &changes, time_t now)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    applyChanges(changes, now, true);
+}
+
+
+void QueueIndex::skipChanges(const std::vector<QueueChange> &changes, time_t now)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    applyChanges(changes, now, false);
+}
+
+
+void QueueIndex::applyChanges(const std::vector<QueueChange> &changes, time_t now, bool count)
+{
+    for (auto i = changes.begin(); i != changes.end(); ++i) {
+        if (i->changeId <= lastChangeId || seenChanges.count(i->changeId)) {
+            continue;
+        }
+
+        // The ids skipped since the highest one seen belong to transactions not committed yet
+        const uint64_t highest = seenChanges.empty() ? lastChangeId : *seenChanges.rbegin();
+        if (i->changeId > highest && i->changeId - highest <= MAX_CHANGE_GAP) {
+            for (uint64_t missing = highest + 1; missing < i->changeId; ++missing) {
+                missingChanges.emplace(missing, now);
+            }
+        }
+        missingChanges.erase(i->changeId);
+        seenChanges.insert(i->changeId);
+
+        if (count) {
+            ++queues[Key(i->sourceSe, i->destSe, i->voName)].submitted;
+        }
+    }
+
+    for (auto i = missingChanges.begin(); i != missingChanges.end();) {
+        if (difftime(now, i->second) > CHANGE_GAP_TIMEOUT) {
+            i = missingChanges.erase(i);
+        }
+        else {
+            ++i;
+        }
+    }
+
+    // Move up to the first change still missing
+    uint64_t position = seenChanges.empty() ? lastChangeId : *seenChanges.rbegin();
+    if (!missingChanges.empty()) {
+        position = std::min(position, missingChanges.begin()->first - 1);
+    }
+    if (position > lastChangeId) {
+        lastChangeId = position;
+        seenChanges.erase(seenChanges.begin(), seenChanges.upper_bound(lastChangeId));
+    }
+}
+
+
+void QueueIndex::transferScheduled(uint64_t fileId, const std::string &sourceSe, const std::string &destSe,
+    const std::string &voName)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    Key key(sourceSe, destSe, voName);
+    Counters &queue = queues[key];
+    if (queue.submitted > 0) {
+        --queue.submitted;
+    }
+    ++queue.active;
+
+    running.erase(fileId);
+    running.insert(std::make_pair(fileId, Running(key, time(NULL))));
+}
+
+
+void QueueIndex::transferTerminated(uint64_t fileId)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    auto transfer = running.find(fileId);
+    if (transfer == running.end()) {
+        return;
+    }
+
+    auto queue = queues.find(transfer->second.key);
+    if (queue != queues.end()) {
+        if (queue->second.active > 0) {
+            --queue->second.active;
+        }
+        dropIfEmpty(queue);
+    }
+    running.erase(transfer);
+}
+
+
+void QueueIndex::transferRequeued(uint64_t fileId)
+{
+    // The transfer is back in the queue once the change is read from the log
+    transferTerminated(fileId);
+}
+
+
+void QueueIndex::getQueuesWithPending(std::vector<QueueId> &pending)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    for (auto i = queues.begin(); i != queues.end(); ++i) {
+        if (i->second.submitted > 0) {
+            pending.emplace_back(std::get<0>(i->first), std::get<1>(i->first), std::get<2>(i->first),
+                static_cast<unsigned>(i->second.active));
+        }
+    }
+}
+
+
+uint64_t QueueIndex::getLastChangeId()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return lastChangeId;
+}
+
+
+void QueueIndex::dropIfEmpty(std::map<Key, Counters>::iterator i)
+{
+    if (i->second.submitted == 0 && i->second.active == 0) {
+        queues.erase(i);
+    }
+}
+
+} // end namespace server
+} // end namespace fts3
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef QUEUEINDEX_H_
+#define QUEUEINDEX_H_
+
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "common/Singleton.h"
+#include "db/generic/QueueChange.h"
+#include "db/generic/QueueCounters.h"
+#include "db/generic/QueueId.h"
+
+
+namespace fts3 {
+namespace server {
+
+/// Resident index of the queues (source, destination, vo) with the number of
+/// queued and running transfers for each of them, so the scheduler does not
+/// need to scan t_file on every cycle.
+/// It is kept up to date with the transfers scheduled and terminated by this node,
+/// and with the transfers entering the SUBMITTED state anywhere (submission, staging,
+/// next hop or replica, retries...), read from the change log t_queue_changes.
+/// Change ids are allocated before the transaction commits, so a change may show up after
+/// higher ids: the position in the log stays below the missing ids for a while.
+/// Other changes (cancellations, transfers started by other nodes...)
+/// are picked up when the index is reconciled with the database.
+class QueueIndex: public fts3::common::Singleton<QueueIndex>
+{
+public:
+    QueueIndex();
+
+    /// Bring the index up to date with the database
+    /// The whole index is reloaded if the reconcile interval expired, only new changes are read otherwise.
+    /// Without a position in the change log (schema older than 8.1, or nothing queued yet) it is always reloaded.
+    void refresh();
+
+    /// Replace all counters with the given ones
+    /// @param counters     Submitted and active transfers per queue
+    /// @param lastChangeId Highest change id covered by counters. Only used the first time,
+    ///                     afterwards the position in the change log is kept so the changes
+    ///                     not committed yet are not skipped
+    /// @param now          When the counters were obtained
+    void reload(const std::vector<QueueCounters> &counters, uint64_t lastChangeId, time_t now);
+
+    /// Count the transfers that entered the SUBMITTED state
+    /// @param changes      Changes read from the log, the ones already seen are ignored
+    /// @param now          When the changes were read
+    void addChanges(const std::vector<QueueChange> &changes, time_t now);
+
+    /// Mark the changes as seen without counting them, because they are covered by a reload
+    void skipChanges(const std::vector<QueueChange> &changes, time_t now);
+
+    /// A queued transfer has been picked for execution (SUBMITTED => READY)
+    void transferScheduled(uint64_t fileId, const std::string &sourceSe, const std::string &destSe,
+        const std::string &voName);
+
+    /// A running transfer reached a terminal state
+    void transferTerminated(uint64_t fileId);
+
+    /// A running transfer went back to the queue to be retried
+    /// It is counted as submitted again when the change is read from the log
+    void transferRequeued(uint64_t fileId);
+
+    /// Puts into queues the queues with pending transfers
+    void getQueuesWithPending(std::vector<QueueId> &queues);
+
+    /// Position in the change log: every change up to this one has been seen, or given up on
+    uint64_t getLastChangeId();
+
+private:
+    typedef std::tuple<std::string, std::string, std::string> Key;
+
+    struct Counters {
+        Counters(): submitted(0), active(0) {}
+        uint64_t submitted;
+        uint64_t active;
+    };
+
+    struct Running {
+        Running(const Key &key, time_t since): key(key), since(since) {}
+        Key key;
+        time_t since;
+    };
+
+    boost::mutex mutex;
+    std::map<Key, Counters> queues;
+    // Transfers started by this node, so their queue is known when they finish
+    std::map<uint64_t, Running> running;
+    uint64_t lastChangeId;
+    // Changes seen above lastChangeId
+    std::set<uint64_t> seenChanges;
+    // Changes missing above lastChangeId, and when they were found missing
+    std::map<uint64_t, time_t> missingChanges;
+    time_t lastReload;
+    bool loaded;
+
+    void applyChanges(const std::vector<QueueChange> &changes, time_t now, bool count);
+    void dropIfEmpty(std::map<Key, Counters>::iterator i);
+};
+
+} // end namespace server
+} // end namespace fts3
+
+#endif // QUEUEINDEX_H_
@@ -20,6 +20,7 @@
 
 #include "ReuseTransfersService.h"
 
+#include <algorithm>
 #include <fstream>
 
 #include "common/DaemonTools.h"
@@ -94,7 +95,7 @@ void ReuseTransfersService::writeJobFile(const std::string& jobId, const std::ve
     try
     {
         std::vector<std::string>::const_iterator iter;
-        std::string filename = ServerConfig::instance().get<std::string>("MessagingDirectory") + "/" + jobId;
+        std::string filename = ServerConfig::instance().values().messagingDirectory + "/" + jobId;
         fout.open(filename.c_str(), std::ios::out);
         for (iter = files.begin(); iter != files.end(); ++iter)
         {
@@ -231,7 +232,7 @@ void ReuseTransfersService::startUrlCopy(std::string const & job_id, std::list<T
     cmdBuilder.setLogDir(logsDir);
 
     // Messaging
-    std::string msgDir = ServerConfig::instance().get<std::string>("MessagingDirectory");
+    std::string msgDir = ServerConfig::instance().values().messagingDirectory;
     cmdBuilder.setMonitoring(monitoringMessages, msgDir);
 
     // Set parameters from the "representative", without using the source and destination url, and other data
@@ -243,8 +244,8 @@ void ReuseTransfersService::startUrlCopy(std::string const & job_id, std::list<T
     std::map<uint64_t, std::string> fileIds = generateJobFile(representative.jobId, files);
 
     // Can we run?
-    int currentActive = 0;
-    if (!db->isTrAllowed(representative.sourceSe, representative.destSe, currentActive)) {
+    int currentActive = 0, maxActive = 0;
+    if (!db->isTrAllowed(representative.sourceSe, representative.destSe, currentActive, maxActive)) {
         return;
     }
 
@@ -302,6 +303,9 @@ void ReuseTransfersService::startUrlCopy(std::string const & job_id, std::list<T
     // Current number of actives
     cmdBuilder.setNumberOfActive(currentActive);
 
+    // Run as many transfers of the job at the same time as the optimizer leaves room for
+    cmdBuilder.setConcurrency(std::max<int>(1, std::min<int>(files.size(), maxActive - currentActive)));
+
     // Number of retries and maximum number allowed
     int retry_times = db->getRetryTimes(representative.jobId, representative.fileId);
     cmdBuilder.setNumberOfRetries(retry_times < 0 ? 0 : retry_times);
@@ -310,9 +314,8 @@ void ReuseTransfersService::startUrlCopy(std::string const & job_id, std::list<T
     cmdBuilder.setMaxNumberOfRetries(retry_max < 0 ? 0 : retry_max);
 
     // Log and run
-    std::string params = cmdBuilder.generateParameters();
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Transfer params: " << cmdBuilder << commit;
-    ExecuteProcess pr(cmd, params);
+    ExecuteProcess pr(cmd, cmdBuilder.generateArguments());
 
     // Check if fork failed , check if execvp failed
     std::string forkMessage;
@@ -367,7 +370,7 @@ void ReuseTransfersService::startUrlCopy(std::string const & job_id, std::list<T
  */
 static void failUnschedulable(const std::vector<QueueId> &unschedulable)
 {
-    Producer producer(config::ServerConfig::instance().get<std::string>("MessagingDirectory"));
+    Producer producer(config::ServerConfig::instance().values().messagingDirectory);
 
     std::map<std::string, std::queue<std::pair<std::string, std::list<TransferFile> > > > voQueues;
     DBSingleton::instance().getDBObjectInstance()->getReadySessionReuseTransfers(unschedulable, voQueues);
@@ -402,7 +405,7 @@ static void failUnschedulable(const std::vector<QueueId> &unschedulable)
 void ReuseTransfersService::executeUrlcopy()
 {
     // Bail out as soon as possible if there are too many url-copy processes
-    int maxUrlCopy = config::ServerConfig::instance().get<int>("MaxUrlCopyProcesses");
+    int maxUrlCopy = config::ServerConfig::instance().values().maxUrlCopyProcesses;
     int urlCopyCount = countProcessesWithName("fts_url_copy");
     int availableUrlCopySlots = maxUrlCopy - urlCopyCount;
 
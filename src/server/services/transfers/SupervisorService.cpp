@@ -17,6 +17,7 @@
 #include "SupervisorService.h"
 #include "config/ServerConfig.h"
 #include "db/generic/SingleDbInstance.h"
+#include "ProgressCoalescer.h"
 #include "ThreadSafeList.h"
 #include <msg-bus/events.h>
 
@@ -41,7 +42,6 @@ SupervisorService::SupervisorService(): BaseService("SupervisorService"),
 void SupervisorService::runService()
 {
     while (!boost::this_thread::interruption_requested()) {
-        std::vector<fts3::events::MessageUpdater> events;
         zmq::message_t message;
 
         try {
@@ -52,7 +52,6 @@ void SupervisorService::runService()
                 if (!event.ParseFromArray(message.data(), message.size())) {
                     continue;
                 }
-                events.emplace_back(event);
 
                 FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Process Updater Monitor"
                                                 << "\nJob id: " << event.job_id()
@@ -73,12 +72,10 @@ void SupervisorService::runService()
                                                 << commit;
 
                 ThreadSafeList::get_instance().updateMsg(event);
+                ProgressCoalescer::instance().add(event);
             }
 
-            if (!events.empty()) {
-                db::DBSingleton::instance().getDBObjectInstance()->updateFileTransferProgressVector(events);
-                events.clear();
-            }
+            ProgressCoalescer::instance().flush();
         }
         catch (const boost::thread_interrupted&) {
             FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Thread interruption requested" << commit;
@@ -88,6 +85,14 @@ void SupervisorService::runService()
             FTS3_COMMON_LOGGER_NEWLOG(ERR) << error.what() << commit;
         }
     }
+
+    // Do not lose the progress still pending on shutdown
+    try {
+        ProgressCoalescer::instance().flush(true);
+    }
+    catch (const std::exception &error) {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not write the pending progress: " << error.what() << commit;
+    }
 }
 
 }
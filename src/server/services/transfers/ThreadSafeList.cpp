@@ -18,7 +18,6 @@
  * limitations under the License.
  */
 
-#include <iostream>
 #include <ctime>
 #include <common/Exceptions.h>
 
@@ -29,6 +28,24 @@
 using fts3::common::SystemError;
 
 
+// Lock the shard, giving up after a while
+class ShardLock {
+public:
+    ShardLock(boost::timed_mutex &mutex, const char *func): mutex(mutex) {
+        if (!mutex.timed_lock(boost::posix_time::seconds(10))) {
+            throw SystemError(std::string(func) + ": Mutex timeout expired");
+        }
+    }
+
+    ~ShardLock() {
+        mutex.unlock();
+    }
+
+private:
+    boost::timed_mutex &mutex;
+};
+
+
 ThreadSafeList::ThreadSafeList()
 {
 }
@@ -39,23 +56,60 @@ ThreadSafeList::~ThreadSafeList()
 }
 
 
+ThreadSafeList::Shard &ThreadSafeList::getShard(const std::string &jobId)
+{
+    // Pings may carry more than the job id
+    return shards[std::hash<std::string>()(jobId.substr(0, 36)) % N_SHARDS];
+}
+
+
+void ThreadSafeList::Shard::erase(std::unordered_map<Key, Entry, KeyHash>::iterator entry)
+{
+    const uint64_t pid = entry->second.msg.process_id();
+
+    auto range = byPid.equal_range(pid);
+    for (auto i = range.first; i != range.second; ++i) {
+        if (i->second == entry->first) {
+            byPid.erase(i);
+            break;
+        }
+    }
+    if (byPid.find(pid) == byPid.end()) {
+        pidStartTimes.erase(pid);
+    }
+
+    byTimestamp.erase(entry->second.expiration);
+    byTransfer.erase(entry);
+}
+
+
 void ThreadSafeList::push_back(fts3::events::MessageUpdater &msg)
 {
-    if (!_mutex.timed_lock(boost::posix_time::seconds(10))) {
-        throw SystemError(std::string(__func__) + ": Mutex timeout expired");
+    Shard &shard = getShard(msg.job_id());
+    ShardLock lock(shard.mutex, __func__);
+
+    Key key(msg.job_id(), msg.file_id());
+    auto existing = shard.byTransfer.find(key);
+    if (existing != shard.byTransfer.end()) {
+        shard.erase(existing);
     }
-    m_list.push_back(msg);
-    _mutex.unlock();
+
+    Entry &entry = shard.byTransfer[key];
+    entry.msg = msg;
+    entry.expiration = shard.byTimestamp.emplace(msg.timestamp(), key);
+    shard.byPid.emplace(msg.process_id(), key);
 }
 
 
 void ThreadSafeList::clear()
 {
-    if (!_mutex.timed_lock(boost::posix_time::seconds(10))) {
-        throw SystemError(std::string(__func__) + ": Mutex timeout expired");
+    for (size_t i = 0; i < N_SHARDS; ++i) {
+        ShardLock lock(shards[i].mutex, __func__);
+        shards[i].byTransfer.clear();
+        shards[i].byPid.clear();
+        shards[i].byTimestamp.clear();
+        shards[i].pidStartTimes.clear();
     }
-    m_list.clear();
-    _mutex.unlock();
 }
 
 
@@ -64,110 +118,96 @@ void ThreadSafeList::checkExpiredMsg(std::vector<fts3::events::MessageUpdater> &
 {
     static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
 
-    if (!_mutex.timed_lock(boost::posix_time::seconds(10))) {
-        throw SystemError(std::string(__func__) + ": Mutex timeout expired");
-    }
-
-    try {
-        for (auto iter = m_list.begin(); iter != m_list.end(); ++iter) {
-            auto nowTime = boost::posix_time::microsec_clock::universal_time();
-            auto lastMsgTime = epoch + boost::posix_time::milliseconds(iter->timestamp());
+    const auto nowTime = boost::posix_time::microsec_clock::universal_time();
+    const int64_t cutoff = (nowTime - epoch - timeout).total_milliseconds();
 
-            auto age = nowTime - lastMsgTime;
+    for (size_t i = 0; i < N_SHARDS; ++i) {
+        Shard &shard = shards[i];
+        ShardLock lock(shard.mutex, __func__);
 
-            if (age > timeout) {
-                messages.push_back(*iter);
-            }
+        // Only the expired ones are visited
+        for (auto iter = shard.byTimestamp.begin();
+             iter != shard.byTimestamp.end() && static_cast<int64_t>(iter->first) < cutoff; ++iter) {
+            messages.push_back(shard.byTransfer[iter->second].msg);
         }
     }
-    catch (...) {
-        _mutex.unlock();
-        throw;
-    }
-    _mutex.unlock();
 }
 
 
 void ThreadSafeList::updateMsg(fts3::events::MessageUpdater &msg)
 {
-    if (!_mutex.timed_lock(boost::posix_time::seconds(10))) {
-        throw SystemError(std::string(__func__) + ": Mutex timeout expired");
+    Shard &shard = getShard(msg.job_id());
+    const uint64_t pid = msg.process_id();
+
+    uint64_t pidStartTime = 0;
+    {
+        ShardLock lock(shard.mutex, __func__);
+        if (shard.byPid.find(pid) == shard.byPid.end()) {
+            return;
+        }
+        auto cached = shard.pidStartTimes.find(pid);
+        if (cached != shard.pidStartTimes.end()) {
+            pidStartTime = cached->second;
+        }
+    }
+
+    // Read /proc without holding the lock
+    bool lookedUp = false;
+    if (pidStartTime == 0) {
+        pidStartTime = fts3::common::getPidStartime(pid);
+        lookedUp = true;
+    }
+
+    ShardLock lock(shard.mutex, __func__);
+
+    if (lookedUp && pidStartTime > 0 && shard.byPid.find(pid) != shard.byPid.end()) {
+        shard.pidStartTimes[pid] = pidStartTime;
     }
 
-    try {
-        std::list<fts3::events::MessageUpdater>::iterator iter;
-        uint64_t pidStartTime = fts3::common::getPidStartime(msg.process_id());
-        for (iter = m_list.begin(); iter != m_list.end(); ++iter) {
-
-            if (msg.process_id() == iter->process_id()) {
-                if (pidStartTime > 0 && msg.timestamp() >= pidStartTime) {
-                    iter->set_timestamp(msg.timestamp());
-                }
-                else if (pidStartTime > 0) {
-                    FTS3_COMMON_LOGGER_NEWLOG(WARNING)
-                        << "Found a matching pid, but start time is more recent than last known message"
-                        << "(" << pidStartTime << " vs " << msg.timestamp() << " for " << msg.process_id() << ")"
-                        << fts3::common::commit;
-                }
-            }
+    if (pidStartTime > 0 && msg.timestamp() >= pidStartTime) {
+        auto range = shard.byPid.equal_range(pid);
+        for (auto i = range.first; i != range.second; ++i) {
+            Entry &entry = shard.byTransfer[i->second];
+            entry.msg.set_timestamp(msg.timestamp());
+            shard.byTimestamp.erase(entry.expiration);
+            entry.expiration = shard.byTimestamp.emplace(msg.timestamp(), i->second);
         }
     }
-    catch (...) {
-        _mutex.unlock();
-        throw;
+    else if (pidStartTime > 0) {
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING)
+            << "Found a matching pid, but start time is more recent than last known message"
+            << "(" << pidStartTime << " vs " << msg.timestamp() << " for " << msg.process_id() << ")"
+            << fts3::common::commit;
     }
-    _mutex.unlock();
 }
 
 
 void ThreadSafeList::deleteMsg(std::vector<fts3::events::MessageUpdater> &messages)
 {
-    if (!_mutex.timed_lock(boost::posix_time::seconds(10))) {
-        throw SystemError(std::string(__func__) + ": Mutex timeout expired");
+    for (auto iter = messages.begin(); iter != messages.end(); ++iter) {
+        removeFinishedTr(iter->job_id(), iter->file_id());
     }
-
-    try {
-        std::list<fts3::events::MessageUpdater>::iterator i = m_list.begin();
-        for (auto iter = messages.begin(); iter != messages.end(); ++iter) {
-            i = m_list.begin();
-            while (i != m_list.end()) {
-                if ((*iter).file_id() == i->file_id() && (*iter).job_id().compare(i->job_id()) == 0) {
-                    m_list.erase(i++);
-                }
-                else {
-                    ++i;
-                }
-            }
-        }
-    }
-    catch (...) {
-        _mutex.unlock();
-        throw;
-    }
-    _mutex.unlock();
 }
 
 
 void ThreadSafeList::removeFinishedTr(std::string job_id, uint64_t file_id)
 {
-    if (!_mutex.timed_lock(boost::posix_time::seconds(10))) {
-        throw SystemError(std::string(__func__) + ": Mutex timeout expired");
-    }
+    Shard &shard = getShard(job_id);
+    ShardLock lock(shard.mutex, __func__);
 
-    try {
-        std::list<fts3::events::MessageUpdater>::iterator i = m_list.begin();
-        while (i != m_list.end()) {
-            if (file_id == i->file_id() && job_id == i->job_id()) {
-                m_list.erase(i++);
-            }
-            else {
-                ++i;
-            }
-        }
+    auto entry = shard.byTransfer.find(Key(job_id, file_id));
+    if (entry != shard.byTransfer.end()) {
+        shard.erase(entry);
     }
-    catch (...) {
-        _mutex.unlock();
-        throw;
+}
+
+
+size_t ThreadSafeList::size()
+{
+    size_t total = 0;
+    for (size_t i = 0; i < N_SHARDS; ++i) {
+        ShardLock lock(shards[i].mutex, __func__);
+        total += shards[i].byTransfer.size();
     }
-    _mutex.unlock();
+    return total;
 }
@@ -21,13 +21,19 @@
 #ifndef THREADSAFELIST_H_
 #define THREADSAFELIST_H_
 
-#include <list>
-#include <vector>
+#include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <boost/thread.hpp>
 #include "msg-bus/events.h"
 
 
+/// Watch list of the running url-copy processes, with the time they were last heard of.
+/// Entries are unique per (job_id, file_id), and spread over shards by job, each with its own lock,
+/// so the supervisor, the message processing and the canceler do not contend on a single lock.
+/// Each shard indexes its entries by transfer, by pid, and by the time they were last heard of,
+/// so pings and expiration checks do not need to go through the whole list.
 class ThreadSafeList
 {
 public:
@@ -40,17 +46,51 @@ public:
     ThreadSafeList();
     ~ThreadSafeList();
 
+    /// Watch the transfer, replacing any previous entry for it
     void push_back(fts3::events::MessageUpdater &msg);
     void clear();
+    /// Refresh the last time the process of msg was heard of
     void updateMsg(fts3::events::MessageUpdater &msg);
+    /// Put into messages the entries not heard of for longer than timeout
     void checkExpiredMsg(std::vector<fts3::events::MessageUpdater>& messages,
         boost::posix_time::time_duration timeout);
+    /// Stop watching the transfers in messages
     void deleteMsg(std::vector<fts3::events::MessageUpdater>& messages);
     void removeFinishedTr(std::string job_id, uint64_t file_id);
 
+    /// Number of transfers watched
+    size_t size();
+
 private:
-    std::list<fts3::events::MessageUpdater> m_list;
-    mutable boost::recursive_timed_mutex _mutex;
+    typedef std::pair<std::string, uint64_t> Key;
+
+    struct KeyHash {
+        size_t operator () (const Key &key) const {
+            return std::hash<std::string>()(key.first) ^ (std::hash<uint64_t>()(key.second) << 1);
+        }
+    };
+
+    struct Entry {
+        fts3::events::MessageUpdater msg;
+        std::multimap<uint64_t, Key>::iterator expiration;
+    };
+
+    struct Shard {
+        boost::timed_mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash> byTransfer;
+        std::unordered_multimap<uint64_t, Key> byPid;
+        // Ordered by the timestamp of the last message
+        std::multimap<uint64_t, Key> byTimestamp;
+        // Start time of the watched pids, so /proc is read only once per process
+        std::unordered_map<uint64_t, uint64_t> pidStartTimes;
+
+        void erase(std::unordered_map<Key, Entry, KeyHash>::iterator entry);
+    };
+
+    static const size_t N_SHARDS = 16;
+    Shard shards[N_SHARDS];
+
+    Shard &getShard(const std::string &jobId);
 };
 
 #endif /*THREADSAFELIST_H_*/
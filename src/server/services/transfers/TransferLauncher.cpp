@@ -0,0 +1,521 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TransferLauncher.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include "common/Logger.h"
+#include "config/ServerConfig.h"
+
+#include "CloudStorageConfig.h"
+#include "ExecuteProcess.h"
+#include "ProcessLauncher.h"
+#include "QueueIndex.h"
+#include "SingleTrStateInstance.h"
+#include "ThreadSafeList.h"
+#include "UrlCopyCmd.h"
+#include "UrlCopyWorkerPool.h"
+
+#define BOOST_SPIRIT_THREADSAFE
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+namespace pt = boost::property_tree;
+
+using namespace fts3::common;
+using fts3::config::ServerConfig;
+
+
+namespace fts3 {
+namespace server {
+
+
+/// Retrieve the auth method used, from the job metadata
+static std::string getAuthMethod(const std::string& jobMetadata)
+{
+    if (jobMetadata != "null") {
+        std::stringstream iostr(jobMetadata);
+        pt::ptree job_metadata;
+
+        try {
+            pt::read_json(iostr, job_metadata);
+            return job_metadata.get<std::string>("auth_method", "null");
+        } catch (...) {
+            return "null";
+        }
+    }
+
+    return "null";
+}
+
+
+TransferLauncher::TransferLauncher(GenericDbIfce *db, int forkWorkers, bool monitoringMsg,
+    const std::string &infosys, const std::string &ftsHostName, const std::string &logDir, const std::string &msgDir):
+    db(db),
+    monitoringMsg(monitoringMsg), infosys(infosys), ftsHostName(ftsHostName),
+    logDir(logDir), msgDir(msgDir), inFlight(0), spawning(0)
+{
+    if (forkWorkers <= 0) {
+        forkWorkers = 1;
+    }
+    for (int i = 0; i < forkWorkers; ++i) {
+        workers.create_thread(boost::bind(&TransferLauncher::forkWorker, this));
+    }
+}
+
+
+TransferLauncher::~TransferLauncher()
+{
+    workers.interrupt_all();
+    workers.join_all();
+
+    // Spawns sent to the process launcher still report back here
+    boost::mutex::scoped_lock lock(mutex);
+    while (spawning > 0) {
+        forkedCv.wait(lock);
+    }
+}
+
+
+const TransferLauncher::PairConfig& TransferLauncher::getPairConfig(const std::string &sourceSe,
+    const std::string &destSe)
+{
+    auto key = std::make_pair(sourceSe, destSe);
+    auto i = pairConfigs.find(key);
+    if (i != pairConfigs.end()) {
+        return i->second;
+    }
+
+    PairConfig config;
+    config.currentActive = 0;
+    int maxActive = 0;
+    config.allowed = db->isTrAllowed(sourceSe, destSe, config.currentActive, maxActive);
+    if (config.allowed) {
+        config.streams = db->getStreamsOptimization(sourceSe, destSe);
+        config.ipv6 = db->isProtocolIPv6(sourceSe, destSe);
+        config.udt = db->isProtocolUDT(sourceSe, destSe);
+        config.debugLevel = db->getDebugLevel(sourceSe, destSe);
+        config.disableDelegation = db->getDisableDelegationFlag(sourceSe, destSe);
+        config.thirdPartyTURL = db->getThirdPartyTURL(sourceSe, destSe);
+    }
+    return pairConfigs.insert(std::make_pair(key, config)).first->second;
+}
+
+
+const TransferLauncher::VoConfig& TransferLauncher::getVoConfig(const std::string &voName)
+{
+    auto i = voConfigs.find(voName);
+    if (i != voConfigs.end()) {
+        return i->second;
+    }
+
+    VoConfig config;
+    config.secPerMb = db->getSecPerMb(voName);
+    config.globalTimeout = db->getGlobalTimeout(voName);
+    config.publishUserDn = db->publishUserDn(voName);
+    config.disableStreaming = db->getDisableStreamingFlag(voName);
+    return voConfigs.insert(std::make_pair(voName, config)).first->second;
+}
+
+
+boost::tribool TransferLauncher::getEvictionFlag(const std::string &sourceSe)
+{
+    auto i = evictionFlags.find(sourceSe);
+    if (i == evictionFlags.end()) {
+        i = evictionFlags.insert(std::make_pair(sourceSe, db->getEvictionFlag(sourceSe))).first;
+    }
+    return i->second;
+}
+
+
+int TransferLauncher::getMaxRetries(const std::string &jobId)
+{
+    auto i = maxRetries.find(jobId);
+    if (i == maxRetries.end()) {
+        i = maxRetries.insert(std::make_pair(jobId, db->getRetry(jobId))).first;
+    }
+    return i->second;
+}
+
+
+int TransferLauncher::launch(const std::vector<TransferToLaunch> &batch)
+{
+    // Stage 1: build the command line for each transfer, resolving the configuration once per pair and VO
+    std::list<std::pair<Launch, UrlCopyCmd> > prepared;
+    std::vector<events::Message> protocols;
+
+    for (auto i = batch.begin(); i != batch.end(); ++i) {
+        const TransferFile &tf = i->tf;
+
+        //stop forking when a signal is received to avoid deadlocks
+        if (tf.fileId == 0 || boost::this_thread::interruption_requested()) {
+            continue;
+        }
+
+        try {
+            const PairConfig &pairConfig = getPairConfig(tf.sourceSe, tf.destSe);
+            if (!pairConfig.allowed) {
+                continue;
+            }
+            const VoConfig &voConfig = getVoConfig(tf.voName);
+
+            UrlCopyCmd cmdBuilder;
+
+            if (voConfig.secPerMb > 0) {
+                cmdBuilder.setSecondsPerMB(voConfig.secPerMb);
+            }
+
+            TransferFile::ProtocolParameters protocolParams = tf.getProtocolParameters();
+
+            if (tf.internalFileParams.empty()) {
+                protocolParams.nostreams = pairConfig.streams;
+                protocolParams.timeout = voConfig.globalTimeout;
+                protocolParams.ipv6 = pairConfig.ipv6;
+                protocolParams.udt = pairConfig.udt;
+            }
+
+            cmdBuilder.setFromProtocol(protocolParams);
+
+            // Update from the transfer
+            cmdBuilder.setFromTransfer(tf, false, voConfig.publishUserDn, msgDir);
+
+            // OAuth credentials
+            std::string authMethod = getAuthMethod(tf.jobMetadata);
+            cmdBuilder.setAuthMethod(authMethod);
+
+            std::string cloudConfigFile = generateCloudStorageConfigFile(db, tf);
+            if ("oauth2" == authMethod) {
+                cloudConfigFile = generateOAuthConfigFile(db, tf, cloudConfigFile);
+            }
+            if (!cloudConfigFile.empty()) {
+                cmdBuilder.setOAuthFile(cloudConfigFile);
+            }
+
+            // Retrieve SE-issued tokens flag
+            cmdBuilder.setRetrieveSEToken(ServerConfig::instance().values().retrieveSEToken);
+
+            // Debug level
+            cmdBuilder.setDebugLevel(pairConfig.debugLevel);
+
+            // Disable delegation (according to link config)
+            cmdBuilder.setDisableDelegation(pairConfig.disableDelegation);
+
+            // Get SRM 3rd party TURL (according to link config)
+            if (!pairConfig.thirdPartyTURL.empty()) {
+                cmdBuilder.setThirdPartyTURL(pairConfig.thirdPartyTURL);
+            }
+
+            // Disable streaming via local transfers (according to global config)
+            cmdBuilder.setDisableStreaming(voConfig.disableStreaming);
+
+            // Enable monitoring
+            cmdBuilder.setMonitoring(monitoringMsg, msgDir);
+
+            // Set UrlCopyProcess ping interval (in seconds)
+            cmdBuilder.setPingInterval(ServerConfig::instance().values().urlCopyProcessPingInterval);
+
+            // Proxy
+            if (!i->proxy.empty()) {
+                cmdBuilder.setProxy(i->proxy);
+            }
+
+            // Info system
+            if (!infosys.empty()) {
+                cmdBuilder.setInfosystem(infosys);
+            }
+
+            // UDT and IPv6
+            cmdBuilder.setUDT(pairConfig.udt);
+            if (!cmdBuilder.isIPv6Explicit()) {
+                cmdBuilder.setIPv6(pairConfig.ipv6);
+            }
+
+            // Enable source file eviction from disk buffer (according to SE config)
+            cmdBuilder.setEvict(getEvictionFlag(tf.sourceSe));
+
+            // FTS3 host name
+            cmdBuilder.setFTSName(ftsHostName);
+
+            // Pass the number of active transfers for this link to url_copy
+            cmdBuilder.setNumberOfActive(pairConfig.currentActive);
+
+            // Log directory
+            cmdBuilder.setLogDir(logDir);
+
+            // Protocol parameters (specially interested on nostreams)
+            events::Message protoMsg;
+            protoMsg.set_transfer_status("UPDATE");
+            protoMsg.set_file_id(tf.fileId);
+            protoMsg.set_buffersize(cmdBuilder.getBuffersize());
+            protoMsg.set_nostreams(cmdBuilder.getNoStreams());
+            protoMsg.set_timeout(cmdBuilder.getTimeout());
+            protocols.push_back(protoMsg);
+
+            Launch launch;
+            launch.tf = tf;
+            // Cloud and OAuth configuration files are consumed by the transfer, so those always get their own process
+            if (cloudConfigFile.empty() && UrlCopyWorkerPool::instance().isRunning()) {
+                launch.poolKey = i->proxy.empty() ? "-" : i->proxy;
+            }
+            launch.pid = 0;
+            launch.failed = false;
+            prepared.emplace_back(launch, cmdBuilder);
+        }
+        catch (std::exception &e) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not prepare transfer " << tf.jobId << " " << tf.fileId
+                << ": " << e.what() << commit;
+        }
+    }
+
+    // The number of active transfers changes with every batch launched
+    pairConfigs.clear();
+
+    // check again here if the server has stopped - just in case
+    if (prepared.empty() || boost::this_thread::interruption_requested()) {
+        return 0;
+    }
+
+    // Stage 2: claim the whole batch at once
+    std::map<uint64_t, int> claimed;
+    db->claimTransfers(protocols, claimed);
+
+    std::set<std::string> activeJobs;
+    std::list<Launch> ready;
+
+    for (auto i = prepared.begin(); i != prepared.end(); ++i) {
+        Launch &launch = i->first;
+        UrlCopyCmd &cmdBuilder = i->second;
+        const TransferFile &tf = launch.tf;
+
+        auto claim = claimed.find(tf.fileId);
+        if (claim == claimed.end()) {
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING)
+                << "Transfer " << tf.jobId << " " << tf.fileId
+                << " not updated. Probably picked by another node" << commit;
+            continue;
+        }
+
+        // Forced transfers were never counted as queued
+        if (tf.fileState != "FORCE_START") {
+            QueueIndex::instance().transferScheduled(tf.fileId, tf.sourceSe, tf.destSe, tf.voName);
+        }
+
+        if (activeJobs.insert(tf.jobId).second) {
+            db->updateJobStatus(tf.jobId, "ACTIVE");
+        }
+
+        // Number of retries and maximum number allowed
+        int retry_times = claim->second;
+        cmdBuilder.setNumberOfRetries(retry_times < 0 ? 0 : retry_times);
+
+        if ((retry_times > 0) && (tf.overwriteFlag == "R")) {
+            cmdBuilder.setOverwrite(true);
+        }
+
+        // If is multihop job, file is not the final destination and overwriteFlag is "M" => enable overwrite
+        if (tf.jobType == Job::kTypeMultiHop && !tf.lastHop && tf.overwriteFlag == "M") {
+            cmdBuilder.setOverwrite(true);
+        }
+
+        int retry_max = getMaxRetries(tf.jobId);
+        cmdBuilder.setMaxNumberOfRetries(retry_max < 0 ? 0 : retry_max);
+
+        // Build the parameters
+        launch.args = cmdBuilder.generateArguments();
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Transfer params: " << cmdBuilder << commit;
+
+        ready.push_back(launch);
+    }
+
+    // Stage 3: hand them to the fork workers
+    int scheduled = static_cast<int>(ready.size());
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        inFlight += ready.size();
+        pending.splice(pending.end(), ready);
+    }
+    pendingCv.notify_all();
+
+    // Stage 4: meanwhile, write back whatever has been forked already
+    writeBack(false);
+
+    return scheduled;
+}
+
+
+void TransferLauncher::flush()
+{
+    writeBack(true);
+
+    voConfigs.clear();
+    evictionFlags.clear();
+    maxRetries.clear();
+}
+
+
+void TransferLauncher::forkWorker()
+{
+    while (!boost::this_thread::interruption_requested()) {
+        Launch launch;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while (pending.empty()) {
+                pendingCv.wait(lock);
+            }
+            launch = pending.front();
+            pending.pop_front();
+        }
+
+        // An idle worker for the same credential runs it right away
+        if (!launch.poolKey.empty()) {
+            pid_t pid = 0;
+            if (UrlCopyWorkerPool::instance().assign(launch.poolKey, launch.args, launch.tf.fileId, &pid)) {
+                launch.pid = pid;
+                forkDone(launch, false);
+                continue;
+            }
+        }
+
+        // The launcher replies asynchronously, so this worker can send the next one meanwhile
+        ProcessLauncher &processLauncher = ProcessLauncher::instance();
+        if (processLauncher.isRunning()) {
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                ++spawning;
+            }
+            processLauncher.spawnAsync(UrlCopyCmd::Program, launch.args,
+                [this, launch](pid_t pid, int error) mutable {
+                    // The launcher went away, so fork it from here instead
+                    if (error == ESRCH || error == EPIPE) {
+                        {
+                            boost::mutex::scoped_lock lock(mutex);
+                            pending.push_front(launch);
+                            --spawning;
+                        }
+                        pendingCv.notify_one();
+                        forkedCv.notify_all();
+                        return;
+                    }
+                    launch.pid = (error == 0) ? pid : 0;
+                    launch.failed = (error != 0);
+                    if (error) {
+                        launch.forkMessage = "Failed to spawn " + UrlCopyCmd::Program + ": " + strerror(error);
+                    }
+                    forkDone(launch, true);
+                });
+            continue;
+        }
+
+        try {
+            // Spawn the fts_url_copy
+            ExecuteProcess pr(UrlCopyCmd::Program, launch.args);
+            launch.failed = (-1 == pr.executeProcessShell(launch.forkMessage));
+            launch.pid = pr.getPid();
+        }
+        catch (std::exception &e) {
+            launch.failed = true;
+            launch.forkMessage = e.what();
+        }
+        catch (...) {
+            launch.failed = true;
+        }
+
+        forkDone(launch, false);
+    }
+}
+
+
+void TransferLauncher::forkDone(const Launch &launch, bool spawned)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        forked.push_back(launch);
+        --inFlight;
+        if (spawned) {
+            --spawning;
+        }
+    }
+    forkedCv.notify_all();
+}
+
+
+void TransferLauncher::writeBack(bool wait)
+{
+    std::list<Launch> done;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        while (wait && inFlight > 0) {
+            forkedCv.wait(lock);
+        }
+        done.swap(forked);
+    }
+
+    if (done.empty()) {
+        return;
+    }
+
+    std::vector<fts3::events::MessageUpdater> started;
+
+    for (auto i = done.begin(); i != done.end(); ++i) {
+        const TransferFile &tf = i->tf;
+
+        if (i->failed) {
+            db->updateTransferStatus(
+                tf.jobId, tf.fileId, 0.0, "FAILED",
+                "Transfer failed to fork, check fts3server.log for more details",
+                i->pid, 0, 0, false
+            );
+            db->updateJobStatus(tf.jobId, "FAILED");
+            QueueIndex::instance().transferTerminated(tf.fileId);
+
+            if (i->forkMessage.empty()) {
+                FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Transfer failed to fork "
+                    << tf.jobId << "  " << tf.fileId << commit;
+            }
+            else {
+                FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Transfer failed to fork " << i->forkMessage << "   " << tf.jobId <<
+                    "  " << tf.fileId << commit;
+            }
+        }
+        else {
+            fts3::events::MessageUpdater msg;
+            msg.set_job_id(tf.jobId);
+            msg.set_file_id(tf.fileId);
+            msg.set_process_id(i->pid);
+            msg.set_timestamp(millisecondsSinceEpoch());
+            started.push_back(msg);
+        }
+    }
+
+    if (!started.empty()) {
+        db->setTransfersPid(started);
+    }
+
+    // Only set watcher when the file has started
+    for (auto i = started.begin(); i != started.end(); ++i) {
+        ThreadSafeList::get_instance().push_back(*i);
+    }
+
+    // Send current state
+    for (auto i = done.begin(); i != done.end(); ++i) {
+        SingleTrStateInstance::instance().sendStateMessage(i->tf.jobId, i->tf.fileId);
+    }
+}
+
+} // end namespace server
+} // end namespace fts3
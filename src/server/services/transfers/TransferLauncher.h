@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef TRANSFERLAUNCHER_H_
+#define TRANSFERLAUNCHER_H_
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+#include <boost/logic/tribool.hpp>
+
+#include "db/generic/SingleDbInstance.h"
+#include "db/generic/TransferFile.h"
+
+
+namespace fts3 {
+namespace server {
+
+/// Transfer to be launched, with the proxy it has to use
+struct TransferToLaunch {
+    TransferToLaunch(const TransferFile &tf, const std::string &proxy): tf(tf), proxy(proxy) {}
+
+    TransferFile tf;
+    std::string proxy;
+};
+
+/// Launches fts_url_copy processes in batches, as a pipeline of stages:
+///  1. The configuration is resolved once per pair and VO for the whole batch
+///  2. The batch is claimed (moved to READY) within a single transaction
+///  3. The processes are forked by a pool of long-lived workers, or sent to the
+///     ProcessLauncher, while the caller is already preparing the next batch.
+///     If there is an idle fts_url_copy worker for the credential, it takes the transfer instead.
+///  4. The pids are written back in bulk
+class TransferLauncher
+{
+public:
+    /// Constructor
+    /// @param db               Database the transfers are claimed from
+    /// @param forkWorkers      How many threads fork fts_url_copy
+    /// @param monitoringMsg    If true, monitoring messages are in use
+    /// @param infosys          Information system host
+    /// @param ftsHostName      Hostname of the machine hosting FTS3
+    /// @param logDir           Directory for the transfer logs
+    /// @param msgDir           Directory for the messages
+    TransferLauncher(GenericDbIfce *db, int forkWorkers, bool monitoringMsg, const std::string &infosys,
+        const std::string &ftsHostName, const std::string &logDir, const std::string &msgDir);
+
+    /// Destructor
+    /// Stops the fork workers
+    ~TransferLauncher();
+
+    /// Claim the batch of transfers and queue them to be forked
+    /// Returns as soon as they are queued, without waiting for the forks
+    /// The link configuration, with its number of active transfers, is resolved again for each batch
+    /// @return How many transfers have been scheduled
+    int launch(const std::vector<TransferToLaunch> &batch);
+
+    /// Wait for all the queued forks to be done and write back their pids
+    /// Cached configuration is discarded, so it is resolved again on the next cycle
+    void flush();
+
+private:
+    /// Configuration shared by all the transfers of a pair
+    struct PairConfig {
+        bool allowed;
+        int currentActive;
+        int streams;
+        boost::tribool ipv6;
+        boost::tribool udt;
+        unsigned debugLevel;
+        bool disableDelegation;
+        std::string thirdPartyTURL;
+    };
+
+    /// Configuration shared by all the transfers of a VO
+    struct VoConfig {
+        int secPerMb;
+        int globalTimeout;
+        bool publishUserDn;
+        bool disableStreaming;
+    };
+
+    /// Transfer moving through the pipeline
+    struct Launch {
+        TransferFile tf;
+        std::vector<std::string> args;
+        /// Credential for the url copy workers pool. Empty if it can not run in a worker.
+        std::string poolKey;
+        int pid;
+        bool failed;
+        std::string forkMessage;
+    };
+
+    GenericDbIfce *db;
+    bool monitoringMsg;
+    std::string infosys;
+    std::string ftsHostName;
+    std::string logDir;
+    std::string msgDir;
+
+    // Only touched by the thread calling launch/flush
+    /// Cleared after each batch
+    std::map<std::pair<std::string, std::string>, PairConfig> pairConfigs;
+    std::map<std::string, VoConfig> voConfigs;
+    std::map<std::string, boost::tribool> evictionFlags;
+    std::map<std::string, int> maxRetries;
+
+    // Shared with the fork workers
+    boost::mutex mutex;
+    boost::condition_variable pendingCv;
+    boost::condition_variable forkedCv;
+    std::list<Launch> pending;
+    std::list<Launch> forked;
+    size_t inFlight;
+    /// Sent to the process launcher, waiting for its reply
+    size_t spawning;
+    boost::thread_group workers;
+
+    const PairConfig &getPairConfig(const std::string &sourceSe, const std::string &destSe);
+    const VoConfig &getVoConfig(const std::string &voName);
+    boost::tribool getEvictionFlag(const std::string &sourceSe);
+    int getMaxRetries(const std::string &jobId);
+
+    /// Fork worker main loop
+    void forkWorker();
+
+    /// Hand a launch, forked or failed, to writeBack
+    /// @param spawned  True if it was sent to the process launcher
+    void forkDone(const Launch &launch, bool spawned);
+
+    /// Write back the results of the forks done so far
+    /// @param wait If true, wait for all the queued forks first
+    void writeBack(bool wait);
+};
+
+} // end namespace server
+} // end namespace fts3
+
+#endif // TRANSFERLAUNCHER_H_
@@ -23,7 +23,6 @@
 
 #include "config/ServerConfig.h"
 #include "common/DaemonTools.h"
-#include "common/ThreadPool.h"
 
 #include "cred/DelegCred.h"
 
@@ -32,7 +31,8 @@
 #include "server/DrainMode.h"
 
 #include "TransferFileHandler.h"
-#include "FileTransferExecutor.h"
+#include "QueueIndex.h"
+#include "UrlCopyWorkerPool.h"
 
 #include <msg-bus/producer.h>
 
@@ -59,11 +59,28 @@ TransfersService::TransfersService(): BaseService("TransfersService")
 
     monitoringMessages = config::ServerConfig::instance().get<bool>("MonitoringMessaging");
     schedulingInterval = config::ServerConfig::instance().get<boost::posix_time::time_duration>("SchedulingInterval");
+    launchBatchSize = config::ServerConfig::instance().get<size_t>("TransferLaunchBatchSize");
+
+    launcher.reset(new TransferLauncher(db::DBSingleton::instance().getDBObjectInstance(), execPoolSize,
+        monitoringMessages, infosys, ftsHostName, logDir, msgDir));
+
+    unsigned urlCopyWorkers = config::ServerConfig::instance().get<unsigned>("UrlCopyWorkers");
+    if (urlCopyWorkers > 0) {
+        try {
+            UrlCopyWorkerPool::instance().start(cmd, msgDir + "/url_copy.sock", urlCopyWorkers,
+                config::ServerConfig::instance().get<unsigned>("UrlCopyWorkerMaxTransfers"),
+                config::ServerConfig::instance().get<unsigned>("UrlCopyWorkerIdleTimeout"));
+        }
+        catch (const std::exception &e) {
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << e.what() << ". Transfers will not run in url copy workers" << commit;
+        }
+    }
 }
 
 
 TransfersService::~TransfersService()
 {
+    UrlCopyWorkerPool::instance().stop();
 }
 
 
@@ -107,7 +124,6 @@ void TransfersService::getFiles(const std::vector<QueueId>& queues, int availabl
 {
     auto db = DBSingleton::instance().getDBObjectInstance();
 
-    ThreadPool<FileTransferExecutor> execPool(execPoolSize);
     std::map<std::string, int> slotsLeftForSource, slotsLeftForDestination;
     for (auto i = queues.begin(); i != queues.end(); ++i) {
         // To reduce queries, fill in one go limits as source and as destination
@@ -159,6 +175,10 @@ void TransfersService::getFiles(const std::vector<QueueId>& queues, int availabl
         int initial_size = tfh.size();
 
         std::set<std::string> warningPrintedSrc, warningPrintedDst;
+        std::vector<TransferToLaunch> batch;
+        int scheduled = 0;
+        time_t launchStart = time(0);
+
         while (!tfh.empty() && availableUrlCopySlots > 0)
         {
             // iterate over all VOs
@@ -166,7 +186,6 @@ void TransfersService::getFiles(const std::vector<QueueId>& queues, int availabl
             {
                 if (boost::this_thread::interruption_requested())
                 {
-                    execPool.interrupt();
                     return;
                 }
 
@@ -211,11 +230,12 @@ void TransfersService::getFiles(const std::vector<QueueId>& queues, int availabl
                     // Increment scheduled transfers by activity
                     scheduledByActivity[tf.activity]++;
 
-                    FileTransferExecutor *exec = new FileTransferExecutor(tf,
-                        monitoringMessages, infosys, ftsHostName,
-                        proxies[proxy_key], logDir, msgDir);
+                    batch.emplace_back(tf, proxies[proxy_key]);
+                    if (batch.size() >= launchBatchSize) {
+                        scheduled += launcher->launch(batch);
+                        batch.clear();
+                    }
 
-                    execPool.start(exec);
                     --availableUrlCopySlots;
                     --slotsLeftForDestination[tf.destSe];
                     --slotsLeftForSource[tf.sourceSe];
@@ -229,11 +249,12 @@ void TransfersService::getFiles(const std::vector<QueueId>& queues, int availabl
                 << commit;
         }
 
-        // wait for all the workers to finish
-        execPool.join();
-        int scheduled = execPool.reduce(std::plus<int>());
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) <<"Threadpool processed: " << initial_size
-                << " files (" << scheduled << " have been scheduled)" << commit;
+        // wait for all the forks to be done
+        scheduled += launcher->launch(batch);
+        launcher->flush();
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) <<"Launcher processed: " << initial_size
+                << " files (" << scheduled << " have been scheduled in "
+                << time(0) - launchStart << " seconds)" << commit;
 
         if (scheduled > 0) {
             std::ostringstream out;
@@ -250,8 +271,6 @@ void TransfersService::getFiles(const std::vector<QueueId>& queues, int availabl
     }
     catch (const boost::thread_interrupted&) {
         FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Interruption requested in TransfersService:getFiles" << commit;
-        execPool.interrupt();
-        execPool.join();
     }
     catch (std::exception& e)
     {
@@ -269,7 +288,7 @@ void TransfersService::getFiles(const std::vector<QueueId>& queues, int availabl
  */
 static void failUnschedulable(const std::vector<QueueId> &unschedulable)
 {
-    Producer producer(config::ServerConfig::instance().get<std::string>("MessagingDirectory"));
+    Producer producer(config::ServerConfig::instance().values().messagingDirectory);
 
     std::map<std::string, std::list<TransferFile> > voQueues;
     DBSingleton::instance().getDBObjectInstance()->getReadyTransfers(unschedulable, voQueues);
@@ -302,8 +321,10 @@ void TransfersService::executeUrlcopy()
     boost::thread_group g;
 
     // Bail out as soon as possible if there are too many url-copy processes
-    int maxUrlCopy = config::ServerConfig::instance().get<int>("MaxUrlCopyProcesses");
-    int urlCopyCount = countProcessesWithName("fts_url_copy");
+    int maxUrlCopy = config::ServerConfig::instance().values().maxUrlCopyProcesses;
+    // Idle workers are not running any transfer
+    int urlCopyCount = countProcessesWithName("fts_url_copy") -
+        static_cast<int>(UrlCopyWorkerPool::instance().idleCount());
     int availableUrlCopySlots = maxUrlCopy - urlCopyCount;
 
     if (availableUrlCopySlots <= 0) {
@@ -315,7 +336,8 @@ void TransfersService::executeUrlcopy()
 
     try {
       time_t start = time(0); //std::chrono::system_clock::now();
-        DBSingleton::instance().getDBObjectInstance()->getQueuesWithPending(queues);
+        QueueIndex::instance().refresh();
+        QueueIndex::instance().getQueuesWithPending(queues);
         // Breaking determinism. See FTS-704 for an explanation.
         std::random_shuffle(queues.begin(), queues.end());
         // Apply VO shares at this level. Basically, if more than one VO is used the same link,
@@ -22,11 +22,13 @@
 #ifndef PROCESSSERVICE_H_
 #define PROCESSSERVICE_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "db/generic/QueueId.h"
 #include "../BaseService.h"
+#include "TransferLauncher.h"
 
 
 namespace fts3 {
@@ -53,6 +55,8 @@ protected:
     std::string logDir;
     std::string msgDir;
     boost::posix_time::time_duration schedulingInterval;
+    size_t launchBatchSize;
+    std::unique_ptr<TransferLauncher> launcher;
 
     void getFiles(const std::vector<QueueId>& queues, int availableUrlCopySlots);
     void executeUrlcopy();
@@ -84,6 +84,23 @@ std::string UrlCopyCmd::generateParameters(void)
 }
 
 
+std::vector<std::string> UrlCopyCmd::generateArguments(void)
+{
+    std::vector<std::string> args;
+
+    for (auto flag = flags.begin(); flag != flags.end(); ++flag) {
+        args.push_back("--" + *flag);
+    }
+
+    for (auto option = options.begin(); option != options.end(); ++option) {
+        args.push_back("--" + option->first);
+        args.push_back(option->second);
+    }
+
+    return args;
+}
+
+
 void UrlCopyCmd::setLogDir(const std::string &path)
 {
     setOption("logDir", path);
@@ -309,6 +326,12 @@ void UrlCopyCmd::setNumberOfActive(int active)
 }
 
 
+void UrlCopyCmd::setConcurrency(unsigned concurrency)
+{
+    setOption("concurrency", concurrency);
+}
+
+
 void UrlCopyCmd::setNumberOfRetries(int count)
 {
     setOption("retry", count);
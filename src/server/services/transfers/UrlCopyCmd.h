@@ -24,6 +24,7 @@
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "db/generic/TransferFile.h"
 
@@ -55,6 +56,9 @@ public:
 
     std::string generateParameters(void);
 
+    /// Same as generateParameters, one argument per entry
+    std::vector<std::string> generateArguments(void);
+
     void setLogDir(const std::string&);
     void setMonitoring(bool, const std::string&);
     void setPingInterval(int interval);
@@ -77,6 +81,7 @@ public:
     void setSecondsPerMB(long);
 
     void setNumberOfActive(int);
+    void setConcurrency(unsigned);
     void setNumberOfRetries(int);
     void setMaxNumberOfRetries(int);
     void setDisableDelegation(bool);
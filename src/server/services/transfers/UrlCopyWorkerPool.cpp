@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UrlCopyWorkerPool.h"
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "common/Exceptions.h"
+#include "common/Logger.h"
+
+#include "ExecuteProcess.h"
+
+using namespace fts3::common;
+
+
+namespace fts3 {
+namespace server {
+
+/// Same limit as the process launcher, and fts_url_copy
+static const size_t MAX_ASSIGNMENT_SIZE = 128 * 1024;
+
+/// Messages from the workers are short
+static const size_t MAX_MESSAGE_SIZE = 4096;
+
+/// A worker that did not connect after this many seconds is not expected anymore
+static const time_t START_TIMEOUT = 60;
+
+/// How often, in milliseconds, the idle workers and the stop flag are checked
+static const int POLL_INTERVAL = 1000;
+
+
+UrlCopyWorkerPool::UrlCopyWorkerPool(): maxWorkers(0), maxTransfers(0), idleTimeout(0),
+    listenFd(-1), stopping(false)
+{
+}
+
+
+UrlCopyWorkerPool::~UrlCopyWorkerPool()
+{
+    stop();
+}
+
+
+void UrlCopyWorkerPool::start(const std::string &program, const std::string &socketPath,
+    unsigned maxWorkers, unsigned maxTransfers, unsigned idleTimeout)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    if (listenFd >= 0) {
+        return;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        throw SystemError("The socket path for the url copy workers is too long: " + socketPath);
+    }
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw SystemError(std::string("Could not create the socket for the url copy workers: ") + strerror(errno));
+    }
+
+    // Left behind by a previous run
+    unlink(socketPath.c_str());
+
+    // Only processes running as the same user can connect
+    mode_t oldMask = umask(0177);
+    int bound = bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    umask(oldMask);
+
+    if (bound < 0 || listen(fd, SOMAXCONN) < 0) {
+        int err = errno;
+        close(fd);
+        throw SystemError("Could not listen on " + socketPath + ": " + strerror(err));
+    }
+
+    this->program = program;
+    this->socketPath = socketPath;
+    this->maxWorkers = maxWorkers;
+    this->maxTransfers = maxTransfers;
+    this->idleTimeout = idleTimeout;
+    listenFd = fd;
+    stopping = false;
+    acceptor = boost::thread(&UrlCopyWorkerPool::serve, this);
+
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Url copy workers pool listening on " << socketPath << commit;
+}
+
+
+void UrlCopyWorkerPool::stop()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (listenFd < 0) {
+            return;
+        }
+        stopping = true;
+    }
+
+    acceptor.join();
+
+    boost::mutex::scoped_lock lock(mutex);
+    for (auto w = workers.begin(); w != workers.end(); ++w) {
+        close(w->fd);
+    }
+    workers.clear();
+    starting.clear();
+
+    close(listenFd);
+    listenFd = -1;
+    unlink(socketPath.c_str());
+}
+
+
+bool UrlCopyWorkerPool::isRunning()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return listenFd >= 0 && !stopping;
+}
+
+
+bool UrlCopyWorkerPool::assign(const std::string &key, const std::vector<std::string> &args, uint64_t fileId,
+    pid_t *pid)
+{
+    std::string message;
+    for (auto arg = args.begin(); arg != args.end(); ++arg) {
+        message.append(*arg).push_back('\0');
+    }
+    if (message.size() > MAX_ASSIGNMENT_SIZE) {
+        return false;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if (listenFd < 0 || stopping) {
+            return false;
+        }
+
+        size_t count = starting.count(key);
+        for (auto w = workers.begin(); w != workers.end(); ++w) {
+            if (w->key != key || w->closing) {
+                continue;
+            }
+            ++count;
+            if (!w->idle) {
+                continue;
+            }
+
+            w->idle = false;
+            if (send(w->fd, message.data(), message.size(), MSG_NOSIGNAL | MSG_DONTWAIT) ==
+                static_cast<ssize_t>(message.size())) {
+                w->fileId = fileId;
+                *pid = w->pid;
+                return true;
+            }
+
+            // Gone. The acceptor closes it once it sees the end of the connection.
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not send a transfer to the url copy worker "
+                << w->pid << ": " << strerror(errno) << commit;
+            w->closing = true;
+            shutdown(w->fd, SHUT_RDWR);
+            --count;
+        }
+
+        if (count >= maxWorkers) {
+            return false;
+        }
+        starting.insert(std::make_pair(key, time(NULL)));
+    }
+
+    startWorker(key);
+    return false;
+}
+
+
+bool UrlCopyWorkerPool::cancel(uint64_t fileId)
+{
+    if (fileId == 0) {
+        return false;
+    }
+
+    const std::string message = std::string("CANCEL") + '\0' + boost::lexical_cast<std::string>(fileId);
+
+    boost::mutex::scoped_lock lock(mutex);
+    for (auto w = workers.begin(); w != workers.end(); ++w) {
+        if (w->fileId != fileId) {
+            continue;
+        }
+        if (send(w->fd, message.data(), message.size(), MSG_NOSIGNAL | MSG_DONTWAIT) ==
+            static_cast<ssize_t>(message.size())) {
+            return true;
+        }
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not send a cancel to the url copy worker "
+            << w->pid << ": " << strerror(errno) << commit;
+        return false;
+    }
+    return false;
+}
+
+
+bool UrlCopyWorkerPool::mayKill(pid_t pid, uint64_t fileId)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    for (auto w = workers.begin(); w != workers.end(); ++w) {
+        if (w->pid == pid) {
+            return fileId != 0 && w->fileId == fileId;
+        }
+    }
+    return true;
+}
+
+
+size_t UrlCopyWorkerPool::idleCount()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    size_t count = 0;
+    for (auto w = workers.begin(); w != workers.end(); ++w) {
+        if (w->idle) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+
+void UrlCopyWorkerPool::startWorker(const std::string &key)
+{
+    std::vector<std::string> args;
+    args.push_back("--worker");
+    args.push_back(socketPath);
+    args.push_back("--worker-key");
+    args.push_back(key);
+    args.push_back("--worker-max-transfers");
+    args.push_back(boost::lexical_cast<std::string>(maxTransfers));
+
+    std::string message;
+    ExecuteProcess process(program, args);
+    if (process.executeProcessShell(message) < 0) {
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not start a url copy worker: " << message << commit;
+
+        boost::mutex::scoped_lock lock(mutex);
+        auto s = starting.find(key);
+        if (s != starting.end()) {
+            starting.erase(s);
+        }
+        return;
+    }
+
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Started url copy worker " << process.getPid()
+        << " for " << key << commit;
+}
+
+
+void UrlCopyWorkerPool::onMessage(Worker &worker, const std::string &message)
+{
+    if (message.compare(0, 6, std::string("HELLO\0", 6)) == 0) {
+        worker.key = message.substr(6);
+        worker.idle = true;
+        worker.fileId = 0;
+        worker.idleSince = time(NULL);
+
+        auto s = starting.find(worker.key);
+        if (s != starting.end()) {
+            starting.erase(s);
+        }
+        FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Url copy worker " << worker.pid << " connected for "
+            << worker.key << commit;
+    }
+    else if (message == "READY") {
+        worker.idle = true;
+        worker.fileId = 0;
+        worker.idleSince = time(NULL);
+    }
+    // Exits after its last transfer
+    else if (message == "BYE") {
+        worker.idle = false;
+        worker.fileId = 0;
+        worker.closing = true;
+    }
+    else {
+        FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Unexpected message from the url copy worker " << worker.pid << commit;
+    }
+}
+
+
+void UrlCopyWorkerPool::serve()
+{
+    std::vector<char> buffer(MAX_MESSAGE_SIZE);
+
+    while (true) {
+        // Only this thread closes the connections, so the descriptors stay valid while polling
+        std::vector<struct pollfd> fds;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            if (stopping) {
+                break;
+            }
+
+            time_t now = time(NULL);
+            for (auto w = workers.begin(); w != workers.end(); ++w) {
+                if (w->idle && now - w->idleSince > static_cast<time_t>(idleTimeout)) {
+                    // Exits when it sees the end of the connection
+                    w->idle = false;
+                    w->closing = true;
+                    shutdown(w->fd, SHUT_RDWR);
+                }
+            }
+            for (auto s = starting.begin(); s != starting.end();) {
+                if (now - s->second > START_TIMEOUT) {
+                    starting.erase(s++);
+                }
+                else {
+                    ++s;
+                }
+            }
+
+            struct pollfd pfd;
+            pfd.fd = listenFd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+            for (auto w = workers.begin(); w != workers.end(); ++w) {
+                pfd.fd = w->fd;
+                fds.push_back(pfd);
+            }
+        }
+
+        int ready = ::poll(fds.data(), fds.size(), POLL_INTERVAL);
+        if (ready < 0 && errno != EINTR) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Url copy workers pool failed to poll: " << strerror(errno) << commit;
+            boost::this_thread::sleep(boost::posix_time::milliseconds(POLL_INTERVAL));
+            continue;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                struct ucred cred;
+                socklen_t len = sizeof(cred);
+                if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 || cred.uid != getuid()) {
+                    FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Refused a connection to the url copy workers pool" << commit;
+                    close(fd);
+                }
+                else {
+                    Worker worker;
+                    worker.fd = fd;
+                    worker.pid = cred.pid;
+                    worker.idle = false;
+                    worker.fileId = 0;
+                    worker.closing = false;
+                    worker.idleSince = 0;
+
+                    boost::mutex::scoped_lock lock(mutex);
+                    workers.push_back(worker);
+                }
+            }
+        }
+
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (!fds[i].revents) {
+                continue;
+            }
+
+            ssize_t size = recv(fds[i].fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+            if (size < 0 && (errno == EAGAIN || errno == EINTR)) {
+                continue;
+            }
+
+            boost::mutex::scoped_lock lock(mutex);
+            for (auto w = workers.begin(); w != workers.end(); ++w) {
+                if (w->fd != fds[i].fd) {
+                    continue;
+                }
+                if (size > 0) {
+                    onMessage(*w, std::string(buffer.data(), size));
+                }
+                else {
+                    // Exited, or done
+                    FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Url copy worker " << w->pid << " disconnected" << commit;
+                    close(w->fd);
+                    workers.erase(w);
+                }
+                break;
+            }
+        }
+    }
+}
+
+} // end namespace server
+} // end namespace fts3
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#ifndef URLCOPYWORKERPOOL_H_
+#define URLCOPYWORKERPOOL_H_
+
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include <boost/thread.hpp>
+
+#include "common/Singleton.h"
+
+
+namespace fts3 {
+namespace server {
+
+/// Pool of long-lived fts_url_copy workers (fts_url_copy --worker), per credential.
+///
+/// Workers connect to a unix socket, and are assigned transfers one at a time, with the same
+/// arguments a new fts_url_copy would have been given. They keep their gfal2 contexts, and so
+/// their connections, from one transfer to the next.
+/// When there is no idle worker for a credential, the transfer is launched as usual, and a new
+/// worker is started for the next ones, up to the configured limit.
+/// Canceled transfers are told to the worker running them, which goes on with the next one.
+class UrlCopyWorkerPool: public fts3::common::Singleton<UrlCopyWorkerPool>
+{
+public:
+    UrlCopyWorkerPool();
+
+    /// Stops the pool
+    ~UrlCopyWorkerPool();
+
+    /// Listen on socketPath for workers
+    /// @param program      Binary of the workers
+    /// @param socketPath   Unix socket the workers connect to
+    /// @param maxWorkers   Maximum number of workers per credential
+    /// @param maxTransfers Workers exit after this many transfers
+    /// @param idleTimeout  Workers idle for longer than this, in seconds, are told to exit
+    void start(const std::string &program, const std::string &socketPath,
+        unsigned maxWorkers, unsigned maxTransfers, unsigned idleTimeout);
+
+    /// Disconnect all workers, which exit after their current transfer
+    void stop();
+
+    bool isRunning();
+
+    /// Send a transfer to an idle worker of the credential
+    /// If there is none, one is started for the next time, and the caller has to launch it
+    /// @param key    Credential the transfer runs with
+    /// @param args   Arguments of fts_url_copy for the transfer
+    /// @param fileId File id of the transfer
+    /// @param pid    Set to the pid of the worker
+    /// @return true if a worker took the transfer
+    bool assign(const std::string &key, const std::vector<std::string> &args, uint64_t fileId, pid_t *pid);
+
+    /// Ask the worker running the transfer to cancel it
+    /// The worker stays alive, and takes other transfers afterwards
+    /// @return true if a worker is running the transfer
+    bool cancel(uint64_t fileId);
+
+    /// Workers run several transfers one after the other, so the pid stored for a transfer
+    /// may be running another one by now
+    /// @return false if pid is a worker that is not running the transfer
+    bool mayKill(pid_t pid, uint64_t fileId);
+
+    /// Number of workers waiting for a transfer
+    /// They are fts_url_copy processes, but do not run any transfer
+    size_t idleCount();
+
+private:
+    UrlCopyWorkerPool(UrlCopyWorkerPool const &) = delete;
+    UrlCopyWorkerPool& operator=(UrlCopyWorkerPool const &) = delete;
+
+    struct Worker {
+        int fd;
+        pid_t pid;
+        std::string key;
+        bool idle;
+        /// Transfer it runs, 0 if none
+        uint64_t fileId;
+        /// Told to exit, or failed, waiting for the end of the connection
+        bool closing;
+        time_t idleSince;
+    };
+
+    std::string program;
+    std::string socketPath;
+    unsigned maxWorkers;
+    unsigned maxTransfers;
+    unsigned idleTimeout;
+
+    boost::mutex mutex;
+    int listenFd;
+    bool stopping;
+    std::list<Worker> workers;
+    /// Started, but not connected yet, with when they were started
+    std::multimap<std::string, time_t> starting;
+    boost::thread acceptor;
+
+    /// Accept workers, and read their messages
+    void serve();
+
+    /// Handle a message from a worker
+    void onMessage(Worker &worker, const std::string &message);
+
+    /// Start a new worker for the credential
+    void startWorker(const std::string &key);
+};
+
+} // end namespace server
+} // end namespace fts3
+
+#endif // URLCOPYWORKERPOOL_H_
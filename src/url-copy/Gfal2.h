@@ -352,6 +352,14 @@ public:
         }
     }
 
+    /// Forget the credentials set for specific URLs, like bearer tokens
+    void clearCredentials(void) {
+        GError *error = NULL;
+        if (gfal2_cred_clean(context, &error) < 0) {
+            throw Gfal2Exception(error);
+        }
+    }
+
     /// Cancel any running operation
     void cancel(void) {
         gfal2_cancel(context);
@@ -330,6 +330,12 @@ void LegacyReporter::sendTransferCompleted(const Transfer &transfer, Gfal2Transf
     completed.checksum_source_time_ms = transfer.stats.sourceChecksum.end - transfer.stats.sourceChecksum.start;
     completed.checksum_dest_time_ms = transfer.stats.destChecksum.end - transfer.stats.destChecksum.start;
 
+    completed.preparation_time_ms = transfer.stats.preparation.end - transfer.stats.preparation.start;
+    completed.token_retrieval_time_ms = transfer.stats.tokenRetrieval.end - transfer.stats.tokenRetrieval.start;
+    completed.source_stat_time_ms = transfer.stats.sourceStat.end - transfer.stats.sourceStat.start;
+    completed.dest_stat_time_ms = transfer.stats.destinationStat.end - transfer.stats.destinationStat.start;
+    completed.finalization_time_ms = transfer.stats.finalization.end - transfer.stats.finalization.start;
+
     // Keep 'ipv6' flag for legacy purposes
     completed.ipv6 = transfer.stats.ipver == Transfer::IPver::IPv6;
     // New 'ipver' field keyword ("ipv6" | "ipv4" | "unknown")
@@ -68,6 +68,13 @@ public:
         Interval srmFinalization;
         uint64_t elapsedAtPerf;
 
+        ///< Phases run by fts_url_copy around the copy. Some of them overlap.
+        Interval preparation;
+        Interval tokenRetrieval;
+        Interval sourceStat;
+        Interval destinationStat;
+        Interval finalization;
+
         Interval process;
 
         ///< Flag for IP version used during transfer
@@ -81,6 +81,7 @@ const option UrlCopyOpts::long_options[] =
     {"no-delegation",     no_argument,       0, 810},
     {"no-streaming",      no_argument,       0, 811},
     {"evict",             no_argument,       0, 812},
+    {"concurrency",       required_argument, 0, 813},
 
     {"retry",             required_argument, 0, 820},
     {"retry_max-max",     required_argument, 0, 821},
@@ -88,6 +89,10 @@ const option UrlCopyOpts::long_options[] =
     {"logDir",            required_argument, 0, 900},
     {"msgDir",            required_argument, 0, 901},
 
+    {"worker",            required_argument, 0, 1000},
+    {"worker-key",        required_argument, 0, 1001},
+    {"worker-max-transfers", required_argument, 0, 1002},
+
     {"help",              no_argument,       0, 0},
     {"debug",             required_argument, 0, 1},
     {"stderr",            no_argument,       0, 2},
@@ -176,9 +181,9 @@ UrlCopyOpts::UrlCopyOpts():
     isSessionReuse(false), strictCopy(false), dstFileReport(false), retrieveSEToken(false),
     optimizerLevel(0), overwrite(false), noDelegation(false), nStreams(0), tcpBuffersize(0),
     timeout(0), enableUdt(false), enableIpv6(boost::indeterminate), addSecPerMb(0), noStreaming(false),
-    evict(false), enableMonitoring(false), active(0), pingInterval(60), retry(0), retryMax(0),
+    evict(false), concurrency(1), enableMonitoring(false), active(0), pingInterval(60), retry(0), retryMax(0),
     logDir("/var/log/fts3"), msgDir("/var/lib/fts3"),
-    debugLevel(0), logToStderr(false)
+    debugLevel(0), logToStderr(false), workerMaxTransfers(0)
 {
 }
 
@@ -201,6 +206,9 @@ void UrlCopyOpts::parse(int argc, char * const argv[])
     int opt;
     Transfer referenceTransfer;
 
+    // A worker parses the options of each transfer it is assigned
+    optind = 0;
+
     try {
         while ((opt = getopt_long_only(argc, argv, short_options, long_options, NULL)) > -1) {
             switch (opt) {
@@ -375,6 +383,9 @@ void UrlCopyOpts::parse(int argc, char * const argv[])
                 case 812:
                     evict = true;
                     break;
+                case 813:
+                    concurrency = boost::lexical_cast<unsigned>(optarg);
+                    break;
 
                 case 820:
                     retry = boost::lexical_cast<int>(optarg);
@@ -390,6 +401,16 @@ void UrlCopyOpts::parse(int argc, char * const argv[])
                     msgDir = boost::lexical_cast<std::string>(optarg);
                     break;
 
+                case 1000:
+                    workerSocket = optarg;
+                    break;
+                case 1001:
+                    workerKey = optarg;
+                    break;
+                case 1002:
+                    workerMaxTransfers = boost::lexical_cast<unsigned>(optarg);
+                    break;
+
                 default:
                     usage(argv[0]);
             }
@@ -400,6 +421,11 @@ void UrlCopyOpts::parse(int argc, char * const argv[])
         exit(-1);
     }
 
+    // The transfers come later, from the server
+    if (!workerSocket.empty()) {
+        return;
+    }
+
     if (bulkFile.empty() &&
         (!referenceTransfer.source.fullUri.empty() && !referenceTransfer.destination.fullUri.empty())) {
         transfers.push_back(referenceTransfer);
@@ -72,6 +72,7 @@ public:
     unsigned addSecPerMb;
     bool     noStreaming;
     bool     evict;
+    unsigned concurrency; // Transfers of the list run at the same time
     bool     enableMonitoring; // Legacy option
     unsigned active; // Legacy option
     unsigned pingInterval;
@@ -85,6 +86,13 @@ public:
     unsigned debugLevel;
     bool     logToStderr;
 
+    // Run as a long-lived worker, connected to the server through this socket
+    std::string workerSocket;
+    // Credential the worker runs the transfers with
+    std::string workerKey;
+    // Exit after this many transfers. 0 for no limit.
+    unsigned    workerMaxTransfers;
+
     Transfer::TransferList transfers;
 
 private:
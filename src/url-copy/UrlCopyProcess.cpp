@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <cstdlib>
+#include <list>
 #include <boost/filesystem/operations.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -62,6 +64,16 @@ static void setupGlobalGfal2Config(const UrlCopyOpts &opts, Gfal2 &gfal2)
         setenv("X509_USER_CERT", opts.proxy.c_str(), 1);
         setenv("X509_USER_KEY", opts.proxy.c_str(), 1);
     }
+
+    // Load Cloud + OIDC credentials
+    // The file is removed by UrlCopyProcess::run once all its contexts are set up
+    if (!opts.oauthFile.empty()) {
+        try {
+            gfal2.loadConfigFile(opts.oauthFile);
+        } catch (const std::exception &ex) {
+            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not load OAuth config file: " << ex.what() << commit;
+        }
+    }
 }
 
 
@@ -99,27 +111,47 @@ static DestFile createDestFileReport(const Transfer &transfer, Gfal2 &gfal2, Gfa
 } 
 
 
-UrlCopyProcess::UrlCopyProcess(const UrlCopyOpts &opts, Reporter &reporter):
-    opts(opts), reporter(reporter), canceled(false), timeoutExpired(false)
+UrlCopyProcess::UrlCopyProcess(const UrlCopyOpts &opts, Reporter &reporter, Gfal2 *context):
+    opts(opts), reporter(reporter), ownGfal2(context ? NULL : new Gfal2),
+    gfal2(context ? *context : *ownGfal2), canceled(false), panicked(false)
 {
     todoTransfers = opts.transfers;
     setupGlobalGfal2Config(opts, gfal2);
 }
 
 
-static void setupTokenConfig(const UrlCopyOpts &opts, const Transfer &transfer,
-                             Gfal2 &gfal2, Gfal2TransferParams &params)
+/// Start a thread helping with a transfer, logging into its file if given
+static boost::thread startHelper(const boost::function<void()> &task, const std::string &logFile)
 {
-    // Load Cloud + OIDC credentials
-    if (!opts.oauthFile.empty()) {
-        try {
-            gfal2.loadConfigFile(opts.oauthFile);
-        } catch (const std::exception &ex) {
-            FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not load OAuth config file: " << ex.what() << commit;
+    return boost::thread([task, logFile]() {
+        if (!logFile.empty()) {
+            fts3::common::theLogger().redirectThread(logFile);
         }
-        unlink(opts.oauthFile.c_str());
+        task();
+    });
+}
+
+
+static bool retrieveToken(Gfal2 &gfal2, const std::string &url, const std::string &issuer, unsigned validity,
+                          const std::vector<std::string> &activities, const std::string &side, std::string *token)
+{
+    std::string tokenType = (!issuer.empty()) ? "bearer token" : "macaroon";
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Will attempt retrieval of " << tokenType << " for " << side << commit;
+    try {
+        *token = gfal2.tokenRetrieve(url, issuer, validity, activities);
+        return true;
+    } catch (const std::exception& ex) {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Failed to retrieve " << tokenType << " for " << side << ": " << ex.what() << commit;
     }
+    return false;
+}
+
 
+/// @param delay Seconds before the copy starts, when the transfer is prepared ahead of time
+static void setupTokenConfig(const UrlCopyOpts &opts, Transfer &transfer,
+                             Gfal2 &gfal2, Gfal2TransferParams &params, const std::string &logFile,
+                             unsigned delay)
+{
     // OIDC token has been passed already in the OauthFile
     // and loaded by Gfal2 as the default BEARER token credential
     if ("oauth2" == opts.authMethod) {
@@ -147,39 +179,55 @@ static void setupTokenConfig(const UrlCopyOpts &opts, const Transfer &transfer,
     bool macaroonEnabledDestination = ((transfer.destination.protocol.find("davs") == 0) || (transfer.destination.protocol.find("https") == 0));
     unsigned macaroonValidity = 180;
 
+    bool retrieveSource = !transfer.sourceTokenIssuer.empty() || macaroonEnabledSource;
+    bool retrieveDestination = !transfer.destTokenIssuer.empty() || macaroonEnabledDestination;
+    if (!retrieveSource && !retrieveDestination) {
+        return;
+    }
+
     // Request a macaroon longer twice the timeout as we could run both push and pull mode
     if (opts.timeout) {
         macaroonValidity = ((unsigned) (2 * opts.timeout) / 60) + 10 ;
     } else if (transfer.userFileSize) {
         macaroonValidity = ((unsigned) (2 * adjustTimeoutBasedOnSize(transfer.userFileSize, opts.addSecPerMb)) / 60) + 10;
     }
-
-    if (!transfer.sourceTokenIssuer.empty() || macaroonEnabledSource) {
-        std::string tokenType = (!transfer.sourceTokenIssuer.empty()) ? "bearer token" : "macaroon";
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Will attempt retrieval of " << tokenType << " for source" << commit;
-        try {
-            params.setSourceBearerToken(gfal2.tokenRetrieve(transfer.source, transfer.sourceTokenIssuer,
-                                                            macaroonValidity, {"DOWNLOAD", "LIST"}));
-        } catch (const Gfal2Exception& ex) {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Failed to retrieve " << tokenType << " for source: " << ex.what() << commit;
-        }
+    // Prepared while the previous copy runs, which can last until its own timeout
+    macaroonValidity += (delay + 59) / 60;
+
+    // Both sides are asked at the same time
+    transfer.stats.tokenRetrieval.start = millisecondsSinceEpoch();
+
+    std::string sourceToken, destToken;
+    bool gotSourceToken = false, gotDestToken = false;
+    boost::thread sourceThread;
+    if (retrieveSource) {
+        sourceThread = startHelper([&]() {
+            gotSourceToken = retrieveToken(gfal2, transfer.source, transfer.sourceTokenIssuer, macaroonValidity,
+                                           {"DOWNLOAD", "LIST"}, "source", &sourceToken);
+        }, logFile);
+    }
+    if (retrieveDestination) {
+        gotDestToken = retrieveToken(gfal2, transfer.destination, transfer.destTokenIssuer, macaroonValidity,
+                                     {"MANAGE", "UPLOAD", "DELETE", "LIST"}, "destination", &destToken);
+    }
+    if (sourceThread.joinable()) {
+        sourceThread.join();
     }
 
-    if (!transfer.destTokenIssuer.empty() || macaroonEnabledDestination) {
-        std::string tokenType = (!transfer.destTokenIssuer.empty()) ? "bearer token" : "macaroon";
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Will attempt retrieval of " << tokenType << " for destination" << commit;
-        try {
-            params.setDestBearerToken(gfal2.tokenRetrieve(transfer.destination, transfer.destTokenIssuer,
-                                                          macaroonValidity, {"MANAGE", "UPLOAD", "DELETE", "LIST"}));
-        } catch (const Gfal2Exception& ex) {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Failed to retrieve " << tokenType << " for destination: " << ex.what() << commit;
-        }
+    transfer.stats.tokenRetrieval.end = millisecondsSinceEpoch();
+
+    if (gotSourceToken) {
+        params.setSourceBearerToken(sourceToken);
+    }
+    if (gotDestToken) {
+        params.setDestBearerToken(destToken);
     }
 }
 
 
-static void setupTransferConfig(const UrlCopyOpts &opts, const Transfer &transfer,
-                                Gfal2 &gfal2, Gfal2TransferParams &params)
+static void setupTransferConfig(const UrlCopyOpts &opts, Transfer &transfer,
+                                Gfal2 &gfal2, Gfal2TransferParams &params, const std::string &logFile,
+                                unsigned delay)
 {
     params.setStrictCopy(opts.strictCopy);
     params.setCreateParentDir(true);
@@ -194,7 +242,7 @@ static void setupTransferConfig(const UrlCopyOpts &opts, const Transfer &transfe
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Source protocol: " << transfer.source.protocol << commit;
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Destination protocol: " << transfer.destination.protocol << commit;
 
-    setupTokenConfig(opts, transfer, gfal2, params);
+    setupTokenConfig(opts, transfer, gfal2, params, logFile, delay);
 
     if (!transfer.sourceTokenDescription.empty()) {
         params.setSourceSpacetoken(transfer.sourceTokenDescription);
@@ -217,7 +265,12 @@ static void setupTransferConfig(const UrlCopyOpts &opts, const Transfer &transfe
             }
     	}
     }
+}
 
+
+/// Settings of the context for the transfer
+static void setupTransferContext(const UrlCopyOpts &opts, const Transfer &transfer, Gfal2 &gfal2)
+{
     // Avoid TPC attempts in S3 to S3 transfers
     if ((transfer.source.protocol.find("s3") == 0) && (transfer.destination.protocol.find("s3") == 0)) {
         gfal2.set("HTTP PLUGIN", "ENABLE_REMOTE_COPY", false);
@@ -235,12 +288,92 @@ static void setupTransferConfig(const UrlCopyOpts &opts, const Transfer &transfe
 }
 
 
-static void timeoutTask(boost::posix_time::time_duration &duration, UrlCopyProcess *urlCopyProcess)
+/// Get the source file size, and check the destination does not exist yet, both at the same time
+static void checkEndpoints(const UrlCopyOpts &opts, Transfer &transfer, Gfal2 &gfal2,
+                           Gfal2TransferParams &params, const std::string &logFile)
+{
+    if (opts.strictCopy) {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Copy only transfer!" << commit;
+        transfer.fileSize = transfer.userFileSize;
+        return;
+    }
+
+    bool destExists = false;
+    boost::shared_ptr<UrlCopyError> sourceError, destError;
+
+    boost::thread destThread;
+    if (!opts.overwrite) {
+        destThread = startHelper([&]() {
+            transfer.stats.destinationStat.start = millisecondsSinceEpoch();
+            try {
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Checking existence of destination file" << commit;
+                gfal2.stat(params, transfer.destination, false);
+                destExists = true;
+            } catch (const Gfal2Exception &ex) {
+                if (ex.code() != ENOENT) {
+                    destError.reset(new UrlCopyError(DESTINATION, TRANSFER_PREPARATION, ex));
+                }
+            } catch (const std::exception &ex) {
+                destError.reset(new UrlCopyError(DESTINATION, TRANSFER_PREPARATION, EINVAL, ex.what()));
+            }
+            transfer.stats.destinationStat.end = millisecondsSinceEpoch();
+        }, logFile);
+    }
+
+    transfer.stats.sourceStat.start = millisecondsSinceEpoch();
+    try {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Getting source file size" << commit;
+        transfer.fileSize = gfal2.stat(params, transfer.source, true).st_size;
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "File size: " << transfer.fileSize << commit;
+    } catch (const Gfal2Exception &ex) {
+        sourceError.reset(new UrlCopyError(SOURCE, TRANSFER_PREPARATION, ex));
+    } catch (const std::exception &ex) {
+        sourceError.reset(new UrlCopyError(SOURCE, TRANSFER_PREPARATION, EINVAL, ex.what()));
+    }
+    transfer.stats.sourceStat.end = millisecondsSinceEpoch();
+
+    if (destThread.joinable()) {
+        destThread.join();
+    }
+
+    // Same precedence as if they were done one after the other
+    if (sourceError) {
+        throw *sourceError;
+    }
+    if (destError) {
+        throw *destError;
+    }
+
+    if (destExists) {
+        if (opts.dstFileReport) {
+            try {
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Checking integrity of destination tape file: "
+                                                << transfer.destination << commit;
+                auto destFile = createDestFileReport(transfer, gfal2, params);
+                transfer.fileMetadata = DestFile::appendDestFileToFileMetadata(transfer.fileMetadata, destFile.toJSON());
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Destination file report: " << destFile.toString() << commit;
+            } catch (const std::exception &ex) {
+                FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to check integrity of destination tape file: "
+                                               << transfer.destination << " (error=" << ex.what() << ")" << commit;
+            }
+        }
+
+        throw UrlCopyError(DESTINATION, TRANSFER_PREPARATION, EEXIST,
+                           "Destination file exists and overwrite is not enabled");
+    }
+}
+
+
+static void timeoutTask(boost::posix_time::time_duration &duration, boost::function<void()> onTimeout,
+    const std::string &logFile)
 {
+    if (!logFile.empty()) {
+        fts3::common::theLogger().redirectThread(logFile);
+    }
     try {
         boost::this_thread::sleep(duration);
         FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Timeout expired!" << commit;
-        urlCopyProcess->timeout();
+        onTimeout();
     } catch (const boost::thread_interrupted&) {
         FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Timeout thread stopped" << commit;
     } catch (const std::exception &ex) {
@@ -249,11 +382,16 @@ static void timeoutTask(boost::posix_time::time_duration &duration, UrlCopyProce
 }
 
 
-static void pingTask(Transfer *transfer, Reporter *reporter, unsigned pingInterval)
+static void pingTask(Transfer *transfer, Reporter *reporter, unsigned pingInterval, boost::mutex *reporterMutex,
+    const std::string &logFile)
 {
+    if (!logFile.empty()) {
+        fts3::common::theLogger().redirectThread(logFile);
+    }
     try {
         while (!boost::this_thread::interruption_requested()) {
             boost::this_thread::sleep(boost::posix_time::seconds(pingInterval));
+            boost::lock_guard<boost::mutex> lock(*reporterMutex);
             reporter->sendPing(*transfer);
         }
     } catch (const boost::thread_interrupted&) {
@@ -264,8 +402,15 @@ static void pingTask(Transfer *transfer, Reporter *reporter, unsigned pingInterv
 }
 
 
-void UrlCopyProcess::runTransfer(Transfer &transfer, Gfal2TransferParams &params)
+void UrlCopyProcess::runTransfer(Prepared &prepared, Slot &slot)
 {
+    Transfer &transfer = prepared.transfer;
+    Gfal2TransferParams &params = prepared.params;
+
+    // The context of the slot, not the one of the process
+    Gfal2 &gfal2 = slot.gfal2;
+    const std::string threadLogFile = (slot.threadLog && !opts.logToStderr) ? transfer.logFile : std::string();
+
     if (!opts.proxy.empty()) {
         FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Proxy: " << opts.proxy << commit;
     } else {
@@ -297,46 +442,20 @@ void UrlCopyProcess::runTransfer(Transfer &transfer, Gfal2TransferParams &params
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Third Party TURL protocol list: " << gfal2.get("SRM PLUGIN", "TURL_3RD_PARTY_PROTOCOLS")
                                     << ((!opts.thirdPartyTURL.empty()) ? " (database configuration)" : "") << commit;
 
-    if (opts.strictCopy) {
-        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Copy only transfer!" << commit;
-        transfer.fileSize = transfer.userFileSize;
+    if (prepared.ready) {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Source and destination checked while the previous transfer was running"
+                                        << commit;
+        if (prepared.error) {
+            throw *prepared.error;
+        }
     } else {
         try {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Getting source file size" << commit;
-            transfer.fileSize = gfal2.stat(params, transfer.source, true).st_size;
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "File size: " << transfer.fileSize << commit;
-        } catch (const Gfal2Exception &ex) {
-            throw UrlCopyError(SOURCE, TRANSFER_PREPARATION, ex);
-        } catch (const std::exception &ex) {
-            throw UrlCopyError(SOURCE, TRANSFER_PREPARATION, EINVAL, ex.what());
-        }
-
-        if (!opts.overwrite) {
-            try {
-                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Checking existence of destination file" << commit;
-                gfal2.stat(params, transfer.destination, false);
-
-                if (opts.dstFileReport) {
-                    try {
-                        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Checking integrity of destination tape file: "
-                                                        << transfer.destination << commit;
-                        auto destFile = createDestFileReport(transfer, gfal2, params);
-                        transfer.fileMetadata = DestFile::appendDestFileToFileMetadata(transfer.fileMetadata, destFile.toJSON());
-                        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Destination file report: " << destFile.toString() << commit;
-                    } catch (const std::exception &ex) {
-                        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Failed to check integrity of destination tape file: "
-                                                       << transfer.destination << " (error=" << ex.what() << ")" << commit;
-                    }
-                }
-
-                throw UrlCopyError(DESTINATION, TRANSFER_PREPARATION, EEXIST,
-                                   "Destination file exists and overwrite is not enabled");
-            } catch (const Gfal2Exception &ex) {
-                if (ex.code() != ENOENT) {
-                    throw UrlCopyError(DESTINATION, TRANSFER_PREPARATION, ex);
-                }
-            }
+            checkEndpoints(opts, transfer, gfal2, params, threadLogFile);
+        } catch (...) {
+            transfer.stats.preparation.end = millisecondsSinceEpoch();
+            throw;
         }
+        transfer.stats.preparation.end = millisecondsSinceEpoch();
     }
 
     // Timeout
@@ -355,28 +474,39 @@ void UrlCopyProcess::runTransfer(Transfer &transfer, Gfal2TransferParams &params
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "TCP streams: " << params.getNumberOfStreams() << commit;
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "TCP buffer size: " << opts.tcpBuffersize << commit;
 
-    reporter.sendProtocol(transfer, params);
+    {
+        boost::lock_guard<boost::mutex> lock(transfersMutex);
+        reporter.sendProtocol(transfer, params);
+    }
 
     // Install callbacks
     params.addEventCallback(eventCallback, &transfer);
     params.addMonitorCallback(performanceCallback, &transfer);
 
-    timeoutExpired = false;
+    slot.timeoutExpired = false;
     AutoInterruptThread timeoutThread(
-        boost::bind(&timeoutTask, boost::posix_time::seconds(timeout + 60), this)
+        boost::bind(&timeoutTask, boost::posix_time::seconds(timeout + 60),
+            boost::function<void()>(boost::bind(&Slot::timeout, &slot)), threadLogFile)
     );
     FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Timeout set to: " << timeout << commit;
 
     // Ping thread
-    AutoInterruptThread pingThread(boost::bind(&pingTask, &transfer, &reporter, opts.pingInterval));
+    AutoInterruptThread pingThread(boost::bind(&pingTask, &transfer, &reporter, opts.pingInterval,
+        &transfersMutex, threadLogFile));
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Setting ping interval to: " << opts.pingInterval << commit;
 
+    // The next transfer of the slot is prepared while this one runs, until it times out at the latest
+    if (slot.prefetchGfal2) {
+        slot.prefetchThread = boost::thread(boost::bind(&UrlCopyProcess::prefetch, this, boost::ref(slot),
+            timeout + 60));
+    }
+
     // Transfer
     FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Starting transfer" << commit;
     try {
         gfal2.copy(params, transfer.source, transfer.destination);
     } catch (const Gfal2Exception &ex) {
-        if (timeoutExpired) {
+        if (slot.timeoutExpired) {
             throw UrlCopyError(TRANSFER, TRANSFER, ETIMEDOUT, ex.what());
         } else {
             throw UrlCopyError(TRANSFER, TRANSFER, ex);
@@ -385,76 +515,302 @@ void UrlCopyProcess::runTransfer(Transfer &transfer, Gfal2TransferParams &params
         throw UrlCopyError(TRANSFER, TRANSFER, EINVAL, ex.what());
     }
 
-    // Release file for SRM source bring online
+    transfer.stats.finalization.start = millisecondsSinceEpoch();
+
+    // Release file for SRM source bring online, while the destination is checked
+    boost::thread releaseThread;
     if (transfer.source.protocol == "srm" && !transfer.tokenBringOnline.empty()) {
-        FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Releasing file for SRM source" << commit;
-        try {
-            gfal2.releaseFile(params, transfer.source, transfer.tokenBringOnline, true);
-        } catch (const Gfal2Exception &ex) {
-            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "RELEASE-PIN Failed to release file for SRM source: "
-                                               << transfer.source << commit;
-        }
+        releaseThread = startHelper([&]() {
+            FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Releasing file for SRM source" << commit;
+            try {
+                gfal2.releaseFile(params, transfer.source, transfer.tokenBringOnline, true);
+            } catch (const std::exception &ex) {
+                FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "RELEASE-PIN Failed to release file for SRM source: "
+                                                   << transfer.source << commit;
+            }
+        }, threadLogFile);
     }
 
     // Validate destination size
+    boost::shared_ptr<UrlCopyError> destError;
     if (!opts.strictCopy) {
-        uint64_t destSize;
         try {
-            destSize = gfal2.stat(params, transfer.destination, false).st_size;
+            uint64_t destSize = gfal2.stat(params, transfer.destination, false).st_size;
+            if (destSize != transfer.fileSize) {
+                destError.reset(new UrlCopyError(DESTINATION, TRANSFER_FINALIZATION, EINVAL,
+                                                 "Source and destination file size mismatch"));
+            } else {
+                FTS3_COMMON_LOGGER_NEWLOG(INFO) << "DESTINATION Source and destination file size matching" << commit;
+            }
         } catch (const Gfal2Exception &ex) {
-            throw UrlCopyError(DESTINATION, TRANSFER_FINALIZATION, ex);
+            destError.reset(new UrlCopyError(DESTINATION, TRANSFER_FINALIZATION, ex));
         } catch (const std::exception &ex) {
-            throw UrlCopyError(DESTINATION, TRANSFER_FINALIZATION, EINVAL, ex.what());
+            destError.reset(new UrlCopyError(DESTINATION, TRANSFER_FINALIZATION, EINVAL, ex.what()));
         }
+    }
 
-        if (destSize != transfer.fileSize) {
-            throw UrlCopyError(DESTINATION, TRANSFER_FINALIZATION, EINVAL,
-                               "Source and destination file size mismatch");
-        } else {
-            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "DESTINATION Source and destination file size matching" << commit;
-        }
+    if (releaseThread.joinable()) {
+        releaseThread.join();
+    }
+    transfer.stats.finalization.end = millisecondsSinceEpoch();
+
+    if (destError) {
+        throw *destError;
     }
 }
 
 
 void UrlCopyProcess::run(void)
 {
-    while (!todoTransfers.empty() && !canceled) {
-        Transfer transfer;
+    unsigned concurrency;
+    bool prefetch;
+    {
+        boost::lock_guard<boost::mutex> lock(transfersMutex);
+        nextTransfer = todoTransfers.begin();
+        concurrency = static_cast<unsigned>(std::min<size_t>(opts.concurrency, todoTransfers.size()));
+        if (concurrency < 1) {
+            concurrency = 1;
+        }
+        prefetch = todoTransfers.size() > concurrency;
+    }
+    // The debug output of the libraries goes to the process stderr, which can only follow one transfer
+    if (opts.debugLevel > 0) {
+        concurrency = 1;
+        prefetch = false;
+    }
+
+    if (concurrency > 1) {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Running up to " << concurrency << " transfers at the same time" << commit;
+    }
+
+    // Each slot has its own context, so a timeout only cancels the transfer that expired
+    std::vector<std::unique_ptr<Gfal2>> contexts;
+    std::list<Slot> slots;
+    for (unsigned i = 0; i < concurrency; ++i) {
+        if (i == 0) {
+            slots.emplace_back(gfal2, concurrency > 1);
+        }
+        else {
+            contexts.emplace_back(new Gfal2);
+            setupGlobalGfal2Config(opts, *contexts.back());
+            slots.emplace_back(*contexts.back(), true);
+        }
+        // Preparing a transfer sets credentials and client information in the context,
+        // which must not change under the copy running with it
+        if (prefetch) {
+            contexts.emplace_back(new Gfal2);
+            setupGlobalGfal2Config(opts, *contexts.back());
+            slots.back().prefetchGfal2 = contexts.back().get();
+        }
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(slotsMutex);
+        for (auto context = contexts.begin(); context != contexts.end(); ++context) {
+            slotContexts.push_back(context->get());
+        }
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(transfersMutex);
+        for (auto slot = slots.begin(); slot != slots.end(); ++slot) {
+            runningSlots.push_back(&*slot);
+        }
+    }
+
+    // All the contexts have loaded it by now
+    if (!opts.oauthFile.empty()) {
+        unlink(opts.oauthFile.c_str());
+    }
+
+    if (slots.size() == 1) {
+        runSlot(slots.front());
+    }
+    else {
+        boost::thread_group threads;
+        for (auto slot = slots.begin(); slot != slots.end(); ++slot) {
+            threads.create_thread(boost::bind(&UrlCopyProcess::runSlot, this, boost::ref(*slot)));
+        }
+        threads.join_all();
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(slotsMutex);
+        slotContexts.clear();
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(transfersMutex);
+        runningSlots.clear();
+    }
+
+    // On cancellation, todoTransfers will not be empty
+    // and a termination message must be sent for them
+    for (auto transfer = todoTransfers.begin(); transfer != todoTransfers.end(); ++transfer) {
+        Gfal2TransferParams params;
+        transfer->error.reset(new UrlCopyError(TRANSFER, TRANSFER_PREPARATION, ECANCELED, "Transfer canceled"));
+        reporter.sendTransferCompleted(*transfer, params);
+    }
+}
+
+
+std::unique_ptr<UrlCopyProcess::Prepared> UrlCopyProcess::takeTransfer(Slot &slot, bool forPrefetch)
+{
+    std::unique_ptr<Prepared> prepared;
+    {
+        boost::unique_lock<boost::mutex> lock(transfersMutex);
+        while (nextTransfer == todoTransfers.end() && !forPrefetch && !canceled && !panicked) {
+            // Nothing left in the list, but another slot may be holding one it has not started
+            bool preparing = false;
+            for (auto other = runningSlots.begin(); other != runningSlots.end(); ++other) {
+                if ((*other)->next) {
+                    FTS3_COMMON_LOGGER_NEWLOG(DEBUG) << "Taking the transfer "
+                        << (*other)->next->transfer.fileId << " prepared by another slot" << commit;
+                    return std::move((*other)->next);
+                }
+                preparing = preparing || (*other)->prefetching;
+            }
+            if (!preparing) {
+                return prepared;
+            }
+            prefetchDone.wait(lock);
+        }
+
+        if (canceled || panicked || nextTransfer == todoTransfers.end()) {
+            return prepared;
+        }
+        prepared.reset(new Prepared);
+        prepared->entry = nextTransfer++;
+        prepared->transfer = *prepared->entry;
+        slot.prefetching = forPrefetch;
+    }
+
+    // Prepare logging
+    Transfer &transfer = prepared->transfer;
+    transfer.stats.process.start = millisecondsSinceEpoch();
+    transfer.logFile = generateLogPath(opts.logDir, transfer);
+
+    if (opts.debugLevel) {
+        transfer.debugLogFile = transfer.logFile + ".debug";
+    } else {
+        transfer.debugLogFile = "/dev/null";
+    }
+    return prepared;
+}
+
+
+void UrlCopyProcess::prefetch(Slot &slot, unsigned delay)
+{
+    std::unique_ptr<Prepared> next;
+    try {
+        next = takeTransfer(slot, true);
+        if (!next) {
+            return;
+        }
+    } catch (const std::exception &ex) {
+        FTS3_COMMON_LOGGER_NEWLOG(ERR) << "Could not prepare the next transfer: " << ex.what() << commit;
         {
             boost::lock_guard<boost::mutex> lock(transfersMutex);
-            transfer = todoTransfers.front();
+            slot.prefetching = false;
         }
+        prefetchDone.notify_all();
+        return;
+    }
 
-        // Prepare logging
-        transfer.stats.process.start = millisecondsSinceEpoch();
-        transfer.logFile = generateLogPath(opts.logDir, transfer);
+    // Taken from the list, so it has to be run by the slot from now on, or by one with nothing left to do
+    Transfer &transfer = next->transfer;
+    const std::string logFile = opts.logToStderr ? std::string() : transfer.logFile;
+    if (!logFile.empty()) {
+        fts3::common::theLogger().redirectThread(logFile);
+    }
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Preparing the transfer while the previous one runs" << commit;
 
-        if (opts.debugLevel) {
-            transfer.debugLogFile = transfer.logFile + ".debug";
-        } else {
-            transfer.debugLogFile = "/dev/null";
+    transfer.stats.preparation.start = millisecondsSinceEpoch();
+    try {
+        setupTransferConfig(opts, transfer, *slot.prefetchGfal2, next->params, logFile, delay);
+    } catch (const UrlCopyError &ex) {
+        transfer.error.reset(new UrlCopyError(ex));
+    } catch (const std::exception &ex) {
+        next->error.reset(new UrlCopyError(AGENT, TRANSFER_SERVICE, EINVAL, ex.what()));
+    }
+
+    if (!next->error) {
+        try {
+            setupTransferContext(opts, transfer, *slot.prefetchGfal2);
+            checkEndpoints(opts, transfer, *slot.prefetchGfal2, next->params, logFile);
+        } catch (const UrlCopyError &ex) {
+            next->error.reset(new UrlCopyError(ex));
+        } catch (const std::exception &ex) {
+            next->error.reset(new UrlCopyError(AGENT, TRANSFER_SERVICE, EINVAL, ex.what()));
+        }
+    }
+    transfer.stats.preparation.end = millisecondsSinceEpoch();
+
+    next->ready = true;
+    {
+        boost::lock_guard<boost::mutex> lock(transfersMutex);
+        slot.next = std::move(next);
+        slot.prefetching = false;
+    }
+    prefetchDone.notify_all();
+}
+
+
+void UrlCopyProcess::runSlot(Slot &slot)
+{
+    while (!canceled) {
+        // Prepared while the previous copy was running, if any
+        if (slot.prefetchThread.joinable()) {
+            slot.prefetchThread.join();
         }
 
+        // Unless another slot took it meanwhile
+        std::unique_ptr<Prepared> prepared;
+        {
+            boost::lock_guard<boost::mutex> lock(transfersMutex);
+            // Left in the list, so it is reported with the others
+            if (canceled || panicked) {
+                break;
+            }
+            prepared = std::move(slot.next);
+        }
+        if (!prepared) {
+            prepared = takeTransfer(slot, false);
+            if (!prepared) {
+                break;
+            }
+        }
+        Transfer &transfer = prepared->transfer;
+        Gfal2TransferParams &params = prepared->params;
+
         if (!opts.logToStderr) {
-            fts3::common::theLogger().redirect(transfer.logFile, transfer.debugLogFile);
+            if (slot.threadLog) {
+                fts3::common::theLogger().redirectThread(transfer.logFile);
+            }
+            else {
+                fts3::common::theLogger().redirect(transfer.logFile, transfer.debugLogFile);
+            }
         }
 
         // Prepare Gfal2 transfer parameters
-        Gfal2TransferParams params;
         try {
-            setupTransferConfig(opts, transfer, gfal2, params);
+            if (!prepared->ready) {
+                transfer.stats.preparation.start = millisecondsSinceEpoch();
+                setupTransferConfig(opts, transfer, slot.gfal2, params,
+                    (slot.threadLog && !opts.logToStderr) ? transfer.logFile : std::string(), 0);
+            }
+            setupTransferContext(opts, transfer, slot.gfal2);
         } catch (const UrlCopyError &ex) {
             transfer.error.reset(new UrlCopyError(ex));
         }
 
         // Notify we got it
         FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Transfer accepted" << commit;
-        reporter.sendTransferStart(transfer, params);
+        {
+            boost::lock_guard<boost::mutex> lock(transfersMutex);
+            reporter.sendTransferStart(transfer, params);
+        }
 
         // Run the transfer
         try {
-            runTransfer(transfer, params);
+            runTransfer(*prepared, slot);
         } catch (const UrlCopyError &ex) {
             transfer.error.reset(new UrlCopyError(ex));
         } catch (const std::exception &ex) {
@@ -486,19 +842,15 @@ void UrlCopyProcess::run(void)
             doneTransfers.push_back(transfer);
 
             // todoTransfers may have been emptied by panic()
-            if (!todoTransfers.empty()) {
-                todoTransfers.pop_front();
+            if (!panicked) {
+                todoTransfers.erase(prepared->entry);
                 reporter.sendTransferCompleted(transfer, params);
             }
         }
     }
 
-    // On cancellation, todoTransfers will not be empty
-    // and a termination message must be sent for them
-    for (auto transfer = todoTransfers.begin(); transfer != todoTransfers.end(); ++transfer) {
-        Gfal2TransferParams params;
-        transfer->error.reset(new UrlCopyError(TRANSFER, TRANSFER_PREPARATION, ECANCELED, "Transfer canceled"));
-        reporter.sendTransferCompleted(*transfer, params);
+    if (slot.prefetchThread.joinable()) {
+        slot.prefetchThread.join();
     }
 }
 
@@ -532,10 +884,15 @@ void UrlCopyProcess::cancel(void)
 {
     canceled = true;
     gfal2.cancel();
+
+    boost::lock_guard<boost::mutex> lock(slotsMutex);
+    for (auto context = slotContexts.begin(); context != slotContexts.end(); ++context) {
+        (*context)->cancel();
+    }
 }
 
 
-void UrlCopyProcess::timeout(void)
+void UrlCopyProcess::Slot::timeout(void)
 {
     timeoutExpired = true;
     gfal2.cancel();
@@ -551,4 +908,6 @@ void UrlCopyProcess::panic(const std::string &msg)
         reporter.sendTransferCompleted(*transfer, params);
     }
     todoTransfers.clear();
+    nextTransfer = todoTransfers.end();
+    panicked = true;
 }
@@ -17,6 +17,9 @@
 #ifndef URLCOPYPROCESS_H
 #define URLCOPYPROCESS_H
 
+#include <atomic>
+#include <memory>
+#include <vector>
 #include <boost/thread.hpp>
 #include <gfal_api.h>
 
@@ -34,20 +37,84 @@ void performanceCallback(gfalt_transfer_status_t h, const char*, const char*, gp
 /// Main class of fts_url_copy. Implements the transfer logic.
 class UrlCopyProcess {
 private:
+    /// A transfer taken from the list, with what was done before its copy
+    struct Prepared {
+        Transfer::TransferList::iterator entry;
+        Transfer transfer;
+        Gfal2TransferParams params;
+        /// Tokens retrieved, source and destination checked
+        bool ready;
+        /// Error of the checks, raised when the transfer runs
+        boost::shared_ptr<UrlCopyError> error;
+
+        Prepared(): ready(false) {}
+    };
+
+    /// Runs transfers of the list one after the other, with its own gfal2 context
+    struct Slot {
+        Gfal2 &gfal2;
+        std::atomic<bool> timeoutExpired;
+        /// Log into the file of the transfer from this thread only, since other slots run at the same time
+        bool threadLog;
+
+        /// Context preparing the next transfer while the copy runs, if enabled
+        Gfal2 *prefetchGfal2;
+        boost::thread prefetchThread;
+        /// Set by the prefetch thread. Protected by transfersMutex, since a slot with nothing
+        /// left to do takes it if this one has not started it yet.
+        std::unique_ptr<Prepared> next;
+        /// The prefetch thread took a transfer, and is preparing it
+        bool prefetching;
+
+        Slot(Gfal2 &gfal2, bool threadLog): gfal2(gfal2), timeoutExpired(false), threadLog(threadLog),
+            prefetchGfal2(NULL), prefetching(false) {}
+
+        /// Trigger a cancel, mark running transfer as expired.
+        void timeout(void);
+    };
+
+    /// Protects the lists, and serializes the messages sent by the reporter
     boost::mutex transfersMutex;
+    /// Notified when a prefetch thread is done with its transfer
+    boost::condition_variable prefetchDone;
+    /// Slots running, so they can take the transfers prefetched by the others
+    std::vector<Slot*> runningSlots;
 
     UrlCopyOpts opts;
     Transfer::TransferList todoTransfers;
     Transfer::TransferList doneTransfers;
+    /// First transfer of todoTransfers not started yet
+    Transfer::TransferList::iterator nextTransfer;
 
     Reporter &reporter;
 
-    Gfal2 gfal2;
-    bool canceled;
-    bool timeoutExpired;
+    /// Only set if the context is not given by the caller
+    std::unique_ptr<Gfal2> ownGfal2;
+    Gfal2 &gfal2;
+    std::atomic<bool> canceled;
+    bool panicked;
+
+    /// Contexts of the other slots, and the prefetch ones, while running
+    boost::mutex slotsMutex;
+    std::vector<Gfal2*> slotContexts;
+
+    /// Run transfers until there are none left, or the process is canceled
+    void runSlot(Slot &slot);
+
+    /// Take the next transfer of the list, and set up its log files
+    /// When the list is empty, a transfer prefetched by another slot, and not started yet, is taken instead
+    /// @param slot         Slot that runs the transfer
+    /// @param forPrefetch  Taken by the prefetch thread of the slot, which never takes one from another slot
+    /// @return NULL if there is none left
+    std::unique_ptr<Prepared> takeTransfer(Slot &slot, bool forPrefetch);
+
+    /// Take the next transfer of the list, and prepare it with the prefetch context of the slot
+    /// @param delay Seconds until the copy running in the slot is done at the latest, which the
+    ///              retrieved tokens must outlive
+    void prefetch(Slot &slot, unsigned delay);
 
     /// Run a single transfer
-    void runTransfer(Transfer &transfer, Gfal2TransferParams &params);
+    void runTransfer(Prepared &prepared, Slot &slot);
 
     /// Archive the transfer logs
     void archiveLogs(Transfer &transfer);
@@ -55,21 +122,21 @@ private:
 public:
 
     /// Constructor. Initialize all internals from the command line options.
-    UrlCopyProcess(const UrlCopyOpts &opts, Reporter &reporter);
+    /// @param context  gfal2 context to use, so it can be kept from one process to the next.
+    ///                 If NULL, a new one is created.
+    UrlCopyProcess(const UrlCopyOpts &opts, Reporter &reporter, Gfal2 *context = NULL);
 
     /// Run the UrlCopy process
+    /// Up to opts.concurrency transfers of the list run at the same time, each with its own gfal2 context
     void run(void);
 
-    /// Cancel gracefully the process: cancel the running transfer, and send cancellation
+    /// Cancel gracefully the process: cancel the running transfers, and send cancellation
     /// messages for the remaining ones.
     void cancel(void);
 
     /// Send a termination messages for running and pending transfers. This is to be called
     /// just before a panic quit (i.e. from a SIGSEGV)
     void panic(const std::string &msg);
-
-    /// Trigger a cancel, mark running transfer as expired.
-    void timeout(void);
 };
 
 
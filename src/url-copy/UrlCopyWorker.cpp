@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UrlCopyWorker.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "common/Exceptions.h"
+#include "common/Logger.h"
+
+#include "LegacyReporter.h"
+#include "LogHelper.h"
+
+using fts3::common::commit;
+using fts3::common::SystemError;
+
+
+/// Same limit as the server
+static const size_t MAX_ASSIGNMENT_SIZE = 128 * 1024;
+
+/// gfal2 contexts kept around
+static const size_t MAX_CONTEXTS = 16;
+
+
+/// Each argument of a message ends with '\0'
+static void splitMessage(const char *p, const char *end, std::vector<std::string> *args)
+{
+    args->clear();
+    while (p < end) {
+        const char *nul = static_cast<const char*>(memchr(p, '\0', end - p));
+        if (!nul) {
+            nul = end;
+        }
+        args->emplace_back(p, nul);
+        p = nul + 1;
+    }
+}
+
+
+/// CANCEL, followed by the file id
+static bool isCancel(const std::vector<std::string> &args)
+{
+    return !args.empty() && args[0] == "CANCEL";
+}
+
+
+UrlCopyWorker::UrlCopyWorker(const UrlCopyOpts &opts): opts(opts), sock(-1), stopping(false), current(NULL)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (opts.workerSocket.size() >= sizeof(addr.sun_path)) {
+        throw SystemError("Worker socket path too long: " + opts.workerSocket);
+    }
+    strncpy(addr.sun_path, opts.workerSocket.c_str(), sizeof(addr.sun_path) - 1);
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        throw SystemError(std::string("Could not create the worker socket: ") + strerror(errno));
+    }
+    if (connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        int err = errno;
+        close(sock);
+        throw SystemError("Could not connect to " + opts.workerSocket + ": " + strerror(err));
+    }
+    if (pipe2(wakeup, O_CLOEXEC | O_NONBLOCK) < 0) {
+        int err = errno;
+        close(sock);
+        throw SystemError(std::string("Could not create the worker pipe: ") + strerror(err));
+    }
+}
+
+
+UrlCopyWorker::~UrlCopyWorker()
+{
+    if (sock >= 0) {
+        close(sock);
+    }
+    close(wakeup[0]);
+    close(wakeup[1]);
+}
+
+
+void UrlCopyWorker::run(void)
+{
+    send(std::string("HELLO") + '\0' + opts.workerKey);
+
+    unsigned done = 0;
+    std::vector<std::string> args;
+    while (!stopping && receive(&args)) {
+        // For a transfer already done
+        if (isCancel(args)) {
+            continue;
+        }
+        runAssignment(args);
+        ++done;
+
+        if (stopping || (opts.workerMaxTransfers && done >= opts.workerMaxTransfers)) {
+            send("BYE");
+            break;
+        }
+        send("READY");
+    }
+
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Worker exiting after " << done << " transfers" << commit;
+}
+
+
+void UrlCopyWorker::runAssignment(const std::vector<std::string> &args)
+{
+    // Parsed as if it was the command line
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>("fts_url_copy"));
+    for (auto arg = args.begin(); arg != args.end(); ++arg) {
+        argv.push_back(const_cast<char*>(arg->c_str()));
+    }
+    argv.push_back(NULL);
+
+    UrlCopyOpts assignment;
+    assignment.parse(static_cast<int>(argv.size() - 1), argv.data());
+    setupLogging(assignment.debugLevel);
+
+    // OAuth configuration is loaded into the context, so those never share one
+    std::unique_ptr<Gfal2> ownContext;
+    Gfal2 *context = NULL;
+    if (assignment.oauthFile.empty()) {
+        context = &getContext(assignment);
+        // The tokens of the previous transfer must not be used for this one
+        context->clearCredentials();
+    }
+    else {
+        ownContext.reset(new Gfal2);
+        context = ownContext.get();
+    }
+
+    LegacyReporter reporter(assignment);
+    UrlCopyProcess process(assignment, reporter, context);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        current = &process;
+        // Canceled while waiting for it
+        if (stopping) {
+            process.cancel();
+        }
+    }
+
+    std::set<uint64_t> fileIds;
+    for (auto t = assignment.transfers.begin(); t != assignment.transfers.end(); ++t) {
+        fileIds.insert(t->fileId);
+    }
+    boost::thread listener(&UrlCopyWorker::listen, this, fileIds);
+
+    try {
+        process.run();
+    }
+    catch (const std::exception &e) {
+        process.panic(e.what());
+    }
+
+    char byte = 0;
+    while (write(wakeup[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+    listener.join();
+    while (read(wakeup[0], &byte, 1) > 0) {
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        current = NULL;
+    }
+
+    // Whatever is logged until the next assignment does not belong to this transfer
+    if (!assignment.logToStderr) {
+        fts3::common::theLogger().redirect("/dev/null", "/dev/null");
+    }
+}
+
+
+Gfal2 &UrlCopyWorker::getContext(const UrlCopyOpts &assignment)
+{
+    // Settings applied to the whole context, see setupGlobalGfal2Config
+    std::ostringstream key;
+    if (!assignment.transfers.empty()) {
+        key << assignment.transfers.front().source.host << ' '
+            << assignment.transfers.front().destination.host << ' ';
+    }
+    key << assignment.proxy << ' ' << assignment.enableUdt << ' '
+        << (indeterminate(assignment.enableIpv6) ? "-" : (assignment.enableIpv6 ? "1" : "0")) << ' '
+        << assignment.infosys << ' ' << assignment.thirdPartyTURL;
+
+    for (auto i = contexts.begin(); i != contexts.end(); ++i) {
+        if (i->first == key.str()) {
+            contexts.splice(contexts.begin(), contexts, i);
+            return *contexts.front().second;
+        }
+    }
+
+    contexts.emplace_front(key.str(), std::unique_ptr<Gfal2>(new Gfal2));
+    if (contexts.size() > MAX_CONTEXTS) {
+        contexts.pop_back();
+    }
+    return *contexts.front().second;
+}
+
+
+void UrlCopyWorker::listen(const std::set<uint64_t> &fileIds)
+{
+    std::vector<char> buffer(MAX_ASSIGNMENT_SIZE);
+    std::vector<std::string> args;
+
+    struct pollfd fds[2];
+    fds[0].fd = sock;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeup[0];
+    fds[1].events = POLLIN;
+
+    while (true) {
+        fds[0].revents = fds[1].revents = 0;
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        ssize_t size = recv(sock, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (size < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        // The server is gone, the next receive will tell
+        if (size <= 0) {
+            return;
+        }
+
+        splitMessage(buffer.data(), buffer.data() + size, &args);
+        if (!isCancel(args) || args.size() < 2) {
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Unexpected message from the server during a transfer" << commit;
+            continue;
+        }
+
+        uint64_t fileId = strtoull(args[1].c_str(), NULL, 10);
+        if (fileIds.count(fileId)) {
+            FTS3_COMMON_LOGGER_NEWLOG(INFO) << "Transfer " << fileId << " canceled by the server" << commit;
+            boost::mutex::scoped_lock lock(mutex);
+            if (current) {
+                current->cancel();
+            }
+        }
+    }
+}
+
+
+bool UrlCopyWorker::receive(std::vector<std::string> *args)
+{
+    std::vector<char> buffer(MAX_ASSIGNMENT_SIZE);
+    ssize_t size;
+    do {
+        size = recv(sock, buffer.data(), buffer.size(), 0);
+    } while (size < 0 && errno == EINTR);
+
+    if (size <= 0) {
+        return false;
+    }
+
+    splitMessage(buffer.data(), buffer.data() + size, args);
+    return true;
+}
+
+
+void UrlCopyWorker::send(const std::string &message)
+{
+    while (::send(sock, message.data(), message.size(), MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR) {
+            // The server is gone, the next receive will tell
+            FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Could not write to the server: " << strerror(errno) << commit;
+            break;
+        }
+    }
+}
+
+
+void UrlCopyWorker::cancel(void)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    stopping = true;
+    if (current) {
+        current->cancel();
+    }
+    else {
+        // Wake up the receive
+        shutdown(sock, SHUT_RD);
+    }
+}
+
+
+void UrlCopyWorker::panic(const std::string &msg)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    if (current) {
+        current->panic(msg);
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef URLCOPYWORKER_H
+#define URLCOPYWORKER_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "Gfal2.h"
+#include "Transfer.h"
+#include "UrlCopyOpts.h"
+#include "UrlCopyProcess.h"
+
+
+/// fts_url_copy running as a long-lived worker of the server (--worker)
+///
+/// It connects to the server socket, and runs the transfers it is assigned one at a time.
+/// Each assignment carries the same arguments the server would have passed in the command line,
+/// and is reported through the usual Reporter. While it runs, the server may send a cancel
+/// for it over the same socket.
+/// The gfal2 contexts, and so their connections, are kept from one transfer to the next,
+/// one per pair of endpoints and protocol settings. The credentials set for a transfer,
+/// like bearer tokens, are cleared before the next one.
+class UrlCopyWorker {
+public:
+    /// Constructor
+    /// @param opts Worker options: socket, credential key and maximum number of transfers
+    UrlCopyWorker(const UrlCopyOpts &opts);
+
+    /// Closes the connection
+    ~UrlCopyWorker();
+
+    /// Run the transfers assigned until the server closes the connection, the maximum number
+    /// of transfers is reached, or the worker is canceled
+    void run(void);
+
+    /// Cancel the running transfer, and stop
+    void cancel(void);
+
+    /// Send a termination message for the running transfer, if any. See UrlCopyProcess::panic.
+    void panic(const std::string &msg);
+
+private:
+    UrlCopyOpts opts;
+    int sock;
+    /// Written to stop listening for cancels
+    int wakeup[2];
+    std::atomic<bool> stopping;
+
+    boost::mutex mutex;
+    UrlCopyProcess *current;
+
+    /// Most recently used first
+    std::list<std::pair<std::string, std::unique_ptr<Gfal2>>> contexts;
+
+    /// Context for the transfers of the assignment
+    Gfal2 &getContext(const UrlCopyOpts &assignment);
+
+    /// Run an assignment
+    void runAssignment(const std::vector<std::string> &args);
+
+    /// Cancel the running transfer when the server asks to, until woken up
+    /// @param fileIds File ids of the running assignment
+    void listen(const std::set<uint64_t> &fileIds);
+
+    /// Wait for the next assignment
+    /// @return false if the connection was closed
+    bool receive(std::vector<std::string> *args);
+
+    void send(const std::string &message);
+};
+
+#endif // URLCOPYWORKER_H
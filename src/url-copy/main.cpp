@@ -21,6 +21,7 @@
 #include "UrlCopyOpts.h"
 #include "UrlCopyProcess.h"
 #include "LegacyReporter.h"
+#include "UrlCopyWorker.h"
 
 #include <cstdlib>
 
@@ -59,6 +60,50 @@ static void signalCallback(int signum, void *udata)
     }
 }
 
+/// Signal handler when running as a worker
+static void workerSignalCallback(int signum, void *udata)
+{
+    UrlCopyWorker *worker = (UrlCopyWorker*)(udata);
+    std::string stackTrace;
+
+    FTS3_COMMON_LOGGER_NEWLOG(WARNING) << "Received signal " << signum << commit;
+    switch (signum) {
+        case SIGABRT: case SIGSEGV: case SIGILL: case SIGFPE: case SIGBUS:
+        case SIGTRAP: case SIGSYS:
+            stackTrace = panic::stack_dump(panic::stack_backtrace, panic::stack_backtrace_size);
+            FTS3_COMMON_LOGGER_NEWLOG(CRIT) << "Stacktrace: " << stackTrace << commit;
+            if (worker) {
+                worker->panic("Transfer process died with: " + stackTrace);
+            }
+            break;
+        // The running transfer is canceled, and the worker exits after it
+        case SIGINT: case SIGTERM:
+            if (worker) {
+                worker->cancel();
+            }
+            break;
+    }
+}
+
+
+/// Run the transfers sent by the server, see UrlCopyWorker
+static int runWorker(const UrlCopyOpts &opts)
+{
+    try {
+        UrlCopyWorker worker(opts);
+        panic::setup_signal_handlers(workerSignalCallback, &worker);
+        worker.run();
+        panic::setup_signal_handlers(workerSignalCallback, NULL);
+    }
+    catch (const std::exception &e) {
+        panic::setup_signal_handlers(workerSignalCallback, NULL);
+        FTS3_COMMON_LOGGER_NEWLOG(CRIT) << "Worker failed: " << e.what() << commit;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
+
+
 /// Remove some environment variables that may interfere
 /// set   XrdSecGSIDELEGPROXY=1  as a workaround for FTS-1354
 void clearEnvironment()
@@ -86,6 +131,10 @@ int main(int argc, char *argv[])
     opts.parse(argc, argv);
     setupLogging(opts.debugLevel);
 
+    if (!opts.workerSocket.empty()) {
+        return runWorker(opts);
+    }
+
     // Construct Url Copy Process
     LegacyReporter reporter(opts);
     UrlCopyProcess urlCopyProcess(opts, reporter);
@@ -66,5 +66,24 @@ BOOST_AUTO_TEST_CASE (blocking)
 }
 
 
+BOOST_AUTO_TEST_CASE (batch)
+{
+    ConcurrentQueue *queue = ConcurrentQueue::getInstance();
+    queue->push("abcde");
+    queue->push("cdefg");
+    queue->push("efghi");
+
+    std::vector<std::string> batch;
+    BOOST_CHECK_EQUAL(queue->popBatch(batch, 2, 0), 2);
+    BOOST_CHECK_EQUAL(batch.size(), 2);
+    BOOST_CHECK_EQUAL(batch[0], "abcde");
+    BOOST_CHECK_EQUAL(batch[1], "cdefg");
+
+    BOOST_CHECK_EQUAL(queue->popBatch(batch, 2, 0), 1);
+    BOOST_CHECK_EQUAL(batch.back(), "efghi");
+    BOOST_CHECK_EQUAL(queue->empty(), true);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
 BOOST_AUTO_TEST_SUITE_END()
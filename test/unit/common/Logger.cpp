@@ -17,7 +17,10 @@
 #include <boost/test/unit_test_suite.hpp>
 #include <boost/test/test_tools.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <chrono>
 #include <fstream>
+#include <map>
 
 #include "common/Logger.h"
 
@@ -123,5 +126,188 @@ BOOST_AUTO_TEST_CASE(redirect)
 }
 
 
+static std::vector<std::string> readLines(const std::string &path)
+{
+    std::vector<std::string> lines;
+    std::ifstream read(path);
+    std::string line;
+    while (std::getline(read, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+
+static void logLines(int thread, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        FTS3_COMMON_LOGGER_NEWLOG(INFO) << "THREAD " << thread << " LINE " << i << fts3::common::commit;
+    }
+}
+
+
+static void logLinesInto(const std::string &path, int thread, int count)
+{
+    fts3::common::theLogger().redirectThread(path);
+    logLines(thread, count);
+}
+
+
+BOOST_AUTO_TEST_CASE(redirectThread)
+{
+    const std::string sharedPath("/tmp/fts3tests-shared.log");
+    const std::string path1("/tmp/fts3tests-thread1.log");
+    const std::string path2("/tmp/fts3tests-thread2.log");
+    boost::filesystem::remove(sharedPath);
+    boost::filesystem::remove(path1);
+    boost::filesystem::remove(path2);
+
+    int oldOut = dup(STDOUT_FILENO);
+    int oldErr = dup(STDERR_FILENO);
+
+    fts3::common::Logger &logger = fts3::common::theLogger();
+    logger.setLogLevel(fts3::common::Logger::INFO);
+    BOOST_CHECK_EQUAL(logger.redirect(sharedPath, sharedPath), 0);
+
+    // Two threads into their own file, and a third one into the same as the first
+    boost::thread t1(logLinesInto, path1, 1, 100);
+    boost::thread t2(logLinesInto, path2, 2, 100);
+    boost::thread t3(logLinesInto, path1, 3, 100);
+    t1.join();
+    t2.join();
+    t3.join();
+
+    // This thread was not redirected
+    FTS3_COMMON_LOGGER_NEWLOG(INFO) << "SHARED" << fts3::common::commit;
+
+    std::vector<std::string> lines1 = readLines(path1);
+    std::vector<std::string> lines2 = readLines(path2);
+    std::vector<std::string> shared = readLines(sharedPath);
+
+    BOOST_CHECK_EQUAL(lines1.size(), 200);
+    BOOST_CHECK_EQUAL(lines2.size(), 100);
+    for (auto i = lines1.begin(); i != lines1.end(); ++i) {
+        BOOST_CHECK(i->find("THREAD 1 LINE") != std::string::npos || i->find("THREAD 3 LINE") != std::string::npos);
+    }
+    for (auto i = lines2.begin(); i != lines2.end(); ++i) {
+        BOOST_CHECK(i->find("THREAD 2 LINE") != std::string::npos);
+    }
+    BOOST_CHECK_EQUAL(shared.size(), 1);
+
+    close(STDOUT_FILENO);
+    close(STDERR_FILENO);
+    dup2(oldOut, STDOUT_FILENO);
+    dup2(oldErr, STDERR_FILENO);
+    close(oldOut);
+    close(oldErr);
+
+    boost::filesystem::remove(sharedPath);
+    boost::filesystem::remove(path1);
+    boost::filesystem::remove(path2);
+}
+
+
+BOOST_AUTO_TEST_CASE(async)
+{
+    const std::string logPath("/tmp/fts3tests-async.log");
+    boost::filesystem::remove(logPath);
+
+    fts3::common::Logger &logger = fts3::common::theLogger();
+    BOOST_REQUIRE_EQUAL(logger.redirect(logPath, ""), 0);
+    logger.setLogLevel(fts3::common::Logger::INFO);
+
+    // Small queues, so the threads have to wait for the writer
+    logger.setAsync(true, 16, false);
+
+    const int N_THREADS = 8, N_LINES = 2000;
+    boost::thread_group threads;
+    for (int i = 0; i < N_THREADS; ++i) {
+        threads.create_thread(boost::bind(logLines, i, N_LINES));
+    }
+    threads.join_all();
+    logger.setAsync(false);
+
+    // Nothing lost, and in order within a thread
+    std::map<int, int> next;
+    for (auto line: readLines(logPath)) {
+        int thread, number;
+        const char *p = strstr(line.c_str(), "THREAD ");
+        if (p && sscanf(p, "THREAD %d LINE %d", &thread, &number) == 2) {
+            BOOST_CHECK_EQUAL(next[thread], number);
+            next[thread] = number + 1;
+        }
+    }
+    BOOST_CHECK_EQUAL(next.size(), N_THREADS);
+    for (auto i = next.begin(); i != next.end(); ++i) {
+        BOOST_CHECK_EQUAL(i->second, N_LINES);
+    }
+
+    boost::filesystem::remove(logPath);
+}
+
+
+BOOST_AUTO_TEST_CASE(asyncDrop)
+{
+    const std::string logPath("/tmp/fts3tests-async.log");
+    boost::filesystem::remove(logPath);
+
+    fts3::common::Logger &logger = fts3::common::theLogger();
+    BOOST_REQUIRE_EQUAL(logger.redirect(logPath, ""), 0);
+    logger.setLogLevel(fts3::common::Logger::INFO);
+    logger.setAsync(true, 4, true);
+    logLines(0, 10000);
+    logger.setAsync(false);
+
+    // Whatever is lost is accounted for
+    int written = 0, dropped = 0;
+    for (auto line: readLines(logPath)) {
+        int count;
+        const char *p = strstr(line.c_str(), "; ");
+        if (strstr(line.c_str(), "THREAD 0 LINE ")) {
+            ++written;
+        }
+        else if (p && sscanf(p, "; %d log lines were dropped", &count) == 1) {
+            dropped += count;
+        }
+    }
+    BOOST_CHECK_EQUAL(written + dropped, 10000);
+
+    boost::filesystem::remove(logPath);
+}
+
+
+/// Lines per second written by several threads at once, synchronously and asynchronously.
+/// Only reported, since it depends on the machine
+BOOST_AUTO_TEST_CASE(throughput)
+{
+    const std::string logPath("/tmp/fts3tests-throughput.log");
+    const int N_THREADS = 8, N_LINES = 20000;
+
+    fts3::common::Logger &logger = fts3::common::theLogger();
+    logger.setLogLevel(fts3::common::Logger::INFO);
+
+    for (int async = 0; async < 2; ++async) {
+        boost::filesystem::remove(logPath);
+        BOOST_REQUIRE_EQUAL(logger.redirect(logPath, ""), 0);
+        logger.setAsync(async, 4096, false);
+
+        auto start = std::chrono::steady_clock::now();
+        boost::thread_group threads;
+        for (int i = 0; i < N_THREADS; ++i) {
+            threads.create_thread(boost::bind(logLines, i, N_LINES));
+        }
+        threads.join_all();
+        logger.setAsync(false);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        BOOST_CHECK_GE(readLines(logPath).size(), N_THREADS * N_LINES);
+        BOOST_TEST_MESSAGE((async ? "Asynchronous: " : "Synchronous: ")
+            << static_cast<uint64_t>(N_THREADS * N_LINES / elapsed.count()) << " lines/second");
+    }
+
+    boost::filesystem::remove(logPath);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
 BOOST_AUTO_TEST_SUITE_END()
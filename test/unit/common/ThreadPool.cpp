@@ -22,10 +22,14 @@
 #include <boost/test/test_tools.hpp>
 
 #include <boost/any.hpp>
+#include <atomic>
+#include <chrono>
 
 #include "common/ThreadPool.h"
 
+using fts3::common::CompletionCounter;
 using fts3::common::ThreadPool;
+using fts3::common::ThreadPoolMetrics;
 
 
 BOOST_AUTO_TEST_SUITE(common)
@@ -133,6 +137,21 @@ BOOST_AUTO_TEST_CASE (ThreadPoolInterrupt)
 }
 
 
+BOOST_AUTO_TEST_CASE (ThreadPoolDiscard)
+{
+    CompletionCounter batch;
+    {
+        ThreadPool<InfiniteTask> tp(1);
+        for (int i = 0; i < 4; ++i) {
+            tp.start(new InfiniteTask(), &batch);
+        }
+    }
+    // The tasks never run count as done, so nobody waits for them forever
+    BOOST_CHECK_EQUAL(batch.size(), 0);
+    batch.wait();
+}
+
+
 struct InitTask
 {
     InitTask(std::string & str) : str(str) {}
@@ -242,5 +261,178 @@ BOOST_AUTO_TEST_CASE (ThreadPoolReduce)
 }
 
 
+struct CountTask
+{
+    CountTask(std::atomic<int> & count) : count(count) {}
+
+    virtual ~CountTask() {}
+
+    virtual void run(boost::any const &)
+    {
+        ++count;
+    }
+
+    std::atomic<int> & count;
+};
+
+
+struct OtherCountTask: public CountTask
+{
+    OtherCountTask(std::atomic<int> & count) : CountTask(count) {}
+};
+
+
+BOOST_AUTO_TEST_CASE (ThreadPoolWait)
+{
+    std::atomic<int> count(0);
+    ThreadPool<CountTask> tp(4);
+
+    // The pool is reused after waiting
+    for (int round = 1; round <= 3; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            tp.start(new CountTask(count));
+        }
+        tp.wait();
+        BOOST_CHECK_EQUAL(count, round * 1000);
+        BOOST_CHECK_EQUAL(tp.pending(), 0);
+    }
+    tp.join();
+}
+
+
+BOOST_AUTO_TEST_CASE (ThreadPoolBatch)
+{
+    bool slowDone = false;
+    std::atomic<int> count(0);
+
+    ThreadPool<SleepyTask> slow(1);
+    slow.start(new SleepyTask(slowDone));
+
+    ThreadPool<CountTask> tp(2);
+    CompletionCounter batch;
+    for (int i = 0; i < 100; ++i) {
+        tp.start(new CountTask(count), &batch);
+    }
+    batch.wait();
+    BOOST_CHECK_EQUAL(batch.size(), 0);
+    BOOST_CHECK_EQUAL(count, 100);
+
+    slow.join();
+    BOOST_CHECK(slowDone);
+    tp.join();
+}
+
+
+struct SpawnTask
+{
+    SpawnTask(ThreadPool<SpawnTask> & pool, std::atomic<int> & count, int depth) :
+        pool(pool), count(count), depth(depth) {}
+
+    void run(boost::any const &)
+    {
+        ++count;
+        if (depth > 0) {
+            pool.start(new SpawnTask(pool, count, depth - 1));
+            pool.start(new SpawnTask(pool, count, depth - 1));
+        }
+    }
+
+    ThreadPool<SpawnTask> & pool;
+    std::atomic<int> & count;
+    int depth;
+};
+
+
+BOOST_AUTO_TEST_CASE (ThreadPoolNested)
+{
+    std::atomic<int> count(0);
+    ThreadPool<SpawnTask> tp(4);
+    tp.start(new SpawnTask(tp, count, 10));
+    tp.wait();
+    BOOST_CHECK_EQUAL(count, (1 << 11) - 1);
+    tp.join();
+}
+
+
+BOOST_AUTO_TEST_CASE (ThreadPoolMetricsPerType)
+{
+    std::atomic<int> count(0);
+    ThreadPool<CountTask> tp(2);
+    for (int i = 0; i < 10; ++i) {
+        tp.start(new CountTask(count));
+    }
+    for (int i = 0; i < 5; ++i) {
+        tp.start(new OtherCountTask(count));
+    }
+    tp.wait();
+
+    // Keyed by the full name of the task type
+    std::map<std::string, ThreadPoolMetrics> metrics = tp.getMetrics();
+    BOOST_CHECK_EQUAL(metrics.size(), 2);
+    BOOST_CHECK_EQUAL(metrics["common::ThreadPoolTest::CountTask"].executed, 10);
+    BOOST_CHECK_EQUAL(metrics["common::ThreadPoolTest::OtherCountTask"].executed, 5);
+    tp.join();
+}
+
+
+struct BusyTask
+{
+    BusyTask(std::atomic<int> & count) : count(count) {}
+
+    void run(boost::any const &)
+    {
+        volatile double x = 1;
+        for (int i = 0; i < 2000; ++i) {
+            x = x * 1.000001 + 1;
+        }
+        ++count;
+    }
+
+    std::atomic<int> & count;
+};
+
+
+/// Tasks per second with an increasing number of workers, started from outside
+/// and from within the pool. Only reported, since it depends on the machine
+BOOST_AUTO_TEST_CASE (ThreadPoolScaling)
+{
+    const int N = 50000;
+
+    for (int workers = 1; workers <= 8; workers *= 2) {
+        std::atomic<int> count(0);
+        ThreadPool<BusyTask> tp(workers);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; ++i) {
+            tp.start(new BusyTask(count));
+        }
+        tp.wait();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        BOOST_CHECK_EQUAL(count, N);
+        BOOST_TEST_MESSAGE(workers << " workers: "
+            << static_cast<uint64_t>(N / elapsed.count()) << " tasks/second, "
+            << tp.getMetrics()["common::ThreadPoolTest::BusyTask"].stolen << " stolen");
+        tp.join();
+    }
+
+    for (int workers = 1; workers <= 8; workers *= 2) {
+        std::atomic<int> count(0);
+        ThreadPool<SpawnTask> tp(workers);
+
+        auto start = std::chrono::steady_clock::now();
+        tp.start(new SpawnTask(tp, count, 16));
+        tp.wait();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        BOOST_CHECK_EQUAL(count, (1 << 17) - 1);
+        BOOST_TEST_MESSAGE(workers << " workers, nested: "
+            << static_cast<uint64_t>(count / elapsed.count()) << " tasks/second, "
+            << tp.getMetrics()["common::ThreadPoolTest::SpawnTask"].stolen << " stolen");
+        tp.join();
+    }
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
 BOOST_AUTO_TEST_SUITE_END()
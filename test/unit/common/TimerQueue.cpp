@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include <chrono>
+#include <memory>
+
+#include "common/TimerQueue.h"
+
+using fts3::common::TimerQueue;
+
+BOOST_AUTO_TEST_SUITE(common)
+BOOST_AUTO_TEST_SUITE(TimerQueueTest)
+
+
+struct Item
+{
+    Item(int id, int *deleted = NULL): id(id), deleted(deleted) {}
+    ~Item()
+    {
+        if (deleted) {
+            ++(*deleted);
+        }
+    }
+
+    int id;
+    int *deleted;
+};
+
+
+BOOST_AUTO_TEST_CASE (order)
+{
+    TimerQueue<Item> queue;
+    queue.push(30, new Item(1));
+    queue.push(10, new Item(2));
+    queue.push(20, new Item(3));
+    queue.push(10, new Item(4));
+
+    BOOST_CHECK_EQUAL(queue.size(), 4);
+    BOOST_CHECK_EQUAL(queue.next(), 10);
+
+    // Nothing due yet
+    BOOST_CHECK(queue.pop(5) == NULL);
+
+    // Ties keep the insertion order
+    time_t due = 0;
+    std::unique_ptr<Item> item(queue.pop(15, &due));
+    BOOST_CHECK_EQUAL(item->id, 2);
+    BOOST_CHECK_EQUAL(due, 10);
+    item.reset(queue.pop(15));
+    BOOST_CHECK_EQUAL(item->id, 4);
+    BOOST_CHECK(queue.pop(15) == NULL);
+
+    item.reset(queue.pop(100));
+    BOOST_CHECK_EQUAL(item->id, 3);
+    item.reset(queue.pop(100));
+    BOOST_CHECK_EQUAL(item->id, 1);
+    BOOST_CHECK(queue.empty());
+}
+
+
+BOOST_AUTO_TEST_CASE (ownership)
+{
+    int deleted = 0;
+    {
+        TimerQueue<Item> queue;
+        for (int i = 0; i < 10; ++i) {
+            queue.push(i, new Item(i, &deleted));
+        }
+        delete queue.pop(0);
+        BOOST_CHECK_EQUAL(deleted, 1);
+        queue.clear();
+        BOOST_CHECK_EQUAL(deleted, 10);
+        queue.push(0, new Item(0, &deleted));
+    }
+    BOOST_CHECK_EQUAL(deleted, 11);
+}
+
+
+// With most of the items due much later, taking the few expired ones
+// should not depend on how many are waiting.
+// Only reported, since it depends on the machine
+BOOST_AUTO_TEST_CASE (expiredOnly)
+{
+    const int N = 200000;
+    TimerQueue<Item> queue;
+    for (int i = 0; i < N; ++i) {
+        queue.push((i % 100 == 0) ? 0 : 600 + i % 600, new Item(i));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int expired = 0;
+    while (Item *item = queue.pop(1)) {
+        ++expired;
+        delete item;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    BOOST_CHECK_EQUAL(expired, N / 100);
+    BOOST_CHECK_EQUAL(queue.size(), N - N / 100);
+    BOOST_TEST_MESSAGE("Took " << expired << " expired out of " << N << " in "
+        << elapsed.count() * 1000 << " ms");
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
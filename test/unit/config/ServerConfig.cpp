@@ -41,6 +41,7 @@ BOOST_FIXTURE_TEST_CASE(getStr, fts3::config::ServerConfig)
     const std::string f_val = "value";
     _vars[f_key] =
     f_val;
+    _publish();
 
     std::string val = get<std::string>(f_key);
     BOOST_CHECK_EQUAL (val, f_val);
@@ -70,6 +71,7 @@ BOOST_FIXTURE_TEST_CASE (read, fts3::config::ServerConfig)
 BOOST_FIXTURE_TEST_CASE (getInt, fts3::config::ServerConfig)
 {
     _vars["key"] = "10";
+    _publish();
     BOOST_CHECK_EQUAL (get<int>("key"), 10);
 }
 
@@ -77,9 +79,37 @@ BOOST_FIXTURE_TEST_CASE (getInt, fts3::config::ServerConfig)
 BOOST_FIXTURE_TEST_CASE (getDouble, fts3::config::ServerConfig)
 {
     _vars["key"] = "10.05";
+    _publish();
     BOOST_CHECK_EQUAL (get<double>("key"), 10.05);
 }
 
 
+BOOST_FIXTURE_TEST_CASE (typedValues, fts3::config::ServerConfig)
+{
+    _vars["UseFixedJobPriority"] = "3";
+    _vars["RetrieveSEToken"] = "False";
+    _vars["MessagingDirectory"] = "/var/lib/fts3";
+    _publish();
+
+    const fts3::config::ServerConfigValues &before = values();
+    BOOST_CHECK_EQUAL(before.useFixedJobPriority, 3);
+    BOOST_CHECK_EQUAL(before.retrieveSEToken, false);
+    BOOST_CHECK_EQUAL(before.messagingDirectory, "/var/lib/fts3");
+    // Not set
+    BOOST_CHECK_EQUAL(before.urlCopyProcessPingInterval, 0);
+
+    // An invalid value keeps the current configuration
+    _vars["UseFixedJobPriority"] = "high";
+    BOOST_CHECK_THROW(_publish(), fts3::common::UserError);
+    BOOST_CHECK_EQUAL(values().useFixedJobPriority, 3);
+
+    // Values read before a reload stay valid
+    _vars["UseFixedJobPriority"] = "5";
+    _publish();
+    BOOST_CHECK_EQUAL(values().useFixedJobPriority, 5);
+    BOOST_CHECK_EQUAL(before.useFixedJobPriority, 3);
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
 BOOST_AUTO_TEST_SUITE_END()
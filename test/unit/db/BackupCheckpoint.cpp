@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/filesystem.hpp>
+#include "db/generic/BackupCheckpoint.h"
+
+BOOST_AUTO_TEST_SUITE(db)
+BOOST_AUTO_TEST_SUITE(BackupCheckpointTest)
+
+
+BOOST_AUTO_TEST_CASE(resume)
+{
+    const std::string path("/tmp/fts3tests-backup.checkpoint");
+    boost::filesystem::remove(path);
+
+    {
+        BackupCheckpoint checkpoint(path);
+        BOOST_CHECK_EQUAL(checkpoint.getLastKey("t_job:0"), "");
+        checkpoint.setLastKey("t_job:0", "0a6a1a3c-b915-11e5-9a03-02163e006dd0");
+        checkpoint.setDone("t_job:1");
+        checkpoint.setDone("t_optimizer_evolution");
+    }
+
+    // As if the run was interrupted
+    {
+        BackupCheckpoint checkpoint(path);
+        BOOST_CHECK_EQUAL(checkpoint.getLastKey("t_job:0"), "0a6a1a3c-b915-11e5-9a03-02163e006dd0");
+        BOOST_CHECK(!checkpoint.isDone("t_job:0"));
+        BOOST_CHECK(checkpoint.isDone("t_job:1"));
+        BOOST_CHECK_EQUAL(checkpoint.getLastKey("t_job:1"), "");
+        BOOST_CHECK(checkpoint.isDone("t_optimizer_evolution"));
+        BOOST_CHECK(!checkpoint.isDone("t_file_retry_errors"));
+
+        checkpoint.clear();
+    }
+
+    BOOST_CHECK(!boost::filesystem::exists(path));
+    BackupCheckpoint checkpoint(path);
+    BOOST_CHECK(!checkpoint.isDone("t_job:1"));
+}
+
+
+BOOST_AUTO_TEST_CASE(chunkSize)
+{
+    BackupChunkSize chunkSize(4000, 1.0);
+    BOOST_CHECK_EQUAL(chunkSize.get(), 1000);
+
+    // Fast and full, grows up to the maximum
+    chunkSize.update(1000, 0.1);
+    BOOST_CHECK_EQUAL(chunkSize.get(), 2000);
+    chunkSize.update(2000, 0.1);
+    chunkSize.update(4000, 0.1);
+    BOOST_CHECK_EQUAL(chunkSize.get(), 4000);
+
+    // Fast, but not full, stays
+    chunkSize.update(10, 0.1);
+    BOOST_CHECK_EQUAL(chunkSize.get(), 4000);
+
+    // Within the target, stays
+    chunkSize.update(4000, 0.8);
+    BOOST_CHECK_EQUAL(chunkSize.get(), 4000);
+
+    // Slow, shrinks to what would have fit
+    chunkSize.update(4000, 1.5);
+    BOOST_CHECK_EQUAL(chunkSize.get(), 2000);
+    chunkSize.update(2000, 10.0);
+    BOOST_CHECK_EQUAL(chunkSize.get(), 200);
+
+    // But never below the minimum
+    for (int i = 0; i < 10; ++i) {
+        chunkSize.update(chunkSize.get(), 100.0);
+    }
+    BOOST_CHECK_EQUAL(chunkSize.get(), BackupChunkSize::MIN_SIZE);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include "db/generic/ConfigSnapshot.h"
+
+BOOST_AUTO_TEST_SUITE(db)
+
+
+/// Snapshot built from the rows of the configuration tables
+struct ConfigSnapshotFixture {
+    ConfigSnapshot snapshot;
+    std::map<std::string, ConfigSnapshot::Storage> storages;
+
+    ConfigSnapshotFixture(): snapshot(1) {
+    }
+
+    /// The storage is added to the snapshot on the next call to loadStorages
+    ConfigSnapshot::Storage &addStorage(const std::string &storage, boost::tribool ipv6,
+        boost::optional<int> debugLevel) {
+        ConfigSnapshot::Storage &entry = storages[storage];
+        entry.config.ipv6 = ipv6;
+        entry.config.debugLevel = debugLevel ? *debugLevel : 0;
+        entry.debugLevel = debugLevel;
+        return entry;
+    }
+
+    void loadStorages() {
+        for (auto i = storages.begin(); i != storages.end(); ++i) {
+            snapshot.addStorage(i->first, i->second);
+        }
+        storages.clear();
+    }
+
+    void addLink(const std::string &source, const std::string &destination,
+        boost::optional<int> streams, boost::optional<std::string> turl) {
+        ConfigSnapshot::Link entry;
+        entry.config.source = source;
+        entry.config.destination = destination;
+        entry.numberOfStreams = streams;
+        entry.thirdPartyTURL = turl;
+        snapshot.addLink(entry);
+    }
+};
+
+
+BOOST_FIXTURE_TEST_CASE (ConfigSnapshotStorage, ConfigSnapshotFixture)
+{
+    addStorage("*", true, 1).config.inboundMaxActive = 50;
+
+    ConfigSnapshot::Storage &source = addStorage("mock://source", false, 0);
+    source.config.outboundMaxActive = 10;
+    source.eviction = true;
+    addStorage("mock://dest", boost::indeterminate, boost::none);
+    loadStorages();
+
+    StorageConfig config = snapshot.getStorageConfig("mock://source");
+    BOOST_CHECK_EQUAL(10, config.outboundMaxActive);
+    BOOST_CHECK_EQUAL(50, config.inboundMaxActive);
+    BOOST_CHECK_EQUAL(50, snapshot.getStorageConfig("mock://unknown").inboundMaxActive);
+
+    // A debug level of 0 is still a value, only nulls fall back to '*'
+    BOOST_CHECK_EQUAL(0, snapshot.getDebugLevel("mock://source", "mock://dest"));
+    BOOST_CHECK_EQUAL(1, snapshot.getDebugLevel("mock://dest", "mock://unknown"));
+
+    // Only one defined, it decides; none defined, '*' decides
+    BOOST_CHECK_EQUAL(false, snapshot.isProtocolIPv6("mock://source", "mock://dest").value);
+    BOOST_CHECK_EQUAL(true, snapshot.isProtocolIPv6("mock://dest", "mock://unknown").value);
+    BOOST_CHECK(boost::indeterminate(snapshot.isProtocolUDT("mock://source", "mock://dest")));
+
+    BOOST_CHECK_EQUAL(true, snapshot.getEvictionFlag("mock://source").value);
+    BOOST_CHECK_EQUAL(false, snapshot.getEvictionFlag("mock://dest").value);
+}
+
+
+BOOST_FIXTURE_TEST_CASE (ConfigSnapshotLinks, ConfigSnapshotFixture)
+{
+    addLink("*", "*", 4, boost::none);
+    addLink("mock://source", "*", boost::none, std::string("gsiftp"));
+    addLink("mock://source", "mock://dest", 2, boost::none);
+
+    BOOST_CHECK_EQUAL(2, *snapshot.getStreamsOptimization("mock://source", "mock://dest"));
+    BOOST_CHECK_EQUAL(4, *snapshot.getStreamsOptimization("mock://source", "mock://other"));
+    BOOST_CHECK_EQUAL("gsiftp", snapshot.getThirdPartyTURL("mock://source", "mock://dest"));
+    // */* does not apply to the third party TURL
+    BOOST_CHECK_EQUAL("", snapshot.getThirdPartyTURL("mock://other", "mock://dest"));
+
+    BOOST_CHECK(snapshot.getLinkConfig("mock://source", "mock://dest").get() != NULL);
+    BOOST_CHECK(snapshot.getLinkConfig("mock://other", "mock://dest").get() == NULL);
+
+    ConfigSnapshot empty(2);
+    BOOST_CHECK(!empty.getStreamsOptimization("mock://source", "mock://dest"));
+}
+
+
+BOOST_FIXTURE_TEST_CASE (ConfigSnapshotVo, ConfigSnapshotFixture)
+{
+    ConfigSnapshot::Vo fallback;
+    fallback.globalTimeout = 100;
+    snapshot.addVo(boost::none, fallback);
+
+    ConfigSnapshot::Vo star;
+    star.secPerMb = 5;
+    star.noStreaming = std::string("on");
+    snapshot.addVo(std::string("*"), star);
+
+    ConfigSnapshot::Vo dteam;
+    dteam.secPerMb = 2;
+    dteam.maxTimeInQueue = -1;
+    dteam.showUserDn = std::string("on");
+    snapshot.addVo(std::string("dteam"), dteam);
+
+    BOOST_CHECK_EQUAL(2, snapshot.getSecPerMb("dteam"));
+    BOOST_CHECK_EQUAL(5, snapshot.getSecPerMb("atlas"));
+    BOOST_CHECK_EQUAL(0, snapshot.getMaxTimeInQueue("dteam"));
+    // The first match is used even if the value is null
+    BOOST_CHECK_EQUAL(0, snapshot.getGlobalTimeout("dteam"));
+    BOOST_CHECK(snapshot.getDisableStreamingFlag("atlas"));
+    BOOST_CHECK(!snapshot.getDisableStreamingFlag("dteam"));
+
+    BOOST_CHECK(snapshot.publishUserDn("dteam"));
+    BOOST_CHECK(!snapshot.publishUserDn("atlas"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <map>
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include "db/generic/HashRing.h"
+
+BOOST_AUTO_TEST_SUITE(db)
+BOOST_AUTO_TEST_SUITE(HashRingTest)
+
+
+/// Ring shared by a few hosts
+struct HashRingFixture {
+    HashRing ring;
+    std::vector<std::string> hosts;
+
+    void addHosts(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            hosts.push_back("fts" + std::to_string(i) + ".cern.ch");
+        }
+    }
+
+    std::vector<std::string> getOwners() const {
+        std::vector<std::string> owners(HashRing::HASH_MAX + 1);
+        for (unsigned hash = 0; hash <= HashRing::HASH_MAX; ++hash) {
+            owners[hash] = ring.getOwner(hash);
+        }
+        return owners;
+    }
+};
+
+
+BOOST_FIXTURE_TEST_CASE(single, HashRingFixture)
+{
+    addHosts(1);
+    BOOST_CHECK(ring.getRanges("fts0.cern.ch").empty());
+    BOOST_CHECK(ring.setMembers(hosts));
+    BOOST_CHECK(!ring.setMembers(hosts));
+
+    auto ranges = ring.getRanges("fts0.cern.ch");
+    BOOST_REQUIRE_EQUAL(ranges.size(), 1);
+    BOOST_CHECK_EQUAL(ranges[0].first, 0);
+    BOOST_CHECK_EQUAL(ranges[0].second, HashRing::HASH_MAX);
+}
+
+
+BOOST_FIXTURE_TEST_CASE(partition, HashRingFixture)
+{
+    addHosts(5);
+    ring.setMembers(hosts);
+
+    // Every hash belongs to exactly one host, the one getOwner says
+    std::vector<std::string> owners(HashRing::HASH_MAX + 1);
+    for (auto host = hosts.begin(); host != hosts.end(); ++host) {
+        auto ranges = ring.getRanges(*host);
+        size_t owned = 0;
+        for (auto range = ranges.begin(); range != ranges.end(); ++range) {
+            for (unsigned hash = range->first; hash <= range->second; ++hash) {
+                BOOST_CHECK(owners[hash].empty());
+                owners[hash] = *host;
+                ++owned;
+            }
+        }
+        // Reasonably balanced
+        BOOST_CHECK_GT(owned, (HashRing::HASH_MAX + 1) / hosts.size() / 2);
+        BOOST_CHECK_LT(owned, (HashRing::HASH_MAX + 1) / hosts.size() * 2);
+    }
+    BOOST_CHECK(owners == getOwners());
+
+    // Exactly one host owns 0
+    size_t leaders = 0;
+    for (auto host = hosts.begin(); host != hosts.end(); ++host) {
+        leaders += (ring.getRanges(*host).front().first == 0);
+    }
+    BOOST_CHECK_EQUAL(leaders, 1);
+}
+
+
+BOOST_FIXTURE_TEST_CASE(join, HashRingFixture)
+{
+    addHosts(4);
+    ring.setMembers(hosts);
+    const auto before = getOwners();
+
+    hosts.push_back("new.cern.ch");
+    BOOST_CHECK(ring.setMembers(hosts));
+    const auto after = getOwners();
+
+    // Only the hashes taken by the new host move
+    size_t moved = 0;
+    for (size_t hash = 0; hash < before.size(); ++hash) {
+        if (before[hash] != after[hash]) {
+            BOOST_CHECK_EQUAL(after[hash], "new.cern.ch");
+            ++moved;
+        }
+    }
+    BOOST_CHECK_GT(moved, 0);
+    BOOST_CHECK_LT(moved, before.size() / 2);
+}
+
+
+BOOST_FIXTURE_TEST_CASE(leave, HashRingFixture)
+{
+    addHosts(4);
+    ring.setMembers(hosts);
+    const auto before = getOwners();
+
+    const std::string gone = hosts[1];
+    hosts.erase(hosts.begin() + 1);
+    BOOST_CHECK(ring.setMembers(hosts));
+    BOOST_CHECK(ring.getRanges(gone).empty());
+    const auto after = getOwners();
+
+    // Only the hashes of the host gone move
+    for (size_t hash = 0; hash < before.size(); ++hash) {
+        if (before[hash] != gone) {
+            BOOST_CHECK_EQUAL(before[hash], after[hash]);
+        }
+    }
+}
+
+
+// With a single virtual node (HeartBeatVirtualNodes=1), a host whose position collides
+// with the one of another host owns nothing
+BOOST_AUTO_TEST_CASE(collision)
+{
+    // Look for two host names at the same position
+    std::map<unsigned, std::string> positions;
+    std::vector<std::string> hosts;
+    for (unsigned i = 0; hosts.empty(); ++i) {
+        const std::string host = "fts" + std::to_string(i) + ".cern.ch";
+        auto inserted = positions.emplace(HashRing::getPosition(host, 0), host);
+        if (!inserted.second) {
+            hosts.push_back(inserted.first->second);
+            hosts.push_back(host);
+        }
+    }
+    std::sort(hosts.begin(), hosts.end());
+
+    HashRing ring(1);
+    ring.setMembers(hosts);
+
+    // The lowest name wins
+    auto ranges = ring.getRanges(hosts[0]);
+    BOOST_REQUIRE_EQUAL(ranges.size(), 1);
+    BOOST_CHECK_EQUAL(ranges[0].first, 0);
+    BOOST_CHECK_EQUAL(ranges[0].second, HashRing::HASH_MAX);
+
+    BOOST_CHECK(ring.getRanges(hosts[1]).empty());
+    for (unsigned hash = 0; hash <= HashRing::HASH_MAX; hash += 0xFF) {
+        BOOST_CHECK_EQUAL(ring.getOwner(hash), hosts[0]);
+    }
+
+    // The one left without hashes is neither the first one, nor matches any hash
+    HashRing::Range bounds = HashRing::getBounds(ring.getRanges(hosts[1]));
+    BOOST_CHECK_EQUAL(bounds.first, HashRing::NO_HASH);
+    BOOST_CHECK_EQUAL(bounds.second, HashRing::NO_HASH);
+    BOOST_CHECK_GT(bounds.first, HashRing::HASH_MAX);
+
+    bounds = HashRing::getBounds(ranges);
+    BOOST_CHECK_EQUAL(bounds.first, 0);
+    BOOST_CHECK_EQUAL(bounds.second, HashRing::HASH_MAX);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/algorithm/string/find_iterator.hpp>
+#include <boost/algorithm/string/finder.hpp>
+#include "db/generic/ReadyTransfersQuery.h"
+
+BOOST_AUTO_TEST_SUITE(db)
+BOOST_AUTO_TEST_SUITE(ReadyTransfersQueryTest)
+
+
+/// Builds the statement for a few queues
+struct ReadyTransfersQueryFixture {
+    std::vector<ReadyTransfersQuery> queries;
+
+    void addQuery(const std::string &sourceSe, const std::string &activity = std::string()) {
+        queries.emplace_back(QueueId(sourceSe, "mock://dest", "dteam", 0), 3, 10);
+        if (!activity.empty()) {
+            queries.back().byActivity = true;
+            queries.back().activity = activity;
+            queries.back().defaultActivities = " ('', 'express') ";
+        }
+    }
+
+    static size_t count(const std::string &select, const std::string &what) {
+        size_t n = 0;
+        for (auto i = boost::make_find_iterator(select, boost::first_finder(what));
+             i != boost::find_iterator<std::string::const_iterator>(); ++i) {
+            ++n;
+        }
+        return n;
+    }
+};
+
+
+BOOST_FIXTURE_TEST_CASE(unionAll, ReadyTransfersQueryFixture)
+{
+    addQuery("mock://a");
+    addQuery("mock://b");
+    addQuery("mock://c");
+
+    std::string select = buildReadyTransfersQuery(queries, 0, queries.size(), "(f.hashed_id BETWEEN 0 AND 65535)");
+    BOOST_CHECK_EQUAL(count(select, "(SELECT "), 3);
+    BOOST_CHECK_EQUAL(count(select, " UNION ALL "), 2);
+    BOOST_CHECK_EQUAL(count(select, "(f.hashed_id BETWEEN 0 AND 65535)"), 3);
+    // Each subquery is limited on its own
+    BOOST_CHECK_EQUAL(count(select, " LIMIT :filesNum)"), 3);
+
+    // Only the given range of queries
+    select = buildReadyTransfersQuery(queries, 1, 2, "(0=1)");
+    BOOST_CHECK_EQUAL(count(select, "(SELECT "), 1);
+    BOOST_CHECK_EQUAL(count(select, " UNION ALL "), 0);
+}
+
+
+BOOST_FIXTURE_TEST_CASE(activities, ReadyTransfersQueryFixture)
+{
+    addQuery("mock://a");
+    addQuery("mock://a", "default");
+    addQuery("mock://a", "production");
+
+    // One :activity for the column, and another for the filter of the queues with activity shares
+    std::string select = buildReadyTransfersQuery(queries, 0, 1, "(0=1)");
+    BOOST_CHECK_EQUAL(count(select, ":activity"), 1);
+    BOOST_CHECK_EQUAL(count(select, "j.job_type IN ('N', 'R', 'H')"), 1);
+
+    select = buildReadyTransfersQuery(queries, 1, 2, "(0=1)");
+    BOOST_CHECK_EQUAL(count(select, ":activity"), 2);
+    BOOST_CHECK_EQUAL(count(select, "f.activity IN  ('', 'express') "), 1);
+
+    select = buildReadyTransfersQuery(queries, 2, 3, "(0=1)");
+    BOOST_CHECK_EQUAL(count(select, ":activity"), 2);
+    BOOST_CHECK_EQUAL(count(select, "f.activity IS NULL"), 0);
+
+    // As many placeholders as values bound
+    select = buildReadyTransfersQuery(queries, 0, queries.size(), "(0=1)");
+    BOOST_CHECK_EQUAL(count(select, ":"), 1 * 7 + 2 * 8);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
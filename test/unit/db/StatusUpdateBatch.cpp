@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include "db/generic/StatusUpdateBatch.h"
+
+BOOST_AUTO_TEST_SUITE(db)
+BOOST_AUTO_TEST_SUITE(StatusUpdateBatchTest)
+
+
+/// A batch of status messages, as read from the queue
+struct StatusUpdateBatchFixture {
+    std::vector<fts3::events::Message> messages;
+    std::vector<uint64_t> fileIds;
+
+    void addMessage(const std::string &jobId, uint64_t fileId, const std::string &state) {
+        messages.emplace_back();
+        messages.back().set_job_id(jobId);
+        messages.back().set_file_id(fileId);
+        messages.back().set_transfer_status(state);
+    }
+};
+
+
+BOOST_FIXTURE_TEST_CASE(byJob, StatusUpdateBatchFixture)
+{
+    addMessage("job-a", 1, "FINISHED");
+    addMessage("job-b", 2, "FAILED");
+    addMessage("job-a", 3, "CANCELED");
+    // Not terminal, or not bound to a transfer
+    addMessage("job-a", 4, "ACTIVE");
+    addMessage("job-b", 0, "FAILED");
+    addMessage("", 5, "FAILED");
+
+    auto byJob = groupTerminalStatuses(messages, fileIds);
+    BOOST_REQUIRE_EQUAL(byJob.size(), 2);
+    BOOST_REQUIRE_EQUAL(byJob["job-a"].size(), 2);
+    BOOST_CHECK_EQUAL(byJob["job-a"][0], 0);
+    BOOST_CHECK_EQUAL(byJob["job-a"][1], 2);
+    BOOST_REQUIRE_EQUAL(byJob["job-b"].size(), 1);
+    BOOST_CHECK_EQUAL(byJob["job-b"][0], 1);
+    BOOST_CHECK_EQUAL(fileIds.size(), 3);
+}
+
+
+BOOST_FIXTURE_TEST_CASE(duplicates, StatusUpdateBatchFixture)
+{
+    // The transfer failed, was retried and finished within the same batch
+    addMessage("job-a", 1, "FAILED");
+    addMessage("job-a", 2, "FINISHED");
+    addMessage("job-a", 1, "FINISHED");
+
+    auto byJob = groupTerminalStatuses(messages, fileIds);
+    BOOST_REQUIRE_EQUAL(byJob["job-a"].size(), 2);
+    // Only the first one goes in bulk, the last one is applied on its own after it
+    BOOST_CHECK_EQUAL(byJob["job-a"][0], 0);
+    BOOST_CHECK_EQUAL(byJob["job-a"][1], 1);
+    BOOST_REQUIRE_EQUAL(fileIds.size(), 2);
+    BOOST_CHECK_EQUAL(fileIds[0], 1);
+    BOOST_CHECK_EQUAL(fileIds[1], 2);
+}
+
+
+BOOST_AUTO_TEST_CASE(jobTypes)
+{
+    BOOST_CHECK(canUpdateStatusesInBulk(Job::kTypeRegular, -1));
+    BOOST_CHECK(canUpdateStatusesInBulk(Job::kTypeSessionReuse, -1));
+    // These pick the next file when one terminates
+    BOOST_CHECK(!canUpdateStatusesInBulk(Job::kTypeMultipleReplica, -1));
+    BOOST_CHECK(!canUpdateStatusesInBulk(Job::kTypeMultiHop, -1));
+    // Archiving
+    BOOST_CHECK(!canUpdateStatusesInBulk(Job::kTypeRegular, 0));
+    BOOST_CHECK(!canUpdateStatusesInBulk(Job::kTypeSessionReuse, 3600));
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include <chrono>
+#include <sstream>
+
+#include <cajun/json/elements.h>
+#include <cajun/json/reader.h>
+#include <cajun/json/writer.h>
+
+#include "monitoring/JsonFields.h"
+#include "monitoring/JsonWriter.h"
+
+
+BOOST_AUTO_TEST_SUITE(monitoring)
+BOOST_AUTO_TEST_SUITE(JsonFieldsTest)
+
+
+/// A transfer message, as produced by fts_url_copy
+struct JsonFieldsFixture {
+    std::string message;
+
+    JsonFieldsFixture() {
+        JsonWriter writer(message);
+        writer.add("tr_id", "2024-01-01-0000__source.cern.ch__destination.cern.ch__42__1906cc40-b915-11e5-9a03-02163e006dd0");
+        writer.add("job_id", "1906cc40-b915-11e5-9a03-02163e006dd0");
+        writer.add("file_id", 42ul);
+        writer.add("endpnt", "old.cern.ch");
+        writer.add("vo_name", "dteam");
+        writer.add("t__error_message", "Failed with \"quotes\"\nand a new line");
+        writer.add("throughput", 1234.5);
+        writer.add("job_m_replica", false);
+        writer.addRaw("job_metadata", "{\"endpnt\": \"nested\", \"list\": [1, {\"a\": \"}\"}]}");
+        writer.end();
+    }
+};
+
+
+BOOST_AUTO_TEST_CASE (writer)
+{
+    std::string msg;
+    JsonWriter writer(msg);
+    writer.add("s", "a\"b\\c\x01").add("n", -5).add("d", 0.5).add("b", true).add("r", std::string("x"));
+    writer.end();
+    BOOST_CHECK_EQUAL(msg, "{\"s\":\"a\\\"b\\\\c\\u0001\",\"n\":-5,\"d\":0.5,\"b\":true,\"r\":\"x\"}");
+}
+
+
+BOOST_FIXTURE_TEST_CASE (get, JsonFieldsFixture)
+{
+    BOOST_CHECK_EQUAL(getJsonField(message, "job_id"), "1906cc40-b915-11e5-9a03-02163e006dd0");
+    BOOST_CHECK_EQUAL(getJsonField(message, "file_id"), "42");
+    BOOST_CHECK_EQUAL(getJsonField(message, "t__error_message"), "Failed with \"quotes\"\nand a new line");
+    BOOST_CHECK_EQUAL(getJsonField(message, "job_m_replica"), "false");
+    BOOST_CHECK_EQUAL(getJsonField(message, "missing"), "");
+
+    // Nested keys are not top level fields
+    std::string raw;
+    BOOST_CHECK(getJsonRawField(message, "job_metadata", &raw));
+    BOOST_CHECK_EQUAL(raw, "{\"endpnt\": \"nested\", \"list\": [1, {\"a\": \"}\"}]}");
+    BOOST_CHECK(!getJsonRawField(message, "list", &raw));
+}
+
+
+BOOST_FIXTURE_TEST_CASE (set, JsonFieldsFixture)
+{
+    // Replaced in place
+    BOOST_CHECK(setJsonField(message, "endpnt", "fts3.cern.ch"));
+    BOOST_CHECK_EQUAL(getJsonField(message, "endpnt"), "fts3.cern.ch");
+    // Appended
+    BOOST_CHECK(setJsonField(message, "fqdn", "fts-node-01.cern.ch"));
+    BOOST_CHECK_EQUAL(getJsonField(message, "fqdn"), "fts-node-01.cern.ch");
+    // Nothing else touched
+    BOOST_CHECK_EQUAL(getJsonField(message, "vo_name"), "dteam");
+    BOOST_CHECK(message.find("\"endpnt\": \"nested\"") != std::string::npos);
+
+    std::string empty("{}");
+    BOOST_CHECK(setJsonField(empty, "endpnt", "fts3.cern.ch"));
+    BOOST_CHECK_EQUAL(empty, "{\"endpnt\":\"fts3.cern.ch\"}");
+
+    // White space, as older producers wrote it
+    std::string pretty("{\n\t\"vo_name\" : \"dteam\",\n\t\"endpnt\" : \"old\"\n}");
+    BOOST_CHECK(setJsonField(pretty, "endpnt", "new"));
+    BOOST_CHECK_EQUAL(getJsonField(pretty, "endpnt"), "new");
+    BOOST_CHECK_EQUAL(getJsonField(pretty, "vo_name"), "dteam");
+
+    std::string broken("{\"vo_name\": \"dte");
+    BOOST_CHECK(!setJsonField(broken, "endpnt", "fts3.cern.ch"));
+}
+
+
+// Messages per second prepared for the broker with the previous parse and serialize round trip,
+// and with the in place update. The broker send itself is left out.
+// Only reported, since it depends on the machine
+BOOST_FIXTURE_TEST_CASE (throughput, JsonFieldsFixture)
+{
+    const int N = 20000;
+    size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i) {
+        std::istringstream input(message);
+        json::Object msg;
+        json::Reader::Read(msg, input);
+        msg["endpnt"] = json::String("fts3.cern.ch");
+        msg["fqdn"] = json::String("fts-node-01.cern.ch");
+        std::ostringstream output;
+        json::Writer::Write(msg, output);
+        auto vo = msg.Find("vo_name");
+        sink += output.str().size() + (vo != msg.End());
+    }
+    std::chrono::duration<double> roundTrip = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i) {
+        std::string msg(message);
+        setJsonField(msg, "endpnt", "fts3.cern.ch");
+        setJsonField(msg, "fqdn", "fts-node-01.cern.ch");
+        sink += msg.size() + getJsonField(msg, "vo_name").size();
+    }
+    std::chrono::duration<double> inPlace = std::chrono::steady_clock::now() - start;
+
+    BOOST_CHECK_GT(sink, 0);
+    BOOST_TEST_MESSAGE("Parse and serialize: " << static_cast<uint64_t>(N / roundTrip.count()) << " messages/second");
+    BOOST_TEST_MESSAGE("In place: " << static_cast<uint64_t>(N / inPlace.count()) << " messages/second");
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
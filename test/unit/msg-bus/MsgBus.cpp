@@ -19,10 +19,14 @@
 #include <boost/filesystem.hpp>
 #include <boost/function.hpp>
 
+#include <chrono>
 #include <glib.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "msg-bus/consumer.h"
 #include "msg-bus/producer.h"
+#include "msg-bus/RingBuffer.h"
 
 using namespace fts3::events;
 
@@ -51,6 +55,20 @@ class MsgBusFixture {
 protected:
     static const std::string TEST_PATH;
 
+    /// Terminal status of a transfer
+    static Message getStatus(uint64_t fileId) {
+        Message msg;
+        msg.set_job_id("1906cc40-b915-11e5-9a03-02163e006dd0");
+        msg.set_transfer_status("FINISHED");
+        msg.set_source_se("mock://source/file");
+        msg.set_dest_se("mock://source/file2");
+        msg.set_file_id(fileId);
+        msg.set_process_id(1234);
+        msg.set_filesize(1023);
+        msg.set_timestamp(15689);
+        return msg;
+    }
+
 public:
     MsgBusFixture() {
         boost::filesystem::create_directories(TEST_PATH);
@@ -252,4 +270,288 @@ BOOST_FIXTURE_TEST_CASE (simpleStaging, MsgBusFixture)
 }
 
 
+// Status messages go through the ring buffer once the consumer sets it up
+BOOST_FIXTURE_TEST_CASE (ringStatus, MsgBusFixture)
+{
+    Consumer consumer(TEST_PATH);
+    consumer.setupStatusRing(8);
+    Producer producer(TEST_PATH);
+
+    BOOST_CHECK(boost::filesystem::exists(TEST_PATH + "/status.ring"));
+
+    Message original = getStatus(42);
+    BOOST_CHECK_EQUAL(0, producer.runProducerStatus(original));
+
+    // Nothing went to the directory queue
+    Consumer dirqOnly(TEST_PATH);
+    expectZeroMessages<std::vector<Message>>(&Consumer::runConsumerStatus, dirqOnly);
+
+    std::vector<Message> statuses;
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(1, statuses.size());
+    BOOST_CHECK_EQUAL(statuses[0], original);
+
+    statuses.clear();
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(0, statuses.size());
+}
+
+
+// Once the ring buffer is full, messages go to the directory queue, and are consumed after those in the ring
+BOOST_FIXTURE_TEST_CASE (ringFallback, MsgBusFixture)
+{
+    Consumer consumer(TEST_PATH);
+    consumer.setupStatusRing(2);
+    Producer producer(TEST_PATH);
+
+    for (uint64_t i = 0; i < 5; ++i) {
+        BOOST_CHECK_EQUAL(0, producer.runProducerStatus(getStatus(i)));
+    }
+    // Too big for a slot
+    Message big = getStatus(5);
+    big.set_transfer_message(std::string(RingBuffer::SLOT_SIZE, 'x'));
+    BOOST_CHECK_EQUAL(0, producer.runProducerStatus(big));
+
+    std::vector<Message> statuses;
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(6, statuses.size());
+    for (uint64_t i = 0; i < statuses.size(); ++i) {
+        BOOST_CHECK_EQUAL(i, statuses[i].file_id());
+    }
+}
+
+
+// Disabling the ring buffer removes it, but what is left in it is still consumed
+BOOST_FIXTURE_TEST_CASE (ringDisable, MsgBusFixture)
+{
+    std::unique_ptr<Producer> running;
+    {
+        Consumer consumer(TEST_PATH);
+        consumer.setupStatusRing(8);
+        running.reset(new Producer(TEST_PATH));
+        BOOST_CHECK_EQUAL(0, running->runProducerStatus(getStatus(1)));
+    }
+
+    Consumer consumer(TEST_PATH);
+    consumer.setupStatusRing(0);
+    BOOST_CHECK(!boost::filesystem::exists(TEST_PATH + "/status.ring"));
+
+    Producer producer(TEST_PATH);
+    BOOST_CHECK_EQUAL(0, producer.runProducerStatus(getStatus(2)));
+    // Still has the removed one mapped
+    BOOST_CHECK_EQUAL(0, running->runProducerStatus(getStatus(3)));
+
+    Consumer dirqOnly(TEST_PATH);
+    std::vector<Message> statuses;
+    BOOST_CHECK_EQUAL(0, dirqOnly.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(2, statuses.size());
+
+    statuses.clear();
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(1, statuses.size());
+}
+
+
+// Producers that have the ring buffer mapped move to its replacement
+BOOST_FIXTURE_TEST_CASE (ringResize, MsgBusFixture)
+{
+    std::unique_ptr<Producer> running;
+    {
+        Consumer consumer(TEST_PATH);
+        consumer.setupStatusRing(8);
+        running.reset(new Producer(TEST_PATH));
+        BOOST_CHECK_EQUAL(0, running->runProducerStatus(getStatus(0)));
+    }
+
+    Consumer consumer(TEST_PATH);
+    consumer.setupStatusRing(16);
+    BOOST_CHECK_EQUAL(0, running->runProducerStatus(getStatus(1)));
+
+    // Nothing went to the directory queue
+    Consumer dirqOnly(TEST_PATH);
+    expectZeroMessages<std::vector<Message>>(&Consumer::runConsumerStatus, dirqOnly);
+
+    std::vector<Message> statuses;
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_REQUIRE_EQUAL(2, statuses.size());
+    BOOST_CHECK_EQUAL(0, statuses[0].file_id());
+    BOOST_CHECK_EQUAL(1, statuses[1].file_id());
+
+    std::unique_ptr<RingBuffer> ring = RingBuffer::open(TEST_PATH + "/status.ring");
+    BOOST_REQUIRE(ring.get() != NULL);
+    BOOST_CHECK_EQUAL(16, ring->getSlots());
+    BOOST_CHECK_EQUAL(2, ring->getGeneration());
+}
+
+
+// A second replacement does not lose what is left in the first replaced ring buffer
+BOOST_FIXTURE_TEST_CASE (ringResizeTwice, MsgBusFixture)
+{
+    Consumer consumer(TEST_PATH);
+    consumer.setupStatusRing(8);
+    std::unique_ptr<RingBuffer> first = RingBuffer::open(TEST_PATH + "/status.ring");
+    BOOST_REQUIRE(first.get() != NULL);
+    BOOST_CHECK(first->push(getStatus(0).SerializeAsString()));
+
+    consumer.setupStatusRing(16);
+    consumer.setupStatusRing(32);
+
+    std::vector<Message> statuses;
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_REQUIRE_EQUAL(1, statuses.size());
+    BOOST_CHECK_EQUAL(0, statuses[0].file_id());
+}
+
+
+// Producers go back to the ring buffer once the consumer has emptied the directory queue
+BOOST_FIXTURE_TEST_CASE (ringBypassReset, MsgBusFixture)
+{
+    Consumer consumer(TEST_PATH);
+    consumer.setupStatusRing(2);
+    Producer producer(TEST_PATH);
+    Consumer dirqOnly(TEST_PATH);
+
+    for (uint64_t i = 0; i < 4; ++i) {
+        BOOST_CHECK_EQUAL(0, producer.runProducerStatus(getStatus(i)));
+    }
+    std::vector<Message> statuses;
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(4, statuses.size());
+
+    // The pass that emptied it may have started before the last write
+    BOOST_CHECK_EQUAL(0, producer.runProducerStatus(getStatus(4)));
+    statuses.clear();
+    BOOST_CHECK_EQUAL(0, dirqOnly.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(1, statuses.size());
+
+    expectZeroMessages<std::vector<Message>>(&Consumer::runConsumerStatus, consumer);
+    expectZeroMessages<std::vector<Message>>(&Consumer::runConsumerStatus, consumer);
+
+    BOOST_CHECK_EQUAL(0, producer.runProducerStatus(getStatus(5)));
+    expectZeroMessages<std::vector<Message>>(&Consumer::runConsumerStatus, dirqOnly);
+
+    statuses.clear();
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_REQUIRE_EQUAL(1, statuses.size());
+    BOOST_CHECK_EQUAL(5, statuses[0].file_id());
+}
+
+
+// Frames pushed by other processes, even gone ones, are consumed, and the position survives a restart
+BOOST_FIXTURE_TEST_CASE (ringProcesses, MsgBusFixture)
+{
+    const std::string path = TEST_PATH + "/test.ring";
+    std::unique_ptr<RingBuffer> consumer = RingBuffer::create(path, 4);
+
+    pid_t child = fork();
+    if (child == 0) {
+        std::unique_ptr<RingBuffer> producer = RingBuffer::open(path);
+        producer->push("first");
+        _exit(0);
+    }
+    waitpid(child, NULL, 0);
+
+    std::unique_ptr<RingBuffer> producer = RingBuffer::open(path);
+    BOOST_REQUIRE(producer.get() != NULL);
+    BOOST_CHECK(producer->push("second"));
+
+    std::string frame;
+    BOOST_CHECK(consumer->pop(frame));
+    BOOST_CHECK_EQUAL(frame, "first");
+    BOOST_CHECK(consumer->pop(frame));
+    BOOST_CHECK_EQUAL(frame, "second");
+    BOOST_CHECK(!consumer->pop(frame));
+
+    // Reusing it keeps the position
+    consumer.reset();
+    consumer = RingBuffer::create(path, 4);
+    BOOST_CHECK(producer->push("third"));
+    BOOST_CHECK(consumer->pop(frame));
+    BOOST_CHECK_EQUAL(frame, "third");
+}
+
+
+// Compare the throughput of the directory queue and the ring buffer
+// Only reported, since it depends on the machine and the file system
+BOOST_FIXTURE_TEST_CASE (throughput, MsgBusFixture)
+{
+    const unsigned N = 5000;
+
+    for (int useRing = 0; useRing < 2; ++useRing) {
+        Consumer consumer(TEST_PATH, N);
+        consumer.setupStatusRing(useRing ? N : 0);
+        Producer producer(TEST_PATH);
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < N; ++i) {
+            producer.runProducerStatus(getStatus(i));
+        }
+        std::vector<Message> statuses;
+        consumer.runConsumerStatus(statuses);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        BOOST_CHECK_EQUAL(N, statuses.size());
+        const double seconds = std::max(elapsed.count(), 1e-9);
+        BOOST_TEST_MESSAGE((useRing ? "Ring buffer: " : "Directory queue: ")
+            << static_cast<uint64_t>(N / seconds) << " messages/second");
+    }
+}
+
+
+// Messages that can not be parsed are dropped, instead of repeating the previous one
+BOOST_FIXTURE_TEST_CASE (corruptedStatus, MsgBusFixture)
+{
+    // Write raw content into what the consumer sees as the status queue
+    Producer producer(TEST_PATH + "/raw");
+    BOOST_CHECK_EQUAL(0, producer.runProducerMonitoring(getStatus(1).SerializeAsString()));
+    BOOST_CHECK_EQUAL(0, producer.runProducerMonitoring("\xff\xff\xff"));
+
+    boost::filesystem::create_directories(TEST_PATH + "/alt");
+    boost::filesystem::create_symlink(TEST_PATH + "/raw/monitoring", TEST_PATH + "/alt/status");
+    Consumer consumer(TEST_PATH + "/alt");
+
+    std::vector<Message> statuses;
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(1, statuses.size());
+    BOOST_CHECK_EQUAL(1, statuses[0].file_id());
+
+    // Both were removed
+    statuses.clear();
+    BOOST_CHECK_EQUAL(0, consumer.runConsumerStatus(statuses));
+    BOOST_CHECK_EQUAL(0, statuses.size());
+}
+
+
+// Rate at which the consumer parses messages out of the directory queue
+// Only reported, since it depends on the machine and the file system
+BOOST_FIXTURE_TEST_CASE (consumeThroughput, MsgBusFixture)
+{
+    const unsigned N = 5000;
+
+    Producer producer(TEST_PATH);
+    Consumer consumer(TEST_PATH, N);
+
+    for (unsigned i = 0; i < N; ++i) {
+        producer.runProducerStatus(getStatus(i));
+        producer.runProducerMonitoring(getStatus(i).SerializeAsString());
+    }
+
+    std::vector<Message> statuses;
+    auto start = std::chrono::steady_clock::now();
+    consumer.runConsumerStatus(statuses);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    BOOST_CHECK_EQUAL(N, statuses.size());
+    BOOST_TEST_MESSAGE("Status consumption: "
+        << static_cast<uint64_t>(N / std::max(elapsed.count(), 1e-9)) << " messages/second");
+
+    std::vector<std::string> monitoring;
+    start = std::chrono::steady_clock::now();
+    consumer.runConsumerMonitoring(monitoring);
+    elapsed = std::chrono::steady_clock::now() - start;
+    BOOST_CHECK_EQUAL(N, monitoring.size());
+    BOOST_TEST_MESSAGE("Monitoring consumption: "
+        << static_cast<uint64_t>(N / std::max(elapsed.count(), 1e-9)) << " messages/second");
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
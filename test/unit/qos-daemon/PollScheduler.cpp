@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+
+#include "qos-daemon/task/PollScheduler.h"
+
+
+BOOST_AUTO_TEST_SUITE(qos)
+BOOST_AUTO_TEST_SUITE(PollSchedulerTest)
+
+
+BOOST_AUTO_TEST_CASE (fallback)
+{
+    PollScheduler scheduler(2, 600);
+
+    // No history
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "tape.cern.ch", 0, 4), 4);
+    // Clamped
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "tape.cern.ch", 0, 0), 2);
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "tape.cern.ch", 0, 1000), 600);
+
+    // Not enough history
+    for (int i = 0; i < 4; ++i) {
+        scheduler.addSample("STAGING", "tape.cern.ch", 100);
+    }
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "tape.cern.ch", 0, 4), 4);
+}
+
+
+BOOST_AUTO_TEST_CASE (history)
+{
+    PollScheduler scheduler(2, 600);
+
+    // A fast endpoint and a slow one
+    for (int i = 1; i <= 100; ++i) {
+        scheduler.addSample("STAGING", "fast.cern.ch", i);
+        scheduler.addSample("STAGING", "slow.cern.ch", 1000 + 10 * i);
+    }
+
+    // A quarter of the fast ones are done after 25 seconds
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "fast.cern.ch", 0, 4), 26);
+    // Still pending after 50, a quarter of the longer ones are done by 63
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "fast.cern.ch", 50, 4), 13);
+    // The slow one is left alone, up to the maximum
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "slow.cern.ch", 0, 4), 600);
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "slow.cern.ch", 1200, 4), 210);
+    // Longer than anything seen, back to the caller's rule
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("STAGING", "fast.cern.ch", 500, 64), 64);
+    // Archiving has its own history
+    BOOST_CHECK_EQUAL(scheduler.getPollInterval("ARCHIVING", "fast.cern.ch", 0, 8), 8);
+}
+
+
+BOOST_AUTO_TEST_CASE (rateLimit)
+{
+    PollScheduler scheduler;
+
+    // No limit
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 110, 100), 110);
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 110, 100), 110);
+
+    scheduler.setRateLimit(2);
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 110, 100), 110);
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 110, 100), 110);
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 110, 100), 111);
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 111, 100), 111);
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 110, 100), 112);
+    // Other endpoints are not affected
+    BOOST_CHECK_EQUAL(scheduler.reserve("disk.cern.ch", 110, 100), 110);
+    // Never in the past
+    BOOST_CHECK_EQUAL(scheduler.reserve("tape.cern.ch", 50, 100), 100);
+}
+
+
+BOOST_AUTO_TEST_CASE (pollTimes)
+{
+    PollTimes times;
+    std::set<std::string> urls = {"a", "b", "c"};
+
+    // Never scheduled, so due
+    BOOST_CHECK_EQUAL(times.getDue(urls, 100).size(), 3);
+    BOOST_CHECK_EQUAL(times.getNext(urls), 0);
+
+    times.set("a", 150);
+    times.set("b", 120);
+    times.set("c", 200);
+    BOOST_CHECK(times.getDue(urls, 100).empty());
+    BOOST_CHECK_EQUAL(times.getNext(urls), 120);
+
+    std::set<std::string> due = times.getDue(urls, 150);
+    BOOST_CHECK_EQUAL(due.size(), 2);
+    BOOST_CHECK(due.count("a") && due.count("b"));
+
+    times.remove("b");
+    urls.erase("b");
+    BOOST_CHECK_EQUAL(times.getNext(urls), 150);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+
+#include "common/Exceptions.h"
+#include "qos-daemon/fetch/StagingCoalescer.h"
+
+
+BOOST_AUTO_TEST_SUITE(qos)
+BOOST_AUTO_TEST_SUITE(StagingCoalescerTest)
+
+
+/// Staging operations as fetched from the database
+struct StagingCoalescerFixture {
+    std::vector<StagingOperation> ops;
+
+    void addOp(uint64_t fileId, const std::string &surl,
+        const std::string &metadata = "", const std::string &credId = "cred") {
+        ops.emplace_back("job", fileId, "dteam", "/DC=ch/CN=user", credId,
+            surl, metadata, 3600, 28800, 0, "", "");
+    }
+};
+
+
+BOOST_FIXTURE_TEST_CASE (disabled, StagingCoalescerFixture)
+{
+    StagingCoalescer coalescer(0, 0, 2);
+
+    addOp(1, "srm://tape.cern.ch/a");
+    addOp(2, "srm://tape.cern.ch/b");
+    addOp(3, "srm://tape.cern.ch/c");
+    addOp(4, "srm://other.cern.ch/a");
+    addOp(5, "srm://tape.cern.ch/d", "", "other");
+
+    coalescer.update(ops, 100);
+    auto requests = coalescer.release(100);
+
+    // Split by storage and credential, then by size
+    BOOST_CHECK_EQUAL(requests.size(), 4);
+    BOOST_CHECK_EQUAL(coalescer.size(), 0);
+
+    StagingCoalescer::Metrics metrics = coalescer.getMetrics();
+    BOOST_CHECK_EQUAL(metrics.requests, 4);
+    BOOST_CHECK_EQUAL(metrics.files, 5);
+    BOOST_CHECK_EQUAL(metrics.maxRequestSize, 2);
+    BOOST_CHECK_EQUAL(coalescer.getMetrics().requests, 0);
+}
+
+
+BOOST_FIXTURE_TEST_CASE (window, StagingCoalescerFixture)
+{
+    StagingCoalescer coalescer(300, 4, 10);
+
+    addOp(1, "srm://tape.cern.ch/a");
+    coalescer.update(ops, 100);
+    BOOST_CHECK(coalescer.release(100).empty());
+
+    // Refetched, with one more. The first one keeps its arrival time.
+    addOp(2, "srm://tape.cern.ch/b");
+    coalescer.update(ops, 160);
+    BOOST_CHECK(coalescer.release(160).empty());
+    BOOST_CHECK_EQUAL(coalescer.size(), 2);
+
+    // Cancelled meanwhile, so not fetched again
+    ops.erase(ops.begin());
+    coalescer.update(ops, 400);
+    BOOST_CHECK_EQUAL(coalescer.size(), 1);
+    BOOST_CHECK(coalescer.release(400).empty());
+
+    auto requests = coalescer.release(460);
+    BOOST_REQUIRE_EQUAL(requests.size(), 1);
+    BOOST_CHECK_EQUAL(requests[0][0].fileId, 2);
+    BOOST_CHECK_EQUAL(coalescer.getMetrics().totalHoldTime, 300);
+}
+
+
+BOOST_FIXTURE_TEST_CASE (missingFromFetch, StagingCoalescerFixture)
+{
+    StagingCoalescer coalescer(300, 4, 10);
+
+    addOp(1, "srm://tape.cern.ch/a");
+    addOp(2, "srm://tape.cern.ch/b");
+    coalescer.update(ops, 100);
+    BOOST_CHECK(coalescer.release(100).empty());
+
+    // Beyond the fetch limit on this pass
+    coalescer.update({ops[1]}, 160);
+    BOOST_CHECK_EQUAL(coalescer.size(), 1);
+    BOOST_CHECK(coalescer.release(160).empty());
+
+    // Back, with the time it first arrived
+    coalescer.update(ops, 220);
+    BOOST_CHECK(coalescer.release(220).empty());
+    auto requests = coalescer.release(400);
+    BOOST_REQUIRE_EQUAL(requests.size(), 1);
+    BOOST_CHECK_EQUAL(requests[0].size(), 2);
+    BOOST_CHECK_EQUAL(coalescer.getMetrics().totalHoldTime, 600);
+
+    // Gone for longer than the window, starts over
+    coalescer.update(ops, 500);
+    coalescer.update({}, 900);
+    coalescer.update(ops, 910);
+    BOOST_CHECK(coalescer.release(1000).empty());
+    BOOST_CHECK_EQUAL(coalescer.release(1210).size(), 1);
+}
+
+
+BOOST_FIXTURE_TEST_CASE (targetSize, StagingCoalescerFixture)
+{
+    StagingCoalescer coalescer(300, 3, 10);
+
+    addOp(1, "srm://tape.cern.ch/a");
+    addOp(2, "srm://tape.cern.ch/b");
+    addOp(3, "srm://other.cern.ch/a");
+    coalescer.update(ops, 100);
+    BOOST_CHECK(coalescer.release(100).empty());
+
+    addOp(4, "srm://tape.cern.ch/c");
+    coalescer.update(ops, 110);
+    auto requests = coalescer.release(110);
+    BOOST_REQUIRE_EQUAL(requests.size(), 1);
+    BOOST_CHECK_EQUAL(requests[0].size(), 3);
+    BOOST_CHECK_EQUAL(coalescer.size(), 1);
+}
+
+
+BOOST_FIXTURE_TEST_CASE (locality, StagingCoalescerFixture)
+{
+    StagingCoalescer coalescer(0, 0, 2, StagingCoalescer::getLocalityKey("metadata:tape"));
+
+    addOp(1, "srm://tape.cern.ch/a", "{\"tape\": \"T2\"}");
+    addOp(2, "srm://tape.cern.ch/b", "{\"tape\": \"T1\"}");
+    addOp(3, "srm://tape.cern.ch/c", "{\"tape\": \"T2\"}");
+    addOp(4, "srm://tape.cern.ch/d", "{\"tape\": \"T1\"}");
+    coalescer.update(ops, 100);
+
+    auto requests = coalescer.release(100);
+    BOOST_REQUIRE_EQUAL(requests.size(), 2);
+    BOOST_CHECK_EQUAL(requests[0][0].fileId, 2);
+    BOOST_CHECK_EQUAL(requests[0][1].fileId, 4);
+    BOOST_CHECK_EQUAL(requests[1][0].fileId, 1);
+    BOOST_CHECK_EQUAL(requests[1][1].fileId, 3);
+
+    BOOST_CHECK(!StagingCoalescer::getLocalityKey("none"));
+    BOOST_CHECK(StagingCoalescer::getLocalityKey("surl"));
+    BOOST_CHECK_THROW(StagingCoalescer::getLocalityKey("tape"), fts3::common::UserError);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -46,6 +46,7 @@ typedef std::list<OptimizerEntry> OptimizerRegister;
 
 
 struct MockTransfer {
+    uint64_t fileId;
     time_t start, end;
     std::string state;
     uint64_t filesize;
@@ -53,9 +54,9 @@ struct MockTransfer {
     bool recoverable;
     int numRetries;
 
-    MockTransfer(time_t start, time_t end, const std::string &state,
+    MockTransfer(uint64_t fileId, time_t start, time_t end, const std::string &state,
         uint64_t filesize, double throughput, bool recoverable):
-        start(start), end(end), state(state), filesize(filesize), throughput(throughput), recoverable(recoverable),
+        fileId(fileId), start(start), end(end), state(state), filesize(filesize), throughput(throughput), recoverable(recoverable),
         numRetries(0) {
     }
 };
@@ -67,6 +68,7 @@ protected:
     std::map<Pair, int> streamsRegistry;
     std::map<Pair, TransferList> transferStore;
     OptimizerMode mockOptimizerMode;
+    uint64_t nextFileId;
 
     void populateTransfers(const Pair &pair, const std::string &state, int count,
         bool recoverable = false, double thr = 10, uint64_t filesize = 1024) {
@@ -81,7 +83,7 @@ protected:
                 start = time(NULL) - count - 60;
             }
 
-            transfers.emplace_back(start, end, state, filesize, thr, recoverable);
+            transfers.emplace_back(++nextFileId, start, end, state, filesize, thr, recoverable);
         }
     }
 
@@ -110,7 +112,7 @@ protected:
     }
 
 public:
-    BaseOptimizerFixture(): Optimizer(this, NULL) {
+    BaseOptimizerFixture(): Optimizer(this, NULL), nextFileId(0) {
         mockOptimizerMode = kOptimizerDisabled;
     }
 
@@ -307,6 +309,40 @@ public:
     void storeOptimizerStreams(const Pair &pair, int streams) {
         streamsRegistry[pair] = streams;
     }
+
+    void getPairsData(std::map<Pair, PairData> *pairs) {
+        std::list<Pair> active = getActivePairs();
+        for (auto i = active.begin(); i != active.end(); ++i) {
+            getPairData(*i, &(*pairs)[*i]);
+        }
+    }
+
+    void getTerminatedSince(time_t since, std::vector<TerminatedTransfer> *terminated) {
+        for (auto i = transferStore.begin(); i != transferStore.end(); ++i) {
+            for (auto j = i->second.begin(); j != i->second.end(); ++j) {
+                if (j->state == "SUBMITTED" || j->state == "ACTIVE" || j->end < since) {
+                    continue;
+                }
+                TerminatedTransfer transfer(j->fileId, i->first, j->state);
+                transfer.start = j->start;
+                transfer.end = j->end;
+                transfer.filesize = j->filesize;
+                transfer.txDuration = j->end - j->start;
+                transfer.recoverable = j->recoverable;
+                terminated->push_back(transfer);
+            }
+        }
+    }
+
+    void storeOptimizerDecisions(const std::map<Pair, PairDecision> &decisions) {
+        for (auto i = decisions.begin(); i != decisions.end(); ++i) {
+            if (i->second.store) {
+                storeOptimizerDecision(i->first, i->second.decision, i->second.current,
+                    i->second.diff, i->second.rationale);
+                storeOptimizerStreams(i->first, i->second.streams);
+            }
+        }
+    }
 };
 
 
@@ -611,6 +647,28 @@ BOOST_FIXTURE_TEST_CASE (optimizerMaxStreams, BaseOptimizerFixture)
     BOOST_CHECK_LE(streamsRegistry[pair], maxNumberOfStreams);
 }
 
+// A full run over many pairs, split between several workers
+BOOST_FIXTURE_TEST_CASE (optimizerRunSharded, BaseOptimizerFixture)
+{
+    std::vector<Pair> pairs;
+    for (int i = 0; i < 20; ++i) {
+        pairs.emplace_back("mock://source" + std::to_string(i) + ".cern.ch", "mock://dcache.desy.de");
+        populateTransfers(pairs.back(), "FINISHED", 10, false, 100, 1024*1024);
+        populateTransfers(pairs.back(), "SUBMITTED", 10);
+    }
+
+    setWorkers(4);
+    run();
+
+    for (auto i = pairs.begin(); i != pairs.end(); ++i) {
+        auto lastEntry = getLastEntry(*i);
+        BOOST_REQUIRE(lastEntry != NULL);
+        BOOST_CHECK_EQUAL(lastEntry->rationale, "No information. Start halfway.");
+        BOOST_CHECK_EQUAL(streamsRegistry[*i], 1);
+        BOOST_CHECK(inMemoryStore.find(*i) != inMemoryStore.end());
+    }
+}
+
 // NOTE: I am not sure it is worth to add more tests. At the end, we will basically be
 //       writing tests that set the parameters to fit the implementation at the time.
 //       They do not prove that the optimizer optimizes.
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include "server/services/optimizer/PairStatistics.h"
+
+using namespace fts3::optimizer;
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(PairStatisticsTestSuite)
+
+
+static const Pair pair("mock://dpm.cern.ch", "mock://dcache.desy.de");
+// Aligned to the bucket width
+static const time_t now = 1700000010;
+
+
+/// Statistics of a single pair, fed with transfers terminated around now
+struct PairStatisticsFixture {
+    PairStatistics statistics;
+    PairState state;
+    std::vector<TerminatedTransfer> terminated;
+
+    /// The transfer is given to the statistics on the next call to feed
+    TerminatedTransfer &addTransfer(uint64_t fileId, const std::string &fileState, time_t start, time_t end,
+        int64_t filesize = 0) {
+        terminated.emplace_back(fileId, pair, fileState);
+        terminated.back().start = start;
+        terminated.back().end = end;
+        terminated.back().filesize = filesize;
+        terminated.back().txDuration = end - start;
+        return terminated.back();
+    }
+
+    void feed() {
+        for (auto i = terminated.begin(); i != terminated.end(); ++i) {
+            statistics.add(*i);
+        }
+        terminated.clear();
+    }
+
+    void getState(time_t at, const std::vector<RunningTransfer> &running = std::vector<RunningTransfer>()) {
+        feed();
+        statistics.getState(pair, running, at, &state);
+    }
+};
+
+
+// No information at all
+BOOST_FIXTURE_TEST_CASE (empty, PairStatisticsFixture)
+{
+    getState(now);
+
+    BOOST_CHECK_EQUAL(state.throughput, 0);
+    BOOST_CHECK_EQUAL(state.avgDuration, 0);
+    BOOST_CHECK_EQUAL(state.successRate, 100);
+    BOOST_CHECK_EQUAL(state.filesizeAvg, 0);
+    BOOST_CHECK_EQUAL(state.retryCount, 0);
+}
+
+
+// Success rate, average duration and file size statistics of the terminated transfers
+BOOST_FIXTURE_TEST_CASE (terminated, PairStatisticsFixture)
+{
+    addTransfer(1, "FINISHED", now - 120, now - 60, 1000);
+    addTransfer(2, "FINISHED", now - 120, now - 60, 3000);
+    addTransfer(3, "FINISHED", now - 120, now - 60, 2000);
+    addTransfer(4, "FAILED", now - 120, now - 60).recoverable = true;
+    // Non recoverable failures do not count
+    addTransfer(5, "FAILED", now - 120, now - 60);
+
+    getState(now);
+
+    BOOST_CHECK_EQUAL(state.avgDuration, 60);
+    BOOST_CHECK_EQUAL(state.successRate, 75);
+    BOOST_CHECK_CLOSE(state.filesizeAvg, 2000, 0.001);
+    BOOST_CHECK_CLOSE(state.filesizeStdDev, 816.4966, 0.001);
+    // 6000 bytes over the 15 minutes window
+    BOOST_CHECK_CLOSE(state.throughput, 6000.0 / 900, 0.001);
+}
+
+
+// The same transfer retrieved twice must only be counted once
+BOOST_FIXTURE_TEST_CASE (duplicates, PairStatisticsFixture)
+{
+    addTransfer(1, "FINISHED", now - 120, now - 60, 1000);
+    addTransfer(1, "FINISHED", now - 120, now - 60, 1000);
+
+    getState(now);
+    BOOST_CHECK_CLOSE(state.throughput, 1000.0 / 900, 0.001);
+}
+
+
+// Only the part of a transfer that happened within the window counts for the throughput
+BOOST_FIXTURE_TEST_CASE (throughputWindow, PairStatisticsFixture)
+{
+    // Short transfers make the window 5 minutes
+    addTransfer(1, "FINISHED", now - 20, now - 10, 1000);
+    // Half of it happened before the window
+    addTransfer(2, "FINISHED", now - 600, now, 6000).txDuration = 10;
+
+    // Same for the running one
+    std::vector<RunningTransfer> running(1);
+    running[0].start = now - 600;
+    running[0].transferred = 6000;
+
+    getState(now, running);
+    BOOST_CHECK_EQUAL(state.avgDuration, 10);
+    BOOST_CHECK_CLOSE(state.throughput, (1000.0 + 3000 + 3000) / 300, 0.001);
+}
+
+
+// Old transfers are forgotten
+BOOST_FIXTURE_TEST_CASE (expire, PairStatisticsFixture)
+{
+    addTransfer(1, "FINISHED", now - 120, now - 60, 1000);
+    feed();
+    BOOST_CHECK_EQUAL(statistics.getScanStart(now), now - 60 - 120);
+
+    const time_t later = now + 3600;
+    statistics.expire(later);
+    getState(later);
+
+    BOOST_CHECK_EQUAL(state.throughput, 0);
+    BOOST_CHECK_EQUAL(state.successRate, 100);
+    BOOST_CHECK_EQUAL(statistics.getScanStart(later), later - 1800);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include "config/ServerConfig.h"
+#include "server/services/transfers/MessageProcessingService.h"
+
+#include "MockDb.h"
+
+using namespace fts3::server;
+using fts3::config::ServerConfig;
+
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(MessageProcessingServiceTestSuite)
+
+
+/// Configuration and database the service is built with
+struct MessageProcessingSetup {
+    MockDb mockDb;
+    boost::filesystem::path msgDir;
+
+    MessageProcessingSetup() {
+        msgDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("messages-%%%%%%");
+        const std::string msgDirOption = "--MessagingDirectory=" + msgDir.string();
+
+        std::vector<const char*> argv{
+            "executable", "--configfile=/dev/null", "--SiteName", "required", "--MonitoringMessaging=false",
+            msgDirOption.c_str()
+        };
+        ServerConfig::instance().read(argv.size(), (char**)argv.data());
+    }
+
+    ~MessageProcessingSetup() {
+        boost::filesystem::remove_all(msgDir);
+    }
+};
+
+
+/// Applies status messages to MockDb
+struct MessageProcessingFixture: public MessageProcessingSetup, public MessageProcessingService {
+    std::vector<fts3::events::Message> batch;
+
+    MessageProcessingFixture(): MessageProcessingService(&mockDb) {
+    }
+
+    void addMessage(const std::string &jobId, uint64_t fileId, const std::string &state) {
+        batch.emplace_back();
+        batch.back().set_job_id(jobId);
+        batch.back().set_file_id(fileId);
+        batch.back().set_transfer_status(state);
+    }
+};
+
+
+/**
+ * Terminal messages are applied in a single call, after the others
+ */
+BOOST_FIXTURE_TEST_CASE (bulk, MessageProcessingFixture)
+{
+    addMessage("job-a", 1, "FINISHED");
+    addMessage("job-a", 2, "ACTIVE");
+    addMessage("job-b", 3, "FAILED");
+    handleOtherMessages(batch);
+
+    BOOST_REQUIRE_EQUAL(mockDb.bulkUpdates.size(), 1);
+    BOOST_CHECK_EQUAL(mockDb.bulkUpdates[0], 2);
+
+    BOOST_REQUIRE_EQUAL(mockDb.transferStates.size(), 3);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[0].first, 2);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[1].first, 1);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[2].first, 3);
+
+    // Only the message that went on its own updated its job
+    BOOST_REQUIRE_EQUAL(mockDb.jobStates.size(), 1);
+    BOOST_CHECK_EQUAL(mockDb.jobStates[0].second, "ACTIVE");
+}
+
+/**
+ * A file reported twice in the same batch is applied in bulk once, and then on its own
+ */
+BOOST_FIXTURE_TEST_CASE (duplicates, MessageProcessingFixture)
+{
+    addMessage("job-a", 1, "FAILED");
+    addMessage("job-a", 1, "FINISHED");
+    handleOtherMessages(batch);
+
+    BOOST_REQUIRE_EQUAL(mockDb.bulkUpdates.size(), 1);
+    BOOST_REQUIRE_EQUAL(mockDb.transferStates.size(), 2);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[0].second, "FAILED");
+    BOOST_CHECK_EQUAL(mockDb.transferStates[1].second, "FINISHED");
+    BOOST_REQUIRE_EQUAL(mockDb.jobStates.size(), 1);
+    BOOST_CHECK_EQUAL(mockDb.jobStates[0].second, "FINISHED");
+}
+
+/**
+ * Messages the database did not apply, like those of multihop or archiving jobs, go one by one
+ */
+BOOST_FIXTURE_TEST_CASE (notApplied, MessageProcessingFixture)
+{
+    mockDb.notApplied.insert(2);
+    addMessage("job-a", 1, "FINISHED");
+    addMessage("job-b", 2, "FINISHED");
+    handleOtherMessages(batch);
+
+    BOOST_REQUIRE_EQUAL(mockDb.transferStates.size(), 2);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[0].first, 1);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[1].first, 2);
+    BOOST_REQUIRE_EQUAL(mockDb.jobStates.size(), 1);
+    BOOST_CHECK_EQUAL(mockDb.jobStates[0].first, "job-b");
+}
+
+/**
+ * If the batch fails as a whole, every message is applied on its own
+ */
+BOOST_FIXTURE_TEST_CASE (bulkFailure, MessageProcessingFixture)
+{
+    mockDb.bulkFails = true;
+    addMessage("job-a", 1, "FINISHED");
+    addMessage("job-a", 2, "CANCELED");
+    handleOtherMessages(batch);
+
+    BOOST_CHECK_EQUAL(mockDb.bulkUpdates.size(), 1);
+    BOOST_REQUIRE_EQUAL(mockDb.transferStates.size(), 2);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[0].first, 1);
+    BOOST_CHECK_EQUAL(mockDb.transferStates[1].first, 2);
+    BOOST_CHECK_EQUAL(mockDb.jobStates.size(), 2);
+}
+
+/**
+ * With the batching disabled, every message is applied on its own
+ */
+BOOST_FIXTURE_TEST_CASE (disabled, MessageProcessingFixture)
+{
+    batchStatusUpdates = false;
+    addMessage("job-a", 1, "FINISHED");
+    addMessage("job-a", 2, "FINISHED");
+    handleOtherMessages(batch);
+
+    BOOST_CHECK(mockDb.bulkUpdates.empty());
+    BOOST_CHECK_EQUAL(mockDb.transferStates.size(), 2);
+    BOOST_CHECK_EQUAL(mockDb.jobStates.size(), 2);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef MOCKDB_H
+#define MOCKDB_H
+
+#include "common/Exceptions.h"
+#include "db/generic/GenericDbIfce.h"
+#include "db/generic/StatusUpdateBatch.h"
+
+
+/// Database that records the calls done by the transfer services
+/// Only the methods they use do something, the rest return an empty value
+class MockDb: public GenericDbIfce
+{
+public:
+    /// Transfers claimTransfers reports as picked by another node
+    std::set<uint64_t> taken;
+    /// Transfers updateTransferStatuses leaves to be applied on their own, as for jobs that can not be updated in bulk
+    std::set<uint64_t> notApplied;
+    /// If true, updateTransferStatuses throws
+    bool bulkFails;
+
+    /// File ids of each call to claimTransfers
+    std::vector<std::vector<uint64_t>> claimBatches;
+    /// Pids written back, by file id
+    std::map<uint64_t, int> pids;
+    /// Transfer states set with updateTransferStatus, in order
+    std::vector<std::pair<uint64_t, std::string>> transferStates;
+    /// Job states set with updateJobStatus, in order
+    std::vector<std::pair<std::string, std::string>> jobStates;
+    /// Number of messages of each call to updateTransferStatuses
+    std::vector<size_t> bulkUpdates;
+    /// Number of times a link configuration has been queried
+    int linkQueries;
+
+    MockDb(): bulkFails(false), linkQueries(0)
+    {
+    }
+
+    void claimTransfers(const std::vector<fts3::events::Message>& transfers, std::map<uint64_t, int>& claimed)
+    {
+        std::vector<uint64_t> batch;
+        for (auto i = transfers.begin(); i != transfers.end(); ++i) {
+            batch.push_back(i->file_id());
+            if (taken.count(i->file_id()) == 0) {
+                claimed[i->file_id()] = 0;
+            }
+        }
+        claimBatches.push_back(batch);
+    }
+
+    void setTransfersPid(const std::vector<fts3::events::MessageUpdater>& transfers)
+    {
+        for (auto i = transfers.begin(); i != transfers.end(); ++i) {
+            pids[i->file_id()] = i->process_id();
+        }
+    }
+
+    boost::tuple<bool, std::string> updateTransferStatus(const std::string& jobId, uint64_t fileId,
+        double throughput, const std::string& transferState, const std::string& errorReason,
+        int processId, double filesize, double duration, bool retry, std::string fileMetadata)
+    {
+        transferStates.push_back(std::make_pair(fileId, transferState));
+        return boost::make_tuple(true, transferState);
+    }
+
+    bool updateJobStatus(const std::string& jobId, const std::string& jobState)
+    {
+        jobStates.push_back(std::make_pair(jobId, jobState));
+        return true;
+    }
+
+    void updateTransferStatuses(const std::vector<fts3::events::Message>& messages,
+        std::vector<StatusUpdateResult>& results)
+    {
+        bulkUpdates.push_back(messages.size());
+        if (bulkFails) {
+            throw fts3::common::SystemError("Deadlock found when trying to get lock");
+        }
+        results.assign(messages.size(), StatusUpdateResult());
+
+        // Same grouping as the backends, so duplicates are left out the same way
+        std::vector<uint64_t> fileIds;
+        std::map<std::string, std::vector<size_t>> byJob = groupTerminalStatuses(messages, fileIds);
+        std::set<size_t> grouped;
+        for (auto job = byJob.begin(); job != byJob.end(); ++job) {
+            grouped.insert(job->second.begin(), job->second.end());
+        }
+
+        for (auto i = grouped.begin(); i != grouped.end(); ++i) {
+            const fts3::events::Message &msg = messages[*i];
+            if (notApplied.count(msg.file_id()) == 0) {
+                results[*i].applied = true;
+                results[*i].updated = true;
+                results[*i].storedState = "ACTIVE";
+                transferStates.push_back(std::make_pair(msg.file_id(), msg.transfer_status()));
+            }
+        }
+    }
+
+    bool isTrAllowed(const std::string& sourceStorage, const std::string& destStorage,
+        int &currentActive, int &maxActive)
+    {
+        ++linkQueries;
+        currentActive = 0;
+        maxActive = 100;
+        return true;
+    }
+
+    void init(const std::string& username, const std::string& password,
+        const std::string& connectString, int nPooledConnections) {}
+    std::list<fts3::events::MessageUpdater> getActiveInHost(const std::string &host)
+        { return std::list<fts3::events::MessageUpdater>(); }
+    void getReadySessionReuseTransfers(const std::vector<QueueId>& queues, std::map< std::string,
+        std::queue< std::pair<std::string, std::list<TransferFile>>>>& files) {}
+    void getReadyTransfers(const std::vector<QueueId>& queues, std::map< std::string,
+        std::list<TransferFile>>& files) {}
+    boost::optional<UserCredential> findCredential(const std::string& delegationId, const std::string& userDn)
+        { return boost::optional<UserCredential>(); }
+    bool isCredentialExpired(const std::string& delegationId, const std::string &userDn) { return false; }
+    unsigned getDebugLevel(const std::string& sourceStorage, const std::string& destStorage) { return 0; }
+    fts3::optimizer::OptimizerDataSource* getOptimizerDataSource() { return NULL; }
+    bool terminateReuseProcess(const std::string & jobId, int pid, const std::string & message, bool force)
+        { return false; }
+    void reapStalledTransfers(std::vector<TransferFile>& transfers) {}
+    void setPidForJob(const std::string& jobId, int pid) {}
+    void backup(int intervalDays, long bulkSize, long* nJobs, long* nFiles, long* nDeletions) {}
+    void forkFailed(const std::string& jobId) {}
+    std::unique_ptr<LinkConfig> getLinkConfig(const std::string &source, const std::string &destination)
+        { return std::unique_ptr<LinkConfig>(); }
+    std::vector<ShareConfig> getShareConfig(const std::string &source, const std::string &destination)
+        { return std::vector<ShareConfig>(); }
+    int getRetry(const std::string & jobId) { return 0; }
+    int getRetryTimes(const std::string & jobId, uint64_t fileId) { return 0; }
+    void setToFailOldQueuedJobs(std::vector<std::string>& jobs) {}
+    void updateProtocol(const std::vector<fts3::events::Message>& messages) {}
+    void updateProtocol(const fts3::events::Message& message) {}
+    std::vector<TransferState> getStateOfTransfer(const std::string& jobId, uint64_t fileId)
+        { return std::vector<TransferState>(); }
+    void checkSanityState() {}
+    void multihopSanitySate() {}
+    void setRetryTransfer(const std::string & jobId, uint64_t fileId, int retry,
+        const std::string& reason, int errcode) {}
+    void updateFileTransferProgressVector(const std::vector<fts3::events::MessageUpdater> &messages) {}
+    void transferLogFileVector(std::map<int, fts3::events::MessageLog>& messagesLog) {}
+    unsigned int updateFileStatusReuse(const TransferFile &file, const std::string &status) { return 0; }
+    void getCancelJob(std::vector<std::pair<int, uint64_t>>& canceled) {}
+    std::list<TransferFile> getForceStartTransfers() { return std::list<TransferFile>(); }
+    bool getDrain() { return false; }
+    boost::tribool isProtocolUDT(const std::string &sourceSe, const std::string &destSe)
+        { return boost::indeterminate; }
+    boost::tribool isProtocolIPv6(const std::string &sourceSe, const std::string &destSe)
+        { return boost::indeterminate; }
+    boost::tribool getEvictionFlag(const std::string &source) { return boost::indeterminate; }
+    int getStreamsOptimization(const std::string &sourceSe, const std::string &destSe) { return 0; }
+    bool getDisableDelegationFlag(const std::string &sourceSe, const std::string &destSe) { return false; }
+    std::string getThirdPartyTURL(const std::string &sourceSe, const std::string &destSE)
+        { return std::string(); }
+    int getGlobalTimeout(const std::string &voName) { return 0; }
+    int getSecPerMb(const std::string &voName) { return 0; }
+    bool getDisableStreamingFlag(const std::string &voName) { return false; }
+    void getQueuesWithPending(std::vector<QueueId>& queues) {}
+    void getQueuesWithSessionReusePending(std::vector<QueueId>& queues) {}
+    uint64_t getQueueCounters(std::vector<QueueCounters>& counters) { return 0; }
+    void getQueueChangesSince(uint64_t afterChangeId, std::vector<QueueChange>& changes) {}
+    void purgeQueueChanges(int olderThan) {}
+    void updateDeletionsState(const std::vector<MinFileStatus>& delOpsStatus) {}
+    void getFilesForDeletion(std::vector<DeleteOperation>& delOps) {}
+    void requeueStartedDeletes() {}
+    void updateStagingState(const std::vector<MinFileStatus>& stagingOpStatus) {}
+    void updateArchivingState(const std::vector<MinFileStatus>& archivingOpStatus) {}
+    void setArchivingStartTime(const std::map< std::string, std::map<std::string,
+        std::vector<uint64_t> > > &jobs) {}
+    void updateBringOnlineToken(const std::map< std::string, std::map<std::string,
+        std::vector<uint64_t> > > &jobs, const std::string &token) {}
+    void getFilesForStaging(std::vector<StagingOperation> &stagingOps) {}
+    void getFilesForArchiving(std::vector<ArchivingOperation> &archivingOps) {}
+    void getFilesForQosTransition(std::vector<QosTransitionOperation> &qosTranstionOps,
+        const std::string &qosOp, bool matchHost) {}
+    bool updateFileStateToQosRequestSubmitted(const std::string& jobId, uint64_t fileId) { return false; }
+    void updateFileStateToQosTerminal(const std::string& jobId, uint64_t fileId,
+        const std::string& fileState, const std::string& reason) {}
+    void getAlreadyStartedStaging(std::vector<StagingOperation> &stagingOps) {}
+    void getAlreadyStartedArchiving(std::vector<ArchivingOperation> &archivingOps) {}
+    void getStagingFilesForCanceling(std::set< std::pair<std::string, std::string> >& files) {}
+    void getArchivingFilesForCanceling(std::set< std::pair<std::string, std::string> >& files) {}
+    bool getCloudStorageCredentials(const std::string& userDn, const std::string& voName,
+        const std::string& cloudName, CloudStorageAuth& auth) { return false; }
+    bool publishUserDn(const std::string &vo) { return false; }
+    StorageConfig getStorageConfig(const std::string &storage) { return StorageConfig(); }
+};
+
+#endif // MOCKDB_H
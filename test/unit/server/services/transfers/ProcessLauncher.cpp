@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "server/services/transfers/ExecuteProcess.h"
+#include "server/services/transfers/ProcessLauncher.h"
+
+using namespace fts3::server;
+
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(ProcessLauncherTestSuite)
+
+
+BOOST_AUTO_TEST_CASE (spawn)
+{
+    ProcessLauncher &launcher = ProcessLauncher::instance();
+    launcher.start();
+    BOOST_CHECK(launcher.isRunning());
+
+    int error = 0;
+    pid_t pid = launcher.spawn("true", std::vector<std::string>(), &error);
+    BOOST_CHECK_EQUAL(error, 0);
+    BOOST_CHECK_GT(pid, 0);
+
+    // Arguments are sent one by one, so they can have spaces
+    std::vector<std::string> args;
+    args.push_back("-c");
+    args.push_back("test \"$0\" = 'a b'");
+    args.push_back("a b");
+    pid = launcher.spawn("sh", args, &error);
+    BOOST_CHECK_EQUAL(error, 0);
+    BOOST_CHECK_GT(pid, 0);
+
+    pid = launcher.spawn("/does/not/exist", std::vector<std::string>(), &error);
+    BOOST_CHECK_EQUAL(pid, -1);
+    BOOST_CHECK_EQUAL(error, ENOENT);
+
+    launcher.stop();
+}
+
+
+BOOST_AUTO_TEST_CASE (async)
+{
+    ProcessLauncher &launcher = ProcessLauncher::instance();
+    launcher.start();
+
+    const int count = 20;
+    boost::mutex mutex;
+    boost::condition_variable cv;
+    int replies = 0, spawned = 0;
+
+    for (int i = 0; i < count; ++i) {
+        launcher.spawnAsync("true", std::vector<std::string>(), [&](pid_t pid, int error) {
+            boost::mutex::scoped_lock lock(mutex);
+            ++replies;
+            if (pid > 0 && error == 0) {
+                ++spawned;
+            }
+            cv.notify_all();
+        });
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    while (replies < count) {
+        cv.wait(lock);
+    }
+    BOOST_CHECK_EQUAL(spawned, count);
+    lock.unlock();
+
+    launcher.stop();
+}
+
+
+BOOST_AUTO_TEST_CASE (stopped)
+{
+    ProcessLauncher &launcher = ProcessLauncher::instance();
+    launcher.start();
+    launcher.stop();
+    BOOST_CHECK(!launcher.isRunning());
+
+    int error = 0;
+    pid_t pid = launcher.spawn("true", std::vector<std::string>(), &error);
+    BOOST_CHECK_EQUAL(pid, -1);
+    BOOST_CHECK_EQUAL(error, ESRCH);
+
+    // Can be started again
+    launcher.start();
+    pid = launcher.spawn("true", std::vector<std::string>(), &error);
+    BOOST_CHECK_GT(pid, 0);
+    launcher.stop();
+}
+
+
+/// Average milliseconds to launch a process with ExecuteProcess
+static double averageLaunchTime(int count)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        std::string message;
+        ExecuteProcess process("true", std::vector<std::string>());
+        BOOST_REQUIRE_EQUAL(process.executeProcessShell(message), 0);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+
+/**
+ * Launch latency, forking this process or going through the launcher
+ * The heap is grown first, since the cost of forking grows with it
+ */
+BOOST_AUTO_TEST_CASE (launchLatency)
+{
+    const int count = 100;
+    const size_t heapSize = 256 * 1024 * 1024;
+
+    ProcessLauncher &launcher = ProcessLauncher::instance();
+    launcher.start();
+
+    std::vector<char> heap(heapSize);
+    memset(heap.data(), 1, heap.size());
+
+    double viaLauncher = averageLaunchTime(count);
+    launcher.stop();
+    double viaFork = averageLaunchTime(count);
+
+    BOOST_TEST_MESSAGE("Launch latency with a " << (heapSize >> 20) << " MiB heap: fork "
+        << viaFork << " ms, launcher " << viaLauncher << " ms");
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
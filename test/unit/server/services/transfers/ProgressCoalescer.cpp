@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include "server/services/transfers/ProgressCoalescer.h"
+
+using namespace fts3::server;
+using fts3::events::MessageUpdater;
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(ProgressCoalescerTestSuite)
+
+
+/// Coalescer fed with the progress of a single job
+struct ProgressCoalescerFixture {
+    ProgressCoalescer coalescer;
+    std::vector<MessageUpdater> batch;
+
+    void addProgress(uint64_t fileId, uint64_t timestamp, uint64_t transferred,
+        const std::string &state = "ACTIVE") {
+        MessageUpdater msg;
+        msg.set_job_id("1906cc40-b915-11e5-9a03-02163e006dd0");
+        msg.set_file_id(fileId);
+        msg.set_transfer_status(state);
+        msg.set_timestamp(timestamp);
+        msg.set_throughput(10.0);
+        msg.set_transferred(transferred);
+        msg.set_process_id(1234);
+        coalescer.add(msg);
+    }
+};
+
+/**
+ * Only the latest progress of each transfer is kept
+ */
+BOOST_FIXTURE_TEST_CASE (TestCoalesce, ProgressCoalescerFixture)
+{
+    addProgress(1, 100, 10);
+    addProgress(1, 300, 30);
+    // Arrives late, but it is older
+    addProgress(1, 200, 20);
+    addProgress(2, 100, 5);
+    // Not progress of a running transfer
+    addProgress(3, 100, 5, "FINISHED");
+
+    BOOST_CHECK(coalescer.collect(batch, time(NULL), 1000, 60, true));
+    BOOST_CHECK_EQUAL(2, batch.size());
+    BOOST_CHECK_EQUAL(1, batch[0].file_id());
+    BOOST_CHECK_EQUAL(30, batch[0].transferred());
+    BOOST_CHECK_EQUAL(2, batch[1].file_id());
+
+    ProgressMetrics metrics = coalescer.getMetrics();
+    BOOST_CHECK_EQUAL(4, metrics.received);
+    BOOST_CHECK_EQUAL(2, metrics.written);
+    BOOST_CHECK_CLOSE(metrics.getCoalescingRatio(), 2.0, 0.001);
+
+    // Nothing left
+    batch.clear();
+    BOOST_CHECK(!coalescer.collect(batch, time(NULL), 1000, 60, true));
+    BOOST_CHECK(batch.empty());
+}
+
+/**
+ * Pending progress is only released once the size or time thresholds are reached
+ */
+BOOST_FIXTURE_TEST_CASE (TestThresholds, ProgressCoalescerFixture)
+{
+    const time_t now = time(NULL);
+
+    addProgress(1, 100, 10);
+    addProgress(2, 100, 10);
+    BOOST_CHECK(!coalescer.collect(batch, now, 3, 60));
+
+    // Size
+    addProgress(3, 100, 10);
+    BOOST_CHECK(coalescer.collect(batch, now, 3, 60));
+    BOOST_CHECK_EQUAL(3, batch.size());
+
+    // Time
+    batch.clear();
+    addProgress(4, 100, 10);
+    BOOST_CHECK(!coalescer.collect(batch, now, 3, 60));
+    BOOST_CHECK(coalescer.collect(batch, now + 61, 3, 60));
+    BOOST_CHECK_EQUAL(1, batch.size());
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+
+#include "server/services/transfers/QueueIndex.h"
+
+using namespace fts3::server;
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(QueueIndexTestSuite)
+
+
+static std::vector<QueueId> getPending(QueueIndex &index)
+{
+    std::vector<QueueId> pending;
+    index.getQueuesWithPending(pending);
+    return pending;
+}
+
+/**
+ * Queues are loaded from the counters, only the ones with submitted transfers are pending
+ */
+BOOST_AUTO_TEST_CASE (TestReload)
+{
+    QueueIndex index;
+    std::vector<QueueCounters> counters{
+        {"mock://a", "mock://b", "dteam", 10, 2},
+        {"mock://a", "mock://c", "dteam", 0, 5},
+    };
+    index.reload(counters, 100, time(NULL));
+
+    std::vector<QueueId> pending = getPending(index);
+    BOOST_CHECK_EQUAL(1, pending.size());
+    BOOST_CHECK_EQUAL("mock://a", pending[0].sourceSe);
+    BOOST_CHECK_EQUAL("mock://b", pending[0].destSe);
+    BOOST_CHECK_EQUAL("dteam", pending[0].voName);
+    BOOST_CHECK_EQUAL(2, pending[0].activeCount);
+    BOOST_CHECK_EQUAL(100, index.getLastChangeId());
+}
+
+/**
+ * Changes read from the log are added on top of the existing counters
+ */
+BOOST_AUTO_TEST_CASE (TestAddChanges)
+{
+    const time_t now = time(NULL);
+    QueueIndex index;
+    index.reload({{"mock://a", "mock://b", "dteam", 0, 1}}, 100, now);
+    BOOST_CHECK(getPending(index).empty());
+
+    index.addChanges({
+        {101, "mock://a", "mock://b", "dteam"},
+        {102, "mock://a", "mock://b", "atlas"},
+    }, now);
+
+    std::vector<QueueId> pending = getPending(index);
+    BOOST_CHECK_EQUAL(2, pending.size());
+    BOOST_CHECK_EQUAL(102, index.getLastChangeId());
+
+    // Changes already seen are not counted twice, and the position never goes back
+    index.addChanges({{90, "mock://a", "mock://c", "dteam"}, {102, "mock://a", "mock://c", "dteam"}}, now);
+    BOOST_CHECK_EQUAL(2, getPending(index).size());
+    BOOST_CHECK_EQUAL(102, index.getLastChangeId());
+}
+
+/**
+ * A change committed after higher ids is not skipped
+ */
+BOOST_AUTO_TEST_CASE (TestChangeCommittedLate)
+{
+    const time_t now = time(NULL);
+    QueueIndex index;
+    index.reload({}, 100, now);
+
+    // 101 and 102 are not committed yet
+    index.addChanges({{103, "mock://a", "mock://b", "dteam"}}, now);
+    BOOST_CHECK_EQUAL(100, index.getLastChangeId());
+    BOOST_CHECK_EQUAL(1, getPending(index).size());
+
+    // Read again from the position, 103 is not counted twice
+    index.addChanges({{102, "mock://a", "mock://c", "dteam"}, {103, "mock://a", "mock://b", "dteam"}}, now);
+    BOOST_CHECK_EQUAL(100, index.getLastChangeId());
+    BOOST_CHECK_EQUAL(2, getPending(index).size());
+
+    index.addChanges({
+        {101, "mock://a", "mock://d", "dteam"},
+        {102, "mock://a", "mock://c", "dteam"},
+        {103, "mock://a", "mock://b", "dteam"}
+    }, now);
+    BOOST_CHECK_EQUAL(103, index.getLastChangeId());
+    BOOST_CHECK_EQUAL(3, getPending(index).size());
+
+    index.transferScheduled(1, "mock://a", "mock://b", "dteam");
+    BOOST_CHECK_EQUAL(2, getPending(index).size());
+}
+
+/**
+ * Changes that never show up (rolled back) are given up on after a while
+ */
+BOOST_AUTO_TEST_CASE (TestChangeRolledBack)
+{
+    const time_t now = time(NULL);
+    QueueIndex index;
+    index.reload({}, 100, now);
+
+    index.addChanges({{102, "mock://a", "mock://b", "dteam"}}, now);
+    BOOST_CHECK_EQUAL(100, index.getLastChangeId());
+
+    index.addChanges({{102, "mock://a", "mock://b", "dteam"}}, now + 30);
+    BOOST_CHECK_EQUAL(100, index.getLastChangeId());
+
+    index.addChanges({{102, "mock://a", "mock://b", "dteam"}}, now + 3600);
+    BOOST_CHECK_EQUAL(102, index.getLastChangeId());
+    BOOST_CHECK_EQUAL(1, getPending(index).size());
+}
+
+/**
+ * A reconcile does not move the position in the log past the changes still missing
+ */
+BOOST_AUTO_TEST_CASE (TestReloadKeepsPosition)
+{
+    const time_t now = time(NULL);
+    QueueIndex index;
+    index.reload({}, 100, now);
+
+    index.skipChanges({{102, "mock://a", "mock://b", "dteam"}}, now);
+    index.reload({{"mock://a", "mock://b", "dteam", 1, 0}}, 102, now);
+    BOOST_CHECK_EQUAL(100, index.getLastChangeId());
+
+    // Covered by the reload
+    index.addChanges({{102, "mock://a", "mock://b", "dteam"}}, now);
+    std::vector<QueueId> pending = getPending(index);
+    BOOST_CHECK_EQUAL(1, pending.size());
+
+    // Committed after the reload
+    index.addChanges({{101, "mock://a", "mock://c", "dteam"}, {102, "mock://a", "mock://b", "dteam"}}, now);
+    BOOST_CHECK_EQUAL(102, index.getLastChangeId());
+    BOOST_CHECK_EQUAL(2, getPending(index).size());
+}
+
+/**
+ * Follow a transfer from the queue until it finishes
+ */
+BOOST_AUTO_TEST_CASE (TestScheduleAndTerminate)
+{
+    QueueIndex index;
+    index.reload({{"mock://a", "mock://b", "dteam", 1, 0}}, 100, time(NULL));
+
+    index.transferScheduled(42, "mock://a", "mock://b", "dteam");
+    BOOST_CHECK(getPending(index).empty());
+
+    index.addChanges({{101, "mock://a", "mock://b", "dteam"}}, time(NULL));
+    std::vector<QueueId> pending = getPending(index);
+    BOOST_CHECK_EQUAL(1, pending.size());
+    BOOST_CHECK_EQUAL(1, pending[0].activeCount);
+
+    index.transferTerminated(42);
+    pending = getPending(index);
+    BOOST_CHECK_EQUAL(1, pending.size());
+    BOOST_CHECK_EQUAL(0, pending[0].activeCount);
+
+    // Unknown or repeated notifications are ignored
+    index.transferTerminated(42);
+    index.transferTerminated(1000);
+    pending = getPending(index);
+    BOOST_CHECK_EQUAL(0, pending[0].activeCount);
+}
+
+/**
+ * A retried transfer goes back to the queue
+ */
+BOOST_AUTO_TEST_CASE (TestRequeue)
+{
+    QueueIndex index;
+    index.reload({{"mock://a", "mock://b", "dteam", 1, 0}}, 100, time(NULL));
+
+    index.transferScheduled(42, "mock://a", "mock://b", "dteam");
+    BOOST_CHECK(getPending(index).empty());
+
+    // Queued again once the change is read from the log
+    index.transferRequeued(42);
+    BOOST_CHECK(getPending(index).empty());
+
+    index.addChanges({{101, "mock://a", "mock://b", "dteam"}}, time(NULL));
+    std::vector<QueueId> pending = getPending(index);
+    BOOST_CHECK_EQUAL(1, pending.size());
+    BOOST_CHECK_EQUAL(0, pending[0].activeCount);
+}
+
+/**
+ * A transfer started before a reload can still be terminated afterwards
+ */
+BOOST_AUTO_TEST_CASE (TestTerminateAfterReload)
+{
+    QueueIndex index;
+    index.reload({{"mock://a", "mock://b", "dteam", 2, 0}}, 100, time(NULL));
+    index.transferScheduled(42, "mock://a", "mock://b", "dteam");
+
+    index.reload({{"mock://a", "mock://b", "dteam", 1, 1}}, 100, time(NULL));
+    index.transferTerminated(42);
+
+    std::vector<QueueId> pending = getPending(index);
+    BOOST_CHECK_EQUAL(1, pending.size());
+    BOOST_CHECK_EQUAL(0, pending[0].activeCount);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+#include <unistd.h>
+
+#include "common/PidTools.h"
+#include "server/services/transfers/ThreadSafeList.h"
+
+using fts3::events::MessageUpdater;
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(ThreadSafeListTestSuite)
+
+
+/// Watch list fed with the pings of the url-copy processes
+struct ThreadSafeListFixture {
+    ThreadSafeList list;
+
+    static uint64_t nowMs() {
+        return time(NULL) * 1000ull;
+    }
+
+    static MessageUpdater getPing(const std::string &jobId, uint64_t fileId, uint64_t pid, uint64_t timestamp) {
+        MessageUpdater msg;
+        msg.set_job_id(jobId);
+        msg.set_file_id(fileId);
+        msg.set_process_id(pid);
+        msg.set_timestamp(timestamp);
+        return msg;
+    }
+
+    void addWatch(const std::string &jobId, uint64_t fileId, uint64_t pid, uint64_t timestamp) {
+        MessageUpdater msg = getPing(jobId, fileId, pid, timestamp);
+        list.push_back(msg);
+    }
+
+    void ping(const std::string &jobId, uint64_t fileId, uint64_t pid, uint64_t timestamp) {
+        MessageUpdater msg = getPing(jobId, fileId, pid, timestamp);
+        list.updateMsg(msg);
+    }
+
+    std::vector<MessageUpdater> getExpired(int seconds) {
+        std::vector<MessageUpdater> expired;
+        list.checkExpiredMsg(expired, boost::posix_time::seconds(seconds));
+        return expired;
+    }
+};
+
+/**
+ * Only entries not heard of for longer than the timeout are expired
+ */
+BOOST_FIXTURE_TEST_CASE (TestExpired, ThreadSafeListFixture)
+{
+    addWatch("1906cc40-b915-11e5-9a03-02163e006dd0", 1, 100, nowMs() - 600000);
+    addWatch("1906cc40-b915-11e5-9a03-02163e006dd0", 2, 101, nowMs());
+
+    std::vector<MessageUpdater> expired = getExpired(300);
+    BOOST_CHECK_EQUAL(1, expired.size());
+    BOOST_CHECK_EQUAL(1, expired[0].file_id());
+
+    list.deleteMsg(expired);
+    BOOST_CHECK_EQUAL(1, list.size());
+    BOOST_CHECK(getExpired(300).empty());
+}
+
+/**
+ * A ping refreshes every transfer run by the process, so they are not expired
+ */
+BOOST_FIXTURE_TEST_CASE (TestUpdate, ThreadSafeListFixture)
+{
+    const uint64_t pid = getpid();
+    const uint64_t startTime = fts3::common::getPidStartime(pid);
+    BOOST_REQUIRE(startTime > 0);
+
+    // Session reuse: one process, several files
+    addWatch("5b9e7a3c-b915-11e5-9a03-02163e006dd0", 1, pid, nowMs() - 120000);
+    addWatch("5b9e7a3c-b915-11e5-9a03-02163e006dd0", 2, pid, nowMs() - 120000);
+    BOOST_CHECK_EQUAL(2, getExpired(60).size());
+
+    ping("5b9e7a3c-b915-11e5-9a03-02163e006dd0", 1, pid, nowMs());
+    BOOST_CHECK(getExpired(60).empty());
+
+    // A message older than the process is ignored
+    ping("5b9e7a3c-b915-11e5-9a03-02163e006dd0", 1, pid, startTime - 10000);
+    BOOST_CHECK(getExpired(60).empty());
+}
+
+/**
+ * There is a single entry per transfer
+ */
+BOOST_FIXTURE_TEST_CASE (TestUnique, ThreadSafeListFixture)
+{
+    addWatch("8a3e9a3c-b915-11e5-9a03-02163e006dd0", 1, 100, nowMs());
+    addWatch("8a3e9a3c-b915-11e5-9a03-02163e006dd0", 1, 200, nowMs());
+    BOOST_CHECK_EQUAL(1, list.size());
+
+    list.removeFinishedTr("8a3e9a3c-b915-11e5-9a03-02163e006dd0", 1);
+    BOOST_CHECK_EQUAL(0, list.size());
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+
+#include <csignal>
+#include <cstdlib>
+
+#include <boost/filesystem.hpp>
+
+#include "config/ServerConfig.h"
+#include "server/services/transfers/QueueIndex.h"
+#include "server/services/transfers/TransferLauncher.h"
+
+#include "MockDb.h"
+
+using namespace fts3::server;
+using fts3::config::ServerConfig;
+
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(TransferLauncherTestSuite)
+
+
+/// Runs the launcher against MockDb, with an fts_url_copy that exits right away
+struct TransferLauncherFixture {
+    MockDb db;
+    std::vector<TransferToLaunch> batch;
+    boost::filesystem::path binDir;
+    std::string path;
+
+    TransferLauncherFixture() {
+        std::vector<const char*> argv{
+            "executable", "--configfile=/dev/null", "--SiteName", "required", "--MonitoringMessaging=false"
+        };
+        ServerConfig::instance().read(argv.size(), (char**)argv.data());
+
+        binDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("launcher-%%%%%%");
+        boost::filesystem::create_directories(binDir);
+
+        path = getenv("PATH");
+        setenv("PATH", (binDir.string() + ":" + path).c_str(), 1);
+    }
+
+    ~TransferLauncherFixture() {
+        setenv("PATH", path.c_str(), 1);
+        boost::filesystem::remove_all(binDir);
+        // ExecuteProcess ignores SIGCHLD, do not let it leak into the other suites
+        signal(SIGCHLD, SIG_DFL);
+    }
+
+    void installUrlCopy() {
+        boost::filesystem::create_symlink("/bin/true", binDir / "fts_url_copy");
+    }
+
+    void addTransfer(uint64_t fileId, const std::string &jobId, const std::string &fileState = "SUBMITTED") {
+        TransferFile tf;
+        tf.fileId = fileId;
+        tf.jobId = jobId;
+        tf.fileState = fileState;
+        tf.sourceSurl = "mock://source/file" + std::to_string(fileId);
+        tf.destSurl = "mock://destination/file" + std::to_string(fileId);
+        tf.sourceSe = "mock://source";
+        tf.destSe = "mock://destination";
+        tf.voName = "dteam";
+        tf.jobMetadata = "null";
+        tf.archiveTimeout = -1;
+        batch.emplace_back(tf, "");
+    }
+};
+
+
+/**
+ * Each batch is claimed in a single call, and the pids are written back once the forks are done
+ */
+BOOST_FIXTURE_TEST_CASE (batching, TransferLauncherFixture)
+{
+    installUrlCopy();
+    TransferLauncher launcher(&db, 2, false, "", "fts3.cern.ch", "/tmp", "/tmp");
+
+    addTransfer(1, "job-a");
+    addTransfer(2, "job-a");
+    BOOST_CHECK_EQUAL(launcher.launch(batch), 2);
+
+    batch.clear();
+    addTransfer(3, "job-b");
+    BOOST_CHECK_EQUAL(launcher.launch(batch), 1);
+
+    launcher.flush();
+
+    BOOST_REQUIRE_EQUAL(db.claimBatches.size(), 2);
+    BOOST_CHECK_EQUAL(db.claimBatches[0].size(), 2);
+    BOOST_CHECK_EQUAL(db.claimBatches[1].size(), 1);
+    BOOST_CHECK_EQUAL(db.claimBatches[1][0], 3);
+
+    // The link configuration, with its number of active transfers, is resolved again for every batch
+    BOOST_CHECK_EQUAL(db.linkQueries, 2);
+
+    // One update per job and batch
+    BOOST_REQUIRE_EQUAL(db.jobStates.size(), 2);
+    BOOST_CHECK_EQUAL(db.jobStates[0].first, "job-a");
+    BOOST_CHECK_EQUAL(db.jobStates[0].second, "ACTIVE");
+    BOOST_CHECK_EQUAL(db.jobStates[1].first, "job-b");
+
+    BOOST_CHECK_EQUAL(db.pids.size(), 3);
+    BOOST_CHECK(db.transferStates.empty());
+}
+
+/**
+ * Transfers picked by another node are neither forked nor written back
+ */
+BOOST_FIXTURE_TEST_CASE (claimFailure, TransferLauncherFixture)
+{
+    installUrlCopy();
+    TransferLauncher launcher(&db, 1, false, "", "fts3.cern.ch", "/tmp", "/tmp");
+
+    db.taken.insert(2);
+    addTransfer(1, "job-a");
+    addTransfer(2, "job-b");
+    BOOST_CHECK_EQUAL(launcher.launch(batch), 1);
+    launcher.flush();
+
+    BOOST_REQUIRE_EQUAL(db.claimBatches.size(), 1);
+    BOOST_CHECK_EQUAL(db.claimBatches[0].size(), 2);
+
+    BOOST_CHECK_EQUAL(db.pids.size(), 1);
+    BOOST_CHECK_EQUAL(db.pids.count(1), 1);
+
+    // The job of the transfer not claimed is left alone
+    BOOST_REQUIRE_EQUAL(db.jobStates.size(), 1);
+    BOOST_CHECK_EQUAL(db.jobStates[0].first, "job-a");
+}
+
+/**
+ * The pid of the forked process is the one written back
+ */
+BOOST_FIXTURE_TEST_CASE (pidWriteBack, TransferLauncherFixture)
+{
+    installUrlCopy();
+    TransferLauncher launcher(&db, 1, false, "", "fts3.cern.ch", "/tmp", "/tmp");
+
+    addTransfer(1, "job-a");
+    launcher.launch(batch);
+    launcher.flush();
+
+    BOOST_REQUIRE_EQUAL(db.pids.count(1), 1);
+    BOOST_CHECK_GT(db.pids[1], 0);
+    BOOST_CHECK_NE(db.pids[1], getpid());
+}
+
+/**
+ * If fts_url_copy can not be run, the transfer and its job fail instead of getting a pid
+ */
+BOOST_FIXTURE_TEST_CASE (forkFailure, TransferLauncherFixture)
+{
+    setenv("PATH", binDir.string().c_str(), 1);
+    TransferLauncher launcher(&db, 1, false, "", "fts3.cern.ch", "/tmp", "/tmp");
+
+    addTransfer(1, "job-a");
+    BOOST_CHECK_EQUAL(launcher.launch(batch), 1);
+    launcher.flush();
+
+    BOOST_CHECK(db.pids.empty());
+    BOOST_REQUIRE_EQUAL(db.transferStates.size(), 1);
+    BOOST_CHECK_EQUAL(db.transferStates[0].first, 1);
+    BOOST_CHECK_EQUAL(db.transferStates[0].second, "FAILED");
+    BOOST_CHECK_EQUAL(db.jobStates.back().second, "FAILED");
+}
+
+/**
+ * Forced transfers were never counted as queued, so they do not take a slot off the queue
+ */
+BOOST_FIXTURE_TEST_CASE (forceStart, TransferLauncherFixture)
+{
+    installUrlCopy();
+    QueueIndex::instance().reload({{"mock://source", "mock://destination", "dteam", 1, 0}}, 0, time(NULL));
+    TransferLauncher launcher(&db, 1, false, "", "fts3.cern.ch", "/tmp", "/tmp");
+
+    addTransfer(1, "job-a", "FORCE_START");
+    BOOST_CHECK_EQUAL(launcher.launch(batch), 1);
+    launcher.flush();
+
+    std::vector<QueueId> pending;
+    QueueIndex::instance().getQueuesWithPending(pending);
+    BOOST_CHECK_EQUAL(pending.size(), 1);
+    QueueIndex::instance().reload({}, 0, time(NULL));
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -49,5 +49,21 @@ BOOST_AUTO_TEST_CASE (TestIpFlags)
     BOOST_CHECK_EQUAL(params.find("ipv6"), std::string::npos);
 }
 
+/**
+ * Test the arguments are generated one per entry, without splitting the values
+ */
+BOOST_AUTO_TEST_CASE (TestArguments)
+{
+    UrlCopyCmd cmd;
+    cmd.setIPv6(true);
+    cmd.setLogDir("/var/log/fts3/transfers");
+
+    std::vector<std::string> args = cmd.generateArguments();
+    BOOST_REQUIRE_EQUAL(args.size(), 3);
+    BOOST_CHECK_EQUAL(args[0], "--ipv6");
+    BOOST_CHECK_EQUAL(args[1], "--logDir");
+    BOOST_CHECK_EQUAL(args[2], "/var/log/fts3/transfers");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) CERN 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <boost/test/unit_test_suite.hpp>
+#include <boost/test/test_tools.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <boost/filesystem.hpp>
+
+#include "server/services/transfers/UrlCopyWorkerPool.h"
+
+using namespace fts3::server;
+
+
+BOOST_AUTO_TEST_SUITE(server)
+BOOST_AUTO_TEST_SUITE(UrlCopyWorkerPoolTestSuite)
+
+
+/// Plays the part of fts_url_copy --worker
+class FakeWorker {
+public:
+    int sock;
+
+    FakeWorker(const std::string &path, const std::string &key) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+        sock = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        BOOST_REQUIRE(sock >= 0);
+        BOOST_REQUIRE_EQUAL(connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)), 0);
+        send(std::string("HELLO") + '\0' + key);
+    }
+
+    ~FakeWorker() {
+        close(sock);
+    }
+
+    void send(const std::string &message) {
+        BOOST_REQUIRE_EQUAL(::send(sock, message.data(), message.size(), 0), static_cast<ssize_t>(message.size()));
+    }
+
+    /// Empty if the connection is closed
+    std::string receive() {
+        char buffer[1024];
+        ssize_t size = recv(sock, buffer, sizeof(buffer), 0);
+        return size > 0 ? std::string(buffer, size) : std::string();
+    }
+};
+
+
+static std::string socketPath()
+{
+    return (boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("url_copy-%%%%%%.sock")).string();
+}
+
+
+/// Wait for the pool to see the change
+static bool waitIdle(UrlCopyWorkerPool &pool, size_t expected)
+{
+    for (int i = 0; i < 100; ++i) {
+        if (pool.idleCount() == expected) {
+            return true;
+        }
+        usleep(50000);
+    }
+    return false;
+}
+
+
+BOOST_AUTO_TEST_CASE (assign)
+{
+    const std::string path = socketPath();
+    UrlCopyWorkerPool &pool = UrlCopyWorkerPool::instance();
+    // A worker that exits right away, so only the fake ones ever connect
+    pool.start("true", path, 1, 10, 300);
+    BOOST_CHECK(pool.isRunning());
+
+    std::vector<std::string> args;
+    args.push_back("--file-id");
+    args.push_back("42");
+
+    // Nobody connected yet
+    pid_t pid = 0;
+    BOOST_CHECK(!pool.assign("/tmp/x509up_h1", args, 42, &pid));
+
+    FakeWorker worker(path, "/tmp/x509up_h1");
+    BOOST_REQUIRE(waitIdle(pool, 1));
+
+    // Other credentials are not sent to it
+    BOOST_CHECK(!pool.assign("/tmp/x509up_h2", args, 42, &pid));
+
+    BOOST_CHECK(pool.assign("/tmp/x509up_h1", args, 42, &pid));
+    BOOST_CHECK_EQUAL(pid, getpid());
+    BOOST_CHECK_EQUAL(worker.receive(), std::string("--file-id\0" "42\0", 13));
+    BOOST_CHECK_EQUAL(pool.idleCount(), 0);
+
+    // Busy, and the limit is one worker
+    BOOST_CHECK(!pool.assign("/tmp/x509up_h1", args, 42, &pid));
+
+    worker.send("READY");
+    BOOST_REQUIRE(waitIdle(pool, 1));
+    BOOST_CHECK(pool.assign("/tmp/x509up_h1", args, 42, &pid));
+    worker.receive();
+
+    // Exits after this one
+    worker.send("BYE");
+    BOOST_CHECK(!pool.assign("/tmp/x509up_h1", args, 42, &pid));
+
+    pool.stop();
+    BOOST_CHECK(!pool.isRunning());
+    BOOST_CHECK(!boost::filesystem::exists(path));
+    BOOST_CHECK_EQUAL(worker.receive(), std::string());
+}
+
+
+BOOST_AUTO_TEST_CASE (cancel)
+{
+    const std::string path = socketPath();
+    UrlCopyWorkerPool &pool = UrlCopyWorkerPool::instance();
+    pool.start("true", path, 1, 10, 300);
+
+    std::vector<std::string> args;
+    args.push_back("--file-id");
+    args.push_back("42");
+
+    FakeWorker worker(path, "-");
+    BOOST_REQUIRE(waitIdle(pool, 1));
+
+    // Idle, so it is not running the transfer
+    BOOST_CHECK(!pool.cancel(42));
+    BOOST_CHECK(!pool.mayKill(getpid(), 42));
+    // Not a worker
+    BOOST_CHECK(pool.mayKill(getpid() + 1, 42));
+
+    pid_t pid = 0;
+    BOOST_REQUIRE(pool.assign("-", args, 42, &pid));
+    worker.receive();
+    BOOST_CHECK(pool.mayKill(pid, 42));
+    BOOST_CHECK(!pool.mayKill(pid, 43));
+
+    BOOST_CHECK(!pool.cancel(43));
+    BOOST_CHECK(pool.cancel(42));
+    BOOST_CHECK_EQUAL(worker.receive(), std::string("CANCEL\0" "42", 9));
+
+    // Done with it, and running the next one
+    worker.send("READY");
+    BOOST_REQUIRE(waitIdle(pool, 1));
+    args[1] = "43";
+    BOOST_REQUIRE(pool.assign("-", args, 43, &pid));
+    worker.receive();
+    BOOST_CHECK(!pool.cancel(42));
+    BOOST_CHECK(!pool.mayKill(pid, 42));
+    BOOST_CHECK(pool.mayKill(pid, 43));
+
+    pool.stop();
+}
+
+
+BOOST_AUTO_TEST_CASE (idleTimeout)
+{
+    const std::string path = socketPath();
+    UrlCopyWorkerPool &pool = UrlCopyWorkerPool::instance();
+    pool.start("true", path, 1, 10, 1);
+
+    FakeWorker worker(path, "-");
+    BOOST_REQUIRE(waitIdle(pool, 1));
+
+    // Told to exit
+    BOOST_CHECK_EQUAL(worker.receive(), std::string());
+    BOOST_CHECK(waitIdle(pool, 0));
+
+    pool.stop();
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
+BOOST_AUTO_TEST_SUITE_END()
@@ -72,6 +72,12 @@ BOOST_FIXTURE_TEST_CASE (simpleTransfer, UrlCopyFixture)
     BOOST_CHECK_NE(c.stats.process.end, 0);
     BOOST_CHECK_NE(c.stats.transfer.start, 0);
     BOOST_CHECK_NE(c.stats.transfer.end, 0);
+    BOOST_CHECK_NE(c.stats.sourceStat.start, 0);
+    BOOST_CHECK_NE(c.stats.destinationStat.start, 0);
+    BOOST_CHECK_NE(c.stats.finalization.start, 0);
+    BOOST_CHECK_LE(c.stats.preparation.start, c.stats.sourceStat.start);
+    BOOST_CHECK_LE(c.stats.preparation.end, c.stats.transfer.start);
+    BOOST_CHECK_LE(c.stats.transfer.end, c.stats.finalization.end);
 }
 
 
@@ -179,6 +185,98 @@ BOOST_FIXTURE_TEST_CASE (multipleSimple, UrlCopyFixture)
 }
 
 
+BOOST_FIXTURE_TEST_CASE (multiplePrefetch, UrlCopyFixture)
+{
+    Transfer original, original2;
+    original.source = Uri::parse("mock://host/path?size=10");
+    original.destination = Uri::parse("mock://host/path?size_post=10&time=2");
+    original2.source = Uri::parse("mock://host/path2?size=42");
+    original2.destination = Uri::parse("mock://host/path2?size_post=42&time=1");
+    opts.transfers.push_back(original);
+    opts.transfers.push_back(original2);
+
+    UrlCopyProcess proc(opts, *this);
+    proc.run();
+
+    BOOST_CHECK_EQUAL(startMsgs.size(), 2);
+    BOOST_CHECK_EQUAL(completedMsgs.size(), 2);
+
+    Transfer first = completedMsgs.front();
+    completedMsgs.pop_front();
+    Transfer second = completedMsgs.front();
+
+    BOOST_CHECK_EQUAL(first.error.get(), (void*)NULL);
+    BOOST_CHECK_EQUAL(second.error.get(), (void*)NULL);
+    BOOST_CHECK_EQUAL(second.fileSize, 42);
+
+    // The second one was prepared while the first one was copied
+    BOOST_CHECK_NE(second.stats.preparation.end, 0);
+    BOOST_CHECK_LT(second.stats.preparation.start, first.stats.transfer.end);
+    BOOST_CHECK_LE(first.stats.process.end, second.stats.transfer.start);
+}
+
+
+BOOST_FIXTURE_TEST_CASE (multipleConcurrent, UrlCopyFixture)
+{
+    Transfer original, original2;
+    original.source = Uri::parse("mock://host/path?size=10");
+    original.destination = Uri::parse("mock://host/path?size_post=10&time=4");
+    original2.source = Uri::parse("mock://host/path2?size=42");
+    original2.destination = Uri::parse("mock://host/path2?size_post=42&time=1");
+    opts.transfers.push_back(original);
+    opts.transfers.push_back(original2);
+    opts.concurrency = 2;
+
+    time_t start = time(NULL);
+    UrlCopyProcess proc(opts, *this);
+    proc.run();
+
+    // One after the other would take at least 5 seconds
+    BOOST_CHECK_LT(time(NULL) - start, 5);
+
+    BOOST_CHECK_EQUAL(startMsgs.size(), 2);
+    BOOST_CHECK_EQUAL(completedMsgs.size(), 2);
+
+    // The shorter one finishes first
+    Transfer c = completedMsgs.front();
+    BOOST_CHECK_EQUAL(c.error.get(), (void*)NULL);
+    BOOST_CHECK_EQUAL(c.fileSize, 42);
+
+    completedMsgs.pop_front();
+    c = completedMsgs.front();
+    BOOST_CHECK_EQUAL(c.error.get(), (void*)NULL);
+    BOOST_CHECK_EQUAL(c.fileSize, 10);
+}
+
+
+BOOST_FIXTURE_TEST_CASE (multipleConcurrentPrefetch, UrlCopyFixture)
+{
+    Transfer original, original2, original3;
+    original.source = Uri::parse("mock://host/path?size=10");
+    original.destination = Uri::parse("mock://host/path?size_post=10&time=4");
+    original2.source = Uri::parse("mock://host/path2?size=42");
+    original2.destination = Uri::parse("mock://host/path2?size_post=42&time=1");
+    original3.source = Uri::parse("mock://host/path3?size=21");
+    original3.destination = Uri::parse("mock://host/path3?size_post=21&time=1");
+    opts.transfers.push_back(original);
+    opts.transfers.push_back(original2);
+    opts.transfers.push_back(original3);
+    opts.concurrency = 2;
+
+    UrlCopyProcess proc(opts, *this);
+    proc.run();
+
+    BOOST_CHECK_EQUAL(startMsgs.size(), 3);
+    BOOST_CHECK_EQUAL(completedMsgs.size(), 3);
+
+    // The last one does not wait for the long one, even if prefetched by its slot
+    for (auto c = completedMsgs.begin(); c != completedMsgs.end(); ++c) {
+        BOOST_CHECK_EQUAL(c->error.get(), (void*)NULL);
+    }
+    BOOST_CHECK_EQUAL(completedMsgs.back().fileSize, 10);
+}
+
+
 BOOST_FIXTURE_TEST_CASE (multipleCancel, UrlCopyFixture)
 {
     Transfer original, original2;